@@ -11,7 +11,8 @@ set(TEST_SRC_PATH "${PROJECT_PATH}/test")
 set(BENCH_SRC
     "${BENCH_SRC_PATH}/benchBtree.cpp"
     "${BENCH_SRC_PATH}/benchHashTable.cpp"
-    "${BENCH_SRC_PATH}/benchART.cpp")
+    "${BENCH_SRC_PATH}/benchART.cpp"
+    "${BENCH_SRC_PATH}/benchConcurrentMaps.cpp")
 set(RAND_INT_BENCH_SRC "${BENCH_SRC_PATH}/randIntBench.cpp")
 set(YCSB_SRC
     "${YCSB_SRC_PATH}/core/core_workload.cpp"
@@ -26,5 +27,6 @@ set(TEST_SRC
     "${TEST_SRC_PATH}/testConcurrentMapUtils.cpp"
     "${TEST_SRC_PATH}/testBtreeConcurrentMap.cpp"
     "${TEST_SRC_PATH}/testBtreeMap.cpp"
+    "${TEST_SRC_PATH}/testEpochManager.cpp"
     "${TEST_SRC_PATH}/testBase.cpp"
     "${TEST_SRC_PATH}/sha512.cpp")
@@ -1,13 +1,16 @@
 #pragma once
 
 #include "art_dump.h"
+#include "indexes/utils/PageAllocator.h"
 #include "indexes/utils/Utils.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cinttypes>
+#include <cstddef>
 #include <deque>
 #include <optional>
+#include <ostream>
 #include <utility>
 
 #define ART_DEBUG(expr)                                                        \
@@ -23,9 +26,50 @@
 namespace indexes::art {
 struct art_traits_default {
   static constexpr bool DEBUG = false;
+  // Store values (of trivially copyable types, that fit in a pointer) of
+  // leaves at the last level of the tree in their parent's child pointer,
+  // instead of a separately allocated leaf.
+  static constexpr bool EMBEDDED_LEAVES = true;
+
+  // Allocator of nodes (of each node type's size), used by concurrent_map.
+  // Must provide static `void *allocate()` and `void deallocate(void *)`.
+  template <std::size_t NodeSize>
+  using Allocator = indexes::utils::PagePool<NodeSize>;
 };
 
 struct art_traits_debug : art_traits_default {
   static constexpr bool DEBUG = true;
 };
+
+// Memory of a concurrent_map (see `concurrent_map::memory_usage`) by node
+// type. Leaves embedded in their parent take no memory of their own.
+struct art_memory_usage_t {
+  std::size_t num_node4 = 0;
+  std::size_t num_node16 = 0;
+  std::size_t num_node48 = 0;
+  std::size_t num_node256 = 0;
+  std::size_t num_leaves = 0;
+
+  // Of linked nodes
+  std::size_t inner_bytes = 0;
+  std::size_t leaf_bytes = 0;
+
+  // Of unlinked nodes pending reclamation
+  std::size_t retired_bytes = 0;
+
+  std::size_t total_bytes() const {
+    return inner_bytes + leaf_bytes + retired_bytes;
+  }
+
+  void dump(std::ostream &ostr) const {
+    ostr << "Num Node4 = " << num_node4 << "\n";
+    ostr << "Num Node16 = " << num_node16 << "\n";
+    ostr << "Num Node48 = " << num_node48 << "\n";
+    ostr << "Num Node256 = " << num_node256 << "\n";
+    ostr << "Num Leaves = " << num_leaves << "\n";
+    ostr << "Inner Bytes = " << inner_bytes << "\n";
+    ostr << "Leaf Bytes = " << leaf_bytes << "\n";
+    ostr << "Retired Bytes = " << retired_bytes << "\n";
+  }
+};
 }
\ No newline at end of file
@@ -1,27 +1,168 @@
 // include/art/concurrent_map.h
-// Concurrent Adaptive Radix Tree implementation for Integer keys
+// Concurrent Adaptive Radix Tree implementation for Integer and binary keys
 
 #pragma once
 
 #include "common.h"
 #include "indexes/utils/EpochManager.h"
-#include "sync_prim/Mutex.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 namespace indexes::art {
-template <typename Value, typename Traits = art_traits_default>
+// Key encodings of concurrent_map. Keys are stored (`stored_type`) in nodes
+// as byte strings, such that no key is a prefix of another, so that every key
+// ends at a leaf. Inner nodes store (upto PREFIX_LENGTH bytes of) the prefix
+// of keys below them. Byte order of the stored keys is the order of keys
+// (`decode`d by iterators).
+
+// 64 bit integers, with their bytes in big endian order.
+struct integer_key {
+  using key_type = std::uint64_t;
+  using stored_type = std::uint64_t;
+  using decoded_type = std::uint64_t;
+
+  static constexpr int MAX_LENGTH = sizeof(stored_type);
+
+  static inline stored_type encode(key_type key) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return key;
+#else
+    return __builtin_bswap64(key);
+#endif
+  }
+
+  static inline decoded_type decode(const stored_type &key) {
+    return encode(key);
+  }
+
+  static inline const std::uint8_t *bytes(const stored_type &key) {
+    return reinterpret_cast<const std::uint8_t *>(&key);
+  }
+
+  static inline int length(const stored_type &) { return MAX_LENGTH; }
+
+  // # bytes of it's prefix an inner node stores, all of them.
+  static constexpr int PREFIX_LENGTH = MAX_LENGTH;
+
+  // Key of the first `len` bytes of `keyvec`, followed by `byte`, rest are
+  // zeroed.
+  static inline stored_type append(const std::uint8_t *keyvec, int len,
+                                   std::uint8_t byte) {
+    stored_type ret = 0;
+    auto retvec = reinterpret_cast<std::uint8_t *>(&ret);
+
+    std::copy(keyvec, keyvec + len, retvec);
+    retvec[len] = byte;
+
+    return ret;
+  }
+};
+
+// Arbitrary byte strings. 0x00 is escaped as 0x00 0xFF and every key is
+// terminated by 0x00 0x00, so that a key, which is a prefix of another, is
+// still stored in it's own leaf. Escaping preserves the lexicographic order of
+// keys. Throws std::length_error for keys longer than MAX_LENGTH (escaped).
+struct binary_key {
+  using key_type = std::string_view;
+  using stored_type = std::string;
+  using decoded_type = std::string;
+
+  static constexpr int MAX_LENGTH = std::numeric_limits<std::int16_t>::max();
+
+  static stored_type encode(key_type key) {
+    stored_type encoded;
+
+    encoded.reserve(key.size() + 2);
+
+    for (char c : key) {
+      encoded.push_back(c);
+
+      if (c == '\0') {
+        encoded.push_back('\xFF');
+      }
+    }
+
+    encoded.append(2, '\0');
+
+    if (encoded.size() > static_cast<std::size_t>(MAX_LENGTH)) {
+      throw std::length_error{"art::binary_key: key is too long"};
+    }
+
+    return encoded;
+  }
+
+  static decoded_type decode(const stored_type &key) {
+    decoded_type decoded;
+
+    decoded.reserve(key.size() - 2);
+
+    for (std::size_t i = 0; key[i] != '\0' || key[i + 1] != '\0'; i++) {
+      decoded.push_back(key[i]);
+
+      // Skip the escape of 0x00
+      if (key[i] == '\0') {
+        i++;
+      }
+    }
+
+    return decoded;
+  }
+
+  static inline const std::uint8_t *bytes(const stored_type &key) {
+    return reinterpret_cast<const std::uint8_t *>(key.data());
+  }
+
+  static inline int length(const stored_type &key) { return key.size(); }
+
+  // # bytes of it's prefix an inner node stores (the last ones), the rest
+  // are read from a leaf under it.
+  static constexpr int PREFIX_LENGTH = 16;
+
+  static inline stored_type append(const std::uint8_t *keyvec, int len,
+                                   std::uint8_t byte) {
+    stored_type ret(reinterpret_cast<const char *>(keyvec), len);
+
+    ret.push_back(static_cast<char>(byte));
+
+    return ret;
+  }
+};
+
+template <typename Value, typename Traits = art_traits_default,
+          typename KeyEncoding = integer_key>
 class concurrent_map {
 public:
-  using key_type = std::uint64_t;
+  using key_type = typename KeyEncoding::key_type;
   using value_type = Value;
 
 private:
-  static constexpr int KEYTYPE_SIZE = sizeof(key_type);
+  using stored_key_t = typename KeyEncoding::stored_type;
+
   static constexpr int NUM_BITS = 8;
   static constexpr int MAX_CHILDREN = 1 << NUM_BITS;
-  static constexpr int MAX_DEPTH = (KEYTYPE_SIZE * CHAR_BIT) / NUM_BITS;
+  static constexpr int MAX_DEPTH = KeyEncoding::MAX_LENGTH;
 
   using bytea = const std::uint8_t *_RESTRICT;
   using version_t = std::uint64_t;
@@ -61,6 +202,27 @@ private:
     }
   }
 
+  // First `depth` bytes of keys are known to be common.
+  static int common_prefix_length(const stored_key_t &k1,
+                                  const stored_key_t &k2, int depth) {
+    bytea keyvec1 = KeyEncoding::bytes(k1);
+    bytea keyvec2 = KeyEncoding::bytes(k2);
+    int maxlen = std::min(KeyEncoding::length(k1), KeyEncoding::length(k2));
+    int len = depth;
+
+    while (len < maxlen) {
+      if (keyvec1[len] != keyvec2[len]) {
+        break;
+      }
+
+      len++;
+    }
+
+    return len;
+  }
+
+  enum iter_direction { REVERSE, FORWARD };
+
   enum class node_type_t : std::uint8_t {
     LEAF,
     NODE4,
@@ -69,61 +231,56 @@ private:
     NODE256
   };
 
+  // Version of a node is also it's lock (optimistic lock coupling), writers
+  // set the LOCKED bit of the version they read the node at (see
+  // `try_lock`), and increment the version with every change of the node. A
+  // deleted node is marked OBSOLETE, and is never locked again. Readers
+  // validate the version they read a node at, after reading it (see
+  // `is_valid`), and restart if it was locked or has changed since.
+  static constexpr version_t LOCKED = version_t{1} << 62;
+  static constexpr version_t OBSOLETE = version_t{1} << 63;
+
+  // Inner nodes store the last (upto) PREFIX_LENGTH bytes of their prefix
+  // (first `level` bytes of the keys below them), from `prefix_start` on, in
+  // place. Bytes of longer prefixes before it are those of any leaf under
+  // the node (optimistic path compression): `search` and `erase` skip them,
+  // as they compare the whole key at the leaf, others read them from a leaf
+  // (see `prefix_view`).
+  static constexpr int PREFIX_LENGTH = KeyEncoding::PREFIX_LENGTH;
+
+  static constexpr int prefix_start(int level) {
+    return std::max(0, level - PREFIX_LENGTH);
+  }
+
   struct node_t {
     const node_type_t node_type;
-    const std::int8_t level;
+    const std::int16_t level;
     std::atomic<std::int16_t> num_children;
     std::atomic<std::int16_t> num_deleted;
 
-    const key_type key;
     std::atomic<version_t> version;
-    sync_prim::mutex::Mutex m;
-
-    static constexpr version_t DEAD_VERSION =
-        std::numeric_limits<version_t>::max();
 
-    node_t(node_type_t a_node_type, key_type a_key, std::int8_t a_level)
+    node_t(node_type_t a_node_type, std::int16_t a_level)
         : node_type(a_node_type), level(a_level), num_children(0),
-          num_deleted(0), key(a_key), version(0), m() {}
-
-    constexpr int get_ind(key_type key) const {
-      return reinterpret_cast<bytea>(&key)[level];
-    }
-
-    constexpr int longest_common_prefix_length(key_type otherkey) const {
-      auto keyvec = reinterpret_cast<bytea>(&key);
-      auto otherkeyvec = reinterpret_cast<bytea>(&otherkey);
-      int len = 0;
-
-      while (len < KEYTYPE_SIZE) {
-        if (keyvec[len] != otherkeyvec[len]) {
-          break;
-        }
-
-        len++;
-      }
+          num_deleted(0), version(0) {}
 
-      return len;
-    }
-
-    static constexpr key_type extract_common_prefix(key_type key, int lcpl) {
-      key_type ret = 0;
-      auto keyvec = reinterpret_cast<bytea>(&key);
-      auto retvec = reinterpret_cast<std::uint8_t * _RESTRICT>(&ret);
-      std::copy(keyvec, keyvec + lcpl, retvec);
-
-      return ret;
+    int get_ind(const stored_key_t &key) const {
+      return KeyEncoding::bytes(key)[level];
     }
 
     constexpr int size() const { return num_children - num_deleted; }
     constexpr bool is_leaf() const { return node_type == node_type_t::LEAF; }
 
-    constexpr void mark_as_deleted() {
-      concurrent_map::store_rs(version, DEAD_VERSION);
+    bool is_locked() const { return load_rx(version) & LOCKED; }
+
+    // Must be called under the node's lock.
+    void increment_version() {
+      concurrent_map::store_rs(version, load_rx(version) + 1);
     }
 
-    constexpr bool is_deleted() const {
-      return load_aq(version) == DEAD_VERSION;
+    void mark_as_deleted() {
+      ART_DEBUG_ASSERT(is_locked());
+      concurrent_map::store_rs(version, load_rx(version) | OBSOLETE);
     }
 
     bool equals(const node_t *other) const {
@@ -162,7 +319,7 @@ private:
     bool add(node_t *child, std::uint8_t ind) {
       bool ret = false;
 
-      ART_DEBUG_ASSERT(m.is_locked());
+      ART_DEBUG_ASSERT(is_locked());
 
       switch (node_type) {
       case node_type_t::NODE4:
@@ -186,21 +343,19 @@ private:
       }
 
       if (ret) {
-        concurrent_map::store_rs(version, load_aq(version) + 1);
+        increment_version();
       }
 
       return ret;
     }
 
     node_t *find(int key) const { return find(static_cast<std::uint8_t>(key)); }
-    node_t *find(key_type key) const { return find(get_ind(key)); }
-    bool add(node_t *child) { return add(child, get_ind(child->key)); }
+    node_t *find(const stored_key_t &key) const { return find(get_ind(key)); }
 
-    node_t *update(node_t *child) {
+    node_t *update(node_t *child, std::uint8_t ind) {
       ART_DEBUG_ASSERT(this->size() != 0);
-      ART_DEBUG_ASSERT(m.is_locked());
+      ART_DEBUG_ASSERT(is_locked());
 
-      std::uint8_t ind = get_ind(child->key);
       node_t *ret = nullptr;
 
       switch (node_type) {
@@ -224,16 +379,14 @@ private:
         ART_DEBUG_ASSERT("add called for leaf");
       }
 
-      concurrent_map::store_rs(version, load_aq(version) + 1);
+      increment_version();
 
       return ret;
     }
 
-    void remove(key_type key) {
+    void remove(std::uint8_t ind) {
       ART_DEBUG_ASSERT(this->size() != 0);
-      ART_DEBUG_ASSERT(m.is_locked());
-
-      std::uint8_t ind = get_ind(key);
+      ART_DEBUG_ASSERT(is_locked());
 
       switch (node_type) {
       case node_type_t::NODE4:
@@ -256,27 +409,21 @@ private:
         ART_DEBUG_ASSERT("add called for leaf");
       }
 
-      concurrent_map::store_rs(version, load_aq(version) + 1);
+      increment_version();
     }
 
     node_t *expand() const {
       ART_DEBUG_ASSERT(this->size() != 0);
-      ART_DEBUG_ASSERT(m.is_locked());
+      ART_DEBUG_ASSERT(is_locked());
 
       switch (node_type) {
+      // Full node4 and node16 have no deleted slots, as they are compacted
+      // in place instead (see `node4_t::add`).
       case node_type_t::NODE4:
-        if (this->num_deleted) {
-          return new node4_t(static_cast<const node4_t *>(this));
-        } else {
-          return new node16_t(static_cast<const node4_t *>(this));
-        }
+        return new node16_t(static_cast<const node4_t *>(this));
 
       case node_type_t::NODE16:
-        if (this->num_deleted) {
-          return new node16_t(static_cast<const node16_t *>(this));
-        } else {
-          return new node48_t(static_cast<const node16_t *>(this));
-        }
+        return new node48_t(static_cast<const node16_t *>(this));
 
       case node_type_t::NODE48:
         return new node256_t(static_cast<const node48_t *>(this));
@@ -315,7 +462,7 @@ private:
 
     node_t *shrink() const {
       ART_DEBUG_ASSERT(this->size() != 0);
-      ART_DEBUG_ASSERT(m.is_locked());
+      ART_DEBUG_ASSERT(is_locked());
 
       switch (node_type) {
       case node_type_t::NODE4:
@@ -339,7 +486,7 @@ private:
 
     static void free(node_t *node) {
       ART_DEBUG_ASSERT(node->is_leaf() || node->size() != 0);
-      ART_DEBUG_ASSERT(!node->m.is_locked());
+      ART_DEBUG_ASSERT(!node->is_locked());
 
       switch (node->node_type) {
       case node_type_t::NODE4:
@@ -364,12 +511,71 @@ private:
       }
     }
 
+    static std::size_t size_of(node_t *node) {
+      switch (node->node_type) {
+      case node_type_t::NODE4:
+        return sizeof(node4_t);
+
+      case node_type_t::NODE16:
+        return sizeof(node16_t);
+
+      case node_type_t::NODE48:
+        return sizeof(node48_t);
+
+      case node_type_t::NODE256:
+        return sizeof(node256_t);
+
+      case node_type_t::LEAF:
+        return sizeof(leaf_t);
+      }
+
+      return 0;
+    }
+
+    // Child with the smallest byte >= `from` (FORWARD) or the largest byte
+    // <= `from` (REVERSE) and it's byte, or nullptr if there is none.
+    template <iter_direction IDir>
+    std::pair<int, node_t *> next_child(int from) const {
+      auto step = [](int ind) { return IDir == FORWARD ? ind + 1 : ind - 1; };
+
+      auto find_from = [&](const auto *node) -> std::pair<int, node_t *> {
+        for (int ind = from; ind >= 0 && ind < MAX_CHILDREN; ind = step(ind)) {
+          if (node_t *child = node->find(static_cast<std::uint8_t>(ind))) {
+            return {ind, child};
+          }
+        }
+
+        return {-1, nullptr};
+      };
+
+      switch (node_type) {
+      case node_type_t::NODE4:
+        return node4_t::template next_child<IDir>(
+            static_cast<const node4_t *>(this), from);
+
+      case node_type_t::NODE16:
+        return node4_t::template next_child<IDir>(
+            static_cast<const node16_t *>(this), from);
+
+      case node_type_t::NODE48:
+        return find_from(static_cast<const node48_t *>(this));
+
+      case node_type_t::NODE256:
+        return find_from(static_cast<const node256_t *>(this));
+
+      case node_type_t::LEAF:
+        ART_DEBUG_ASSERT("next_child called for leaf");
+      }
+
+      return {-1, nullptr};
+    }
+
     template <typename Cont> void get_children(Cont &nodes) const {
       if (!is_leaf()) {
         for (int i = 0; i < MAX_CHILDREN; i++) {
           node_t *child = find(i);
 
-          if (child) {
+          if (child && !is_embedded(child)) {
             nodes.push_back(child);
           }
         }
@@ -385,216 +591,664 @@ private:
   struct node256_t;
   struct leaf_t;
 
-  struct leaf_t : node_t {
-    value_type value;
+  // Every node type (size class) is allocated from it's own pool of fixed
+  // size blocks (Traits::Allocator), with per thread free lists, so nodes
+  // freed after their grace period (see `node_t::free`) are reused, without
+  // going to the global heap.
+  template <typename Node> struct pooled_t {
+    static void *operator new(std::size_t size) {
+      ART_DEBUG_ASSERT(size == sizeof(Node));
+      ART_DEBUG_ONLY(size);
+
+      return Traits::template Allocator<sizeof(Node)>::allocate();
+    }
 
-    leaf_t(key_type key, value_type a_value)
-        : node_t(node_type_t::LEAF, key, KEYTYPE_SIZE), value(a_value) {}
+    static void operator delete(void *node) {
+      Traits::template Allocator<sizeof(Node)>::deallocate(node);
+    }
   };
 
-  using atomic_key_t = std::atomic<std::uint8_t>;
-  using atomic_node_t = std::atomic<node_t *>;
+  struct leaf_t : node_t, pooled_t<leaf_t> {
+    const stored_key_t key;
+    value_type value;
 
-  struct node4_t : node_t {
-    static constexpr int MAX_CHILDREN = 4;
-    static constexpr int MAX_KEYS = 4;
+    leaf_t(const stored_key_t &a_key, value_type a_value)
+        : node_t(node_type_t::LEAF, KeyEncoding::length(a_key)), key(a_key),
+          value(a_value) {}
+  };
 
-    atomic_key_t keys[MAX_CHILDREN];
-    atomic_node_t children[MAX_CHILDREN];
+  // Base of node4_t ... node256_t, with the bytes of the prefix from
+  // `prefix_start` to `level`.
+  struct inner_node_t : node_t {
+    std::uint8_t prefix[PREFIX_LENGTH];
 
-    node4_t(key_type key, std::int8_t level)
-        : node_t(node_type_t::NODE4, key, level) {
-      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
-    }
+    // Prefix is the first `level` bytes of `key`.
+    inner_node_t(node_type_t a_node_type, const stored_key_t &key,
+                 std::int16_t a_level)
+        : node_t(a_node_type, a_level) {
+      bytea keyvec = KeyEncoding::bytes(key);
+      int start = prefix_start(a_level);
 
-    node4_t(const node16_t *node) : node4_t(node->key, node->level) {
-      copy(this, node);
+      std::fill(prefix, prefix + PREFIX_LENGTH, 0);
+      std::copy(keyvec + start, keyvec + a_level, prefix);
     }
 
-    node4_t(const node4_t *node) : node4_t(node->key, node->level) {
-      copy(this, node);
+    // Prefix is same as `node`'s.
+    inner_node_t(node_type_t a_node_type, const inner_node_t *node)
+        : node_t(a_node_type, node->level) {
+      std::copy(node->prefix, node->prefix + PREFIX_LENGTH, prefix);
     }
+  };
 
-    template <typename NodeTypeDst, typename NodeTypeSrc>
-    static void copy(NodeTypeDst *dst, const NodeTypeSrc *src) {
-      ART_DEBUG_ASSERT(src->size() <= NodeTypeDst::MAX_CHILDREN);
+  // Leaves are embedded in their parent's child slot, as the value tagged
+  // with the lowest bit (child pointers are aligned), instead of a pointer to
+  // a leaf_t, if the value fits in the rest of the bits. Only children of
+  // nodes at the last level (MAX_DEPTH - 1) are embedded, as their keys are
+  // known from their path (see `child_key`) and so they are never expanded.
+  // Only if whole prefixes are stored in nodes, as an embedded leaf has no
+  // key to check skipped bytes (see PREFIX_LENGTH) against.
+  static constexpr bool EMBED_LEAVES =
+      Traits::EMBEDDED_LEAVES && PREFIX_LENGTH >= MAX_DEPTH - 1 &&
+      std::is_trivially_copyable_v<value_type> &&
+      std::is_default_constructible_v<value_type> &&
+      sizeof(value_type) <= sizeof(std::uintptr_t);
+
+  static constexpr std::uintptr_t EMBEDDED_TAG = 1;
+
+  static inline bool is_embedded(const node_t *child) {
+    return EMBED_LEAVES &&
+           (reinterpret_cast<std::uintptr_t>(child) & EMBEDDED_TAG);
+  }
 
-      int num_children = load_aq(src->num_children);
+  static inline value_type embedded_value(const node_t *child) {
+    if constexpr (EMBED_LEAVES) {
+      std::uintptr_t bits = reinterpret_cast<std::uintptr_t>(child) >> 1;
+      value_type value;
 
-      for (int i = 0; i < num_children; i++) {
-        if (load_aq(src->children[i])) {
-          dst->add(load_aq(src->children[i]), load_aq(src->keys[i]));
-        }
-      }
+      std::memcpy(&value, &bits, sizeof(value_type));
 
-      ART_DEBUG_ASSERT(dst->equals(src));
+      return value;
+    } else {
+      return static_cast<const leaf_t *>(child)->value;
     }
+  }
 
-    static void add(atomic_key_t *keys, atomic_node_t *children,
-                    std::atomic<std::int16_t> &num_children, node_t *node,
-                    std::uint8_t ind) {
-      int num_children_loc = load_aq(num_children);
+  // Leaf of `key` to be added to `parent`, embedded if possible.
+  static node_t *new_leaf(const node_t *parent, const stored_key_t &key,
+                          const value_type &value) {
+    return new_leaf(parent ? parent->level : -1, key, value);
+  }
 
-      concurrent_map::store_rs(keys[num_children_loc], ind);
-      concurrent_map::store_rs(children[num_children_loc], node);
-      concurrent_map::store_rs(num_children, num_children_loc + 1);
-    }
+  // Same as above, for a parent at `parent_level` (-1 for root).
+  static node_t *new_leaf(int parent_level, const stored_key_t &key,
+                          const value_type &value) {
+    if constexpr (EMBED_LEAVES) {
+      constexpr int PTR_BITS = sizeof(std::uintptr_t) * CHAR_BIT;
+      std::uintptr_t bits = 0;
 
-    static std::uint8_t find_pos(const atomic_key_t *keys,
-                                 const atomic_node_t *children,
-                                 int num_children, std::uint8_t ind) {
-      for (std::uint8_t pos = 0; pos < num_children; pos++) {
-        if (load_aq(children[pos]) && ind == load_aq(keys[pos])) {
-          return pos;
-        }
-      }
+      std::memcpy(&bits, &value, sizeof(value_type));
 
-      return num_children;
+      if (parent_level == MAX_DEPTH - 1 && (bits >> (PTR_BITS - 1)) == 0) {
+        return reinterpret_cast<node_t *>((bits << 1) | EMBEDDED_TAG);
+      }
     }
 
-    static node_t *find(const atomic_key_t *keys, const atomic_node_t *children,
-                        int num_children, std::uint8_t ind) {
-      std::uint8_t pos = find_pos(keys, children, num_children, ind);
+    return new leaf_t(key, value);
+  }
 
-      return pos < num_children ? load_aq(children[pos]) : nullptr;
+  static void free_leaf(node_t *leaf) {
+    if (!is_embedded(leaf)) {
+      delete static_cast<leaf_t *>(leaf);
     }
+  }
 
-    static void remove(const atomic_key_t *keys, atomic_node_t *children,
-                       std::atomic<std::int16_t> &num_children,
-                       std::atomic<std::int16_t> &num_deleted,
-                       std::uint8_t ind) {
-      std::uint8_t pos = find_pos(keys, children, load_aq(num_children), ind);
+  // Key of the child at `ind` of `node`.
+  static stored_key_t child_key(const node_t *node, std::uint8_t ind) {
+    ART_DEBUG_ASSERT(prefix_start(node->level) == 0);
 
-      ART_DEBUG_ASSERT(pos < num_children);
+    return KeyEncoding::append(static_cast<const inner_node_t *>(node)->prefix,
+                               node->level, ind);
+  }
 
-      concurrent_map::store_rs(children[pos], nullptr);
-      concurrent_map::store_rs(num_deleted, load_aq(num_deleted) + 1);
+  // Bytes of a node's prefix (or a leaf's key), byte `i` being at
+  // `bytes[i - offset]`.
+  struct prefix_view_t {
+    const std::uint8_t *bytes;
+    int offset;
+
+    std::uint8_t operator[](int i) const { return bytes[i - offset]; }
+  };
+
+  // Any leaf under `node`, or nullptr if there is none (or it is `stale`).
+  // Leaves under a node all have it's prefix, so the leaf is not validated:
+  // it's key never changes, and it is not freed before the caller's epoch
+  // ends, even if it was removed since. Must be called under an epoch.
+  static const leaf_t *any_leaf(const node_t *node, bool &stale) {
+    if (node->is_leaf()) {
+      return static_cast<const leaf_t *>(node);
     }
 
-    static node_t *update(atomic_key_t *keys, atomic_node_t *children,
-                          int num_children, std::uint8_t ind,
-                          node_t *new_child) {
-      std::uint8_t pos = find_pos(keys, children, num_children, ind);
+    version_t version = load_aq(node->version);
 
-      ART_DEBUG_ASSERT(pos < num_children);
+    for (int from = 0; from < MAX_CHILDREN;) {
+      auto [ind, child] = node->template next_child<FORWARD>(from);
 
-      return concurrent_map::xchg_rs(children[pos], new_child);
-    }
+      if (!is_valid(node, version, stale) || child == nullptr) {
+        return nullptr;
+      }
 
-    bool add(node_t *node, std::uint8_t ind) {
-      int num_children = load_aq(this->num_children);
+      if (!is_embedded(child)) {
+        if (const leaf_t *leaf = any_leaf(child, stale)) {
+          return leaf;
+        }
 
-      if (num_children != MAX_CHILDREN) {
-        add(keys, children, this->num_children, node, ind);
-        return true;
+        if (stale) {
+          return nullptr;
+        }
       }
 
-      return false;
+      from = ind + 1;
     }
 
-    bool add(node_t *node) { return add(node, this->get_ind(node->key)); }
+    return nullptr;
+  }
 
-    node_t *find(std::uint8_t ind) const {
-      const atomic_node_t *children = this->children;
-      return find(keys, children, load_aq(this->num_children), ind);
+  // `node`'s prefix (or key) from byte `from` on, read from any leaf under
+  // it, if it starts before the bytes stored in the node. Fails, if there is
+  // no such leaf (or it is `stale`).
+  static bool prefix_view(const node_t *node, int from, prefix_view_t &view,
+                          bool &stale) {
+    int start = prefix_start(node->level);
+
+    stale = false;
+
+    if (!node->is_leaf() && from >= start) {
+      view = {static_cast<const inner_node_t *>(node)->prefix, start};
+      return true;
     }
 
-    node_t *update(node_t *new_child, std::uint8_t ind) {
-      atomic_node_t *children = this->children;
-      return update(keys, children, load_aq(this->num_children), ind,
-                    new_child);
+    if (const leaf_t *leaf = any_leaf(node, stale)) {
+      view = {KeyEncoding::bytes(leaf->key), 0};
+      return true;
     }
 
-    void remove(std::uint8_t ind) {
-      remove(keys, children, this->num_children, this->num_deleted, ind);
+    return false;
+  }
+
+  // Length of the common prefix of `key` and `node`'s prefix (or key), upto
+  // the node's level. First `depth` bytes are known to be common.
+  static int common_prefix_length(const node_t *node,
+                                  const prefix_view_t &prefix,
+                                  const stored_key_t &key, int depth) {
+    bytea keyvec = KeyEncoding::bytes(key);
+    int maxlen = std::min<int>(node->level, KeyEncoding::length(key));
+    int len = depth;
+
+    while (len < maxlen && prefix[len] == keyvec[len]) {
+      len++;
     }
 
-    bool is_underfull() const { return this->size() <= 1; }
+    return len;
+  }
 
-    node_t *shrink() const {
-      ART_DEBUG_ASSERT(this->size() == 1);
+  // Whether `key` has inner `node`'s prefix from byte `depth` on, as far as
+  // the node stores it. Bytes before `prefix_start` are left to be compared
+  // at the leaf `key` leads to.
+  static bool prefix_matches(const node_t *node, const stored_key_t &key,
+                             int depth) {
+    auto inner = static_cast<const inner_node_t *>(node);
+    int level = node->level;
+    int start = prefix_start(level);
+    int from = std::max(depth, start);
+    bytea keyvec = KeyEncoding::bytes(key);
+
+    return KeyEncoding::length(key) > level &&
+           std::equal(keyvec + from, keyvec + level,
+                      inner->prefix + (from - start));
+  }
 
-      int num_children = load_aq(this->num_children);
+  using atomic_key_t = std::atomic<std::uint8_t>;
+  using atomic_node_t = std::atomic<node_t *>;
 
-      for (int i = 0; i < num_children; i++) {
-        node_t *child = load_aq(children[i]);
+  static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Keys must be loadable as atomic words");
 
-        if (child) {
-          return child;
-        }
-      }
+  // Keys of node4 and node16, packed into atomic words (one for node4, two
+  // for node16). A key is only written under the node's lock, by storing
+  // (`store_rs`) the whole word it is in, and readers load whole words, so
+  // that every access to the keys is atomic and of the same width. Reading
+  // all of the keys at once (see `match_keys`) takes one or two loads,
+  // instead of one per key. Keys within a word are read together, while
+  // words are read separately, but a reader validates the node's version
+  // after it's lookup, so a mix of keys from before and after a change (see
+  // `node4_t::add_or_compact`) is never used.
+  template <int NumKeys> struct packed_keys_t {
+    using word_t =
+        std::conditional_t<NumKeys == 4, std::uint32_t, std::uint64_t>;
 
-      return nullptr;
-    }
-  };
+    static constexpr int KEYS_PER_WORD = sizeof(word_t);
+    static constexpr int NUM_WORDS = NumKeys / KEYS_PER_WORD;
 
-  struct node16_t : node_t {
-    static constexpr int MAX_CHILDREN = 16;
-    static constexpr int MAX_KEYS = 16;
+    std::atomic<word_t> words[NUM_WORDS];
 
-    atomic_key_t keys[MAX_CHILDREN];
-    atomic_node_t children[MAX_CHILDREN];
+    packed_keys_t() { concurrent_map::fill_zero_rx(words, NUM_WORDS); }
 
-    node16_t(key_type key, std::int8_t level)
-        : node_t(node_type_t::NODE16, key, level) {
-      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
-    }
+    static inline std::uint8_t byte_at(word_t word, int pos) {
+      std::uint8_t bytes[KEYS_PER_WORD];
 
-    node16_t(const node4_t *node) : node16_t(node->key, node->level) {
-      node4_t::copy(this, node);
+      std::memcpy(bytes, &word, sizeof(word));
+      return bytes[pos];
     }
 
-    node16_t(const node16_t *node) : node16_t(node->key, node->level) {
-      node4_t::copy(this, node);
-    }
+    // Keys in their order in memory (key 0 in the lowest byte), whatever the
+    // byte order.
+    inline word_t load_word(int i) const {
+      word_t word = load_aq(words[i]);
 
-    node16_t(const node48_t *node) : node16_t(node->key, node->level) {
-      for (int i = 0, pos = 0; i < node48_t::MAX_KEYS; i++) {
-        std::uint8_t ind = load_aq(node->keys[i]);
-        if (ind) {
-          concurrent_map::store_rs(keys[pos], i);
-          concurrent_map::store_rs(children[pos],
-                                   load_aq(node->children[ind - 1]));
-          pos++;
-        }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+      if constexpr (KEYS_PER_WORD == 4) {
+        word = __builtin_bswap32(word);
+      } else {
+        word = __builtin_bswap64(word);
       }
+#endif
 
-      store_rs(this->num_children, load_aq(node->num_children));
+      return word;
+    }
 
-      ART_DEBUG_ASSERT(this->equals(node));
+    inline std::uint8_t get(int pos) const {
+      return byte_at(load_aq(words[pos / KEYS_PER_WORD]), pos % KEYS_PER_WORD);
     }
 
-    bool add(node_t *node, std::uint8_t ind) {
-      int num_children = load_aq(this->num_children);
+    // All keys, a word at a time.
+    void get_all(std::uint8_t (&keys)[NumKeys]) const {
+      for (int i = 0; i < NUM_WORDS; i++) {
+        word_t word = load_aq(words[i]);
 
-      if (num_children != MAX_CHILDREN) {
-        node4_t::add(keys, children, this->num_children, node, ind);
-        return true;
+        std::memcpy(keys + i * KEYS_PER_WORD, &word, sizeof(word));
       }
-
-      return false;
     }
 
-    node_t *find(std::uint8_t ind) const {
-      return node4_t::find(keys, children, this->num_children, ind);
-    }
+    // Must be called under the node's lock (or before it is published).
+    void set(int pos, std::uint8_t key) {
+      std::atomic<word_t> &word = words[pos / KEYS_PER_WORD];
+      word_t val = load_rx(word);
+      std::uint8_t bytes[KEYS_PER_WORD];
 
-    node_t *update(node_t *new_child, std::uint8_t ind) {
-      return node4_t::update(keys, children, this->num_children, ind,
-                             new_child);
-    }
+      std::memcpy(bytes, &val, sizeof(val));
+      bytes[pos % KEYS_PER_WORD] = key;
+      std::memcpy(&val, bytes, sizeof(val));
 
-    void remove(std::uint8_t ind) {
-      node4_t::remove(keys, children, this->num_children, this->num_deleted,
-                      ind);
+      concurrent_map::store_rs(word, val);
     }
 
-    bool is_underfull() const { return this->size() <= node4_t::MAX_CHILDREN; }
+    // Same as `set` of every key, a word at a time.
+    void set_all(const std::uint8_t (&keys)[NumKeys]) {
+      for (int i = 0; i < NUM_WORDS; i++) {
+        word_t word;
+
+        std::memcpy(&word, keys + i * KEYS_PER_WORD, sizeof(word));
+        concurrent_map::store_rs(words[i], word);
+      }
+    }
   };
 
-  struct node48_t : node_t {
-    static constexpr int MAX_CHILDREN = 48;
-    static constexpr int MAX_KEYS = 256;
+  // Keys of node4 and node16 are published (stored) before their child and
+  // `num_children`, and only change after, when the node is compacted (under
+  // it's lock, which readers validate). So the first `num_children` keys
+  // (read after `num_children` is acquired) could be matched together, as a
+  // word or a vector, while keys after them, which could be written
+  // concurrently, are masked out. Slots of deleted children keep their key,
+  // so a match is only a candidate, until it's child is checked (see
+  // `node4_t::find_pos`).
+  // Matches return a bitmask of `keys` equal to `ind`, along with the # bits
+  // per key in the mask (only the lowest of which is set, on a match).
+
+  // SWAR: A byte of `x` is zero, iff the high bit of it's byte is set in
+  // ~(((x & 0x7F..) + 0x7F..) | x | 0x7F..).
+  static std::pair<std::uint64_t, int>
+  match_keys(const packed_keys_t<4> &keys, int num_children,
+             std::uint8_t ind) {
+    constexpr std::uint32_t LOW_BITS = 0x7F7F7F7F;
+    std::uint32_t x = keys.load_word(0) ^ (ind * 0x01010101u);
+    std::uint64_t mask = ~(((x & LOW_BITS) + LOW_BITS) | x | LOW_BITS);
+
+    mask >>= CHAR_BIT - 1;
+    mask &= (std::uint64_t{1} << (num_children * CHAR_BIT)) - 1;
+
+    return {mask, CHAR_BIT};
+  }
+
+#if defined(__SSE2__)
+  static constexpr bool HAS_VECTOR_KEY_MATCH = true;
+
+  static std::pair<std::uint64_t, int>
+  match_keys(const packed_keys_t<16> &keys, int num_children,
+             std::uint8_t ind) {
+    __m128i keyvec = _mm_set_epi64x(keys.load_word(1), keys.load_word(0));
+    __m128i cmp = _mm_cmpeq_epi8(keyvec, _mm_set1_epi8(ind));
+    std::uint64_t mask = _mm_movemask_epi8(cmp);
+
+    return {mask & ((std::uint64_t{1} << num_children) - 1), 1};
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  static constexpr bool HAS_VECTOR_KEY_MATCH = true;
+
+  // No movemask in NEON, narrowing the 16 bit lanes of the comparison by 4
+  // bits, leaves a 64 bit mask with 4 bits per key.
+  static std::pair<std::uint64_t, int>
+  match_keys(const packed_keys_t<16> &keys, int num_children,
+             std::uint8_t ind) {
+    uint8x16_t keyvec = vreinterpretq_u8_u64(vcombine_u64(
+        vcreate_u64(keys.load_word(0)), vcreate_u64(keys.load_word(1))));
+    uint8x16_t cmp = vceqq_u8(keyvec, vdupq_n_u8(ind));
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+
+    mask &= 0x1111111111111111;
+
+    if (num_children < 16) {
+      mask &= (std::uint64_t{1} << (num_children * 4)) - 1;
+    }
+
+    return {mask, 4};
+  }
+#else
+  static constexpr bool HAS_VECTOR_KEY_MATCH = false;
+#endif
+
+  struct node4_t : inner_node_t, pooled_t<node4_t> {
+    static constexpr int MAX_CHILDREN = 4;
+    static constexpr int MAX_KEYS = 4;
+
+    packed_keys_t<MAX_CHILDREN> keys;
+    atomic_node_t children[MAX_CHILDREN];
+
+    node4_t(const stored_key_t &key, std::int16_t level)
+        : inner_node_t(node_type_t::NODE4, key, level) {
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    // Empty node, with the prefix of `node`.
+    explicit node4_t(const inner_node_t *node)
+        : inner_node_t(node_type_t::NODE4, node) {
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    node4_t(const node16_t *node)
+        : node4_t(static_cast<const inner_node_t *>(node)) {
+      copy(this, node);
+    }
+
+    template <typename NodeTypeDst, typename NodeTypeSrc>
+    static void copy(NodeTypeDst *dst, const NodeTypeSrc *src) {
+      ART_DEBUG_ASSERT(src->size() <= NodeTypeDst::MAX_CHILDREN);
+
+      int num_children = load_aq(src->num_children);
+
+      for (int i = 0; i < num_children; i++) {
+        if (load_aq(src->children[i])) {
+          dst->add(load_aq(src->children[i]), src->keys.get(i));
+        }
+      }
+
+      ART_DEBUG_ASSERT(dst->equals(src));
+    }
+
+    template <int NumKeys>
+    static void add(packed_keys_t<NumKeys> &keys, atomic_node_t *children,
+                    std::atomic<std::int16_t> &num_children, node_t *node,
+                    std::uint8_t ind) {
+      int num_children_loc = load_aq(num_children);
+
+      keys.set(num_children_loc, ind);
+      concurrent_map::store_rs(children[num_children_loc], node);
+      concurrent_map::store_rs(num_children, num_children_loc + 1);
+    }
+
+    // Adds `node` in place, compacting the deleted slots of a full node
+    // first, if any. Returns false, if the node has to be expanded.
+    // Readers race with the compaction (see `match_keys`), so keys and
+    // children are moved by atomic stores, same as by `add`, and the version
+    // check of a reader rejects whatever it read while they moved.
+    template <int MaxChildren>
+    static bool add_or_compact(packed_keys_t<MaxChildren> &keys,
+                               atomic_node_t *children,
+                               std::atomic<std::int16_t> &num_children,
+                               std::atomic<std::int16_t> &num_deleted,
+                               node_t *node, std::uint8_t ind) {
+      int num_children_loc = load_aq(num_children);
+
+      if (num_children_loc == MaxChildren) {
+        if (load_aq(num_deleted) == 0) {
+          return false;
+        }
+
+        std::uint8_t keyvec[MaxChildren];
+        int pos = 0;
+
+        keys.get_all(keyvec);
+
+        for (int i = 0; i < num_children_loc; i++) {
+          node_t *child = load_aq(children[i]);
+
+          if (child) {
+            if (pos != i) {
+              keyvec[pos] = keyvec[i];
+              concurrent_map::store_rs(children[pos], child);
+            }
+
+            pos++;
+          }
+        }
+
+        for (int i = pos; i < num_children_loc; i++) {
+          concurrent_map::store_rs(children[i], nullptr);
+        }
+
+        keys.set_all(keyvec);
+        concurrent_map::store_rs(num_children, pos);
+        concurrent_map::store_rs(num_deleted, 0);
+      }
+
+      add(keys, children, num_children, node, ind);
+      return true;
+    }
+
+    template <int NumKeys>
+    static std::uint8_t find_pos(const packed_keys_t<NumKeys> &keys,
+                                 const atomic_node_t *children,
+                                 int num_children, std::uint8_t ind) {
+      if constexpr (NumKeys == 4 || HAS_VECTOR_KEY_MATCH) {
+        auto [mask, bits_per_key] = match_keys(keys, num_children, ind);
+
+        while (mask) {
+          int pos = utils::trailing_zeroes(mask) / bits_per_key;
+
+          if (load_aq(children[pos])) {
+            return pos;
+          }
+
+          mask &= mask - 1;
+        }
+      } else {
+        std::uint8_t keyvec[NumKeys];
+
+        keys.get_all(keyvec);
+
+        for (std::uint8_t pos = 0; pos < num_children; pos++) {
+          if (ind == keyvec[pos] && load_aq(children[pos])) {
+            return pos;
+          }
+        }
+      }
+
+      return num_children;
+    }
+
+    // Keys of node4 and node16 are unordered, see node_t::next_child.
+    template <iter_direction IDir, typename Node>
+    static std::pair<int, node_t *> next_child(const Node *node, int from) {
+      std::pair<int, node_t *> next{-1, nullptr};
+      int num_children = load_aq(node->num_children);
+      std::uint8_t keys[Node::MAX_KEYS];
+
+      node->keys.get_all(keys);
+
+      for (int pos = 0; pos < num_children; pos++) {
+        node_t *child = load_aq(node->children[pos]);
+        int ind = keys[pos];
+        bool in_range = IDir == FORWARD ? ind >= from : ind <= from;
+        bool is_closer =
+            IDir == FORWARD ? ind < next.first : ind > next.first;
+
+        if (child && in_range && (next.second == nullptr || is_closer)) {
+          next = {ind, child};
+        }
+      }
+
+      return next;
+    }
+
+    template <int NumKeys>
+    static node_t *find(const packed_keys_t<NumKeys> &keys,
+                        const atomic_node_t *children, int num_children,
+                        std::uint8_t ind) {
+      std::uint8_t pos = find_pos(keys, children, num_children, ind);
+
+      return pos < num_children ? load_aq(children[pos]) : nullptr;
+    }
+
+    template <int NumKeys>
+    static void remove(const packed_keys_t<NumKeys> &keys,
+                       atomic_node_t *children,
+                       std::atomic<std::int16_t> &num_children,
+                       std::atomic<std::int16_t> &num_deleted,
+                       std::uint8_t ind) {
+      std::uint8_t pos = find_pos(keys, children, load_aq(num_children), ind);
+
+      ART_DEBUG_ASSERT(pos < num_children);
+
+      concurrent_map::store_rs(children[pos], nullptr);
+      concurrent_map::store_rs(num_deleted, load_aq(num_deleted) + 1);
+    }
+
+    template <int NumKeys>
+    static node_t *update(const packed_keys_t<NumKeys> &keys,
+                          atomic_node_t *children,
+                          int num_children, std::uint8_t ind,
+                          node_t *new_child) {
+      std::uint8_t pos = find_pos(keys, children, num_children, ind);
+
+      ART_DEBUG_ASSERT(pos < num_children);
+
+      return concurrent_map::xchg_rs(children[pos], new_child);
+    }
+
+    bool add(node_t *node, std::uint8_t ind) {
+      return add_or_compact<MAX_CHILDREN>(keys, children, this->num_children,
+                                          this->num_deleted, node, ind);
+    }
+
+    node_t *find(std::uint8_t ind) const {
+      const atomic_node_t *children = this->children;
+      return find(keys, children, load_aq(this->num_children), ind);
+    }
+
+    node_t *update(node_t *new_child, std::uint8_t ind) {
+      atomic_node_t *children = this->children;
+      return update(keys, children, load_aq(this->num_children), ind,
+                    new_child);
+    }
+
+    void remove(std::uint8_t ind) {
+      remove(keys, children, this->num_children, this->num_deleted, ind);
+    }
+
+    bool is_underfull() const { return this->size() <= 1; }
+
+    node_t *shrink() const {
+      ART_DEBUG_ASSERT(this->size() == 1);
+
+      int num_children = load_aq(this->num_children);
+
+      for (int i = 0; i < num_children; i++) {
+        node_t *child = load_aq(children[i]);
+
+        if (child) {
+          return child;
+        }
+      }
+
+      return nullptr;
+    }
+  };
+
+  struct node16_t : inner_node_t, pooled_t<node16_t> {
+    static constexpr int MAX_CHILDREN = 16;
+    static constexpr int MAX_KEYS = 16;
+
+    packed_keys_t<MAX_CHILDREN> keys;
+    atomic_node_t children[MAX_CHILDREN];
+
+    node16_t(const stored_key_t &key, std::int16_t level)
+        : inner_node_t(node_type_t::NODE16, key, level) {
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    // Empty node, with the prefix of `node`.
+    explicit node16_t(const inner_node_t *node)
+        : inner_node_t(node_type_t::NODE16, node) {
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    node16_t(const node4_t *node)
+        : node16_t(static_cast<const inner_node_t *>(node)) {
+      node4_t::copy(this, node);
+    }
+
+    node16_t(const node48_t *node)
+        : node16_t(static_cast<const inner_node_t *>(node)) {
+      for (int i = 0, pos = 0; i < node48_t::MAX_KEYS; i++) {
+        std::uint8_t ind = load_aq(node->keys[i]);
+        if (ind) {
+          keys.set(pos, i);
+          concurrent_map::store_rs(children[pos],
+                                   load_aq(node->children[ind - 1]));
+          pos++;
+        }
+      }
+
+      store_rs(this->num_children, load_aq(node->num_children));
+
+      ART_DEBUG_ASSERT(this->equals(node));
+    }
+
+    bool add(node_t *node, std::uint8_t ind) {
+      return node4_t::template add_or_compact<MAX_CHILDREN>(
+          keys, children, this->num_children, this->num_deleted, node, ind);
+    }
+
+    node_t *find(std::uint8_t ind) const {
+      return node4_t::find(keys, children, this->num_children, ind);
+    }
+
+    node_t *update(node_t *new_child, std::uint8_t ind) {
+      return node4_t::update(keys, children, this->num_children, ind,
+                             new_child);
+    }
+
+    void remove(std::uint8_t ind) {
+      node4_t::remove(keys, children, this->num_children, this->num_deleted,
+                      ind);
+    }
+
+    bool is_underfull() const { return this->size() <= node4_t::MAX_CHILDREN; }
+  };
+
+  struct node48_t : inner_node_t, pooled_t<node48_t> {
+    static constexpr int MAX_CHILDREN = 48;
+    static constexpr int MAX_KEYS = 256;
     static constexpr uint64_t ONE = 1;
 
     atomic_key_t keys[MAX_KEYS];
@@ -620,17 +1274,26 @@ private:
       return MAX_CHILDREN - (UINT64_BITS - ind);
     }
 
-    node48_t(key_type key, std::int8_t level)
-        : node_t(node_type_t::NODE48, key, level), freemap(0) {
+    node48_t(const stored_key_t &key, std::int16_t level)
+        : inner_node_t(node_type_t::NODE48, key, level), freemap(0) {
+      concurrent_map::fill_zero_rx(keys, MAX_KEYS);
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    // Empty node, with the prefix of `node`.
+    explicit node48_t(const inner_node_t *node)
+        : inner_node_t(node_type_t::NODE48, node), freemap(0) {
       concurrent_map::fill_zero_rx(keys, MAX_KEYS);
       concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
     }
 
-    node48_t(const node16_t *node) : node48_t(node->key, node->level) {
+    node48_t(const node16_t *node)
+        : node48_t(static_cast<const inner_node_t *>(node)) {
       node4_t::copy(this, node);
     }
 
-    node48_t(const node256_t *node) : node48_t(node->key, node->level) {
+    node48_t(const node256_t *node)
+        : node48_t(static_cast<const inner_node_t *>(node)) {
       ART_DEBUG_ASSERT(node->num_children <= MAX_CHILDREN);
 
       auto src_num_children = load_aq(node->num_children);
@@ -695,18 +1358,25 @@ private:
     bool is_underfull() const { return this->size() <= node16_t::MAX_CHILDREN; }
   };
 
-  struct node256_t : node_t {
+  struct node256_t : inner_node_t, pooled_t<node256_t> {
     static constexpr int MAX_CHILDREN = 256;
     static constexpr int MAX_KEYS = 256;
 
     atomic_node_t children[MAX_CHILDREN];
 
-    node256_t(key_type key, std::int8_t level)
-        : node_t(node_type_t::NODE256, key, level) {
+    node256_t(const stored_key_t &key, std::int16_t level)
+        : inner_node_t(node_type_t::NODE256, key, level) {
+      concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
+    }
+
+    // Empty node, with the prefix of `node`.
+    explicit node256_t(const inner_node_t *node)
+        : inner_node_t(node_type_t::NODE256, node) {
       concurrent_map::fill_zero_rx(children, MAX_CHILDREN);
     }
 
-    node256_t(const node48_t *node) : node256_t(node->key, node->level) {
+    node256_t(const node48_t *node)
+        : node256_t(static_cast<const inner_node_t *>(node)) {
       for (int i = 0; i < node48_t::MAX_KEYS; i++) {
         auto ind = load_aq(node->keys[i]);
 
@@ -752,18 +1422,126 @@ private:
     UOP_Upsert,
   };
 
-  using LockType = std::unique_lock<sync_prim::mutex::Mutex>;
+  // Locks `word` (version of a node or root), if it is still at `version`.
+  static bool try_lock(std::atomic<version_t> &word, version_t version) {
+    return !(version & (LOCKED | OBSOLETE)) &&
+           word.compare_exchange_strong(version, version | LOCKED,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+  }
+
+  // Lock of a node (or root), released by `unlock` or when destroyed. Empty,
+  // if the lock could not be taken. Unlocking does not change the version,
+  // writers increment it as they change the node.
+  class LockType {
+    std::atomic<version_t> *m_word = nullptr;
+
+  public:
+    LockType() = default;
+    explicit LockType(std::atomic<version_t> &word) : m_word(&word) {}
+    LockType(LockType &&other) : m_word(std::exchange(other.m_word, nullptr)) {}
+
+    LockType &operator=(LockType &&other) {
+      unlock();
+      m_word = std::exchange(other.m_word, nullptr);
+      return *this;
+    }
+
+    ~LockType() { unlock(); }
+
+    void unlock() {
+      if (m_word) {
+        store_rs(*m_word, load_rx(*m_word) & ~LOCKED);
+        m_word = nullptr;
+      }
+    }
+
+    explicit operator bool() const { return m_word != nullptr; }
+  };
+
+  // Waits for `word` to be unlocked, and locks it, unless it is obsolete.
+  static LockType lock_or_wait(std::atomic<version_t> &word) {
+    while (true) {
+      version_t version = load_aq(word);
+
+      if (version & OBSOLETE) {
+        return {};
+      }
+
+      if (try_lock(word, version)) {
+        return LockType{word};
+      }
+
+      utils::cpu_relax();
+    }
+  }
+
+  // Updates a value in place with `fn(value_type &)`, under leaf's lock.
+  // A missing value is default constructed, before `fn` is applied to it.
+  template <typename Fn> struct value_updater_t { Fn &fn; };
+
+  template <typename Fn>
+  static constexpr bool is_updater_v = std::is_invocable_v<Fn &, value_type &>;
+
+  static value_type new_value(value_type value) { return value; }
+
+  template <typename Fn>
+  static value_type new_value(value_updater_t<Fn> updater) {
+    value_type value{};
+
+    updater.fn(value);
+    return value;
+  }
+
+  static value_type exchange_value(value_type &old, value_type value) {
+    return std::exchange(old, value);
+  }
+
+  template <typename Fn>
+  static value_type exchange_value(value_type &old,
+                                   value_updater_t<Fn> updater) {
+    value_type oldval = old;
+
+    updater.fn(old);
+    return oldval;
+  }
 
   struct EpochGuard {
-    const concurrent_map *map;
+    const concurrent_map *map = nullptr;
 
+    EpochGuard() = default;
     EpochGuard(const concurrent_map *a_map) : map(a_map) {
       map->m_gc.enter_epoch();
     }
+    EpochGuard(const EpochGuard &o) : map(o.map) {
+      if (map)
+        map->m_gc.enter_epoch();
+    }
+    EpochGuard(EpochGuard &&o) : map(std::exchange(o.map, nullptr)) {}
+    ~EpochGuard() { release(); }
+
+    EpochGuard &operator=(EpochGuard o) {
+      std::swap(map, o.map);
+      return *this;
+    }
 
-    ~EpochGuard() { map->m_gc.exit_epoch(); }
+    void release() {
+      if (map)
+        map->m_gc.exit_epoch();
+      map = nullptr;
+    }
+    void refresh() {
+      if (map) {
+        map->m_gc.exit_epoch();
+        map->m_gc.enter_epoch();
+      }
+    }
   };
 
+  // # keys after which iterators and `InsertBatch` refresh their epoch, so
+  // that long scans and batches do not hold back reclamation.
+  static constexpr int EPOCH_REFRESH_INTERVAL = 256;
+
   struct node_snapshot_t {
     node_t *node;
     version_t version;
@@ -778,18 +1556,21 @@ private:
       this->version = node ? load_aq(node->version) : 0;
     }
 
+    // Fails, if the node was locked or has changed since the snapshot.
     LockType lock() {
-      LockType lock{node->m};
+      return try_lock(node->version, version) ? LockType{node->version}
+                                              : LockType{};
+    }
 
-      if (load_rx(node->version) != version) {
-        lock.unlock();
-      }
+    // Node read since the snapshot is consistent.
+    bool is_valid() const {
+      bool stale;
 
-      return lock;
+      return concurrent_map::is_valid(node, version, stale);
     }
 
     LockType lock_root(concurrent_map &map) {
-      LockType lock{*map.root_mtx};
+      LockType lock = lock_or_wait(map.root_version);
 
       if (node != load_rx(map.root)) {
         lock.unlock();
@@ -802,7 +1583,15 @@ private:
     explicit operator bool() { return node != nullptr; }
   };
 
-  struct traverser_t {
+  // Inner node traversed by an insert, with the depth it was entered at.
+  struct path_entry_t {
+    node_snapshot_t node;
+    int depth;
+  };
+
+  using path_t = std::vector<path_entry_t>;
+
+  struct traverser_t {
     concurrent_map &map;
     EpochGuard guard;
 
@@ -813,29 +1602,71 @@ private:
         : map(map), guard(std::addressof(map)), is_snapshot_stale(false),
           root_snapshot(load_aq(map.root)) {}
 
-    template <UpdateOp UOp>
+    template <UpdateOp UOp, typename ValueType>
     std::optional<value_type> update_leaf(node_snapshot_t &node,
-                                          value_type value) {
+                                          ValueType value) {
       auto leaf = static_cast<leaf_t *>(node.node);
 
       if constexpr (UOp != UpdateOp::UOP_Insert) {
         if (auto lock = node.lock()) {
-          return std::exchange(leaf->value, value);
+          auto oldval = exchange_value(leaf->value, value);
+
+          leaf->increment_version();
+          return oldval;
+        } else {
+          is_snapshot_stale = true;
+        }
+      }
+
+      value_type oldval = leaf->value;
+
+      if (!node.is_valid()) {
+        is_snapshot_stale = true;
+      }
+
+      return oldval;
+    }
+
+    // Same as `update_leaf`, for the leaf embedded in `parent`, under it's
+    // lock. Value is moved to a leaf_t, if the new value could not be
+    // embedded.
+    template <UpdateOp UOp, typename ValueType>
+    std::optional<value_type> update_embedded(node_snapshot_t &parent,
+                                              const stored_key_t &key,
+                                              node_t *child, ValueType value) {
+      value_type oldval = embedded_value(child);
+
+      if constexpr (UOp != UpdateOp::UOP_Insert) {
+        if (auto lock = parent.lock()) {
+          value_type newval = oldval;
+
+          exchange_value(newval, value);
+          parent->update(map.count_new(new_leaf(parent.node, key, newval)),
+                         parent->get_ind(key));
         } else {
           is_snapshot_stale = true;
         }
       }
 
-      return leaf->value;
+      return oldval;
+    }
+
+    // Index of the child on `key`'s path in `parent` (unused for root).
+    static std::uint8_t path_ind(node_snapshot_t &parent,
+                                 const stored_key_t &key) {
+      return parent ? parent->get_ind(key) : 0;
     }
 
-    bool replace_root(node_t *node) {
+    // `node` becomes root of the empty tree, or is added at `node_ind` to a
+    // new root, with the root at `root_ind`.
+    bool replace_root(node_t *node, std::uint8_t node_ind,
+                      std::uint8_t root_ind) {
       if (auto lock = root_snapshot.lock_root(map)) {
         if (root_snapshot.node) {
-          auto newroot = new node4_t(0, 0);
+          auto newroot = map.count_new(new node4_t(stored_key_t{}, 0));
 
-          newroot->add(node);
-          newroot->add(root_snapshot.node);
+          newroot->add(node, node_ind);
+          newroot->add(root_snapshot.node, root_ind);
           map.root = newroot;
         } else {
           map.root = node;
@@ -847,10 +1678,12 @@ private:
       return false;
     }
 
-    bool update_parent(node_t *node, node_snapshot_t &parent) {
+    // `node` replaces the child at `ind` of `parent` (or root).
+    bool update_parent(node_t *node, node_snapshot_t &parent,
+                       std::uint8_t ind) {
       if (parent) {
         if (auto lock = parent.lock()) {
-          parent->update(node);
+          parent->update(node, ind);
           return true;
         }
       } else {
@@ -863,10 +1696,34 @@ private:
       return false;
     }
 
-    void shrink_node(node_snapshot_t &node, node_snapshot_t &parent) {
+    // Removes a node without children under `node` (the child at `ind` of
+    // `parent`), which has no leaves, so that a restarted insert finds a leaf
+    // for it's prefix (see `prefix_view`), once they are all removed.
+    void remove_empty(node_snapshot_t node, node_snapshot_t parent,
+                      std::uint8_t ind) {
+      while (node->size() != 0) {
+        auto [child_ind, child] = node->template next_child<FORWARD>(0);
+
+        if (!node.is_valid() || child == nullptr || is_embedded(child) ||
+            child->is_leaf()) {
+          return;
+        }
+
+        parent = node;
+        ind = child_ind;
+        node.load_snapshot(child);
+      }
+
+      shrink_node(node, parent, ind);
+    }
+
+    // `node` is the child at `ind` of `parent`.
+    void shrink_node(node_snapshot_t &node, node_snapshot_t &parent,
+                     std::uint8_t ind) {
       auto free_node = [&](auto &nodelock) {
         node->mark_as_deleted();
         nodelock.unlock();
+        map.count_freed(node.node);
         map.m_gc.retire_in_new_epoch(node_t::free, node.node);
       };
 
@@ -876,13 +1733,21 @@ private:
 
           ART_DEBUG_ASSERT(replacement != nullptr);
 
-          nodelock.unlock();
+          // Embedded leaves could not be moved up from the last level.
+          if (is_embedded(replacement)) {
+            return;
+          }
+
+          // Node4 is replaced by it's only child.
+          if (node->node_type != node_type_t::NODE4) {
+            map.count_new(replacement);
+          }
 
-          LockType child_lock{replacement->m};
+          nodelock.unlock();
 
-          if (!replacement->is_deleted()) {
+          if (auto child_lock = lock_or_wait(replacement->version)) {
             if (auto nodelock = node.lock()) {
-              if (update_parent(replacement, parent)) {
+              if (update_parent(replacement, parent, ind)) {
                 free_node(nodelock);
                 return;
               }
@@ -890,12 +1755,13 @@ private:
           }
 
           if (node->node_type != node_type_t::NODE4) {
-            delete replacement;
+            map.count_freed(replacement);
+            node_t::free(replacement);
           }
         } else {
           if (parent) {
             if (auto lock = parent.lock()) {
-              parent->remove(node->key);
+              parent->remove(ind);
               free_node(nodelock);
             }
           } else {
@@ -917,55 +1783,73 @@ private:
       if (auto lock = node.lock()) {
         if (parent) {
           if (auto lock = parent.lock()) {
-            parent->remove(leaf->key);
+            parent->remove(parent->get_ind(leaf->key));
             leaf->mark_as_deleted();
             is_snapshot_stale = false;
           }
         } else {
           if (auto lock = root_snapshot.lock_root(map)) {
             map.root = nullptr;
+            leaf->mark_as_deleted();
             is_snapshot_stale = false;
           }
         }
       }
 
       if (!is_snapshot_stale) {
+        map.count_freed(leaf);
         map.m_gc.retire_in_new_epoch(node_t::free, leaf);
       }
 
       return oldval;
     }
 
+    // Same as `remove_leaf`, for the leaf embedded in `parent`.
+    std::optional<value_type> remove_embedded(node_t *child,
+                                              const stored_key_t &key,
+                                              node_snapshot_t &parent) {
+      if (auto lock = parent.lock()) {
+        parent->remove(parent->get_ind(key));
+        return embedded_value(child);
+      }
+
+      is_snapshot_stale = true;
+      return {};
+    }
+
     node_t *expand_node(node_t *node, node_snapshot_t &parent,
-                        LockType &oldlock) {
+                        std::uint8_t ind, LockType &oldlock) {
       node_t *old = node;
 
-      node = node->expand();
+      node = map.count_new(node->expand());
 
-      LockType lock{node->m};
+      LockType lock = lock_or_wait(node->version);
 
-      if (update_parent(node, parent)) {
+      if (update_parent(node, parent, ind)) {
         old->mark_as_deleted();
         oldlock = std::move(lock);
+        map.count_freed(old);
         map.m_gc.retire_in_new_epoch(node_t::free, old);
       } else {
         lock.unlock();
-        delete node;
+        map.count_freed(node);
+        node_t::free(node);
         node = nullptr;
       }
 
       return node;
     }
 
-    bool add_to_parent(node_t *node, node_snapshot_t &parent,
-                       node_snapshot_t &grand_parent) {
+    bool add_to_parent(node_t *node, const stored_key_t &key,
+                       node_snapshot_t &parent, node_snapshot_t &grand_parent) {
       if (parent) {
         if (auto lock = parent.lock()) {
-          if (!parent->add(node)) {
-            node_t *newparent = expand_node(parent.node, grand_parent, lock);
+          if (!parent->add(node, parent->get_ind(key))) {
+            node_t *newparent = expand_node(
+                parent.node, grand_parent, path_ind(grand_parent, key), lock);
 
             if (newparent) {
-              newparent->add(node);
+              newparent->add(node, newparent->get_ind(key));
               return true;
             } else {
               return false;
@@ -975,91 +1859,174 @@ private:
           return true;
         }
       } else {
-        return replace_root(node);
+        // Tree is empty.
+        return replace_root(node, 0, 0);
       }
 
       return false;
     }
 
-    node4_t *decompress_node(node_t *node, int lcpl) {
-      key_type prefix = node_t::extract_common_prefix(node->key, lcpl);
-      auto decomped_node = new node4_t(prefix, lcpl);
+    // New parent of `node` (at `node_ind`), with the first `lcpl` bytes of
+    // `key` (common with `node`'s) as it's prefix.
+    node4_t *decompress_node(node_t *node, const stored_key_t &key, int lcpl,
+                             std::uint8_t node_ind) {
+      auto decomped_node = map.count_new(new node4_t(key, lcpl));
 
-      decomped_node->add(node);
+      decomped_node->add(node, node_ind);
 
       return decomped_node;
     }
 
-    template <UpdateOp UOp>
-    bool insert_leaf(key_type key, value_type value, int depth, int lcpl,
+    // `key` differs from `node` at byte `lcpl`, which is `node_ind` in
+    // `node`'s prefix (or key).
+    template <UpdateOp UOp, typename ValueType>
+    bool insert_leaf(const stored_key_t &key, ValueType value, int depth,
+                     int lcpl, std::uint8_t node_ind,
                      node_snapshot_t &node, node_snapshot_t &parent,
                      node_snapshot_t &grand_parent) {
       if constexpr (UOp != UpdateOp::UOP_Update) {
         int keylen = node->level - depth;
         int common_prefix_len = std::min(lcpl - depth, keylen);
-        auto leaf = new leaf_t(key, value);
 
         if (common_prefix_len && (node->is_leaf() || keylen)) {
           if (auto lock = node.lock()) {
-            node4_t *decomped_node = decompress_node(node.node, lcpl);
+            node4_t *decomped_node =
+                decompress_node(node.node, key, lcpl, node_ind);
+            node_t *leaf = map.count_new(
+                new_leaf(decomped_node, key, new_value(value)));
 
-            decomped_node->add(leaf);
+            decomped_node->add(leaf, decomped_node->get_ind(key));
 
-            if (update_parent(decomped_node, parent)) {
+            if (update_parent(decomped_node, parent,
+                              path_ind(parent, key))) {
               return true;
-            } else {
-              delete decomped_node;
             }
+
+            map.count_freed(leaf);
+            free_leaf(leaf);
+            map.count_freed(decomped_node);
+            delete decomped_node;
           }
         } else {
-          if (add_to_parent(leaf, parent, grand_parent)) {
+          // Only root could have no prefix in common with `key` (children
+          // have their byte in their parent in common).
+          auto leaf = map.count_new(new leaf_t(key, new_value(value)));
+
+          ART_DEBUG_ASSERT(!parent && lcpl == 0);
+
+          if (replace_root(leaf, KeyEncoding::bytes(key)[0], node_ind)) {
             return true;
           }
+
+          map.count_freed(leaf);
+          delete leaf;
         }
 
-        delete leaf;
         return false;
       }
 
       return true;
     }
 
-    template <UpdateOp UOp>
-    std::optional<value_type> insert(key_type key, value_type value) {
-      int depth = 0;
-      node_snapshot_t node, parent, grand_parent;
+    template <UpdateOp UOp, typename ValueType>
+    std::optional<value_type> insert(const stored_key_t &key,
+                                     ValueType value) {
+      return insert<UOp>(key, value, 0, root_snapshot, {}, {}, nullptr);
+    }
 
-      node = root_snapshot;
+    // Same as `insert`, resumed from the deepest node of `path` (traversed
+    // by a previous key), whose prefix is within the first `lcpl` bytes,
+    // that `key` has in common with the previous key. Nodes of `path` changed
+    // since, are read again, and the nodes after them dropped. Inner nodes
+    // traversed by `key` are added to `path`.
+    template <UpdateOp UOp, typename ValueType>
+    std::optional<value_type> insert(const stored_key_t &key, ValueType value,
+                                     path_t &path, int lcpl) {
+      std::size_t len = 0;
 
-      while (node) {
-        int lcpl = node->longest_common_prefix_length(key);
-        int keylen = node->level - depth;
-        int common_prefix_len = std::min(lcpl - depth, keylen);
+      if (!path.empty() && path[0].node.node == root_snapshot.node) {
+        while (len < path.size() && path[len].node->level <= lcpl) {
+          node_snapshot_t &node = path[len++].node;
 
-        if (node->is_leaf()) {
-          if (node->key == key) {
-            return update_leaf<UOp>(node, value);
+          if (!node.is_valid()) {
+            node.load_snapshot(node.node);
+            break;
           }
+        }
+      }
 
-          if (!insert_leaf<UOp>(key, value, depth, lcpl, node, parent,
-                                grand_parent)) {
-            is_snapshot_stale = true;
+      path.resize(len);
+
+      if (len == 0) {
+        return insert<UOp>(key, value, 0, root_snapshot, {}, {}, &path);
+      }
+
+      path_entry_t entry = path.back();
+      node_snapshot_t parent = len > 1 ? path[len - 2].node : node_snapshot_t{};
+      node_snapshot_t grand_parent =
+          len > 2 ? path[len - 3].node : node_snapshot_t{};
+
+      path.pop_back();
+
+      return insert<UOp>(key, value, entry.depth, entry.node, parent,
+                         grand_parent, &path);
+    }
+
+    // Traverses from `node` (entered at `depth`), adding the inner nodes
+    // traversed to `path`, if any.
+    template <UpdateOp UOp, typename ValueType>
+    std::optional<value_type>
+    insert(const stored_key_t &key, ValueType value, int depth,
+           node_snapshot_t node, node_snapshot_t parent,
+           node_snapshot_t grand_parent, path_t *path) {
+      while (node) {
+        if (node->is_leaf() && static_cast<leaf_t *>(node.node)->key == key) {
+          return update_leaf<UOp>(node, value);
+        }
+
+        prefix_view_t prefix;
+        bool stale;
+
+        if (!prefix_view(node.node, depth, prefix, stale)) {
+          if (!stale) {
+            remove_empty(node, parent, path_ind(parent, key));
           }
 
+          is_snapshot_stale = true;
           return {};
         }
 
-        if (common_prefix_len == keylen) {
+        int lcpl = common_prefix_length(node.node, prefix, key, depth);
+        int keylen = node->level - depth;
+        int common_prefix_len = lcpl - depth;
+
+        if (!node->is_leaf() && common_prefix_len == keylen) {
+          if (path) {
+            path->push_back({node, depth});
+          }
+
           depth += common_prefix_len;
 
           ART_DEBUG_ASSERT(depth < MAX_DEPTH);
 
           grand_parent = parent;
           parent = node;
-          node.load_snapshot(node->find(key));
+
+          node_t *child = node->find(key);
+
+          if (!node.is_valid()) {
+            is_snapshot_stale = true;
+            return {};
+          }
+
+          if (is_embedded(child)) {
+            return update_embedded<UOp>(parent, key, child, value);
+          }
+
+          node.load_snapshot(child);
         } else {
-          if (!insert_leaf<UOp>(key, value, depth, lcpl, node, parent,
-                                grand_parent)) {
+          if (!insert_leaf<UOp>(key, value, depth, lcpl, prefix[lcpl], node,
+                                parent, grand_parent)) {
             is_snapshot_stale = true;
           }
 
@@ -1068,7 +2035,12 @@ private:
       }
 
       if constexpr (UOp != UpdateOp::UOP_Update) {
-        if (!add_to_parent(new leaf_t(key, value), parent, grand_parent)) {
+        node_t *leaf =
+            map.count_new(new_leaf(parent.node, key, new_value(value)));
+
+        if (!add_to_parent(leaf, key, parent, grand_parent)) {
+          map.count_freed(leaf);
+          free_leaf(leaf);
           is_snapshot_stale = true;
         }
       }
@@ -1076,7 +2048,7 @@ private:
       return {};
     }
 
-    std::optional<value_type> erase(key_type key) {
+    std::optional<value_type> erase(const stored_key_t &key) {
       int depth = 0;
       node_snapshot_t node, parent, grand_parent;
 
@@ -1089,7 +2061,8 @@ private:
           if (leaf->key == key) {
             if (auto old = remove_leaf(leaf, node, parent)) {
               if (parent && parent->is_underfull()) {
-                shrink_node(parent, grand_parent);
+                shrink_node(parent, grand_parent,
+                            path_ind(grand_parent, key));
               }
 
               return old;
@@ -1099,32 +2072,47 @@ private:
           break;
         }
 
-        int keylen = node->level - depth;
-
-        if (keylen) {
-          int lcpl = node->longest_common_prefix_length(key);
-          int common_prefix_len = std::min(lcpl - depth, keylen);
-
-          if (common_prefix_len != keylen) {
-            break;
-          }
-
-          depth += keylen;
+        if (!prefix_matches(node.node, key, depth)) {
+          break;
         }
 
+        depth = node->level;
+
         ART_DEBUG_ASSERT(depth < MAX_DEPTH);
 
         grand_parent = parent;
         parent = node;
-        node.load_snapshot(node->find(key));
+
+        node_t *child = node->find(key);
+
+        if (!node.is_valid()) {
+          is_snapshot_stale = true;
+          break;
+        }
+
+        if (is_embedded(child)) {
+          if (auto old = remove_embedded(child, key, parent)) {
+            if (parent->is_underfull()) {
+              shrink_node(parent, grand_parent,
+                          path_ind(grand_parent, key));
+            }
+
+            return old;
+          }
+
+          break;
+        }
+
+        node.load_snapshot(child);
       }
 
       return {};
     }
   };
 
-  template <UpdateOp UOp>
-  std::optional<value_type> insert(key_type key, value_type value) {
+  // `value` is either the value or a value_updater_t.
+  template <UpdateOp UOp, typename ValueType>
+  std::optional<value_type> insert(const stored_key_t &key, ValueType value) {
     while (true) {
       traverser_t traverser{*this};
       auto old = traverser.template insert<UOp>(key, value);
@@ -1135,7 +2123,20 @@ private:
     }
   }
 
-  std::optional<value_type> erase(key_type key) {
+  template <typename ValueType>
+  std::optional<value_type> upsert(const stored_key_t &key, ValueType value) {
+    auto &&old = insert<UpdateOp::UOP_Upsert>(key, value);
+
+    if (!old) {
+      std::atomic<std::size_t> &num_inserts =
+          count[utils::ThreadRegistry::ThreadID()].num_inserts;
+      store_rx(num_inserts, load_rx(num_inserts) + 1);
+    }
+
+    return old;
+  }
+
+  std::optional<value_type> erase(const stored_key_t &key) {
     while (true) {
       traverser_t traverser{*this};
       auto value = traverser.erase(key);
@@ -1148,23 +2149,501 @@ private:
 
   static constexpr bool INSERT = false;
   static constexpr bool UPSERT = true;
+  static constexpr int MULTI_SEARCH_GROUP_SIZE = 16;
+
+  struct multi_search_lookup_t {
+    std::size_t idx;
+    int depth;
+    const node_t *node;
+  };
+
+  // Nodes are read optimistically, and validated with their version (see
+  // `is_valid`) before moving on to a child, or returning a leaf's value. So
+  // the search is `stale` (and has to be restarted from root), if a node was
+  // changed, while it was read. Must be called under an epoch.
+  std::optional<value_type> search(const stored_key_t &key,
+                                   bool &stale) const {
+    int depth = 0;
+    const node_t *node = load_aq(root);
+
+    stale = false;
+
+    while (node) {
+      // Embedded leaves are only reached by a full match of `key`.
+      if (is_embedded(node)) {
+        return embedded_value(node);
+      }
+
+      version_t version = load_aq(node->version);
+
+      if (node->is_leaf()) {
+        auto leaf = static_cast<const leaf_t *>(node);
+
+        if (leaf->key == key) {
+          value_type value = leaf->value;
+
+          if (is_valid(node, version, stale)) {
+            return value;
+          }
+        }
+
+        break;
+      }
+
+      if (!prefix_matches(node, key, depth)) {
+        break;
+      }
+
+      depth = node->level;
+
+      ART_DEBUG_ASSERT(depth < MAX_DEPTH);
+
+      const node_t *child = node->find(key);
+
+      if (!is_valid(node, version, stale)) {
+        break;
+      }
+
+      node = child;
+    }
+
+    return {};
+  }
+
+  // Advances `lookup` by one level, same as an iteration of `search`, or
+  // restarts it from root, if it is stale. Returns false, once value is found
+  // (or found missing).
+  bool multi_search_step(const stored_key_t &key, multi_search_lookup_t &lookup,
+                         std::optional<value_type> &value) const {
+    const node_t *node = lookup.node;
+    bool stale;
+
+    auto restart = [&] {
+      lookup.depth = 0;
+      lookup.node = load_aq(root);
+      value = std::nullopt;
+      return true;
+    };
+
+    value = std::nullopt;
+
+    if (node == nullptr)
+      return false;
+
+    version_t version = load_aq(node->version);
+
+    if (node->is_leaf()) {
+      auto leaf = static_cast<const leaf_t *>(node);
+
+      if (leaf->key == key) {
+        value = leaf->value;
+
+        if (!is_valid(node, version, stale)) {
+          return restart();
+        }
+      }
+
+      return false;
+    }
+
+    if (!prefix_matches(node, key, lookup.depth)) {
+      return false;
+    }
+
+    lookup.depth = node->level;
+
+    ART_DEBUG_ASSERT(lookup.depth < MAX_DEPTH);
+
+    lookup.node = node->find(key);
+
+    if (!is_valid(node, version, stale)) {
+      return restart();
+    }
+
+    if (is_embedded(lookup.node)) {
+      value = embedded_value(lookup.node);
+      return false;
+    }
+
+    if (lookup.node) {
+      utils::prefetch<2>(lookup.node);
+    }
+
+    return true;
+  }
+
+  // Ordered traversal helpers.
+  // Nodes are read optimistically and validated with their version, same as
+  // by `search`. Must be called under an epoch.
+
+  static int compare_keys(const stored_key_t &k1, const stored_key_t &k2) {
+    int len1 = KeyEncoding::length(k1);
+    int len2 = KeyEncoding::length(k2);
+    int cmp = std::memcmp(KeyEncoding::bytes(k1), KeyEncoding::bytes(k2),
+                          std::min(len1, len2));
+
+    return cmp ? cmp : len1 - len2;
+  }
+
+  static bool is_valid(const node_t *node, version_t version, bool &stale) {
+    stale = (version & (LOCKED | OBSOLETE)) ||
+            load_aq(node->version) != version;
+
+    return !stale;
+  }
+
+  // Leaves found by an ordered traversal are copied into `found_key` and
+  // `found_value` before the final validation of the leaf (or of the parent
+  // of an embedded leaf), same as by `search`, so that a value changed in
+  // place (see `update_leaf`) while it was copied is never returned.
+
+  static bool copy_leaf(const node_t *node, version_t version,
+                        stored_key_t &found_key, value_type &found_value,
+                        bool &stale) {
+    auto leaf = static_cast<const leaf_t *>(node);
+
+    found_key = leaf->key;
+    found_value = leaf->value;
+
+    return is_valid(node, version, stale);
+  }
+
+  // Embedded `child` at `ind` of `node`, which was validated after `child`
+  // was read.
+  static bool copy_embedded(const node_t *node, int ind, const node_t *child,
+                            stored_key_t &found_key, value_type &found_value) {
+    found_key = child_key(node, ind);
+    found_value = embedded_value(child);
+
+    return true;
+  }
+
+  // Position of an ordered traversal in an inner node: the child at `ind`
+  // of `node`, which was valid in it's `version`. An iterator keeps the
+  // path of inner nodes to it's current leaf, to resume the traversal from.
+  struct scan_entry_t {
+    const node_t *node;
+    version_t version;
+    int ind;
+  };
+
+  using scan_path_t = std::vector<scan_entry_t>;
+
+  template <iter_direction IDir> static constexpr int step(int ind) {
+    return IDir == FORWARD ? ind + 1 : ind - 1;
+  }
+
+  // Smallest (FORWARD) or largest (REVERSE) leaf under the children of
+  // `node` (in it's `version`) from byte `from` on. Inner nodes on the way to
+  // the leaf are pushed to `path`.
+  template <iter_direction IDir>
+  static bool leaf_from(const node_t *node, version_t version, int from,
+                        scan_path_t &path, stored_key_t &found_key,
+                        value_type &found_value, bool &stale) {
+    while (true) {
+      auto [ind, child] = node->template next_child<IDir>(from);
+
+      if (!is_valid(node, version, stale) || child == nullptr) {
+        return false;
+      }
+
+      path.push_back({node, version, ind});
+
+      if (is_embedded(child)) {
+        return copy_embedded(node, ind, child, found_key, found_value);
+      }
+
+      if (extreme_leaf<IDir>(child, path, found_key, found_value, stale) ||
+          stale) {
+        return !stale;
+      }
+
+      path.pop_back();
+      from = step<IDir>(ind);
+    }
+  }
+
+  // Smallest (FORWARD) or largest (REVERSE) leaf under `node`.
+  template <iter_direction IDir>
+  static bool extreme_leaf(const node_t *node, scan_path_t &path,
+                           stored_key_t &found_key, value_type &found_value,
+                           bool &stale) {
+    version_t version = load_aq(node->version);
+
+    if (node->is_leaf()) {
+      return copy_leaf(node, version, found_key, found_value, stale);
+    }
+
+    return leaf_from<IDir>(node, version,
+                           IDir == FORWARD ? 0 : MAX_CHILDREN - 1, path,
+                           found_key, found_value, stale);
+  }
+
+  // Smallest leaf > `key` (FORWARD) or the largest leaf < `key` (REVERSE)
+  // under `node`, whose first `depth` bytes are same as `key`'s. `key`'s leaf
+  // is included, if `inclusive`.
+  template <iter_direction IDir>
+  static bool bound_leaf(const node_t *node, const stored_key_t &key,
+                         int depth, bool inclusive, scan_path_t &path,
+                         stored_key_t &found_key, value_type &found_value,
+                         bool &stale) {
+    version_t version = load_aq(node->version);
+
+    if (node->is_leaf()) {
+      auto leaf = static_cast<const leaf_t *>(node);
+      int cmp = compare_keys(leaf->key, key);
+      bool in_range = IDir == FORWARD ? cmp > 0 : cmp < 0;
+
+      if (in_range || (inclusive && !cmp)) {
+        return copy_leaf(node, version, found_key, found_value, stale);
+      }
+
+      is_valid(node, version, stale);
+      return false;
+    }
+
+    int level = node->level;
+    int keylen = KeyEncoding::length(key);
+    bytea keyvec = KeyEncoding::bytes(key);
+    prefix_view_t prefix;
+
+    // A node without leaves has none in range.
+    if (!prefix_view(node, depth, prefix, stale)) {
+      if (!stale) {
+        is_valid(node, version, stale);
+      }
+
+      return false;
+    }
+
+    // Keys are not prefixes of one another, so `key` could not end within
+    // the node's prefix.
+    ART_DEBUG_ASSERT(level < keylen);
+
+    for (int i = depth; i < level; i++) {
+      if (prefix[i] != keyvec[i]) {
+        // Whole subtree is either in range or out of it.
+        if ((prefix[i] > keyvec[i]) == (IDir == FORWARD)) {
+          return extreme_leaf<IDir>(node, path, found_key, found_value,
+                                    stale);
+        }
+
+        return false;
+      }
+    }
+
+    int keyind = level < keylen ? keyvec[level] : 0;
+    auto [ind, child] = node->template next_child<IDir>(keyind);
+
+    if (!is_valid(node, version, stale)) {
+      return false;
+    }
+
+    if (child != nullptr && ind == keyind) {
+      path.push_back({node, version, ind});
+
+      // Key of an embedded leaf at `keyind` is `key`.
+      bool found =
+          is_embedded(child)
+              ? inclusive && copy_embedded(node, ind, child, found_key,
+                                           found_value)
+              : bound_leaf<IDir>(child, key, level + 1, inclusive, path,
+                                 found_key, found_value, stale);
+
+      if (found || stale) {
+        return !stale;
+      }
+
+      path.pop_back();
+    }
+
+    return leaf_from<IDir>(node, version, step<IDir>(keyind), path, found_key,
+                           found_value, stale);
+  }
+
+  // Leaf following (FORWARD) or preceding (REVERSE) the one `path` leads to,
+  // resuming the traversal from the innermost node of `path` with children
+  // left. Stale, if any node it resumes from was changed since.
+  template <iter_direction IDir>
+  static bool next_leaf(scan_path_t &path, stored_key_t &found_key,
+                        value_type &found_value, bool &stale) {
+    while (!path.empty()) {
+      scan_entry_t entry = path.back();
+
+      path.pop_back();
+
+      if (leaf_from<IDir>(entry.node, entry.version, step<IDir>(entry.ind),
+                          path, found_key, found_value, stale) ||
+          stale) {
+        return !stale;
+      }
+    }
+
+    return false;
+  }
+
+  // Copies the leaf found by `bound_leaf` (or `extreme_leaf`, if `key` is
+  // nullptr) into `found_key` and `found_value`, restarting from root while
+  // the traversal is stale. Returns false, if there is no such leaf. Caller
+  // holds an epoch, for the nodes of `path` to remain valid.
+  template <iter_direction IDir>
+  bool seek(const stored_key_t *key, bool inclusive, scan_path_t &path,
+            stored_key_t &found_key, value_type &found_value) const {
+    while (true) {
+      const node_t *node = load_aq(root);
+      bool stale = false;
+      bool found = false;
+
+      path.clear();
+
+      if (node) {
+        found = key ? bound_leaf<IDir>(node, *key, 0, inclusive, path,
+                                       found_key, found_value, stale)
+                    : extreme_leaf<IDir>(node, path, found_key, found_value,
+                                         stale);
+      }
+
+      if (!stale) {
+        return found;
+      }
+    }
+  }
+
+  // Bulk load helpers
+  // Nodes are built unreachable (so without locking them), and published by
+  // `bulk_load` at once.
+
+  // Subtree of sorted and unique [first, last) (of 2 or more key/values),
+  // whose first `depth` bytes are common, with every inner node built at the
+  // node type of it's final # children. Children of the subtree's root are
+  // built by upto `num_threads` threads, including the calling one, which
+  // builds those left by threads, which could not be registered.
+  template <typename ForwardIt>
+  node_t *bulk_build(ForwardIt first, ForwardIt last, int depth,
+                     int num_threads) {
+    const stored_key_t firstkey = KeyEncoding::encode(first->first);
+    const ForwardIt back = std::next(first, std::distance(first, last) - 1);
+    const int level = common_prefix_length(
+        firstkey, KeyEncoding::encode(back->first), depth);
+    auto index_of = [level](const auto &key_value) {
+      return KeyEncoding::bytes(KeyEncoding::encode(key_value.first))[level];
+    };
+    // Indexes of children (bytes of their keys at `level`), with the first
+    // key/value of each. Keys being sorted, each child's key/values are
+    // found by a binary search.
+    std::vector<std::pair<std::uint8_t, ForwardIt>> groups;
+
+    for (auto it = first; it != last;) {
+      const std::uint8_t ind = index_of(*it);
+
+      groups.emplace_back(ind, it);
+      it = std::partition_point(
+          it, last, [&](const auto &kv) { return index_of(kv) == ind; });
+    }
+
+    std::vector<node_t *> children(groups.size());
+
+    auto build_child = [&](std::size_t i) {
+      ForwardIt child_first = groups[i].second;
+      ForwardIt child_last =
+          i + 1 < groups.size() ? groups[i + 1].second : last;
+
+      if (std::next(child_first) == child_last) {
+        children[i] = count_new(new_leaf(
+            level, KeyEncoding::encode(child_first->first),
+            child_first->second));
+      } else {
+        children[i] = bulk_build(child_first, child_last, level + 1, 1);
+      }
+    };
+
+    if (num_threads > 1 && groups.size() > 1) {
+      std::atomic<std::size_t> next_child{0};
+      std::vector<std::thread> threads;
+
+      auto build_children = [&] {
+        for (std::size_t child; (child = next_child++) < groups.size();)
+          build_child(child);
+      };
+
+      num_threads = std::min<std::size_t>(num_threads, groups.size());
+
+      for (int i = 1; i < num_threads; i++) {
+        threads.emplace_back([&] {
+          if (!utils::ThreadRegistry::RegisterThread())
+            return;
+
+          build_children();
+          utils::ThreadRegistry::UnregisterThread();
+        });
+      }
+
+      build_children();
+
+      for (auto &thread : threads)
+        thread.join();
+    } else {
+      for (std::size_t i = 0; i < groups.size(); i++)
+        build_child(i);
+    }
+
+    auto add_children = [&](auto *node) -> node_t * {
+      for (std::size_t i = 0; i < groups.size(); i++)
+        node->add(children[i], groups[i].first);
+
+      return count_new(node);
+    };
+
+    if (groups.size() <= node4_t::MAX_CHILDREN) {
+      return add_children(new node4_t(firstkey, level));
+    } else if (groups.size() <= node16_t::MAX_CHILDREN) {
+      return add_children(new node16_t(firstkey, level));
+    } else if (groups.size() <= node48_t::MAX_CHILDREN) {
+      return add_children(new node48_t(firstkey, level));
+    } else {
+      return add_children(new node256_t(firstkey, level));
+    }
+  }
 
   struct alignas(128) values_count_t {
     std::atomic<size_t> num_inserts;
     std::atomic<size_t> num_deletes;
+    // Nodes allocated less freed (or retired), by node_type_t.
+    std::atomic<std::ptrdiff_t> num_nodes[5];
   };
 
-  std::unique_ptr<sync_prim::mutex::Mutex> root_mtx;
+  // Counts `node` (unless embedded), allocated by the calling thread, in
+  // `memory_usage`.
+  template <typename Node> Node *count_new(Node *node) {
+    count_nodes(node, 1);
+    return node;
+  }
+
+  // Uncounts `node`, before it is freed or retired.
+  void count_freed(const node_t *node) { count_nodes(node, -1); }
+
+  void count_nodes(const node_t *node, std::ptrdiff_t n) {
+    if (!is_embedded(node)) {
+      std::atomic<std::ptrdiff_t> &num_nodes =
+          count[utils::ThreadRegistry::ThreadID()]
+              .num_nodes[static_cast<int>(node->node_type)];
+
+      store_rx(num_nodes, load_rx(num_nodes) + n);
+    }
+  }
+
+  // Lock of `root` (never obsolete).
+  std::atomic<version_t> root_version{0};
   atomic_node_t root;
   std::unique_ptr<values_count_t[]> count;
 
-  mutable indexes::utils::EpochManager<uint64_t, node_t> m_gc;
+  mutable indexes::utils::EpochManager<uint64_t, node_t> m_gc{
+      node_t::size_of};
 
 public:
   concurrent_map()
-      : root_mtx(std::make_unique<sync_prim::mutex::Mutex>()), root(nullptr),
-        count(std::make_unique<values_count_t[]>(
-            utils::ThreadRegistry::MAX_THREADS)) {}
+      : root(nullptr), count(std::make_unique<values_count_t[]>(
+                             utils::ThreadRegistry::MAX_THREADS)) {}
 
   concurrent_map(const concurrent_map &) = delete;
 
@@ -1172,45 +2651,62 @@ public:
       : root(other.root.exchange(nullptr)),
         count(std::exchange(other.count, nullptr)) {}
 
-  std::optional<value_type> Search(key_type key) const {
+  std::optional<value_type> Search(key_type userkey) const {
+    const stored_key_t key = KeyEncoding::encode(userkey);
     EpochGuard eg{this};
 
-    int depth = 0;
-    node_t *node = root;
-
-    while (node) {
-      if (node->is_leaf()) {
-        auto leaf = static_cast<const leaf_t *>(node);
-        if (leaf->key == key) {
-          return leaf->value;
-        }
+    while (true) {
+      bool stale;
+      auto value = search(key, stale);
 
-        break;
+      if (!stale) {
+        return value;
       }
+    }
+  }
 
-      int keylen = node->level - depth;
+  // Searches all `keys`, storing the result of keys[i] into values[i].
+  // Traversals of the keys are interleaved to overlap their cache misses.
+  void MultiSearch(gsl::span<const key_type> keys,
+                   gsl::span<std::optional<value_type>> values) const {
+    std::array<multi_search_lookup_t, MULTI_SEARCH_GROUP_SIZE> lookups;
+    std::array<stored_key_t, MULTI_SEARCH_GROUP_SIZE> group_keys;
+    std::size_t num_keys = keys.size();
 
-      if (keylen) {
-        int lcpl = node->longest_common_prefix_length(key);
-        int common_prefix_len = std::min(lcpl - depth, keylen);
+    ART_DEBUG_ASSERT(values.size() >= keys.size());
 
-        if (common_prefix_len != keylen) {
-          break;
-        }
+    EpochGuard eg{this};
+
+    for (std::size_t start = 0; start < num_keys;
+         start += MULTI_SEARCH_GROUP_SIZE) {
+      std::size_t end = std::min(start + MULTI_SEARCH_GROUP_SIZE, num_keys);
+      const node_t *node = root;
+      int num_lookups = 0;
 
-        depth += keylen;
+      for (std::size_t idx = start; idx < end; idx++) {
+        group_keys[num_lookups] = KeyEncoding::encode(keys[idx]);
+        lookups[num_lookups++] = {idx, 0, node};
       }
 
-      ART_DEBUG_ASSERT(depth < MAX_DEPTH);
+      while (num_lookups) {
+        int num_active = 0;
 
-      node = node->find(key);
-    }
+        for (int i = 0; i < num_lookups; i++) {
+          auto &lookup = lookups[i];
 
-    return {};
+          if (multi_search_step(group_keys[lookup.idx - start], lookup,
+                                values[lookup.idx])) {
+            lookups[num_active++] = lookup;
+          }
+        }
+
+        num_lookups = num_active;
+      }
+    }
   }
 
   bool Insert(key_type key, value_type value) {
-    auto &&old = insert<UpdateOp::UOP_Insert>(key, value);
+    auto &&old = insert<UpdateOp::UOP_Insert>(KeyEncoding::encode(key), value);
 
     if (!old) {
       std::atomic<std::size_t> &num_inserts =
@@ -1221,24 +2717,124 @@ public:
     return !old;
   }
 
-  std::optional<value_type> Upsert(key_type key, value_type value) {
-    auto &&old = insert<UpdateOp::UOP_Upsert>(key, value);
+  // Inserts `key_values` (same as `Insert` of each), and returns # of them
+  // inserted. Traversal of a key is resumed from the deepest node traversed
+  // by the previous key, within the prefix they have in common. So keys
+  // sorted by key traverse their common prefixes once. The epoch, which
+  // keeps the nodes of the path, is refreshed (and the path dropped) every
+  // EPOCH_REFRESH_INTERVAL keys.
+  std::size_t
+  InsertBatch(gsl::span<const std::pair<key_type, value_type>> key_values) {
+    EpochGuard eg{this};
+    path_t path;
+    stored_key_t prevkey{};
+    std::size_t num_keys = key_values.size();
+    std::size_t num_inserted = 0;
+
+    for (std::size_t i = 0; i < num_keys; i++) {
+      stored_key_t key = KeyEncoding::encode(key_values[i].first);
+      int lcpl = i ? common_prefix_length(prevkey, key, 0) : 0;
+
+      if (i && i % EPOCH_REFRESH_INTERVAL == 0) {
+        eg.refresh();
+        path.clear();
+      }
 
-    if (!old) {
-      std::atomic<std::size_t> &num_inserts =
-          count[utils::ThreadRegistry::ThreadID()].num_inserts;
-      store_rx(num_inserts, load_rx(num_inserts) + 1);
+      while (true) {
+        traverser_t traverser{*this};
+        auto old = traverser.template insert<UpdateOp::UOP_Insert>(
+            key, key_values[i].second, path, lcpl);
+
+        if (!traverser.is_snapshot_stale) {
+          num_inserted += !old;
+          break;
+        }
+
+        path.clear();
+      }
+
+      prevkey = std::move(key);
     }
 
-    return old;
+    std::atomic<std::size_t> &num_inserts =
+        count[utils::ThreadRegistry::ThreadID()].num_inserts;
+    store_rx(num_inserts, load_rx(num_inserts) + num_inserted);
+
+    return num_inserted;
+  }
+
+  // Loads sorted (by key) and unique key/values [first, last) into an empty
+  // map, building every inner node at it's final node type, instead of
+  // expanding (and retiring) it as keys are added. Subtrees of root's
+  // children are built by upto `num_threads` threads (the calling one and
+  // others registered with the ThreadRegistry while they run, or skipped, if
+  // they could not be registered), so keys spread over the top byte are
+  // loaded in parallel. Writers wait, while the map is loaded. Returns false
+  // (without loading anything), if the map is not empty.
+  template <typename ForwardIt>
+  bool bulk_load(ForwardIt first, ForwardIt last, int num_threads = 1) {
+    static_assert(
+        std::is_base_of_v<
+            std::forward_iterator_tag,
+            typename std::iterator_traits<ForwardIt>::iterator_category>,
+        "bulk load requires multipass iterators");
+
+    if (first == last)
+      return true;
+
+    ART_DEBUG_ASSERT(std::adjacent_find(first, last,
+                                        [](const auto &a, const auto &b) {
+                                          return !(a.first < b.first);
+                                        }) == last);
+
+    LockType lock = lock_or_wait(root_version);
+
+    if (load_aq(root))
+      return false;
+
+    std::size_t num_keys = std::distance(first, last);
+    node_t *node = num_keys == 1
+                       ? count_new(new_leaf(-1,
+                                            KeyEncoding::encode(first->first),
+                                            first->second))
+                       : bulk_build(first, last, 0, num_threads);
+
+    store_rs(root, node);
+
+    std::atomic<std::size_t> &num_inserts =
+        count[utils::ThreadRegistry::ThreadID()].num_inserts;
+    store_rx(num_inserts, load_rx(num_inserts) + num_keys);
+
+    return true;
+  }
+
+  std::optional<value_type> Upsert(key_type key, value_type value) {
+    return upsert(KeyEncoding::encode(key), value);
+  }
+
+  // Functional upsert, applies `fn(value_type &)` in place to the value of
+  // `key` under the leaf's lock, or to a default constructed value, which is
+  // inserted, if `key` is missing (`fn` could then be called again, if the
+  // insert has to be retried). Returns the old value, if any.
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<value_type> Upsert(key_type key, Fn &&fn) {
+    return upsert(KeyEncoding::encode(key), value_updater_t<Fn>{fn});
   }
 
   std::optional<value_type> Update(key_type key, value_type value) {
-    return insert<UpdateOp::UOP_Update>(key, value);
+    return insert<UpdateOp::UOP_Update>(KeyEncoding::encode(key), value);
+  }
+
+  // Functional update, same as functional `Upsert`, but does nothing if `key`
+  // is missing.
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<value_type> Update(key_type key, Fn &&fn) {
+    return insert<UpdateOp::UOP_Update>(KeyEncoding::encode(key),
+                                        value_updater_t<Fn>{fn});
   }
 
   std::optional<value_type> Delete(key_type key) {
-    auto &&old = erase(key);
+    auto &&old = erase(KeyEncoding::encode(key));
 
     if (old) {
       std::atomic<std::size_t> &num_deletes =
@@ -1249,6 +2845,174 @@ public:
     return std::move(old);
   }
 
+  // Iterators hold an epoch, a copy of the current key/value and the path of
+  // inner nodes to it's leaf, from which the traversal is resumed for the
+  // next key, at amortized O(1) cost. If a node it resumes from was changed
+  // since, the tree is searched again (at O(depth) cost) for the key
+  // following the current one, as it is every EPOCH_REFRESH_INTERVAL keys,
+  // when the epoch is refreshed. So iteration is not an atomic snapshot,
+  // concurrent updates may or may not be seen. The epoch is released at the
+  // end.
+  template <iter_direction IDir> class iterator_impl {
+  public:
+    using key_type = typename KeyEncoding::decoded_type;
+    using data_type = typename concurrent_map::value_type;
+    using value_type = std::pair<key_type, data_type>;
+    using reference = const value_type &;
+    using pointer = const value_type *;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+
+  private:
+    // nullptr at the end.
+    const concurrent_map *m_map = nullptr;
+    EpochGuard m_eg;
+    scan_path_t m_path;
+    int m_num_steps = 0;
+    stored_key_t m_key{};
+    value_type m_key_value{};
+
+    friend class concurrent_map;
+
+    iterator_impl(const concurrent_map *map, const stored_key_t *key,
+                  bool inclusive)
+        : m_map(map), m_eg(map) {
+      seek(key, inclusive);
+    }
+
+    void seek(const stored_key_t *key, bool inclusive) {
+      stored_key_t found_key;
+
+      if (m_map->template seek<IDir>(key, inclusive, m_path, found_key,
+                                     m_key_value.second)) {
+        found(std::move(found_key));
+      } else {
+        clear();
+      }
+    }
+
+    void found(stored_key_t &&key) {
+      m_key = std::move(key);
+      m_key_value.first = KeyEncoding::decode(m_key);
+    }
+
+    void clear() {
+      m_map = nullptr;
+      m_path.clear();
+      m_eg.release();
+    }
+
+  public:
+    iterator_impl() = default;
+
+    inline reference operator*() const { return m_key_value; }
+
+    inline pointer operator->() const { return &m_key_value; }
+
+    inline const key_type &key() const { return m_key_value.first; }
+
+    inline const data_type &data() const { return m_key_value.second; }
+
+    iterator_impl &operator++() {
+      stored_key_t found_key;
+      bool stale = false;
+
+      if (++m_num_steps % EPOCH_REFRESH_INTERVAL == 0) {
+        // Nodes of the path could be freed, once the epoch is left.
+        m_eg.refresh();
+        stale = true;
+      } else if (next_leaf<IDir>(m_path, found_key, m_key_value.second,
+                                 stale)) {
+        found(std::move(found_key));
+        return *this;
+      }
+
+      if (stale) {
+        seek(&m_key, false);
+      } else {
+        clear();
+      }
+
+      return *this;
+    }
+
+    iterator_impl operator++(int) {
+      auto copy = *this;
+
+      ++*this;
+      return copy;
+    }
+
+    inline bool operator==(const iterator_impl &other) const {
+      return m_map == other.m_map && (m_map == nullptr || m_key == other.m_key);
+    }
+
+    inline bool operator!=(const iterator_impl &other) const {
+      return !(*this == other);
+    }
+  };
+
+  using const_iterator = iterator_impl<FORWARD>;
+  using const_reverse_iterator = iterator_impl<REVERSE>;
+
+  inline const_iterator begin() const { return {this, nullptr, true}; }
+
+  inline const_iterator end() const { return {}; }
+
+  inline const_iterator cbegin() const { return begin(); }
+
+  inline const_iterator cend() const { return end(); }
+
+  inline const_reverse_iterator rbegin() const { return {this, nullptr, true}; }
+
+  inline const_reverse_iterator rend() const { return {}; }
+
+  inline const_reverse_iterator crbegin() const { return rbegin(); }
+
+  inline const_reverse_iterator crend() const { return rend(); }
+
+  // First key/value with key >= `key`.
+  const_iterator lower_bound(key_type key) const {
+    const stored_key_t encoded = KeyEncoding::encode(key);
+
+    return {this, &encoded, true};
+  }
+
+  // First key/value with key > `key`.
+  const_iterator upper_bound(key_type key) const {
+    const stored_key_t encoded = KeyEncoding::encode(key);
+
+    return {this, &encoded, false};
+  }
+
+  // Calls `callback(key, value)` for key/values in range [min, max], in key
+  // order. `callback` could return false to stop the scan. Like iteration, a
+  // scan is not an atomic snapshot of the range. Returns # key/values passed
+  // to `callback`.
+  template <typename Callback>
+  std::size_t scan(key_type min, key_type max, Callback &&callback) const {
+    using key_t = typename const_iterator::key_type;
+    using result_t =
+        std::invoke_result_t<Callback &, const key_t &, const value_type &>;
+    const stored_key_t maxkey = KeyEncoding::encode(max);
+    std::size_t num_scanned = 0;
+
+    for (auto it = lower_bound(min);
+         it != end() && compare_keys(it.m_key, maxkey) <= 0; ++it) {
+      num_scanned++;
+
+      if constexpr (std::is_same_v<result_t, bool>) {
+        if (!callback(it->first, it->second)) {
+          break;
+        }
+      } else {
+        callback(it->first, it->second);
+      }
+    }
+
+    return num_scanned;
+  }
+
   std::size_t size() const {
     std::size_t size = 0;
 
@@ -1262,6 +3026,12 @@ public:
   ~concurrent_map() {
     std::deque<node_t *> children;
 
+    m_gc.stop_background_reclamation();
+
+    // Free retired (and unlinked) nodes as well, no thread could be using
+    // them anymore.
+    m_gc.reclaim_all();
+
     if (root) {
       children.push_back(root);
     }
@@ -1284,6 +3054,53 @@ public:
 
   inline void reclaim_all() { m_gc.reclaim_all(); }
 
+  // Objects retired and pending reclamation (see `utils::epoch_stats_t`).
+  utils::epoch_stats_t<uint64_t> reclamation_stats() const {
+    return m_gc.stats();
+  }
+
+  // Sums node counts of threads, and does not walk the tree. Memory of
+  // values outside the leaves is not included.
+  art_memory_usage_t memory_usage() const {
+    std::ptrdiff_t num_nodes[5] = {};
+    art_memory_usage_t usage;
+
+    for (int i = 0, n = utils::ThreadRegistry::MAX_THREADS; i < n; i++) {
+      for (int type = 0; type < 5; type++)
+        num_nodes[type] += load_rx(count[i].num_nodes[type]);
+    }
+
+    auto num_of = [&](node_type_t type) {
+      return static_cast<std::size_t>(
+          std::max<std::ptrdiff_t>(num_nodes[static_cast<int>(type)], 0));
+    };
+
+    usage.num_node4 = num_of(node_type_t::NODE4);
+    usage.num_node16 = num_of(node_type_t::NODE16);
+    usage.num_node48 = num_of(node_type_t::NODE48);
+    usage.num_node256 = num_of(node_type_t::NODE256);
+    usage.num_leaves = num_of(node_type_t::LEAF);
+    usage.inner_bytes = usage.num_node4 * sizeof(node4_t) +
+                        usage.num_node16 * sizeof(node16_t) +
+                        usage.num_node48 * sizeof(node48_t) +
+                        usage.num_node256 * sizeof(node256_t);
+    usage.leaf_bytes = usage.num_leaves * sizeof(leaf_t);
+    usage.retired_bytes = m_gc.stats().retired_bytes;
+
+    return usage;
+  }
+
+  // Objects retired by writers are reclaimed by a thread every `interval` (see
+  // `utils::EpochManager::start_background_reclamation`).
+  void start_background_reclamation(std::chrono::microseconds interval,
+                                    bool recycle = false) {
+    m_gc.start_background_reclamation(interval, recycle);
+  }
+
+  void stop_background_reclamation() {
+    m_gc.stop_background_reclamation();
+  }
+
   ART_DUMP_METHODS
 };
 } // namespace indexes::art
@@ -0,0 +1,356 @@
+// include/indexes/btree/cached_map.h
+// B+Tree fronted by a fixed size cache of hot keys
+
+#pragma once
+
+#include "concurrent_map.h"
+#include "indexes/utils/Utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+namespace indexes::btree {
+// Memory of a cached_map (see `cached_map::memory_usage`).
+struct cached_map_memory_usage_t {
+  btree_memory_usage_t map;
+  std::size_t cache_bytes = 0;
+
+  std::size_t total_bytes() const { return map.total_bytes() + cache_bytes; }
+
+  void dump(std::ostream &ostr) const {
+    map.dump(ostr);
+    ostr << "Cache Bytes = " << cache_bytes << "\n";
+  }
+};
+
+struct cached_map_cache_stats_t {
+  std::size_t num_hits = 0;
+  std::size_t num_misses = 0;
+
+  double hit_ratio() const {
+    return num_hits + num_misses
+               ? static_cast<double>(num_hits) / (num_hits + num_misses)
+               : 0;
+  }
+
+  void dump(std::ostream &ostr) const {
+    ostr << "Num Cache Hits = " << num_hits << "\n";
+    ostr << "Num Cache Misses = " << num_misses << "\n";
+  }
+};
+
+// concurrent_map, whose point lookups are served from a small fixed size
+// cache of recently found key/values, so that lookups of hot keys do not
+// traverse the tree. Writes go to the map and invalidate the key's cache
+// entry, and range scans (iterators) go to the map only.
+//
+// The cache is a table of buckets, each a cache line of a few key/values and
+// a version, which is odd while the bucket is written. Lookups read buckets
+// optimistically, as readers of the tree read nodes. A value found in the map
+// is cached only if the bucket's version is unchanged since before the map
+// was searched, and writers bump it after writing the map. So a value, which
+// was overwritten while it was searched, is never cached. Entries of a full
+// bucket are evicted by CLOCK, which skips (and clears) the ones hit since
+// the last sweep.
+//
+// Keys and values are copied in and out of buckets racily, so they must be
+// trivially copyable and lock free atomics.
+template <typename Key, typename Value, typename Traits = btree_traits_default,
+          typename Hash = std::hash<Key>>
+class cached_map {
+  static_assert(std::atomic<Key>::is_always_lock_free &&
+                    std::atomic<Value>::is_always_lock_free,
+                "Cached keys and values must be lock free atomics");
+
+public:
+  using map_type = concurrent_map<Key, Value, Traits>;
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using size_type = std::size_t;
+  using const_iterator = typename map_type::const_iterator;
+  using const_reverse_iterator = typename map_type::const_reverse_iterator;
+
+  static constexpr std::size_t DEFAULT_CACHE_CAPACITY = 1 << 16;
+
+private:
+  static constexpr int BUCKET_HEADER_SIZE = 8;
+  // Key/values, which fit a cache line with the header.
+  static constexpr int NUM_WAYS = std::clamp<int>(
+      (utils::CACHELINE_SIZE - BUCKET_HEADER_SIZE) /
+          (sizeof(Key) + sizeof(Value)),
+      1, 8);
+
+  struct alignas(utils::CACHELINE_SIZE) bucket_t {
+    std::atomic<std::uint32_t> version{0};
+    // Bits of ways, which are occupied and which were hit since the last
+    // sweep of `hand`.
+    std::atomic<std::uint8_t> occupied{0};
+    std::atomic<std::uint8_t> referenced{0};
+    // Next way to sweep for eviction. Written only under the bucket lock.
+    std::uint8_t hand = 0;
+    std::atomic<Key> keys[NUM_WAYS];
+    std::atomic<Value> values[NUM_WAYS];
+  };
+
+  static_assert(sizeof(bucket_t) == utils::CACHELINE_SIZE);
+
+  struct alignas(128) cache_count_t {
+    std::atomic<std::size_t> num_hits{0};
+    std::atomic<std::size_t> num_misses{0};
+  };
+
+  template <typename T> static void increment(std::atomic<T> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+  }
+
+  template <typename Fn>
+  static constexpr bool is_updater_v =
+      std::is_invocable_v<Fn &, mapped_type &>;
+
+  map_type m_map;
+  int m_bucket_bits;
+  std::unique_ptr<bucket_t[]> m_buckets;
+  std::unique_ptr<cache_count_t[]> m_counts;
+
+  bucket_t &bucket_of(const key_type &key) const {
+    // Hashes are mixed first, as hashes like std::hash of integers leave the
+    // high bits unset.
+    std::uint64_t hash = Hash{}(key) * 0x9E3779B97F4A7C15ULL;
+
+    return m_buckets[m_bucket_bits ? hash >> (64 - m_bucket_bits) : 0];
+  }
+
+  // Value of `key` in `bucket`, read at `version`, if any.
+  static std::optional<mapped_type> lookup(bucket_t &bucket,
+                                           const key_type &key,
+                                           std::uint32_t version) {
+    if (version & 1)
+      return std::nullopt;
+
+    auto occupied = bucket.occupied.load(std::memory_order_relaxed);
+
+    for (int way = 0; way < NUM_WAYS; way++) {
+      if (!(occupied & (1 << way)) ||
+          bucket.keys[way].load(std::memory_order_relaxed) != key) {
+        continue;
+      }
+
+      mapped_type value = bucket.values[way].load(std::memory_order_relaxed);
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (bucket.version.load(std::memory_order_relaxed) != version)
+        return std::nullopt;
+
+      // Written only once per sweep, to not bounce the line of hot keys.
+      if (!(bucket.referenced.load(std::memory_order_relaxed) & (1 << way)))
+        bucket.referenced.fetch_or(1 << way, std::memory_order_relaxed);
+
+      return value;
+    }
+
+    return std::nullopt;
+  }
+
+  // Caches `key` and `value`, found in the map, unless the bucket changed
+  // since `version`. Does not wait for other writers of the bucket.
+  static void install(bucket_t &bucket, const key_type &key,
+                      const mapped_type &value, std::uint32_t version) {
+    if ((version & 1) ||
+        !bucket.version.compare_exchange_strong(version, version + 1,
+                                                std::memory_order_acquire)) {
+      return;
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto occupied = bucket.occupied.load(std::memory_order_relaxed);
+    auto referenced = bucket.referenced.load(std::memory_order_relaxed);
+    std::uint8_t swept = 0;
+    int way = bucket.hand;
+
+    // Ends within 2 sweeps, as the first clears all referenced bits.
+    while ((occupied & (1 << way)) && (referenced & ~swept & (1 << way))) {
+      swept |= 1 << way;
+      way = (way + 1) % NUM_WAYS;
+    }
+
+    bucket.referenced.fetch_and(~(swept | (1 << way)),
+                                std::memory_order_relaxed);
+    bucket.keys[way].store(key, std::memory_order_relaxed);
+    bucket.values[way].store(value, std::memory_order_relaxed);
+    bucket.occupied.store(occupied | (1 << way), std::memory_order_relaxed);
+    bucket.hand = (way + 1) % NUM_WAYS;
+    bucket.version.store(version + 2, std::memory_order_release);
+  }
+
+  // Drops `key` from the cache and fails concurrent installs into it's
+  // bucket. Must be called after `key` is written to the map.
+  void invalidate(const key_type &key) {
+    bucket_t &bucket = bucket_of(key);
+    auto version = bucket.version.load(std::memory_order_relaxed);
+
+    while ((version & 1) ||
+           !bucket.version.compare_exchange_weak(version, version + 1,
+                                                 std::memory_order_acquire)) {
+      utils::cpu_relax();
+      version = bucket.version.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto occupied = bucket.occupied.load(std::memory_order_relaxed);
+
+    for (int way = 0; way < NUM_WAYS; way++) {
+      if ((occupied & (1 << way)) &&
+          bucket.keys[way].load(std::memory_order_relaxed) == key) {
+        bucket.occupied.store(occupied & ~(1 << way),
+                              std::memory_order_relaxed);
+      }
+    }
+
+    bucket.version.store(version + 2, std::memory_order_release);
+  }
+
+  template <typename Result>
+  Result invalidate_if(const key_type &key, Result &&result) {
+    if (result)
+      invalidate(key);
+
+    return std::forward<Result>(result);
+  }
+
+public:
+  // Cache holds about `cache_capacity` key/values (rounded to a power of 2
+  // buckets).
+  explicit cached_map(std::size_t cache_capacity = DEFAULT_CACHE_CAPACITY)
+      : m_bucket_bits(0),
+        m_counts(std::make_unique<cache_count_t[]>(
+            utils::ThreadRegistry::MAX_THREADS)) {
+    while ((std::size_t{NUM_WAYS} << m_bucket_bits) < cache_capacity)
+      m_bucket_bits++;
+
+    m_buckets = std::make_unique<bucket_t[]>(std::size_t{1} << m_bucket_bits);
+  }
+
+  cached_map(const cached_map &) = delete;
+
+  // The map, which could be read, but not written bypassing the cache.
+  const map_type &map() const { return m_map; }
+
+  void reserve(size_t num_values) { m_map.reserve(num_values); }
+
+  std::optional<mapped_type> Search(const key_type &key) {
+    bucket_t &bucket = bucket_of(key);
+    auto version = bucket.version.load(std::memory_order_acquire);
+    cache_count_t &count = m_counts[utils::ThreadRegistry::ThreadID()];
+
+    if (auto value = lookup(bucket, key, version)) {
+      increment(count.num_hits);
+      return value;
+    }
+
+    increment(count.num_misses);
+
+    auto value = m_map.Search(key);
+
+    if (value)
+      install(bucket, key, *value, version);
+
+    return value;
+  }
+
+  // Inserting a missing key leaves the cache as is, as missing keys are not
+  // cached.
+  bool Insert(const key_type &key, const mapped_type &val) {
+    return m_map.Insert(key, val);
+  }
+
+  std::optional<mapped_type> Upsert(const key_type &key,
+                                    const mapped_type &val) {
+    return invalidate_if(key, m_map.Upsert(key, val));
+  }
+
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn) {
+    return invalidate_if(key, m_map.Upsert(key, std::forward<Fn>(fn)));
+  }
+
+  std::optional<mapped_type> Update(const key_type &key,
+                                    const mapped_type &val) {
+    return invalidate_if(key, m_map.Update(key, val));
+  }
+
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn) {
+    return invalidate_if(key, m_map.Update(key, std::forward<Fn>(fn)));
+  }
+
+  std::optional<mapped_type> Delete(const key_type &key) {
+    return invalidate_if(key, m_map.Delete(key));
+  }
+
+  const_iterator begin() const { return m_map.begin(); }
+
+  const_iterator end() const { return m_map.end(); }
+
+  const_reverse_iterator rbegin() const { return m_map.rbegin(); }
+
+  const_reverse_iterator rend() const { return m_map.rend(); }
+
+  const_iterator lower_bound(const key_type &key) const {
+    return m_map.lower_bound(key);
+  }
+
+  const_iterator upper_bound(const key_type &key) const {
+    return m_map.upper_bound(key);
+  }
+
+  template <ENABLE_IF(Traits::STAT)> std::size_t size() const {
+    return m_map.size();
+  }
+
+  template <ENABLE_IF(Traits::STAT)> bool empty() const {
+    return m_map.empty();
+  }
+
+  std::size_t cache_capacity() const {
+    return std::size_t{NUM_WAYS} << m_bucket_bits;
+  }
+
+  cached_map_cache_stats_t cache_stats() const {
+    cached_map_cache_stats_t stats;
+
+    for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++) {
+      stats.num_hits += m_counts[i].num_hits.load(std::memory_order_relaxed);
+      stats.num_misses +=
+          m_counts[i].num_misses.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+  }
+
+  cached_map_memory_usage_t memory_usage() const {
+    cached_map_memory_usage_t usage;
+
+    usage.map = m_map.memory_usage();
+    usage.cache_bytes = (std::size_t{1} << m_bucket_bits) * sizeof(bucket_t) +
+                        utils::ThreadRegistry::MAX_THREADS *
+                            sizeof(cache_count_t);
+
+    return usage;
+  }
+
+  void reclaim_all() { m_map.reclaim_all(); }
+};
+} // namespace indexes::btree
@@ -20,6 +20,8 @@
 #include <type_traits>
 
 #include "btree_dump.h"
+#include "indexes/utils/PageAllocator.h"
+#include "indexes/utils/Utils.h"
 
 #define BTREE_DEBUG(expr)                                                      \
   do {                                                                         \
@@ -43,7 +45,7 @@
 #define BTREE_UPDATE_STAT(stat, op)                                            \
   do {                                                                         \
     if constexpr (Traits::STAT) {                                              \
-      this->m_stats->CONCAT(CONCAT(num_, stat), s) op;                         \
+      this->m_stats->local().CONCAT(CONCAT(num_, stat), s) op;                 \
     }                                                                          \
   } while (0)
 
@@ -65,9 +67,39 @@
 namespace indexes::btree {
 struct btree_traits_default {
   static constexpr int NODE_SIZE = 8 * 1024;
+  // Sizes of inner nodes and leaves, if not 0 (or else NODE_SIZE). Small inner
+  // nodes keep more of the upper levels in cache, while big leaves make scans
+  // cheaper.
+  static constexpr int INNER_NODE_SIZE = 0;
+  static constexpr int LEAF_NODE_SIZE = 0;
   static constexpr int NODE_MERGE_THRESHOLD = 20;
+  // % of values left in a node when it is split by an append.
+  static constexpr int APPEND_SPLIT_PERCENT = 90;
   static constexpr bool DEBUG = false;
   static constexpr bool STAT = false;
+  // Store integral keys in slots and search them with SIMD (AVX2, if
+  // available, or else branchless scalar code).
+  static constexpr bool SIMD_SEARCH = true;
+  // Store order preserving key prefixes in slots, if the key supports it.
+  // See `key_prefix`.
+  static constexpr bool KEY_PREFIX = true;
+  // Deletes only queue underfull or trimmable leaves, which are merged or
+  // trimmed later by `maintain`, instead of on the deleting thread.
+  static constexpr bool DEFERRED_MAINTENANCE = false;
+  // With STAT, every STAT_SAMPLE_PERIOD'th lock wait of a thread is timed
+  // (0 times none).
+  static constexpr int STAT_SAMPLE_PERIOD = 64;
+  // Leaf updates, which do not split or merge the leaf, elide the leaf's
+  // mutex in a hardware transaction, if the build and CPU support it (see
+  // `utils::htm_supported`). After LOCK_ELISION_RETRIES aborts, the leaf is
+  // locked.
+  static constexpr bool LOCK_ELISION = false;
+  static constexpr int LOCK_ELISION_RETRIES = 3;
+
+  // Allocator of pages of a node size, used by concurrent_map.
+  // Must provide static `void *allocate()` and `void deallocate(void *)`.
+  template <std::size_t PageSize>
+  using Allocator = indexes::utils::PagePool<PageSize>;
 };
 
 struct btree_traits_debug : btree_traits_default {
@@ -75,18 +107,98 @@ struct btree_traits_debug : btree_traits_default {
   static constexpr bool STAT = true;
 };
 
-struct btree_stats_t {
-  std::atomic<size_t> num_elements;
-  std::atomic<size_t> num_leaf_splits;
-  std::atomic<size_t> num_inner_splits;
-  std::atomic<size_t> num_leaf_trims;
-  std::atomic<size_t> num_inner_trims;
-  std::atomic<size_t> num_leaf_merges;
-  std::atomic<size_t> num_inner_merges;
+// Sizes of inner nodes and leaves of the maps using `Traits`.
+template <typename Traits> struct btree_node_sizes {
+  static constexpr int INNER =
+      Traits::INNER_NODE_SIZE ? Traits::INNER_NODE_SIZE : Traits::NODE_SIZE;
+  static constexpr int LEAF =
+      Traits::LEAF_NODE_SIZE ? Traits::LEAF_NODE_SIZE : Traits::NODE_SIZE;
+};
+
+// Counter of a stats shard (see `btree_sharded_stats_t`), which is updated
+// only by it's thread and read by others. Updates are relaxed loads and
+// stores, instead of atomic read-modify-writes.
+class btree_stat_counter_t {
+public:
+  operator size_t() const { return m_value.load(std::memory_order_relaxed); }
+
+  btree_stat_counter_t &operator+=(size_t n) {
+    m_value.store(*this + n, std::memory_order_relaxed);
+    return *this;
+  }
+
+  btree_stat_counter_t &operator-=(size_t n) { return *this += -n; }
+  btree_stat_counter_t &operator++() { return *this += 1; }
+  btree_stat_counter_t &operator--() { return *this -= 1; }
+  void operator++(int) { *this += 1; }
+  void operator--(int) { *this -= 1; }
+
+  void max(size_t n) {
+    if (n > *this)
+      m_value.store(n, std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<size_t> m_value{0};
+};
+
+// Traversals to a leaf by # restarts (the last bucket has all of more).
+constexpr int NUM_RESTART_BUCKETS = 4;
+
+template <typename Counter> struct btree_stat_fields_t {
+  Counter num_elements{};
+  Counter num_leaf_splits{};
+  Counter num_inner_splits{};
+  Counter num_leaf_trims{};
+  Counter num_inner_trims{};
+  Counter num_leaf_merges{};
+  Counter num_inner_merges{};
 
-  std::atomic<size_t> num_pessimistic_reads;
-  std::atomic<size_t> num_optimistic_fails;
-  std::atomic<size_t> num_retrys;
+  Counter num_pessimistic_reads{};
+  Counter num_optimistic_fails{};
+  Counter num_retrys{};
+  // Leaf updates committed in a transaction (see `btree_traits_default::
+  // LOCK_ELISION`), and it's aborted transactions.
+  Counter num_elided_locks{};
+  Counter num_elision_aborts{};
+
+  Counter num_traversals[NUM_RESTART_BUCKETS] = {};
+
+  // Of sampled waits for a node lock (see `btree_traits_default::
+  // STAT_SAMPLE_PERIOD`).
+  Counter num_lock_wait_samples{};
+  Counter lock_wait_nanos{};
+  Counter max_lock_wait_nanos{};
+
+  template <typename OtherCounter>
+  void add(const btree_stat_fields_t<OtherCounter> &other) {
+    num_elements += other.num_elements;
+    num_leaf_splits += other.num_leaf_splits;
+    num_inner_splits += other.num_inner_splits;
+    num_leaf_trims += other.num_leaf_trims;
+    num_inner_trims += other.num_inner_trims;
+    num_leaf_merges += other.num_leaf_merges;
+    num_inner_merges += other.num_inner_merges;
+
+    num_pessimistic_reads += other.num_pessimistic_reads;
+    num_optimistic_fails += other.num_optimistic_fails;
+    num_retrys += other.num_retrys;
+    num_elided_locks += other.num_elided_locks;
+    num_elision_aborts += other.num_elision_aborts;
+
+    for (int restarts = 0; restarts < NUM_RESTART_BUCKETS; restarts++)
+      num_traversals[restarts] += other.num_traversals[restarts];
+
+    num_lock_wait_samples += other.num_lock_wait_samples;
+    lock_wait_nanos += other.lock_wait_nanos;
+    max_lock_wait_nanos =
+        std::max<size_t>(max_lock_wait_nanos, other.max_lock_wait_nanos);
+  }
+};
+
+struct btree_stats_t : btree_stat_fields_t<size_t> {
+  // Stats updated by the calling thread.
+  btree_stats_t &local() { return *this; }
 
   void dump(std::ostream &ostr) const {
     ostr << "Num Leaf Splits = " << num_leaf_splits << "\n";
@@ -99,8 +211,95 @@ struct btree_stats_t {
     ostr << "Num Pessimistic Reads = " << num_pessimistic_reads << "\n";
     ostr << "Num Optimistic Fails = " << num_optimistic_fails << "\n";
     ostr << "Num Retries = " << num_retrys << "\n";
+    ostr << "Num Elided Locks = " << num_elided_locks << "\n";
+    ostr << "Num Elision Aborts = " << num_elision_aborts << "\n";
+
+    for (int restarts = 0; restarts < NUM_RESTART_BUCKETS; restarts++) {
+      ostr << "Num Traversals With " << restarts
+           << (restarts == NUM_RESTART_BUCKETS - 1 ? "+" : "")
+           << " Restarts = " << num_traversals[restarts] << "\n";
+    }
+
+    ostr << "Num Lock Wait Samples = " << num_lock_wait_samples << "\n";
+    ostr << "Avg Lock Wait (ns) = "
+         << (num_lock_wait_samples ? lock_wait_nanos / num_lock_wait_samples
+                                   : 0)
+         << "\n";
+    ostr << "Max Lock Wait (ns) = " << max_lock_wait_nanos << "\n";
   }
 };
 
+// Stats of a concurrent_map, in a shard per thread (on it's own cache lines),
+// so that threads do not contend on counters. Reads sum the shards.
+class btree_sharded_stats_t {
+public:
+  struct alignas(128) shard_t : btree_stat_fields_t<btree_stat_counter_t> {};
+
+  // Stats updated by the calling thread.
+  shard_t &local() { return m_shards[utils::ThreadRegistry::ThreadID()]; }
+
+  btree_stats_t sum() const {
+    btree_stats_t stats;
+
+    for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++)
+      stats.add(m_shards[i]);
+
+    return stats;
+  }
+
+  size_t num_elements() const {
+    size_t num_elements = 0;
+
+    for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++)
+      num_elements += m_shards[i].num_elements;
+
+    return num_elements;
+  }
+
+private:
+  std::unique_ptr<shard_t[]> m_shards =
+      std::make_unique<shard_t[]>(utils::ThreadRegistry::MAX_THREADS);
+};
+
 struct btree_empty_stats_t {};
+
+// Memory of a concurrent_map (see `concurrent_map::memory_usage`). Node pages
+// are split into headers, key/values (and their slots) of live values, of
+// deleted values (reused once the node is trimmed) and free space. Nodes
+// retired, but not reclaimed yet, are included.
+struct btree_memory_usage_t {
+  std::size_t num_inner_nodes = 0;
+  std::size_t num_leaf_nodes = 0;
+  std::size_t inner_bytes = 0;
+  std::size_t leaf_bytes = 0;
+
+  std::size_t header_bytes = 0;
+  std::size_t live_bytes = 0;
+  std::size_t dead_bytes = 0;
+  std::size_t free_bytes = 0;
+
+  // Of nodes pending reclamation
+  std::size_t retired_bytes = 0;
+
+  std::size_t total_bytes() const { return inner_bytes + leaf_bytes; }
+
+  // Fraction of node pages not used by live values
+  double fragmentation() const {
+    return total_bytes() ? static_cast<double>(dead_bytes + free_bytes) /
+                               total_bytes()
+                         : 0;
+  }
+
+  void dump(std::ostream &ostr) const {
+    ostr << "Num Inner Nodes = " << num_inner_nodes << "\n";
+    ostr << "Num Leaf Nodes = " << num_leaf_nodes << "\n";
+    ostr << "Inner Bytes = " << inner_bytes << "\n";
+    ostr << "Leaf Bytes = " << leaf_bytes << "\n";
+    ostr << "Header Bytes = " << header_bytes << "\n";
+    ostr << "Live Bytes = " << live_bytes << "\n";
+    ostr << "Dead Bytes = " << dead_bytes << "\n";
+    ostr << "Free Bytes = " << free_bytes << "\n";
+    ostr << "Retired Bytes = " << retired_bytes << "\n";
+  }
+};
 } // namespace indexes::btree
@@ -5,17 +5,29 @@
 
 #include "common.h"
 #include "indexes/utils/EpochManager.h"
+#include "indexes/utils/MappedFile.h"
+#include "key.h"
 #include "sync_prim/Mutex.h"
 
+#include <array>
 #include <atomic>
 #include <bitset>
 #include <boost/container/small_vector.hpp>
 #include <chrono>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #define ENABLE_IF(cond)                                                        \
   typename Dummy = void, typename = std::enable_if_t<cond, Dummy>
 #define ENABLE_IF_DYNAMIC_KEY ENABLE_IF(is_dynamic_key)
@@ -72,18 +84,195 @@ public:
         m_root_state(detail::load_relaxed(moved.m_root_state)),
         m_root(detail::load_relaxed(moved.m_root)),
         m_height(detail::load_relaxed(moved.m_height)),
-        m_stats(std::move(moved.m_stats)) {
+        m_rightmost_leaf(detail::load_relaxed(moved.m_rightmost_leaf)),
+        m_stats(std::move(moved.m_stats)),
+        m_page_usage(std::move(moved.m_page_usage)),
+        m_maintenance(std::move(moved.m_maintenance)) {
     moved.m_root_state.store({});
     moved.m_root.store(nullptr);
     moved.m_height.store(0);
+    moved.m_rightmost_leaf.store(nullptr);
   }
 
   static constexpr auto is_dynamic_key =
       std::is_base_of_v<dynamic_key_base, key_type>;
 
+  static_assert(!Traits::DEFERRED_MAINTENANCE || !is_dynamic_key,
+                "Deferred maintenance queues copies of keys, so it is only "
+                "supported for static keys");
+
 protected:
+  static constexpr int INNER_NODE_SIZE = btree_node_sizes<Traits>::INNER;
+  static constexpr int LEAF_NODE_SIZE = btree_node_sizes<Traits>::LEAF;
+
+  template <int NodeSize>
+  using page_allocator_t = typename Traits::template Allocator<NodeSize>;
+
+  // Slots point to key/values in the page, they could additionally hold,
+  // - Integral keys themselves (Traits::SIMD_SEARCH), so node searches never
+  //   dereference keys and are done with SIMD compares.
+  // - Order preserving key prefixes (Traits::KEY_PREFIX) in the bits above
+  //   SLOT_OFFSET_BITS, so that node searches dereference keys, which are
+  //   spread all over the page, only on a prefix tie. Prefix and offset of a
+  //   slot are read together atomically.
+  static constexpr bool INLINE_KEY =
+      Traits::SIMD_SEARCH && !is_dynamic_key &&
+      std::is_integral_v<key_type> && !std::is_same_v<key_type, bool> &&
+      sizeof(key_type) <= sizeof(uint64_t);
+  static constexpr bool KEY_PREFIX =
+      !INLINE_KEY && Traits::KEY_PREFIX && !is_dynamic_key &&
+      !std::is_void_v<typename key_prefix<key_type>::family>;
+  static constexpr int SLOT_OFFSET_BITS = 16;
+
+  static_assert(!KEY_PREFIX ||
+                    std::max(INNER_NODE_SIZE, LEAF_NODE_SIZE) <=
+                        (1 << SLOT_OFFSET_BITS),
+                "Page offsets must fit in SLOT_OFFSET_BITS to use key prefix");
+
+  struct inline_key_slot_t {
+    std::atomic<key_type> key;
+    std::atomic<int> offset;
+  };
+
+  using slot_t = std::conditional_t<
+      INLINE_KEY, inline_key_slot_t,
+      std::atomic<std::conditional_t<KEY_PREFIX, uint64_t, int>>>;
+
+  struct slot_value_t {
+    // Key itself, if inlined
+    std::conditional_t<INLINE_KEY, key_type, uint64_t> prefix;
+    int offset;
+  };
+
+  // Can the lookup key be compared with the prefixes stored in slots?
+  template <typename KeyType>
+  static constexpr bool has_key_prefix =
+      KEY_PREFIX && std::is_same_v<
+                        typename key_prefix<std::decay_t<KeyType>>::family,
+                        typename key_prefix<key_type>::family>;
+
+  template <typename KeyType>
+  static inline uint64_t get_key_prefix(const KeyType &key) noexcept {
+    return key_prefix<std::decay_t<KeyType>>::encode(key) >> SLOT_OFFSET_BITS;
+  }
+
+  static inline slot_value_t load_slot(const slot_t &slot) noexcept {
+    if constexpr (INLINE_KEY) {
+      return {detail::load_acquire(slot.key),
+              detail::load_acquire(slot.offset)};
+    } else if constexpr (KEY_PREFIX) {
+      auto value = detail::load_acquire(slot);
+      auto offset_mask = (uint64_t{1} << SLOT_OFFSET_BITS) - 1;
+
+      return {value >> SLOT_OFFSET_BITS, static_cast<int>(value & offset_mask)};
+    } else {
+      return {0, detail::load_acquire(slot)};
+    }
+  }
+
+  static inline void store_slot(slot_t &slot,
+                                const slot_value_t &value) noexcept {
+    if constexpr (INLINE_KEY) {
+      detail::store_release(slot.key, value.prefix);
+      detail::store_release(slot.offset, value.offset);
+    } else if constexpr (KEY_PREFIX) {
+      detail::store_release(slot, (value.prefix << SLOT_OFFSET_BITS) |
+                                      static_cast<uint64_t>(value.offset));
+    } else {
+      detail::store_release(slot, value.offset);
+    }
+  }
+
+  // Slots are binary searched until these many are left, which are then
+  // linearly scanned.
+  static constexpr int LINEAR_SEARCH_WIDTH = 16;
+
+  // Inlined keys in slots[0, num_slots) less than (or equal to, if `OrEqual`)
+  // `key`. Slots are sorted by key, but concurrent updaters could shuffle them,
+  // result is always within [0, num_slots] nevertheless.
+  template <bool OrEqual>
+  static int count_inline_keys(const slot_t *slots, int num_slots,
+                               key_type key) noexcept {
+    auto pred = [key](const slot_t &slot) {
+      auto slot_key = detail::load_acquire(slot.key);
+      return OrEqual ? !(key < slot_key) : slot_key < key;
+    };
+    const slot_t *first = slots;
+
+    // Branchless binary search
+    while (num_slots > LINEAR_SEARCH_WIDTH) {
+      int half = num_slots / 2;
+      bool right = pred(first[half]);
+
+      first = right ? first + half + 1 : first;
+      num_slots = right ? num_slots - half - 1 : half;
+    }
+
+    int count = static_cast<int>(first - slots);
+    int pos = 0;
+
+#if defined(__AVX2__)
+    // Vector loads of the atomics are fine on x86, as every aligned element is
+    // read atomically and loads are not reordered w.r.t other loads.
+    if constexpr (sizeof(key_type) == sizeof(int64_t) &&
+                  sizeof(slot_t) == 2 * sizeof(int64_t)) {
+      constexpr auto sign_bit = std::numeric_limits<int64_t>::min();
+      const auto flip = _mm256_set1_epi64x(
+          std::is_signed_v<key_type> ? 0 : sign_bit);
+      const auto needle = _mm256_xor_si256(
+          _mm256_set1_epi64x(static_cast<int64_t>(key)), flip);
+
+      for (; pos + 4 <= num_slots; pos += 4) {
+        auto lo = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(first + pos));
+        auto hi = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(first + pos + 2));
+        // Keys of 4 slots, in the order 0, 2, 1, 3
+        auto keys = _mm256_xor_si256(_mm256_unpacklo_epi64(lo, hi), flip);
+        auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+            OrEqual ? _mm256_cmpgt_epi64(keys, needle)
+                    : _mm256_cmpgt_epi64(needle, keys)));
+        int num_set = static_cast<int>(std::bitset<4>(mask).count());
+
+        count += OrEqual ? 4 - num_set : num_set;
+      }
+    } else if constexpr (sizeof(key_type) == sizeof(int32_t) &&
+                         sizeof(slot_t) == 2 * sizeof(int32_t)) {
+      constexpr auto sign_bit = std::numeric_limits<int32_t>::min();
+      const auto flip =
+          _mm256_set1_epi32(std::is_signed_v<key_type> ? 0 : sign_bit);
+      const auto needle = _mm256_xor_si256(
+          _mm256_set1_epi32(static_cast<int32_t>(key)), flip);
+
+      for (; pos + 4 <= num_slots; pos += 4) {
+        // Keys are at even lanes
+        auto keys = _mm256_xor_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + pos)),
+            flip);
+        auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(
+                        OrEqual ? _mm256_cmpgt_epi32(keys, needle)
+                                : _mm256_cmpgt_epi32(needle, keys))) &
+                    0x55;
+        int num_set = static_cast<int>(std::bitset<8>(mask).count());
+
+        count += OrEqual ? 4 - num_set : num_set;
+      }
+    }
+#endif
+
+    // Branchless linear scan
+    for (; pos < num_slots; pos++)
+      count += pred(first[pos]);
+
+    return count;
+  }
+
   enum class NodeType : int8_t { LEAF, INNER };
 
+  static constexpr int node_size(NodeType node_type) {
+    return node_type == NodeType::INNER ? INNER_NODE_SIZE : LEAF_NODE_SIZE;
+  }
+
   class nodestate_t {
     using bitset = std::bitset<64>;
 
@@ -142,8 +331,48 @@ protected:
     }
   };
 
+  // Mutex of a node, whose holding is observable by transactions eliding it
+  // (Traits::LOCK_ELISION). It's holder sets `held` after locking it, which
+  // aborts the transactions that read it.
+  class elidable_mutex_t {
+  public:
+    void lock() {
+      mutex.lock();
+      held.store(true, std::memory_order_seq_cst);
+    }
+
+    void unlock() {
+      held.store(false, std::memory_order_release);
+      mutex.unlock();
+    }
+
+    bool is_held() const { return held.load(std::memory_order_acquire); }
+
+  private:
+    sync_prim::mutex::Mutex mutex;
+    std::atomic<bool> held = false;
+  };
+
+  using node_mutex_t = std::conditional_t<Traits::LOCK_ELISION,
+                                          elidable_mutex_t,
+                                          sync_prim::mutex::Mutex>;
+
   struct node_t;
 
+  // Page usage of nodes, accounted by the nodes themselves as they are
+  // allocated, filled and freed (see `memory_usage`). Striped by node address,
+  // so that writers of different nodes rarely update the same counters.
+  struct alignas(64) page_usage_stripe_t {
+    std::atomic<std::ptrdiff_t> num_nodes[2]; // By NodeType
+    std::atomic<std::ptrdiff_t> live_bytes;
+    std::atomic<std::ptrdiff_t> free_bytes;
+  };
+
+  static constexpr int NUM_PAGE_USAGE_STRIPES = 64;
+
+  using page_usage_t =
+      std::array<page_usage_stripe_t, NUM_PAGE_USAGE_STRIPES>;
+
   struct NodeSplitInfo {
     node_t *left;
     node_t *right;
@@ -161,25 +390,36 @@ protected:
     std::atomic<int> logical_pagesize = 0;
     std::atomic<int> next_slot_offset = 0;
     std::atomic<int> max_slot_offset = 0;
-    int last_value_offset = Traits::NODE_SIZE;
+    int last_value_offset;
 
     std::atomic<int8_t> num_dead_values = 0;
+    // Leaf is in the maintenance queue (Traits::DEFERRED_MAINTENANCE).
+    // Guarded by mutex.
+    bool maintenance_queued = false;
     const NodeType node_type;
     const int height;
 
     const std::optional<key_type> lowkey;
     const std::optional<key_type> highkey;
 
-    sync_prim::mutex::Mutex mutex;
+    node_mutex_t mutex;
+
+    // Of the map, the node belongs to.
+    page_usage_t *const page_usage;
 
     inline node_t(NodeType ntype, int initialsize, int a_height,
                   const std::optional<key_type> &a_lowkey,
-                  const std::optional<key_type> &a_highkey)
-        : next_slot_offset(initialsize), node_type(ntype), height(a_height),
-          lowkey(a_lowkey), highkey(a_highkey) {}
+                  const std::optional<key_type> &a_highkey,
+                  page_usage_t *a_page_usage)
+        : next_slot_offset(initialsize), last_value_offset(node_size(ntype)),
+          node_type(ntype), height(a_height), lowkey(a_lowkey),
+          highkey(a_highkey), page_usage(a_page_usage) {}
 
     inline bool isLeaf() const { return node_type == NodeType::LEAF; }
 
+    // Size of the node's page
+    inline int pageSize() const { return node_size(node_type); }
+
     inline bool isInner() const { return node_type == NodeType::INNER; }
 
     inline nodestate_t getState() const { return detail::load_acquire(state); }
@@ -201,10 +441,9 @@ protected:
     // Called this `this` mutex held
     inline bool isUnderfull() const {
       BTREE_DEBUG_ASSERT(detail::load_relaxed(logical_pagesize) <=
-                         Traits::NODE_SIZE);
+                         pageSize());
 
-      return (detail::load_relaxed(logical_pagesize) * 100) /
-                 Traits::NODE_SIZE <
+      return (detail::load_relaxed(logical_pagesize) * 100) / pageSize() <
              Traits::NODE_MERGE_THRESHOLD;
     }
 
@@ -212,8 +451,8 @@ protected:
       return reinterpret_cast<char *>(reinterpret_cast<intptr_t>(this));
     }
 
-    inline std::atomic<int> *get_slots() const {
-      return reinterpret_cast<std::atomic<int> *>(opaque() + sizeof(node_t));
+    inline slot_t *get_slots() const {
+      return reinterpret_cast<slot_t *>(opaque() + sizeof(node_t));
     }
 
     inline bool canTrim() const {
@@ -224,11 +463,31 @@ protected:
       return detail::load_relaxed(num_values) > 2;
     }
 
+    // Bytes between the slots and the key/values
+    inline int freeBytes() const {
+      return last_value_offset - detail::load_relaxed(next_slot_offset);
+    }
+
+    // Adds changes of the page to the map's page usage.
+    // Called with this's mutex held, or on an unreachable node
+    inline void accountPage(int num_nodes, int live_bytes,
+                            int free_bytes) const {
+      auto &stripe = (*page_usage)[reinterpret_cast<uintptr_t>(this) /
+                                   pageSize() % NUM_PAGE_USAGE_STRIPES];
+
+      if (num_nodes) {
+        stripe.num_nodes[static_cast<int>(node_type)].fetch_add(
+            num_nodes, std::memory_order_relaxed);
+      }
+      stripe.live_bytes.fetch_add(live_bytes, std::memory_order_relaxed);
+      stripe.free_bytes.fetch_add(free_bytes, std::memory_order_relaxed);
+    }
+
     static inline void free(node_t *node) {
       if (node->isLeaf())
-        delete ASLEAF(node);
+        leaf_node_t::free(ASLEAF(node));
       else
-        delete ASINNER(node);
+        inner_node_t::free(ASINNER(node));
     }
 
     inline const key_type &get_first_key() const {
@@ -258,14 +517,17 @@ protected:
     template <typename KeyType> friend class SearchOps;
 
     static constexpr enum NodeType NODETYPE = NType;
+    static constexpr int NODE_SIZE = node_size(NType);
 
     static constexpr bool IsLeaf() { return NType == NodeType::LEAF; }
 
     static constexpr bool IsInner() { return NType == NodeType::INNER; }
 
     inline inherited_node_t(const std::optional<key_type> &lowkey,
-                            const std::optional<key_type> &highkey, int height)
-        : node_t(NType, sizeof(inherited_node_t), height, lowkey, highkey) {}
+                            const std::optional<key_type> &highkey, int height,
+                            page_usage_t *page_usage)
+        : node_t(NType, sizeof(inherited_node_t), height, lowkey, highkey,
+                 page_usage) {}
 
     inline ~inherited_node_t() {
       auto num_values = detail::load_relaxed(this->num_values);
@@ -274,21 +536,43 @@ protected:
       }
     }
 
-    static inherited_node_t *alloc(const std::optional<key_type> &lowkey,
+    static inherited_node_t *alloc(page_usage_t *page_usage,
+                                   const std::optional<key_type> &lowkey,
                                    const std::optional<key_type> &highkey,
                                    int height) {
-      return new (new char[Traits::NODE_SIZE])
-          inherited_node_t(lowkey, highkey, height);
+      auto node = new (page_allocator_t<NODE_SIZE>::allocate())
+          inherited_node_t(lowkey, highkey, height, page_usage);
+
+      node->accountPage(1, 0, node->freeBytes());
+      return node;
+    }
+
+    // Node of the same map as `this`
+    inherited_node_t *alloc(const std::optional<key_type> &lowkey,
+                            const std::optional<key_type> &highkey,
+                            int height) const {
+      return alloc(this->page_usage, lowkey, highkey, height);
     }
 
-    static void free(inherited_node_t *node) { delete node; }
+    static void free(inherited_node_t *node) {
+      node->accountPage(-1, -detail::load_relaxed(node->logical_pagesize),
+                        -node->freeBytes());
+      node->~inherited_node_t();
+      page_allocator_t<NODE_SIZE>::deallocate(node);
+    }
+
+    // Number of key/values a freshly allocated node can hold
+    static constexpr int max_num_values() {
+      return (NODE_SIZE - sizeof(inherited_node_t)) /
+             (sizeof(key_value_t) + sizeof(slot_t));
+    }
 
     // Must be called with both this's and other's mutex held
     inline bool haveEnoughSpace() const {
       auto next_slot_offset = detail::load_relaxed(this->next_slot_offset);
       auto max_slot_offset = detail::load_relaxed(this->max_slot_offset);
 
-      return ((next_slot_offset + sizeof(int)) <=
+      return ((next_slot_offset + sizeof(slot_t)) <=
               (this->last_value_offset - sizeof(key_value_t))) &&
              (max_slot_offset <=
               static_cast<int>(this->last_value_offset - sizeof(key_value_t)));
@@ -303,7 +587,7 @@ protected:
       return (logical_pagesize + other_logical_pagesize +
               (IsInner() ? sizeof(key_value_t) : 0)) +
                  sizeof(inherited_node_t) <=
-             Traits::NODE_SIZE;
+             NODE_SIZE;
     }
 
     inline key_value_t *get_key_value_for_offset(int offset) const {
@@ -312,7 +596,7 @@ protected:
 
     inline key_value_t *get_key_value(int slot) const {
       auto slots = this->get_slots();
-      return get_key_value_for_offset(detail::load_acquire(slots[slot]));
+      return get_key_value_for_offset(load_slot(slots[slot]).offset);
     }
 
     inline const key_type &get_key(int slot) const {
@@ -365,9 +649,9 @@ protected:
     // Must be called with this's mutex held
     inline void update_meta_after_insert() {
       int next_slot_offset =
-          detail::load_relaxed(this->next_slot_offset) + sizeof(int);
+          detail::load_relaxed(this->next_slot_offset) + sizeof(slot_t);
       int logical_pagesize = detail::load_relaxed(this->logical_pagesize) +
-                             sizeof(key_value_t) + sizeof(int);
+                             sizeof(key_value_t) + sizeof(slot_t);
       int max_slot_offset = std::max(
           detail::load_relaxed(this->max_slot_offset), next_slot_offset);
 
@@ -375,32 +659,44 @@ protected:
       detail::store_relaxed(this->next_slot_offset, next_slot_offset);
       detail::store_relaxed(this->logical_pagesize, logical_pagesize);
       detail::store_relaxed(this->max_slot_offset, max_slot_offset);
+      this->accountPage(0, sizeof(key_value_t) + sizeof(slot_t),
+                        -static_cast<int>(sizeof(key_value_t) +
+                                          sizeof(slot_t)));
 
       BTREE_DEBUG_ASSERT(next_slot_offset <= this->last_value_offset);
     }
 
     // Must be called with this's mutex held
-    static void copy_backward(std::atomic<int> *slots, int start_pos,
-                              int end_pos, int out_end_pos) {
+    static void copy_backward(slot_t *slots, int start_pos, int end_pos,
+                              int out_end_pos) {
       BTREE_DEBUG_ASSERT(out_end_pos >= end_pos);
 
       while (start_pos < end_pos) {
-        detail::store_release(slots[--out_end_pos],
-                              detail::load_relaxed(slots[--end_pos]));
+        store_slot(slots[--out_end_pos], load_slot(slots[--end_pos]));
       }
     }
 
     // Must be called with this's mutex held
-    static void copy(std::atomic<int> *slots, int start_pos, int end_pos,
-                     int out_pos) {
+    static void copy(slot_t *slots, int start_pos, int end_pos, int out_pos) {
       BTREE_DEBUG_ASSERT(out_pos < start_pos);
 
       while (start_pos < end_pos) {
-        detail::store_release(slots[out_pos++],
-                              detail::load_relaxed(slots[start_pos++]));
+        store_slot(slots[out_pos++], load_slot(slots[start_pos++]));
       }
     }
 
+    // Slot for the key/value at `value_offset`
+    inline slot_value_t new_slot(int value_offset) const {
+      const auto &key = get_key_value_for_offset(value_offset)->first;
+
+      if constexpr (INLINE_KEY)
+        return {key, value_offset};
+      else if constexpr (KEY_PREFIX)
+        return {get_key_prefix(key), value_offset};
+      else
+        return (void)key, slot_value_t{0, value_offset};
+    }
+
     // Must not be called on a reachable node
     INNER_ONLY
     inline void insert_neg_infinity(const value_t &val) {
@@ -411,7 +707,7 @@ protected:
       int current_value_offset = this->last_value_offset - sizeof(value_t);
 
       new (this->opaque() + current_value_offset) value_t{val};
-      detail::store_relaxed(slots[0], current_value_offset);
+      store_slot(slots[0], {{}, current_value_offset});
 
       detail::store_relaxed(this->num_values, num_values + 1);
       update_meta_after_insert();
@@ -425,7 +721,7 @@ protected:
       auto pos = num_values;
 
       new (this->opaque() + current_value_offset) key_value_t{key, val};
-      detail::store_relaxed(slots[pos], current_value_offset);
+      store_slot(slots[pos], new_slot(current_value_offset));
 
       detail::store_relaxed(this->num_values, num_values + 1);
       update_meta_after_insert();
@@ -437,7 +733,7 @@ protected:
       auto slots = this->get_slots();
 
       copy_backward(slots, pos, num_values, num_values + 1);
-      detail::store_release(slots[pos], value_offset);
+      store_slot(slots[pos], new_slot(value_offset));
       detail::store_release(this->num_values, num_values + 1);
     }
 
@@ -488,11 +784,19 @@ protected:
     }
 
     // Must be called with this's mutex held
-    NodeSplitInfo split() const {
+    // Appends (key being inserted is beyond this's keys) split off only
+    // (100 - APPEND_SPLIT_PERCENT)% of the values, as increasing keys will
+    // never be inserted into the left node again.
+    NodeSplitInfo split(bool is_append = false) const {
       BTREE_DEBUG_ASSERT(this->canSplit());
 
       auto num_values = detail::load_relaxed(this->num_values);
       int split_pos = IsInner() ? num_values / 2 : (num_values + 1) / 2;
+
+      if (is_append) {
+        split_pos = std::clamp(num_values * Traits::APPEND_SPLIT_PERCENT / 100,
+                               1, num_values - 1);
+      }
       const key_type &split_key = get_key(split_pos);
       inherited_node_t *left = alloc(this->lowkey, split_key, this->height);
       inherited_node_t *right = alloc(split_key, this->highkey, this->height);
@@ -554,11 +858,10 @@ protected:
     }
     LEAF_ONLY
     static inline void get_all_slots(std::vector<int> &slot_offsets,
-                                     const std::atomic<int> *slots,
-                                     int num_values) {
+                                     const slot_t *slots, int num_values) {
       slot_offsets.clear();
       for (int i = 0; i < num_values; i++) {
-        slot_offsets.emplace_back(detail::load_acquire(slots[i]));
+        slot_offsets.emplace_back(load_slot(slots[i]).offset);
       }
     }
 
@@ -580,21 +883,21 @@ protected:
   using leaf_node_t = inherited_node_t<mapped_type, NodeType::LEAF>;
   using inner_node_t = inherited_node_t<node_t *, NodeType::INNER>;
 
-  static_assert((Traits::NODE_SIZE - sizeof(leaf_node_t)) /
+  static_assert((LEAF_NODE_SIZE - sizeof(leaf_node_t)) /
                         (sizeof(typename leaf_node_t::key_value_t) +
-                         sizeof(int)) >=
+                         sizeof(slot_t)) >=
                     4,
                 "Btree leaf node must have atleast 4 slots");
-  static_assert((Traits::NODE_SIZE - sizeof(inner_node_t)) /
+  static_assert((INNER_NODE_SIZE - sizeof(inner_node_t)) /
                         (sizeof(typename inner_node_t::key_value_t) +
-                         sizeof(int)) >=
+                         sizeof(slot_t)) >=
                     4,
                 "Btree inner node must have atleast 4 slots");
-  static_assert(Traits::NODE_SIZE %
+  static_assert(LEAF_NODE_SIZE %
                         alignof(typename leaf_node_t::key_value_t) ==
                     0,
                 "Alignment mismatch b/w pagesize and Key, Value");
-  static_assert(Traits::NODE_SIZE %
+  static_assert(INNER_NODE_SIZE %
                         alignof(typename inner_node_t::key_value_t) ==
                     0,
                 "Alignment mismatch b/w pagesize and Key, Value");
@@ -628,20 +931,47 @@ protected:
   static constexpr bool FILL_SNAPSHOT_VECTOR = true;
   static constexpr bool NO_FILL_SNAPSHOT_VECTOR = false;
   static constexpr int OPTIMISTIC_TRY_COUNT = 3;
+  static constexpr int MULTI_SEARCH_GROUP_SIZE = 16;
 
   enum class OpResult { SUCCESS, FAILURE, STALE_SNAPSHOT };
 
+  // Locks `mutex`, timing the wait of every STAT_SAMPLE_PERIOD'th pessimistic
+  // read of a thread.
+  inline void lock_sampled(node_mutex_t &mutex) const {
+    if constexpr (Traits::STAT && Traits::STAT_SAMPLE_PERIOD > 0) {
+      auto &stats = this->m_stats->local();
+
+      if (stats.num_pessimistic_reads % Traits::STAT_SAMPLE_PERIOD == 0) {
+        auto start = std::chrono::steady_clock::now();
+
+        mutex.lock();
+
+        std::size_t nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+
+        stats.num_lock_wait_samples++;
+        stats.lock_wait_nanos += nanos;
+        stats.max_lock_wait_nanos.max(nanos);
+        return;
+      }
+    }
+
+    mutex.lock();
+  }
+
   inline void try_lock_pessimistic(node_t *node, nodestate_t &state) const {
     BTREE_UPDATE_STAT(pessimistic_read, ++);
 
     if (node) {
-      node->mutex.lock();
+      lock_sampled(node->mutex);
       state = node->getState();
 
       if (state.is_deleted())
         node->mutex.unlock();
     } else {
-      this->m_root_mutex->lock();
+      lock_sampled(*this->m_root_mutex);
       state = detail::load_acquire(this->m_root_state);
 
       if (state.is_deleted())
@@ -780,6 +1110,14 @@ protected:
       BTREE_DEBUG_ONLY(res);
     }
 
+    if constexpr (Traits::STAT) {
+      // Falling back to the pessimistic traversal is a restart too.
+      int restarts = restart_count - (opt_trav_res == OpResult::SUCCESS);
+
+      this->m_stats->local()
+          .num_traversals[std::min(restarts, NUM_RESTART_BUCKETS - 1)]++;
+    }
+
     return opt_trav_res != OpResult::SUCCESS;
   }
 
@@ -800,7 +1138,8 @@ protected:
   // Root mutex must be held
   inline void create_root(NodeSplitInfo splitinfo) {
     auto new_root =
-        inner_node_t::alloc(splitinfo.left->lowkey, splitinfo.right->highkey,
+        inner_node_t::alloc(this->m_page_usage.get(), splitinfo.left->lowkey,
+                            splitinfo.right->highkey,
                             detail::load_relaxed(this->m_height) + 1);
     new_root->insert_neg_infinity(splitinfo.left);
     new_root->append(*splitinfo.split_key, splitinfo.right);
@@ -820,11 +1159,12 @@ protected:
 
   inline void ensure_root() {
     while (detail::load_acquire(this->m_root) == nullptr) {
-      auto new_root = leaf_node_t::alloc(std::nullopt, std::nullopt,
+      auto new_root = leaf_node_t::alloc(this->m_page_usage.get(),
+                                         std::nullopt, std::nullopt,
                                          detail::load_acquire(this->m_height));
 
       if (!update_root({}, new_root))
-        delete new_root;
+        leaf_node_t::free(new_root);
     }
   }
 
@@ -836,15 +1176,51 @@ protected:
 
   static inline DummyType dummy_snap_vec() noexcept { return {}; }
 
-  std::unique_ptr<sync_prim::mutex::Mutex> m_root_mutex =
-      std::make_unique<sync_prim::mutex::Mutex>();
+  // Must be called with leaf's mutex held
+  inline void remember_rightmost_leaf(leaf_node_t *leaf) {
+    BTREE_DEBUG_ASSERT(!leaf->highkey && !leaf->getState().is_deleted());
+
+    if (detail::load_relaxed(m_rightmost_leaf) != leaf)
+      detail::store_release(m_rightmost_leaf, leaf);
+  }
+
+  // Must be called with node's mutex held and before node is retired, so
+  // that m_rightmost_leaf always points to a live node.
+  inline void mark_deleted(node_t *node) {
+    node->setState(node->getState().set_deleted().increment_version());
+
+    if (node->isLeaf()) {
+      leaf_node_t *leaf = ASLEAF(node);
+      m_rightmost_leaf.compare_exchange_strong(leaf, nullptr);
+    }
+  }
+
+  std::unique_ptr<node_mutex_t> m_root_mutex =
+      std::make_unique<node_mutex_t>();
   std::atomic<nodestate_t> m_root_state = {};
   std::atomic<node_t *> m_root = nullptr;
 
   std::atomic<int> m_height = 0;
+  // Last leaf inserted into, if it is the rightmost one. Speeds up inserts of
+  // increasing keys.
+  std::atomic<leaf_node_t *> m_rightmost_leaf = nullptr;
   std::unique_ptr<Stats> m_stats = std::make_unique<Stats>();
+  // Outlives m_gc, whose reclaimed nodes account their pages in it.
+  std::unique_ptr<page_usage_t> m_page_usage =
+      std::make_unique<page_usage_t>();
+
+  // Keys of leaves waiting for a merge or trim (Traits::DEFERRED_MAINTENANCE).
+  struct maintenance_queue_t {
+    sync_prim::mutex::Mutex mutex;
+    std::vector<key_type> keys;
+  };
 
-  mutable indexes::utils::EpochManager<uint64_t, node_t> m_gc;
+  std::unique_ptr<maintenance_queue_t> m_maintenance =
+      Traits::DEFERRED_MAINTENANCE ? std::make_unique<maintenance_queue_t>()
+                                   : nullptr;
+
+  mutable indexes::utils::EpochManager<uint64_t, node_t> m_gc{
+      [](node_t *node) { return static_cast<std::size_t>(node->pageSize()); }};
 };
 
 template <typename Key, typename Value, typename Traits, typename Stats>
@@ -864,6 +1240,8 @@ protected:
   using NodeSnapshotVector = typename base::NodeSnapshotVector;
   using NodeSnapshot = typename base::NodeSnapshot;
   using OpResult = typename base::OpResult;
+  using slot_t = typename base::slot_t;
+  using node_mutex_t = typename base::node_mutex_t;
 
   struct EpochGuard {
     const concurrent_map_access *map = nullptr;
@@ -966,13 +1344,41 @@ protected:
       return !(k1 < k2);
     }
 
+    static constexpr bool HAS_KEY_PREFIX =
+        base::template has_key_prefix<KeyType>;
+
+    // Inlined keys can be searched with SIMD only for the same key type
+    static constexpr bool SIMD_SEARCH =
+        base::INLINE_KEY && std::is_same_v<std::decay_t<KeyType>, key_type>;
+
+    static inline uint64_t get_key_prefix(const KeyType &key) noexcept {
+      if constexpr (HAS_KEY_PREFIX)
+        return base::get_key_prefix(key);
+      else
+        return (void)key, 0;
+    }
+
+    // Comparing slots use the key (or it's prefix) stored in it (if any),
+    // comparing offsets (int) always use full keys.
     template <typename NodeType> class lower_bound_cmp {
     public:
-      lower_bound_cmp(const search_ops_t *ops, const NodeType *node)
-          : ops(ops), node(node) {}
-      inline bool operator()(const std::atomic<int> &slot,
-                             const KeyType &key) const noexcept {
-        return (*this)(detail::load_acquire(slot), key);
+      lower_bound_cmp(const search_ops_t *ops, const NodeType *node,
+                      uint64_t prefix = 0)
+          : ops(ops), node(node), prefix(prefix) {}
+      inline bool operator()(const slot_t &slot, const KeyType &key) const
+          noexcept {
+        auto value = base::load_slot(slot);
+
+        if constexpr (base::INLINE_KEY) {
+          return ops->less(value.prefix, key);
+        } else {
+          if constexpr (HAS_KEY_PREFIX) {
+            if (value.prefix != prefix)
+              return value.prefix < prefix;
+          }
+
+          return (*this)(value.offset, key);
+        }
       }
       inline bool operator()(int slot, const KeyType &key) const noexcept {
         return ops->less(node->get_key_value_for_offset(slot)->first, key);
@@ -981,15 +1387,28 @@ protected:
     private:
       const search_ops_t *ops;
       const NodeType *node;
+      uint64_t prefix;
     };
 
     template <typename NodeType> class upper_bound_cmp {
     public:
-      upper_bound_cmp(const search_ops_t *ops, const NodeType *node)
-          : ops(ops), node(node) {}
-      inline bool operator()(const KeyType &key,
-                             const std::atomic<int> &slot) const noexcept {
-        return (*this)(key, detail::load_acquire(slot));
+      upper_bound_cmp(const search_ops_t *ops, const NodeType *node,
+                      uint64_t prefix = 0)
+          : ops(ops), node(node), prefix(prefix) {}
+      inline bool operator()(const KeyType &key, const slot_t &slot) const
+          noexcept {
+        auto value = base::load_slot(slot);
+
+        if constexpr (base::INLINE_KEY) {
+          return ops->less(key, value.prefix);
+        } else {
+          if constexpr (HAS_KEY_PREFIX) {
+            if (value.prefix != prefix)
+              return prefix < value.prefix;
+          }
+
+          return (*this)(key, value.offset);
+        }
       }
       inline bool operator()(const KeyType &key, int slot) const noexcept {
         return ops->less(key, node->get_key_value_for_offset(slot)->first);
@@ -998,6 +1417,7 @@ protected:
     private:
       const search_ops_t *ops;
       const NodeType *node;
+      uint64_t prefix;
     };
 
     template <typename NodeType>
@@ -1006,8 +1426,13 @@ protected:
       int firstslot = node->IsLeaf() ? 0 : 1;
       auto slots = node->get_slots();
 
-      return std::lower_bound(slots + firstslot, slots + num_values, key,
-                              lower_bound_cmp<NodeType>{this, node}) -
+      if constexpr (SIMD_SEARCH)
+        return firstslot + base::template count_inline_keys<false>(
+                               slots + firstslot, num_values - firstslot, key);
+
+      return std::lower_bound(
+                 slots + firstslot, slots + num_values, key,
+                 lower_bound_cmp<NodeType>{this, node, get_key_prefix(key)}) -
              slots;
     }
 
@@ -1016,9 +1441,16 @@ protected:
                         int num_values) const noexcept {
       int firstslot = node->IsLeaf() ? 0 : 1;
       auto slots = node->get_slots();
-      int pos = std::upper_bound(slots + firstslot, slots + num_values, key,
-                                 upper_bound_cmp<NodeType>{this, node}) -
-                slots;
+      int pos;
+
+      if constexpr (SIMD_SEARCH)
+        pos = firstslot + base::template count_inline_keys<true>(
+                              slots + firstslot, num_values - firstslot, key);
+      else
+        pos = std::upper_bound(
+                  slots + firstslot, slots + num_values, key,
+                  upper_bound_cmp<NodeType>{this, node, get_key_prefix(key)}) -
+              slots;
 
       return node->IsInner() ? std::min(pos - 1, num_values - 1) : pos;
     }
@@ -1028,8 +1460,14 @@ protected:
                                            const KeyType &key) const noexcept {
       auto num_values = detail::load_acquire(node->num_values);
       auto pos = lower_bound_pos(node, key, num_values);
-      auto present =
-          pos < num_values && equal(node->get_key_value(pos)->first, key);
+      bool present;
+
+      if constexpr (base::INLINE_KEY)
+        present = pos < num_values &&
+                  equal(base::load_slot(node->get_slots()[pos]).prefix, key);
+      else
+        present =
+            pos < num_values && equal(node->get_key_value(pos)->first, key);
 
       return {pos, present, num_values};
     }
@@ -1268,6 +1706,10 @@ protected:
     Stats *m_stats = {};
   };
 
+  // Updates a value in place with `fn(mapped_type &)`, under leaf's mutex.
+  // A missing value is default constructed, before `fn` is applied to it.
+  template <typename Fn> struct value_updater_t { Fn &fn; };
+
   struct update_ops_t : search_ops_t<key_type> {
   public:
     using search_ops_t<key_type>::search_ops_t;
@@ -1312,6 +1754,38 @@ protected:
       return {leaf->insert_into_pos(key, val, pos), oldval};
     }
 
+    // Must be called with leaf's mutex held
+    template <typename Fn>
+    std::pair<InsertStatus, std::optional<mapped_type>>
+    upsert(leaf_node_t *leaf, const key_type &key,
+           const value_updater_t<Fn> &updater) const noexcept {
+      auto key_present = false;
+      int pos = 0;
+      std::optional<mapped_type> oldval = std::nullopt;
+
+      if (detail::load_relaxed(leaf->num_values)) {
+        std::tie(pos, key_present, std::ignore) = this->lower_bound(leaf, key);
+
+        if (key_present) {
+          auto oldval_ptr = &leaf->get_key_value(pos)->second;
+
+          oldval = *oldval_ptr;
+          leaf->atomic_node_update([&]() { updater.fn(*oldval_ptr); });
+
+          return {InsertStatus::DUPLICATE, oldval};
+        }
+      }
+
+      // Value is built only if it could be inserted, so `fn` runs once.
+      if (!leaf->haveEnoughSpace())
+        return {InsertStatus::OVFLOW, oldval};
+
+      mapped_type val{};
+
+      updater.fn(val);
+      return {leaf->insert_into_pos(key, val, pos), oldval};
+    }
+
     // Must be called with node's mutex held
     template <typename Node>
     void remove_pos(Node *node, int pos) const noexcept {
@@ -1325,13 +1799,19 @@ protected:
       });
 
       int next_slot_offset =
-          detail::load_relaxed(node->next_slot_offset) - sizeof(int);
-      int logical_pagesize = detail::load_relaxed(node->logical_pagesize) -
-                             (sizeof(typename Node::key_value_t) + sizeof(int));
+          detail::load_relaxed(node->next_slot_offset) - sizeof(slot_t);
+      int logical_pagesize =
+          detail::load_relaxed(node->logical_pagesize) -
+          (sizeof(typename Node::key_value_t) + sizeof(slot_t));
 
       node->incrementNumDeadValues();
       detail::store_relaxed(node->next_slot_offset, next_slot_offset);
       detail::store_relaxed(node->logical_pagesize, logical_pagesize);
+      node->accountPage(
+          0,
+          -static_cast<int>(sizeof(typename Node::key_value_t) +
+                            sizeof(slot_t)),
+          sizeof(slot_t));
     }
 
     // Must be called with node's mutex held
@@ -1353,6 +1833,24 @@ protected:
       return old_value;
     }
 
+    // Must be called with node's mutex held
+    template <typename Fn>
+    inline std::optional<mapped_type>
+    update_leaf(leaf_node_t *leaf, const key_type &key,
+                const value_updater_t<Fn> &updater) const noexcept {
+      auto [pos, found, _] = this->lower_bound(leaf, key);
+
+      if (!found)
+        return {};
+
+      auto oldval_ptr = &leaf->get_key_value(pos)->second;
+      std::optional<mapped_type> old_value = *oldval_ptr;
+
+      leaf->atomic_node_update([&]() { updater.fn(*oldval_ptr); });
+
+      return old_value;
+    }
+
     // Must be called with node's mutex held
     inline void update_inner_for_trim(inner_node_t *inner, const key_type &key,
                                       node_t *child) const noexcept {
@@ -1416,11 +1914,16 @@ protected:
       inner->incrementNumDeadValues();
       detail::store_relaxed<int>(inner->next_slot_offset,
                                  detail::load_relaxed(inner->next_slot_offset) -
-                                     sizeof(int));
+                                     sizeof(slot_t));
       detail::store_relaxed<int>(
           inner->logical_pagesize,
           detail::load_relaxed(inner->logical_pagesize) -
-              (sizeof(typename inner_node_t::key_value_t) + sizeof(int)));
+              (sizeof(typename inner_node_t::key_value_t) + sizeof(slot_t)));
+      inner->accountPage(
+          0,
+          -static_cast<int>(sizeof(typename inner_node_t::key_value_t) +
+                            sizeof(slot_t)),
+          sizeof(slot_t));
     }
   };
 
@@ -1443,7 +1946,7 @@ protected:
     boost::container::small_vector<node_t *, base::SMALL_HEIGHT> deleted_nodes;
 
     auto res = [&]() {
-      std::vector<std::unique_lock<sync_prim::mutex::Mutex>> locks;
+      std::vector<std::unique_lock<node_mutex_t>> locks;
       for (int node_idx = from_node;
            node_idx < static_cast<int>(snapshots.size()); node_idx++) {
         const NodeSnapshot &snapshot = snapshots[node_idx];
@@ -1459,8 +1962,7 @@ protected:
              node_idx < static_cast<int>(snapshots.size()); node_idx++) {
           const NodeSnapshot &snapshot = snapshots[node_idx];
 
-          snapshot.node->setState(
-              snapshot.node->getState().set_deleted().increment_version());
+          this->mark_deleted(snapshot.node);
 
           deleted_nodes.push_back(snapshot.node);
         }
@@ -1479,7 +1981,7 @@ protected:
 
   template <typename Node>
   std::pair<OpResult, NodeSplitInfo>
-  split_node(update_ops_t ops, int node_idx,
+  split_node(update_ops_t ops, int node_idx, const key_type &key,
              const NodeSnapshotVector &snapshots,
              NodeSplitInfo &prev_split_info) {
     const NodeSnapshot &node_snapshot = snapshots[node_idx];
@@ -1499,7 +2001,8 @@ protected:
       if (this->is_snapshot_stale(node_snapshot))
         return {OpResult::STALE_SNAPSHOT, {}};
 
-      splitinfo = node->split();
+      auto num_values = detail::load_relaxed(node->num_values);
+      splitinfo = node->split(ops.less(node->get_key(num_values - 1), key));
     }
 
     BTREE_UPDATE_STAT_NODE_BASED(split);
@@ -1586,10 +2089,10 @@ protected:
       }
     } else {
       if (node->isLeaf()) {
-        return split_node<leaf_node_t>(ops, node_idx, snapshots,
+        return split_node<leaf_node_t>(ops, node_idx, key, snapshots,
                                        prev_split_info);
       } else {
-        return split_node<inner_node_t>(ops, node_idx, snapshots,
+        return split_node<inner_node_t>(ops, node_idx, key, snapshots,
                                         prev_split_info);
       }
     }
@@ -1641,12 +2144,50 @@ protected:
     BTREE_DEBUG_ASSERT(false && "Shallnot come here");
   }
 
-  template <bool DoUpsert, typename OutputType = std::conditional_t<
-                               DoUpsert, std::optional<mapped_type>, bool>>
+  // Runs `update` of `leaf` under it's mutex. With Traits::LOCK_ELISION,
+  // `update` runs in a hardware transaction instead, which only reads the
+  // mutex, so that updaters do not hand over it's cache line (they still
+  // conflict on the leaf's version and the data they change). The leaf is
+  // locked, once the transaction aborted LOCK_ELISION_RETRIES times (or could
+  // not be retried). `update` must neither block, nor allocate or free nodes.
+  template <typename Update>
+  inline void update_leaf_locked(leaf_node_t *leaf, const Update &update) {
+    if constexpr (Traits::LOCK_ELISION) {
+      if (utils::htm_supported()) {
+        bool may_retry = true;
+
+        for (int tries = 0; may_retry && tries < Traits::LOCK_ELISION_RETRIES;
+             tries++) {
+          if (utils::htm_begin(may_retry)) {
+            if (leaf->mutex.is_held())
+              utils::htm_abort();
+
+            update();
+            utils::htm_commit();
+            BTREE_UPDATE_STAT(elided_lock, ++);
+            return;
+          }
+
+          BTREE_UPDATE_STAT(elision_abort, ++);
+
+          while (leaf->mutex.is_held())
+            utils::cpu_relax();
+        }
+      }
+    }
+
+    std::lock_guard lock{leaf->mutex};
+
+    update();
+  }
+
+  template <bool DoUpsert, typename ValueType,
+            typename OutputType = std::conditional_t<
+                DoUpsert, std::optional<mapped_type>, bool>>
   inline std::pair<OpResult, OutputType>
   insert_or_upsert_leaf(update_ops_t ops, const NodeSnapshotVector &snapshots,
                         bool is_leaf_locked, const key_type &key,
-                        const mapped_type &val) {
+                        const ValueType &val) {
     InsertStatus status;
     std::optional<mapped_type> oldval{};
     NodeSnapshot leaf_snapshot = snapshots.back();
@@ -1663,17 +2204,28 @@ protected:
       else
         status = ops.insert(leaf, key, val);
 
+      if (status != InsertStatus::OVFLOW && !leaf->highkey)
+        this->remember_rightmost_leaf(leaf);
+
       leaf->mutex.unlock();
     } else {
-      std::lock_guard lock{leaf->mutex};
+      bool is_stale = false;
 
-      if (this->is_snapshot_stale(leaf_snapshot))
-        return {OpResult::STALE_SNAPSHOT, {}};
+      update_leaf_locked(leaf, [&]() {
+        if ((is_stale = this->is_snapshot_stale(leaf_snapshot)))
+          return;
 
-      if constexpr (DoUpsert)
-        std::tie(status, oldval) = ops.upsert(leaf, key, val);
-      else
-        status = ops.insert(leaf, key, val);
+        if constexpr (DoUpsert)
+          std::tie(status, oldval) = ops.upsert(leaf, key, val);
+        else
+          status = ops.insert(leaf, key, val);
+
+        if (status != InsertStatus::OVFLOW && !leaf->highkey)
+          this->remember_rightmost_leaf(leaf);
+      });
+
+      if (is_stale)
+        return {OpResult::STALE_SNAPSHOT, {}};
     }
 
     if (status == InsertStatus::OVFLOW) {
@@ -1690,24 +2242,79 @@ protected:
       return {OpResult::SUCCESS, status != InsertStatus::DUPLICATE};
   }
 
+  template <typename ValueType>
   inline std::pair<OpResult, std::optional<mapped_type>>
   update_leaf(update_ops_t ops, const NodeSnapshot &leaf_snapshot,
-              const key_type &key, const mapped_type &val) {
+              const key_type &key, const ValueType &val) {
     leaf_node_t *leaf = ASLEAF(leaf_snapshot.node);
-    std::lock_guard lock{leaf->mutex};
+    std::pair<OpResult, std::optional<mapped_type>> res;
 
-    if (this->is_snapshot_stale(leaf_snapshot))
-      return {OpResult::STALE_SNAPSHOT, std::nullopt};
+    update_leaf_locked(leaf, [&]() {
+      if (this->is_snapshot_stale(leaf_snapshot))
+        res = {OpResult::STALE_SNAPSHOT, std::nullopt};
+      else
+        res = {OpResult::SUCCESS, ops.update_leaf(leaf, key, val)};
+    });
 
-    return {OpResult::SUCCESS, ops.update_leaf(leaf, key, val)};
+    return res;
   }
 
-  template <bool DoUpsert>
+  // Inserts into the rightmost leaf (if remembered) without a traversal, if
+  // `key` belongs to it and fits in it.
+  template <bool DoUpsert, typename ValueType,
+            typename OutputType = std::conditional_t<
+                DoUpsert, std::optional<mapped_type>, bool>>
+  inline std::optional<OutputType>
+  insert_or_upsert_rightmost(update_ops_t ops, const key_type &key,
+                             const ValueType &val) {
+    leaf_node_t *leaf = detail::load_acquire(this->m_rightmost_leaf);
+
+    // Leaf's lowkey is immutable, so it can be checked before locking.
+    if (leaf == nullptr || (leaf->lowkey && ops.less(key, *leaf->lowkey)))
+      return std::nullopt;
+
+    // Stays OVFLOW, if the leaf was deleted.
+    InsertStatus status = InsertStatus::OVFLOW;
+    std::optional<mapped_type> oldval{};
+
+    update_leaf_locked(leaf, [&]() {
+      // Live rightmost leaf owns all the keys >= it's lowkey.
+      if (leaf->getState().is_deleted())
+        return;
+
+      if constexpr (DoUpsert)
+        std::tie(status, oldval) = ops.upsert(leaf, key, val);
+      else
+        status = ops.insert(leaf, key, val);
+    });
+
+    if (status == InsertStatus::OVFLOW)
+      return std::nullopt;
+
+    if (status == InsertStatus::INSERTED)
+      BTREE_UPDATE_STAT(element, ++);
+
+    if constexpr (DoUpsert)
+      return oldval;
+    else
+      return status != InsertStatus::DUPLICATE;
+  }
+
+  // `val` is either the value or a value_updater_t.
+  template <bool DoUpsert, typename ValueType>
   auto insert_or_upsert(update_ops_t ops, const key_type &key,
-                        const mapped_type &val) {
+                        const ValueType &val) {
     NodeSnapshotVector snapshots;
 
     this->ensure_root();
+
+    {
+      EpochGuard eg(this);
+
+      if (auto res = insert_or_upsert_rightmost<DoUpsert>(ops, key, val))
+        return *res;
+    }
+
     while (true) {
       EpochGuard eg(this);
       bool is_leaf_locked = ops.get_leaf_containing(this, key, snapshots);
@@ -1779,9 +2386,8 @@ protected:
 
         ops.update_inner_for_merge(parent, sibilingpos, mergednode);
 
-        sibiling->setState(
-            sibiling->getState().set_deleted().increment_version());
-        node->setState(node->getState().set_deleted().increment_version());
+        this->mark_deleted(sibiling);
+        this->mark_deleted(node);
       }
 
       par_und_full = parent->isUnderfull();
@@ -1804,6 +2410,8 @@ protected:
     leaf_node_t *leaf = ASLEAF(leaf_snapshot.node);
     std::pair<OpResult, std::optional<mapped_type>> ret{};
 
+    bool needs_maintenance = false;
+
     {
       bool is_deleted = false;
 
@@ -1825,6 +2433,13 @@ protected:
         ops.remove_pos(leaf, pos);
         is_deleted = true;
 
+        if constexpr (Traits::DEFERRED_MAINTENANCE) {
+          // Queue the leaf only once, until it is maintained.
+          needs_maintenance =
+              !leaf->maintenance_queued && leaf_needs_maintenance(leaf);
+          leaf->maintenance_queued |= needs_maintenance;
+        }
+
         leaf_snapshot = {leaf, leaf->getState()};
       };
 
@@ -1832,61 +2447,142 @@ protected:
         do_delete();
         leaf->mutex.unlock();
       } else {
-        std::lock_guard lock{leaf->mutex};
-
-        do_delete();
+        update_leaf_locked(leaf, do_delete);
       }
 
       if (is_deleted)
         BTREE_UPDATE_STAT(element, --);
     }
 
-    if (leaf->isUnderfull())
+    if constexpr (Traits::DEFERRED_MAINTENANCE) {
+      if (needs_maintenance) {
+        std::lock_guard lock{this->m_maintenance->mutex};
+
+        this->m_maintenance->keys.push_back(key);
+      }
+    } else if (leaf->isUnderfull()) {
       merge_node<leaf_node_t>(ops, snapshots.size() - 1, snapshots, key);
+    }
 
     return ret;
   }
 
-  inline NodeSnapshot get_last_leaf() const {
-    NodeSnapshot leaf_snapshot{};
+  static inline bool leaf_needs_maintenance(const leaf_node_t *leaf) {
+    return leaf->isUnderfull() || leaf->canTrim();
+  }
 
-    bool is_leaf_locked =
-        this->template traverse_to_leaf<base::NO_FILL_SNAPSHOT_VECTOR>(
-            [](node_t *current) { return ASINNER(current)->get_last_child(); },
-            this->dummy_snap_vec(), leaf_snapshot);
+  // Merges or trims the leaf containing `key`, if it still needs it.
+  void maintain_leaf(update_ops_t ops, const key_type &key) {
+    NodeSnapshotVector snapshots;
 
-    if (is_leaf_locked) {
-      BTREE_DEBUG_ASSERT(leaf_snapshot.node != nullptr);
-      leaf_snapshot.node->mutex.unlock();
-    }
+    while (true) {
+      EpochGuard eg(this);
+      bool is_leaf_locked = ops.get_leaf_containing(this, key, snapshots);
 
-    if (leaf_snapshot.node)
-      BTREE_DEBUG_ASSERT(leaf_snapshot.node->isLeaf());
+      if (snapshots.size() <= 1)
+        return;
 
-    return leaf_snapshot;
-  }
+      leaf_node_t *leaf = ASLEAF(snapshots.back().node);
 
-  inline NodeSnapshot get_first_leaf() const {
-    NodeSnapshot leaf_snapshot{};
+      // Let later deletes queue the leaf again, if it is left as is.
+      if (is_leaf_locked) {
+        leaf->maintenance_queued = false;
+        leaf->mutex.unlock();
+      } else {
+        std::lock_guard lock{leaf->mutex};
 
-    bool is_leaf_locked =
-        this->template traverse_to_leaf<base::NO_FILL_SNAPSHOT_VECTOR>(
-            [](node_t *current) { return ASINNER(current)->get_first_child(); },
-            this->dummy_snap_vec(), leaf_snapshot);
+        leaf->maintenance_queued = false;
+      }
 
-    if (is_leaf_locked) {
-      BTREE_DEBUG_ASSERT(leaf_snapshot.node != nullptr);
-      leaf_snapshot.node->mutex.unlock();
-    }
+      // Root leaf is neither merged nor trimmed, like with inline maintenance.
+      if (snapshots.size() == 2)
+        return;
 
-    if (leaf_snapshot.node)
-      BTREE_DEBUG_ASSERT(leaf_snapshot.node->isLeaf());
+      int leaf_idx = snapshots.size() - 1;
 
-    return leaf_snapshot;
-  }
+      if (leaf->isUnderfull()) {
+        // Best effort, leaf is left as is if it cannot be merged.
+        merge_node<leaf_node_t>(ops, leaf_idx, snapshots, key);
+        return;
+      }
+
+      if (!leaf->canTrim())
+        return;
+
+      NodeSplitInfo splitinfo{};
+
+      if (trim_node<leaf_node_t>(ops, leaf_idx, key, snapshots, splitinfo)
+              .first != OpResult::STALE_SNAPSHOT) {
+        return;
+      }
+
+      BTREE_UPDATE_STAT(retry, ++);
+    }
+  }
+
+  // Processes upto `budget` queued leaves and returns # leaves processed.
+  std::size_t maintain(update_ops_t ops, std::size_t budget) {
+    static_assert(Traits::DEFERRED_MAINTENANCE);
+
+    std::vector<key_type> keys;
+
+    {
+      std::lock_guard lock{this->m_maintenance->mutex};
+      auto &queue = this->m_maintenance->keys;
+      auto first = queue.end() - std::min(budget, queue.size());
 
+      keys.assign(std::make_move_iterator(first),
+                  std::make_move_iterator(queue.end()));
+      queue.erase(first, queue.end());
+    }
+
+    for (const auto &key : keys)
+      maintain_leaf(ops, key);
+
+    return keys.size();
+  }
+
+  inline NodeSnapshot get_last_leaf() const {
+    NodeSnapshot leaf_snapshot{};
+
+    bool is_leaf_locked =
+        this->template traverse_to_leaf<base::NO_FILL_SNAPSHOT_VECTOR>(
+            [](node_t *current) { return ASINNER(current)->get_last_child(); },
+            this->dummy_snap_vec(), leaf_snapshot);
+
+    if (is_leaf_locked) {
+      BTREE_DEBUG_ASSERT(leaf_snapshot.node != nullptr);
+      leaf_snapshot.node->mutex.unlock();
+    }
+
+    if (leaf_snapshot.node)
+      BTREE_DEBUG_ASSERT(leaf_snapshot.node->isLeaf());
+
+    return leaf_snapshot;
+  }
+
+  inline NodeSnapshot get_first_leaf() const {
+    NodeSnapshot leaf_snapshot{};
+
+    bool is_leaf_locked =
+        this->template traverse_to_leaf<base::NO_FILL_SNAPSHOT_VECTOR>(
+            [](node_t *current) { return ASINNER(current)->get_first_child(); },
+            this->dummy_snap_vec(), leaf_snapshot);
+
+    if (is_leaf_locked) {
+      BTREE_DEBUG_ASSERT(leaf_snapshot.node != nullptr);
+      leaf_snapshot.node->mutex.unlock();
+    }
+
+    if (leaf_snapshot.node)
+      BTREE_DEBUG_ASSERT(leaf_snapshot.node->isLeaf());
+
+    return leaf_snapshot;
+  }
+
+  template <typename ValueType>
   std::optional<mapped_type> update(update_ops_t ops, const key_type &key,
-                                    const mapped_type &val) {
+                                    const ValueType &val) {
     while (true) {
       EpochGuard eg(this);
       NodeSnapshot leaf_snapshot = ops.get_leaf_containing(this, key);
@@ -1931,6 +2627,371 @@ protected:
     };
   }
 
+  struct multi_search_lookup_t {
+    std::size_t idx;
+    NodeSnapshot parent;
+    node_t *node;
+  };
+
+  // Advances `lookup` by one level, validating the same way as `traverse`.
+  // Returns false, once value is found (or found missing).
+  template <typename KeyType>
+  bool multi_search_step(search_ops_t<KeyType> ops, const KeyType &key,
+                         multi_search_lookup_t &lookup,
+                         std::optional<mapped_type> &value) {
+    auto slow_path = [&]() {
+      BTREE_UPDATE_STAT(retry, ++);
+      value = search(ops, key);
+      return false;
+    };
+
+    if (lookup.node == nullptr) {
+      if (this->is_snapshot_stale(lookup.parent))
+        return slow_path();
+
+      value = std::nullopt;
+      return false;
+    }
+
+    NodeSnapshot snapshot{lookup.node, lookup.node->getState()};
+
+    if (snapshot.state.is_locked() || snapshot.state.is_deleted() ||
+        this->is_snapshot_stale(lookup.parent)) {
+      return slow_path();
+    }
+
+    if (snapshot.node->isLeaf()) {
+      leaf_node_t *leaf = ASLEAF(snapshot.node);
+      auto [pos, key_present, _] = ops.lower_bound(leaf, key);
+      std::optional<mapped_type> val =
+          key_present
+              ? std::optional<mapped_type>{leaf->get_key_value(pos)->second}
+              : std::nullopt;
+
+      if (this->is_snapshot_stale(snapshot))
+        return slow_path();
+
+      value = std::move(val);
+      return false;
+    }
+
+    node_t *child = ops.get_child_for_key(ASINNER(snapshot.node), key);
+
+    if (this->is_snapshot_stale(snapshot))
+      return slow_path();
+
+    utils::prefetch<2>(child);
+    lookup.parent = snapshot;
+    lookup.node = child;
+
+    return true;
+  }
+
+  // Lookups are done in groups, advancing each lookup in a group by a level,
+  // while the next nodes of the others are being prefetched.
+  template <typename KeyType>
+  void multi_search(search_ops_t<KeyType> ops, gsl::span<const KeyType> keys,
+                    gsl::span<std::optional<mapped_type>> values) {
+    constexpr auto GROUP_SIZE = base::MULTI_SEARCH_GROUP_SIZE;
+    std::array<multi_search_lookup_t, GROUP_SIZE> lookups;
+    std::size_t num_keys = keys.size();
+
+    BTREE_DEBUG_ASSERT(values.size() >= keys.size());
+
+    EpochGuard eg(this);
+    for (std::size_t start = 0; start < num_keys; start += GROUP_SIZE) {
+      std::size_t end = std::min(start + GROUP_SIZE, num_keys);
+      NodeSnapshot root_snapshot{nullptr,
+                                 detail::load_acquire(this->m_root_state)};
+      node_t *root = detail::load_acquire(this->m_root);
+      int num_lookups = 0;
+
+      if (root)
+        utils::prefetch<2>(root);
+
+      for (std::size_t idx = start; idx < end; idx++)
+        lookups[num_lookups++] = {idx, root_snapshot, root};
+
+      while (num_lookups) {
+        int num_active = 0;
+
+        for (int i = 0; i < num_lookups; i++) {
+          auto &lookup = lookups[i];
+
+          if (multi_search_step(ops, keys[lookup.idx], lookup,
+                                values[lookup.idx])) {
+            lookups[num_active++] = lookup;
+          }
+        }
+
+        num_lookups = num_active;
+      }
+
+      eg.refresh();
+    }
+  }
+
+  // Scan sinks receive a leaf's key/values with `copy` (after a `rewind`),
+  // which are handed over with `commit` once validated. `commit` adds the #
+  // key/values handed over to `num_scanned` and returns false to stop the scan.
+  template <typename Callback> class scan_callback_sink_t {
+  public:
+    scan_callback_sink_t(Callback &callback) : m_callback(callback) {
+      m_key_values.reserve(leaf_node_t::max_num_values());
+    }
+
+    inline void rewind() { m_key_values.clear(); }
+
+    inline void copy(const key_type &key, const mapped_type &value) {
+      m_key_values.emplace_back(key, value);
+    }
+
+    bool commit(std::size_t &num_scanned) {
+      using result_t = std::invoke_result_t<Callback &, const key_type &,
+                                            const mapped_type &>;
+
+      for (const auto &kv : m_key_values) {
+        num_scanned++;
+
+        if constexpr (std::is_same_v<result_t, bool>) {
+          if (!m_callback(kv.first, kv.second))
+            return false;
+        } else {
+          m_callback(kv.first, kv.second);
+        }
+      }
+
+      return true;
+    }
+
+  private:
+    Callback &m_callback;
+    std::vector<std::pair<key_type, mapped_type>> m_key_values;
+  };
+
+  class scan_buffer_sink_t {
+  public:
+    scan_buffer_sink_t(gsl::span<std::pair<key_type, mapped_type>> buffer)
+        : m_buffer(buffer) {}
+
+    inline void rewind() { m_pos = m_committed; }
+
+    inline void copy(const key_type &key, const mapped_type &value) {
+      m_buffer[m_pos].first = key;
+      m_buffer[m_pos++].second = value;
+    }
+
+    inline bool commit(std::size_t &num_scanned) {
+      num_scanned += m_pos - m_committed;
+      m_committed = m_pos;
+      return true;
+    }
+
+  private:
+    gsl::span<std::pair<key_type, mapped_type>> m_buffer;
+    std::size_t m_pos = 0;
+    std::size_t m_committed = 0;
+  };
+
+  // Scans upto `limit` key/values of consecutive leaves into `sink`, starting
+  // from `first_leaf()` at `first_pos(leaf, num_values)`. `last_pos(leaf,
+  // num_values)` returns the end position of the range in a leaf and whether
+  // the range ends there. Matching key/values of a leaf are copied under a
+  // single leaf validation and the scan moves to the next leaf through the
+  // leaf's highkey. Returns # key/values scanned.
+  template <typename FirstLeaf, typename FirstPos, typename LastPos,
+            typename Sink>
+  std::size_t scan_leaves(def_search_ops_t ops, FirstLeaf &&first_leaf,
+                          FirstPos &&first_pos, LastPos &&last_pos,
+                          std::size_t limit, Sink &sink) const {
+    std::optional<key_type> next_key;
+    std::size_t num_scanned = 0;
+    EpochGuard eg(this);
+
+    while (num_scanned < limit) {
+      NodeSnapshot leaf_snapshot =
+          next_key ? ops.get_leaf_containing(this, *next_key) : first_leaf();
+      auto leaf = ASLEAF(leaf_snapshot.node);
+
+      if (leaf == nullptr)
+        break;
+
+      int num_values = detail::load_acquire(leaf->num_values);
+      int first = next_key ? ops.lower_bound_pos(leaf, *next_key, num_values)
+                           : first_pos(leaf, num_values);
+      auto [last, range_end] = last_pos(leaf, num_values);
+
+      last = std::max(first, last);
+      if (static_cast<std::size_t>(last - first) > limit - num_scanned)
+        last = first + static_cast<int>(limit - num_scanned);
+
+      sink.rewind();
+      for (int pos = first; pos < last; pos++) {
+        const auto *kv = leaf->get_key_value(pos);
+        sink.copy(kv->first, kv->second);
+      }
+
+      if (this->is_snapshot_stale(leaf_snapshot)) {
+        BTREE_UPDATE_STAT(retry, ++);
+        continue;
+      }
+
+      if (!sink.commit(num_scanned) || range_end)
+        break;
+
+      next_key = leaf->highkey;
+      eg.refresh();
+    }
+
+    return num_scanned;
+  }
+
+  // Scans upto `limit` key/values in range [min, max] (bounds as per LeftR and
+  // RightR) into `sink`.
+  template <range_kind LeftR, range_kind RightR, typename MinKeyType,
+            typename MaxKeyType, typename Sink>
+  std::size_t scan(search_ops_t<MinKeyType> min_ops,
+                   search_ops_t<MaxKeyType> max_ops, const MinKeyType &min,
+                   const MaxKeyType &max, std::size_t limit, Sink &sink) const {
+    auto beyond_max = [&](const key_type &key) {
+      return RightR == range_kind::INCLUSIVE ? max_ops.less(max, key)
+                                             : !max_ops.less(key, max);
+    };
+
+    return scan_leaves(
+        min_ops, [&]() { return min_ops.get_leaf_containing(this, min); },
+        [&](const leaf_node_t *leaf, int num_values) {
+          return LeftR == range_kind::INCLUSIVE
+                     ? min_ops.lower_bound_pos(leaf, min, num_values)
+                     : min_ops.upper_bound_pos(leaf, min, num_values);
+        },
+        [&](const leaf_node_t *leaf, int num_values) {
+          int last = RightR == range_kind::INCLUSIVE
+                         ? max_ops.upper_bound_pos(leaf, max, num_values)
+                         : max_ops.lower_bound_pos(leaf, max, num_values);
+
+          return std::pair{last, last < num_values || !leaf->highkey ||
+                                     beyond_max(leaf->highkey.value())};
+        },
+        limit, sink);
+  }
+
+  // Scans key/values in range [lowkey, highkey) into `sink`, where a missing
+  // bound is unbounded.
+  template <typename Sink>
+  std::size_t scan_partition(def_search_ops_t ops,
+                             const std::optional<key_type> &lowkey,
+                             const std::optional<key_type> &highkey,
+                             Sink &sink) const {
+    return scan_leaves(
+        ops,
+        [&]() {
+          return lowkey ? ops.get_leaf_containing(this, *lowkey)
+                        : this->get_first_leaf();
+        },
+        [&](const leaf_node_t *leaf, int num_values) {
+          return lowkey ? ops.lower_bound_pos(leaf, *lowkey, num_values) : 0;
+        },
+        [&](const leaf_node_t *leaf, int num_values) {
+          if (!highkey)
+            return std::pair{num_values, !leaf->highkey};
+
+          int last = ops.lower_bound_pos(leaf, *highkey, num_values);
+
+          return std::pair{last, last < num_values || !leaf->highkey ||
+                                     !ops.less(*leaf->highkey, *highkey)};
+        },
+        std::numeric_limits<std::size_t>::max(), sink);
+  }
+
+  // Collects separators of the topmost inner level having atleast
+  // `num_partitions - 1` of them (or of the lowest inner level). Returns false
+  // if a node changed while it was read.
+  bool collect_separators(std::size_t num_partitions,
+                          std::vector<key_type> &separators) const {
+    std::vector<node_t *> level;
+    std::vector<node_t *> next_level;
+    nodestate_t state;
+
+    separators.clear();
+
+    if (this->template lock_node_or_restart<base::OPTIMISTIC_LOCKING>(
+            nullptr, state))
+      return false;
+
+    node_t *root = detail::load_acquire(this->m_root);
+
+    if (this->template unlock_node_or_restart<base::OPTIMISTIC_LOCKING>(
+            nullptr, state))
+      return false;
+
+    if (root == nullptr || root->isLeaf())
+      return true;
+
+    level.push_back(root);
+
+    while (true) {
+      separators.clear();
+      next_level.clear();
+
+      for (node_t *node : level) {
+        inner_node_t *inner = ASINNER(node);
+
+        if (this->template lock_node_or_restart<base::OPTIMISTIC_LOCKING>(
+                node, state))
+          return false;
+
+        int num_values = detail::load_acquire(inner->num_values);
+
+        // First child's separator is the node's lowkey.
+        if (inner->lowkey)
+          separators.push_back(*inner->lowkey);
+
+        for (int pos = 0; pos < num_values; pos++) {
+          if (pos > 0)
+            separators.push_back(inner->get_key_value(pos)->first);
+
+          next_level.push_back(inner->get_child(pos));
+        }
+
+        if (this->template unlock_node_or_restart<base::OPTIMISTIC_LOCKING>(
+                node, state))
+          return false;
+      }
+
+      if (separators.size() + 1 >= num_partitions ||
+          next_level.front()->isLeaf())
+        return true;
+
+      std::swap(level, next_level);
+    }
+  }
+
+  // Returns upto `num_partitions - 1` separator keys, which split the key
+  // space into ranges holding roughly equal # subtrees.
+  std::vector<key_type> partition_keys(std::size_t num_partitions) const {
+    std::vector<key_type> separators;
+    std::vector<key_type> keys;
+
+    if (num_partitions < 2)
+      return keys;
+
+    EpochGuard eg(this);
+
+    while (!collect_separators(num_partitions, separators)) {
+      BTREE_UPDATE_STAT(retry, ++);
+      eg.refresh();
+    }
+
+    std::size_t num_keys = std::min(num_partitions - 1, separators.size());
+
+    keys.reserve(num_keys);
+    for (std::size_t i = 1; i <= num_keys; i++)
+      keys.push_back(separators[i * separators.size() / (num_keys + 1)]);
+
+    return keys;
+  }
+
   std::optional<mapped_type> remove(update_ops_t ops, const key_type &key) {
     NodeSnapshotVector snapshots;
 
@@ -1951,6 +3012,377 @@ protected:
       BTREE_UPDATE_STAT(retry, ++);
     }
   }
+
+  // Batch write helpers
+  // Items of a batch are applied in key order, one leaf at a time. A leaf is
+  // traversed to once and locked once, for all the items in it's
+  // [lowkey, highkey). If it overflows midway, it is split, and the rest of
+  // the items are applied after a new traversal.
+
+  // `items` in key order. Sort is stable, so that duplicate keys are applied
+  // in batch order.
+  template <typename Item, typename KeyOf>
+  static std::vector<const Item *>
+  sorted_batch(update_ops_t ops, gsl::span<const Item> items, KeyOf key_of) {
+    std::vector<const Item *> sorted;
+    auto less = [&](const Item *item1, const Item *item2) {
+      return ops.less(key_of(*item1), key_of(*item2));
+    };
+
+    sorted.reserve(items.size());
+    for (const auto &item : items)
+      sorted.push_back(&item);
+
+    if (!std::is_sorted(sorted.begin(), sorted.end(), less))
+      std::stable_sort(sorted.begin(), sorted.end(), less);
+
+    return sorted;
+  }
+
+  // Locks the leaf of a batch (unless the traversal already did). Returns
+  // false (without the lock), if it's snapshot is stale.
+  bool lock_batch_leaf(const NodeSnapshot &leaf_snapshot,
+                       bool is_leaf_locked) {
+    if (is_leaf_locked) {
+      BTREE_DEBUG_ASSERT(!this->is_snapshot_stale(leaf_snapshot));
+      return true;
+    }
+
+    leaf_snapshot.node->mutex.lock();
+
+    if (this->is_snapshot_stale(leaf_snapshot)) {
+      leaf_snapshot.node->mutex.unlock();
+      return false;
+    }
+
+    return true;
+  }
+
+  static inline bool leaf_owns(update_ops_t ops, const leaf_node_t *leaf,
+                               const key_type &key) {
+    return !leaf->highkey || ops.less(key, *leaf->highkey);
+  }
+
+  // Returns # key/values inserted.
+  template <bool DoUpsert>
+  std::size_t insert_or_upsert_batch(
+      update_ops_t ops,
+      gsl::span<const std::pair<key_type, mapped_type>> key_values) {
+    auto sorted = sorted_batch(
+        ops, key_values,
+        [](const auto &key_value) -> const key_type & {
+          return key_value.first;
+        });
+    std::size_t num_inserted = 0;
+    NodeSnapshotVector snapshots;
+
+    this->ensure_root();
+
+    for (auto it = sorted.begin(); it != sorted.end();) {
+      EpochGuard eg(this);
+      bool is_leaf_locked =
+          ops.get_leaf_containing(this, (*it)->first, snapshots);
+      leaf_node_t *leaf = ASLEAF(snapshots.back().node);
+
+      if (!lock_batch_leaf(snapshots.back(), is_leaf_locked)) {
+        BTREE_UPDATE_STAT(retry, ++);
+        continue;
+      }
+
+      InsertStatus status = InsertStatus::DUPLICATE;
+
+      for (; it != sorted.end() && leaf_owns(ops, leaf, (*it)->first); ++it) {
+        const auto &[key, val] = **it;
+
+        if constexpr (DoUpsert)
+          status = ops.upsert(leaf, key, val).first;
+        else
+          status = ops.insert(leaf, key, val);
+
+        if (status == InsertStatus::OVFLOW)
+          break;
+
+        if (status == InsertStatus::INSERTED) {
+          num_inserted++;
+          BTREE_UPDATE_STAT(element, ++);
+        }
+      }
+
+      if (status != InsertStatus::OVFLOW && !leaf->highkey)
+        this->remember_rightmost_leaf(leaf);
+
+      leaf->mutex.unlock();
+
+      if (status == InsertStatus::OVFLOW)
+        handle_overflow(ops, snapshots, (*it)->first);
+    }
+
+    return num_inserted;
+  }
+
+  // Returns # keys deleted.
+  std::size_t remove_batch(update_ops_t ops, gsl::span<const key_type> keys) {
+    auto sorted =
+        sorted_batch(ops, keys, [](const key_type &key) -> const key_type & {
+          return key;
+        });
+    std::size_t num_deleted = 0;
+    NodeSnapshotVector snapshots;
+
+    for (auto it = sorted.begin(); it != sorted.end();) {
+      EpochGuard eg(this);
+      bool is_leaf_locked = ops.get_leaf_containing(this, **it, snapshots);
+
+      if (snapshots.size() <= 1)
+        break;
+
+      NodeSnapshot &leaf_snapshot = snapshots.back();
+      leaf_node_t *leaf = ASLEAF(leaf_snapshot.node);
+      const key_type *last_deleted = nullptr;
+      bool needs_maintenance = false;
+
+      if (!lock_batch_leaf(leaf_snapshot, is_leaf_locked)) {
+        BTREE_UPDATE_STAT(retry, ++);
+        continue;
+      }
+
+      for (; it != sorted.end() && leaf_owns(ops, leaf, **it); ++it) {
+        auto [pos, key_present, _] = ops.lower_bound(leaf, **it);
+
+        if (key_present) {
+          ops.remove_pos(leaf, pos);
+          last_deleted = *it;
+          num_deleted++;
+          BTREE_UPDATE_STAT(element, --);
+        }
+      }
+
+      if constexpr (Traits::DEFERRED_MAINTENANCE) {
+        // Queue the leaf only once, until it is maintained.
+        needs_maintenance = last_deleted && !leaf->maintenance_queued &&
+                            leaf_needs_maintenance(leaf);
+        leaf->maintenance_queued |= needs_maintenance;
+      }
+
+      leaf_snapshot = {leaf, leaf->getState()};
+      leaf->mutex.unlock();
+
+      if constexpr (Traits::DEFERRED_MAINTENANCE) {
+        if (needs_maintenance) {
+          std::lock_guard lock{this->m_maintenance->mutex};
+
+          this->m_maintenance->keys.push_back(*last_deleted);
+        }
+      } else if (last_deleted && leaf->isUnderfull()) {
+        merge_node<leaf_node_t>(ops, snapshots.size() - 1, snapshots,
+                                *last_deleted);
+      }
+    }
+
+    return num_deleted;
+  }
+
+  // Bulk load helpers
+  // Nodes are built unreachable and only published by `bulk_append`, so they
+  // are filled using the non-atomic `append` path.
+
+  template <typename Node> static inline int bulk_fill_count(int fill_factor) {
+    return std::max(2, Node::max_num_values() * fill_factor / 100);
+  }
+
+  template <typename It>
+  static inline It bulk_advance(It it, const It &last, int count) {
+    for (; count > 0 && it != last; count--)
+      ++it;
+
+    return it;
+  }
+
+  // Packs sorted [first, last) into leaves, starting with a copy of `open`
+  // (current rightmost leaf). Built leaves are appended to `level`.
+  // Must be called with open's mutex held
+  template <typename ForwardIt>
+  static void bulk_build_leaves(const leaf_node_t *open, ForwardIt first,
+                                ForwardIt last, int fill_count,
+                                std::vector<node_t *> &level) {
+    auto highkey_at = [&last](const ForwardIt &it) {
+      return it != last ? std::optional<key_type>{it->first} : std::nullopt;
+    };
+    int num_values = detail::load_relaxed(open->num_values);
+    auto next = bulk_advance(first, last, fill_count - num_values);
+    auto leaf = open->alloc(open->lowkey, highkey_at(next), open->height);
+
+    leaf->copy_from(open, 0, num_values);
+
+    while (true) {
+      for (; first != next; ++first)
+        leaf->append(first->first, first->second);
+
+      level.push_back(leaf);
+
+      if (first == last)
+        break;
+
+      next = bulk_advance(first, last, fill_count);
+      leaf = open->alloc(first->first, highkey_at(next), open->height);
+    }
+  }
+
+  // Packs `children` into inner nodes of `height`, appended to `level`.
+  template <typename It>
+  static void bulk_pack_inner(It first, It last, int height, int fill_count,
+                              std::vector<node_t *> &level) {
+    while (first != last) {
+      auto next = bulk_advance(first, last, fill_count);
+      auto inner = inner_node_t::alloc((*first)->page_usage, (*first)->lowkey,
+                                       (*std::prev(next))->highkey, height);
+
+      inner->insert_neg_infinity(*first);
+      for (++first; first != next; ++first)
+        inner->append(*(*first)->lowkey, *first);
+
+      level.push_back(inner);
+    }
+  }
+
+  // Builds the level above `children`. children[0] replaces the last child of
+  // `open` (current rightmost inner node), the rest are appended after it.
+  // Must be called with open's mutex held
+  static void bulk_build_inner(const inner_node_t *open,
+                               const std::vector<node_t *> &children,
+                               int fill_count, std::vector<node_t *> &level) {
+    int num_values = detail::load_relaxed(open->num_values);
+    auto first = std::next(children.begin());
+    auto next = bulk_advance(first, children.end(), fill_count - num_values);
+    auto inner =
+        open->alloc(open->lowkey, (*std::prev(next))->highkey, open->height);
+
+    inner->insert_neg_infinity(open->get_first_child());
+    inner->copy_from(open, 1, num_values);
+    detail::store_relaxed(*inner->get_child_ptr(num_values - 1), children[0]);
+
+    for (; first != next; ++first)
+      inner->append(*(*first)->lowkey, *first);
+
+    level.push_back(inner);
+    bulk_pack_inner(first, children.end(), open->height, fill_count, level);
+  }
+
+  // Appends sorted [first, last) to the right of the tree, by rebuilding the
+  // rightmost path. All keys must be greater than the largest key in the map.
+  // Writers on the rightmost path wait, while the new nodes are built.
+  template <typename ForwardIt>
+  bool bulk_append(update_ops_t ops, ForwardIt first, ForwardIt last,
+                   int fill_factor, bool require_empty) {
+    static_assert(
+        std::is_base_of_v<
+            std::forward_iterator_tag,
+            typename std::iterator_traits<ForwardIt>::iterator_category>,
+        "bulk load requires multipass iterators");
+
+    if (first == last)
+      return true;
+
+    BTREE_DEBUG_ASSERT(std::adjacent_find(first, last,
+                                          [&ops](const auto &a, const auto &b) {
+                                            return !ops.less(a.first, b.first);
+                                          }) == last);
+
+    fill_factor = std::clamp(fill_factor, 1, 100);
+
+    int leaf_fill = bulk_fill_count<leaf_node_t>(fill_factor);
+    int inner_fill = bulk_fill_count<inner_node_t>(fill_factor);
+    NodeSnapshotVector snapshots;
+
+    this->ensure_root();
+    while (true) {
+      EpochGuard eg(this);
+      std::vector<node_t *> spine;
+
+      if (this->template traverse_to_leaf<base::FILL_SNAPSHOT_VECTOR>(
+              [](node_t *current) {
+                return ASINNER(current)->get_last_child();
+              },
+              snapshots, this->dummy_snap_vec())) {
+        snapshots.back().node->mutex.unlock();
+      }
+
+      auto res = [&]() {
+        std::lock_guard root_lock{*this->m_root_mutex};
+        std::vector<std::unique_lock<node_mutex_t>> locks;
+
+        if (this->is_snapshot_stale(snapshots[0]))
+          return OpResult::STALE_SNAPSHOT;
+
+        for (int node_idx = 1; node_idx < static_cast<int>(snapshots.size());
+             node_idx++) {
+          locks.emplace_back(snapshots[node_idx].node->mutex);
+
+          if (this->is_snapshot_stale(snapshots[node_idx]))
+            return OpResult::STALE_SNAPSHOT;
+        }
+
+        auto open = ASLEAF(snapshots.back().node);
+        int num_values = detail::load_relaxed(open->num_values);
+
+        if (require_empty) {
+          if (snapshots.size() != 2 || num_values != 0)
+            return OpResult::FAILURE;
+        } else if (num_values ? !ops.less(open->get_key(num_values - 1),
+                                          first->first)
+                              : open->lowkey &&
+                                    ops.less(first->first, *open->lowkey)) {
+          return OpResult::FAILURE;
+        }
+
+        std::vector<node_t *> level, upper_level;
+        int height = detail::load_relaxed(this->m_height);
+
+        bulk_build_leaves(open, first, last, leaf_fill, level);
+
+        for (int node_idx = snapshots.size() - 2; node_idx > 0; node_idx--) {
+          upper_level.clear();
+          bulk_build_inner(ASINNER(snapshots[node_idx].node), level,
+                           inner_fill, upper_level);
+          level.swap(upper_level);
+        }
+
+        // Rightmost path is full, grow new levels on top.
+        while (level.size() > 1) {
+          upper_level.clear();
+          bulk_pack_inner(level.begin(), level.end(), level[0]->height + 1,
+                          inner_fill, upper_level);
+          level.swap(upper_level);
+          height++;
+        }
+
+        this->store_root(level[0]);
+        detail::store_release(this->m_height, height);
+
+        for (int node_idx = 1; node_idx < static_cast<int>(snapshots.size());
+             node_idx++) {
+          node_t *node = snapshots[node_idx].node;
+
+          this->mark_deleted(node);
+          spine.push_back(node);
+        }
+
+        return OpResult::SUCCESS;
+      }();
+
+      if (res == OpResult::STALE_SNAPSHOT) {
+        BTREE_UPDATE_STAT(retry, ++);
+        continue;
+      }
+
+      if (res == OpResult::SUCCESS) {
+        BTREE_UPDATE_STAT(element, += std::distance(first, last));
+        this->m_gc.retire_in_new_epoch(node_t::free, spine);
+      }
+
+      return res == OpResult::SUCCESS;
+    }
+  }
 };
 
 template <typename Key, typename Value, typename Traits, typename Stats>
@@ -2469,8 +3901,8 @@ protected:
 } // namespace detail
 
 template <typename Key, typename Value, typename Traits = btree_traits_default,
-          typename Stats = std::conditional_t<Traits::STAT, btree_stats_t,
-                                              btree_empty_stats_t>>
+          typename Stats = std::conditional_t<
+              Traits::STAT, btree_sharded_stats_t, btree_empty_stats_t>>
 class concurrent_map
     : public detail::concurrent_map_iter<Key, Value, Traits, Stats> {
 private:
@@ -2500,6 +3932,31 @@ private:
 
   static constexpr auto is_dynamic_key = base::is_dynamic_key;
 
+  // Callables accepted by functional Upsert and Update.
+  template <typename Fn>
+  static constexpr bool is_updater_v = std::is_invocable_v<Fn &, mapped_type &>;
+
+  // Snapshot image is the header followed by key/values in key order.
+  struct snapshot_record_t {
+    key_type first;
+    mapped_type second;
+  };
+
+  struct snapshot_header_t {
+    char magic[8] = {'B', 'T', 'R', 'E', 'E', 'S', 'N', 'P'};
+    std::uint32_t version = 1;
+    std::uint32_t key_size = sizeof(key_type);
+    std::uint32_t value_size = sizeof(mapped_type);
+    std::uint32_t record_size = sizeof(snapshot_record_t);
+  };
+
+  static_assert(sizeof(snapshot_header_t) % alignof(snapshot_record_t) == 0,
+                "Snapshot records must be aligned in the image");
+
+  static constexpr bool is_snapshotable =
+      std::is_trivially_copyable_v<key_type> &&
+      std::is_trivially_copyable_v<mapped_type>;
+
 public:
   void reserve(size_t) {
     // No-op
@@ -2550,6 +4007,44 @@ public:
     return this->update({this->m_stats.get()}, key, val);
   }
 
+  // Functional upsert, applies `fn(mapped_type &)` in place to the value of
+  // `key`, or to a default constructed value, which is inserted, if `key` is
+  // missing. Done with a single traversal and leaf lock (`fn` is called under
+  // the leaf's mutex and must not throw). Returns the old value, if any.
+  template <typename Fn, ENABLE_IF(is_dynamic_key && is_updater_v<Fn>)>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn,
+                                    const dynamic_cmp *cmp) {
+    typename access::template value_updater_t<Fn> updater{fn};
+
+    return this->template insert_or_upsert<base::DO_UPSERT>(
+        {cmp, this->m_stats.get()}, key, updater);
+  }
+
+  template <typename Fn, ENABLE_IF(!is_dynamic_key && is_updater_v<Fn>)>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn) {
+    typename access::template value_updater_t<Fn> updater{fn};
+
+    return this->template insert_or_upsert<base::DO_UPSERT>(
+        {this->m_stats.get()}, key, updater);
+  }
+
+  // Functional update, same as functional `Upsert`, but does nothing if `key`
+  // is missing.
+  template <typename Fn, ENABLE_IF(is_dynamic_key && is_updater_v<Fn>)>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn,
+                                    const dynamic_cmp *cmp) {
+    typename access::template value_updater_t<Fn> updater{fn};
+
+    return this->update({cmp, this->m_stats.get()}, key, updater);
+  }
+
+  template <typename Fn, ENABLE_IF(!is_dynamic_key && is_updater_v<Fn>)>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn) {
+    typename access::template value_updater_t<Fn> updater{fn};
+
+    return this->update({this->m_stats.get()}, key, updater);
+  }
+
   DYNAMIC_KEY_ONLY
   std::optional<mapped_type> Search(const key_type &key,
                                     const dynamic_cmp *cmp) {
@@ -2563,6 +4058,24 @@ public:
     return this->search({this->m_stats.get()}, key);
   }
 
+  // Searches all `keys`, storing the result of keys[i] into values[i].
+  // Traversals of the keys are interleaved to overlap their cache misses.
+  DYNAMIC_KEY_ONLY
+  void MultiSearch(gsl::span<const key_type> keys,
+                   gsl::span<std::optional<mapped_type>> values,
+                   const dynamic_cmp *cmp) {
+    static_assert(is_dynamic_key == true);
+    this->multi_search(def_search_ops_t{cmp, this->m_stats.get()}, keys,
+                       values);
+  }
+
+  STATIC_KEY_ONLY
+  void MultiSearch(gsl::span<const key_type> keys,
+                   gsl::span<std::optional<mapped_type>> values) {
+    static_assert(is_dynamic_key == false);
+    this->multi_search(def_search_ops_t{this->m_stats.get()}, keys, values);
+  }
+
   DYNAMIC_KEY_ONLY
   std::optional<mapped_type> Delete(const key_type &key,
                                     const dynamic_cmp *cmp) {
@@ -2576,6 +4089,166 @@ public:
     return this->remove({this->m_stats.get()}, key);
   }
 
+  // Batch writes of key/values (or keys), in any order. The batch is sorted
+  // (unless it already is), and every leaf it touches is traversed to and
+  // locked once, for all of it's keys. Duplicate keys of a batch are applied
+  // in batch order. Returns # key/values inserted (or keys deleted).
+  DYNAMIC_KEY_ONLY
+  std::size_t
+  InsertBatch(gsl::span<const std::pair<key_type, mapped_type>> key_values,
+              const dynamic_cmp *cmp) {
+    static_assert(is_dynamic_key == true);
+    return this->template insert_or_upsert_batch<base::DO_INSERT>(
+        {cmp, this->m_stats.get()}, key_values);
+  }
+
+  STATIC_KEY_ONLY
+  std::size_t
+  InsertBatch(gsl::span<const std::pair<key_type, mapped_type>> key_values) {
+    static_assert(is_dynamic_key == false);
+    return this->template insert_or_upsert_batch<base::DO_INSERT>(
+        {this->m_stats.get()}, key_values);
+  }
+
+  DYNAMIC_KEY_ONLY
+  std::size_t
+  UpsertBatch(gsl::span<const std::pair<key_type, mapped_type>> key_values,
+              const dynamic_cmp *cmp) {
+    static_assert(is_dynamic_key == true);
+    return this->template insert_or_upsert_batch<base::DO_UPSERT>(
+        {cmp, this->m_stats.get()}, key_values);
+  }
+
+  STATIC_KEY_ONLY
+  std::size_t
+  UpsertBatch(gsl::span<const std::pair<key_type, mapped_type>> key_values) {
+    static_assert(is_dynamic_key == false);
+    return this->template insert_or_upsert_batch<base::DO_UPSERT>(
+        {this->m_stats.get()}, key_values);
+  }
+
+  DYNAMIC_KEY_ONLY
+  std::size_t DeleteBatch(gsl::span<const key_type> keys,
+                          const dynamic_cmp *cmp) {
+    static_assert(is_dynamic_key == true);
+    return this->remove_batch({cmp, this->m_stats.get()}, keys);
+  }
+
+  STATIC_KEY_ONLY
+  std::size_t DeleteBatch(gsl::span<const key_type> keys) {
+    static_assert(is_dynamic_key == false);
+    return this->remove_batch({this->m_stats.get()}, keys);
+  }
+
+  // Merges or trims upto `budget` leaves queued by deletes (with
+  // Traits::DEFERRED_MAINTENANCE) and returns # leaves processed.
+  // Could be called cooperatively by workers or periodically by a background
+  // thread (registered with ThreadRegistry, like any other user of the map).
+  STATIC_KEY_ONLY
+  std::size_t
+  maintain(std::size_t budget = std::numeric_limits<std::size_t>::max()) {
+    static_assert(is_dynamic_key == false);
+    return this->access::maintain({this->m_stats.get()}, budget);
+  }
+
+  // Loads sorted (by key) and unique [first, last) into an empty map.
+  // Leaves and inner nodes are packed upto `fill_factor` percent of their
+  // capacity. Returns false (without loading anything), if map is not empty.
+  template <typename ForwardIt, ENABLE_IF_DYNAMIC_KEY>
+  bool bulk_load(ForwardIt first, ForwardIt last, const dynamic_cmp *cmp,
+                 int fill_factor = 100) {
+    static_assert(is_dynamic_key == true);
+    return this->access::bulk_append({cmp, this->m_stats.get()}, first, last,
+                                     fill_factor, true);
+  }
+
+  template <typename ForwardIt, ENABLE_IF_STATIC_KEY>
+  bool bulk_load(ForwardIt first, ForwardIt last, int fill_factor = 100) {
+    static_assert(is_dynamic_key == false);
+    return this->access::bulk_append({this->m_stats.get()}, first, last,
+                                     fill_factor, true);
+  }
+
+  // Appends sorted (by key) and unique [first, last) to the rightmost end
+  // of the map. Returns false (without loading anything), if `first` is not
+  // greater than the largest key in the map.
+  template <typename ForwardIt, ENABLE_IF_DYNAMIC_KEY>
+  bool bulk_append(ForwardIt first, ForwardIt last, const dynamic_cmp *cmp,
+                   int fill_factor = 100) {
+    static_assert(is_dynamic_key == true);
+    return this->access::bulk_append({cmp, this->m_stats.get()}, first, last,
+                                     fill_factor, false);
+  }
+
+  template <typename ForwardIt, ENABLE_IF_STATIC_KEY>
+  bool bulk_append(ForwardIt first, ForwardIt last, int fill_factor = 100) {
+    static_assert(is_dynamic_key == false);
+    return this->access::bulk_append({this->m_stats.get()}, first, last,
+                                     fill_factor, false);
+  }
+
+  // Writes a snapshot of all key/values to `out`, to be loaded later by
+  // `restore`. Snapshot is taken online, one leaf at a time under an epoch.
+  // So every leaf is copied consistently, but updates concurrent with the
+  // snapshot may or may not be in it. Returns # key/values written.
+  STATIC_KEY_ONLY
+  std::size_t snapshot(std::ostream &out) const {
+    static_assert(is_dynamic_key == false);
+    static_assert(is_snapshotable,
+                  "Snapshot requires trivially copyable keys and values");
+    snapshot_header_t header;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    return scan_partition(
+        std::nullopt, std::nullopt,
+        [&out](const key_type &key, const mapped_type &value) {
+          snapshot_record_t record{key, value};
+
+          out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        });
+  }
+
+  // Loads a snapshot (see `snapshot`) of `size` bytes at `image` into an
+  // empty map, like `bulk_load`. Inner nodes are rebuilt bottom up and
+  // key/values are copied from the image straight into leaves. Throws
+  // std::invalid_argument, if `image` is not a snapshot of this map type.
+  // Returns false (without loading anything), if map is not empty.
+  STATIC_KEY_ONLY
+  bool restore_image(const void *image, std::size_t size,
+                     int fill_factor = 100) {
+    static_assert(is_dynamic_key == false);
+    static_assert(is_snapshotable,
+                  "Snapshot requires trivially copyable keys and values");
+    snapshot_header_t header;
+    auto records = static_cast<const char *>(image) + sizeof(header);
+
+    if (size < sizeof(header) ||
+        std::memcmp(image, &header, sizeof(header)) != 0 ||
+        (size - sizeof(header)) % sizeof(snapshot_record_t) != 0 ||
+        reinterpret_cast<std::uintptr_t>(records) %
+                alignof(snapshot_record_t) !=
+            0) {
+      throw std::invalid_argument{"concurrent_map: invalid snapshot"};
+    }
+
+    auto first = reinterpret_cast<const snapshot_record_t *>(records);
+    auto last = first + (size - sizeof(header)) / sizeof(snapshot_record_t);
+
+    return bulk_load(first, last, fill_factor);
+  }
+
+  // Same as `restore_image`, from the snapshot file at `path`. File is
+  // mmap'd, so it is paged in while leaves are built, without an
+  // intermediate copy. Throws std::system_error, if file could not be read.
+  STATIC_KEY_ONLY
+  bool restore(const std::string &path, int fill_factor = 100) {
+    static_assert(is_dynamic_key == false);
+    utils::MappedFile file{path};
+
+    return restore_image(file.data(), file.size(), fill_factor);
+  }
+
   STATIC_KEY_ONLY
   inline const_iterator cbegin() const {
     static_assert(is_dynamic_key == false);
@@ -2740,25 +4413,202 @@ public:
         this, ops, ops, ops, min, max};
   }
 
+  // Calls `callback(key, value)` for upto `limit` key/values in range
+  // [min, max] (bounds as per LeftR and RightR), in key order. `callback` could
+  // return false to stop the scan. Key/values are copied a leaf at a time,
+  // hence cheaper than range_iter, but a scan is not an atomic snapshot of the
+  // range. Returns # key/values passed to `callback`.
+  template <range_kind LeftR, range_kind RightR, typename KeyT1, typename KeyT2,
+            typename Callback, ENABLE_IF_STATIC_KEY>
+  std::size_t scan(const KeyT1 &min, const KeyT2 &max, std::size_t limit,
+                   Callback &&callback) const {
+    static_assert(is_dynamic_key == false);
+    typename access::template scan_callback_sink_t<Callback> sink{callback};
+
+    return this->access::template scan<LeftR, RightR>(
+        search_ops_t<KeyT1>{this->m_stats.get()},
+        search_ops_t<KeyT2>{this->m_stats.get()}, min, max, limit, sink);
+  }
+  template <range_kind LeftR, range_kind RightR, typename Callback,
+            ENABLE_IF_DYNAMIC_KEY>
+  std::size_t scan(const key_type &min, const key_type &max, std::size_t limit,
+                   Callback &&callback, const dynamic_cmp *cmp) const {
+    static_assert(is_dynamic_key == true);
+    def_search_ops_t ops = {cmp, this->m_stats.get()};
+    typename access::template scan_callback_sink_t<Callback> sink{callback};
+
+    return this->access::template scan<LeftR, RightR>(ops, ops, min, max,
+                                                      limit, sink);
+  }
+
+  // Same as `scan`, but copies key/values into `buffer`, upto it's size.
+  // Returns # key/values copied.
+  template <range_kind LeftR, range_kind RightR, typename KeyT1, typename KeyT2,
+            ENABLE_IF_STATIC_KEY>
+  std::size_t
+  scan_into(const KeyT1 &min, const KeyT2 &max,
+            gsl::span<std::pair<key_type, mapped_type>> buffer) const {
+    static_assert(is_dynamic_key == false);
+    typename access::scan_buffer_sink_t sink{buffer};
+
+    return this->access::template scan<LeftR, RightR>(
+        search_ops_t<KeyT1>{this->m_stats.get()},
+        search_ops_t<KeyT2>{this->m_stats.get()}, min, max, buffer.size(),
+        sink);
+  }
+  template <range_kind LeftR, range_kind RightR, ENABLE_IF_DYNAMIC_KEY>
+  std::size_t scan_into(const key_type &min, const key_type &max,
+                        gsl::span<std::pair<key_type, mapped_type>> buffer,
+                        const dynamic_cmp *cmp) const {
+    static_assert(is_dynamic_key == true);
+    def_search_ops_t ops = {cmp, this->m_stats.get()};
+    typename access::scan_buffer_sink_t sink{buffer};
+
+    return this->access::template scan<LeftR, RightR>(ops, ops, min, max,
+                                                      buffer.size(), sink);
+  }
+
+  // Returns upto `num_partitions - 1` keys, which split the key space into
+  // disjoint ranges [-inf, keys[0]), [keys[0], keys[1]) ... [keys.back(), inf)
+  // of roughly equal # subtrees. Keys are separators of the top inner levels,
+  // so an empty (or single leaf) map has no partitions.
+  STATIC_KEY_ONLY
+  std::vector<key_type> partition_keys(std::size_t num_partitions) const {
+    static_assert(is_dynamic_key == false);
+    return this->access::partition_keys(num_partitions);
+  }
+
+  // Same as `scan`, but over key/values in range [lowkey, highkey), where a
+  // missing bound is unbounded. Partitions (see `partition_keys`) could be
+  // scanned concurrently, each scan holds it's own epoch.
+  template <typename Callback, ENABLE_IF_STATIC_KEY>
+  std::size_t scan_partition(const std::optional<key_type> &lowkey,
+                             const std::optional<key_type> &highkey,
+                             Callback &&callback) const {
+    static_assert(is_dynamic_key == false);
+    typename access::template scan_callback_sink_t<Callback> sink{callback};
+
+    return this->access::scan_partition({this->m_stats.get()}, lowkey,
+                                        highkey, sink);
+  }
+
+  // Scans whole map as upto `num_threads` partitions in parallel, calling
+  // `callback(key, value)` concurrently from all of them. First partition is
+  // scanned by the calling thread and the rest by new threads (registered
+  // with ThreadRegistry). Returns # key/values scanned.
+  template <typename Callback, ENABLE_IF_STATIC_KEY>
+  std::size_t parallel_scan(std::size_t num_threads,
+                            Callback &&callback) const {
+    static_assert(is_dynamic_key == false);
+    std::vector<key_type> keys = partition_keys(num_threads);
+    std::vector<std::size_t> num_scanned(keys.size() + 1);
+    std::vector<std::thread> workers;
+
+    auto scan_nth_partition = [&](std::size_t n) {
+      std::optional<key_type> lowkey;
+      std::optional<key_type> highkey;
+
+      if (n > 0)
+        lowkey = keys[n - 1];
+      if (n < keys.size())
+        highkey = keys[n];
+
+      num_scanned[n] = scan_partition(lowkey, highkey, callback);
+    };
+
+    for (std::size_t n = 1; n < num_scanned.size(); n++) {
+      workers.emplace_back([&, n]() {
+        utils::ThreadRegistry::RegisterThread();
+        scan_nth_partition(n);
+        utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    scan_nth_partition(0);
+
+    for (auto &worker : workers)
+      worker.join();
+
+    return std::accumulate(num_scanned.begin(), num_scanned.end(),
+                           std::size_t{0});
+  }
+
   inline int height() const { return this->m_height; }
 
   inline void reclaim_all() { this->m_gc.reclaim_all(); }
 
+  // Objects retired and pending reclamation (see `utils::epoch_stats_t`).
+  utils::epoch_stats_t<uint64_t> reclamation_stats() const {
+    return this->m_gc.stats();
+  }
+
+  // Objects retired by writers are reclaimed by a thread every `interval` (see
+  // `utils::EpochManager::start_background_reclamation`).
+  void start_background_reclamation(std::chrono::microseconds interval,
+                                    bool recycle = false) {
+    this->m_gc.start_background_reclamation(interval, recycle);
+  }
+
+  void stop_background_reclamation() {
+    this->m_gc.stop_background_reclamation();
+  }
+
+  // Sums counters, which nodes maintain as they change, and does not walk the
+  // tree. Memory of keys and values outside the nodes is not included.
+  btree_memory_usage_t memory_usage() const {
+    std::ptrdiff_t num_nodes[2] = {}, live_bytes = 0, free_bytes = 0;
+    btree_memory_usage_t usage;
+
+    for (const auto &stripe : *this->m_page_usage) {
+      for (int type = 0; type < 2; type++)
+        num_nodes[type] += detail::load_relaxed(stripe.num_nodes[type]);
+
+      live_bytes += detail::load_relaxed(stripe.live_bytes);
+      free_bytes += detail::load_relaxed(stripe.free_bytes);
+    }
+
+    // Stripes are read while writers update them.
+    auto clamp = [](std::ptrdiff_t n) {
+      return static_cast<std::size_t>(std::max<std::ptrdiff_t>(n, 0));
+    };
+
+    usage.num_inner_nodes =
+        clamp(num_nodes[static_cast<int>(base::NodeType::INNER)]);
+    usage.num_leaf_nodes =
+        clamp(num_nodes[static_cast<int>(base::NodeType::LEAF)]);
+    usage.inner_bytes = usage.num_inner_nodes * base::INNER_NODE_SIZE;
+    usage.leaf_bytes = usage.num_leaf_nodes * base::LEAF_NODE_SIZE;
+    usage.header_bytes = usage.num_inner_nodes * sizeof(inner_node_t) +
+                         usage.num_leaf_nodes * sizeof(leaf_node_t);
+    usage.live_bytes = clamp(live_bytes);
+    usage.free_bytes = clamp(free_bytes);
+    usage.dead_bytes =
+        clamp(static_cast<std::ptrdiff_t>(usage.total_bytes()) -
+              static_cast<std::ptrdiff_t>(usage.header_bytes +
+                                          usage.live_bytes + usage.free_bytes));
+    usage.retired_bytes = this->m_gc.stats().retired_bytes;
+
+    return usage;
+  }
+
   template <ENABLE_IF(Traits::STAT)> inline std::size_t size() const {
-    return this->m_stats->num_elements;
+    return this->m_stats->num_elements();
   }
 
   template <ENABLE_IF(Traits::STAT)> inline bool empty() const {
     return size() == 0;
   }
 
-  template <ENABLE_IF(Traits::STAT)> inline const Stats &stats() const {
-    return this->m_stats;
+  // Sums the stats of all threads.
+  template <ENABLE_IF(Traits::STAT)> inline btree_stats_t stats() const {
+    return this->m_stats->sum();
   }
 
   ~concurrent_map() {
     std::deque<node_t *> nodes;
 
+    this->m_gc.stop_background_reclamation();
+
     if (this->m_root)
       nodes.emplace_back(this->m_root);
 
@@ -0,0 +1,339 @@
+// include/indexes/btree/frozen_map.h
+// Read only map, built once from a sorted range, with slots in Eytzinger
+// (breadth first) order
+
+#pragma once
+
+#include "indexes/utils/Utils.h"
+#include "map.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace indexes::btree {
+// Slot `k` (1 based) has it's children at `2k` and `2k + 1`, so a search
+// goes down the implicit tree without a branch per level and prefetches the
+// slots, a few levels below, while comparing the current one. All slots are
+// in a single allocation (of `byte_size()` bytes), which for trivially
+// copyable key and value types could be written out and later served as is,
+// Ex: from an mmap'd file (see `view`).
+template <typename Key, typename Value> class frozen_map {
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using reference = const value_type &;
+  using const_reference = const value_type &;
+
+private:
+  // Slots `k * BLOCK_SIZE` to `(k + 1) * BLOCK_SIZE - 1` are the descendants
+  // of slot `k`, log2(BLOCK_SIZE) levels below it, and fit in a cacheline.
+  static constexpr size_type BLOCK_SIZE = [] {
+    size_type block_size = 1;
+
+    while (block_size * 2 * sizeof(value_type) <= utils::CACHELINE_SIZE)
+      block_size *= 2;
+
+    return block_size;
+  }();
+
+  static constexpr std::align_val_t SLOT_ALIGNMENT{utils::CACHELINE_SIZE};
+
+  template <typename KeyT1, typename KeyT2>
+  static inline bool key_less(const KeyT1 &k1, const KeyT2 &k2) {
+    return k1 < k2;
+  }
+
+  // Slot 0 is unused, so that slots are 1 based.
+  value_type *m_slots = nullptr;
+  size_type m_size = 0;
+  bool m_owned = false;
+
+  static inline size_type leftmost(size_type k, size_type n) {
+    while (2 * k <= n)
+      k = 2 * k;
+
+    return k;
+  }
+
+  static inline size_type rightmost(size_type k, size_type n) {
+    while (2 * k + 1 <= n)
+      k = 2 * k + 1;
+
+    return k;
+  }
+
+  // In order successor of slot `k`, 0 after the last slot.
+  static inline size_type next_slot(size_type k, size_type n) {
+    if (2 * k + 1 <= n)
+      return leftmost(2 * k + 1, n);
+
+    while (k & 1)
+      k >>= 1;
+
+    return k >> 1;
+  }
+
+  // In order predecessor of slot `k`, 0 before the first slot.
+  static inline size_type prev_slot(size_type k, size_type n) {
+    if (k == 0)
+      return n ? rightmost(1, n) : 0;
+
+    if (2 * k <= n)
+      return rightmost(2 * k, n);
+
+    while ((k & 1) == 0)
+      k >>= 1;
+
+    return k >> 1;
+  }
+
+  // Slot reached by a search, after the last step taken to the right of it,
+  // which is the answer (or 0 if every step was to the right).
+  static inline size_type search_result(size_type k) {
+    return k >> (utils::trailing_zeroes(~static_cast<uint64_t>(k)) + 1);
+  }
+
+  template <typename KeyType>
+  inline size_type lower_bound_slot(const KeyType &key) const {
+    size_type k = 1;
+
+    while (k <= m_size) {
+      utils::prefetch(m_slots + k * BLOCK_SIZE);
+      k = 2 * k + key_less(m_slots[k].first, key);
+    }
+
+    return search_result(k);
+  }
+
+  template <typename KeyType>
+  inline size_type upper_bound_slot(const KeyType &key) const {
+    size_type k = 1;
+
+    while (k <= m_size) {
+      utils::prefetch(m_slots + k * BLOCK_SIZE);
+      k = 2 * k + !key_less(key, m_slots[k].first);
+    }
+
+    return search_result(k);
+  }
+
+  static value_type *allocate_slots(size_type size) {
+    return static_cast<value_type *>(
+        ::operator new((size + 1) * sizeof(value_type), SLOT_ALIGNMENT));
+  }
+
+  static void free_slots(value_type *slots) {
+    ::operator delete(slots, SLOT_ALIGNMENT);
+  }
+
+  // Destroys the first `num_values` (in order) values.
+  void destroy_values(size_type num_values) {
+    for (size_type k = leftmost(1, m_size); num_values--;
+         k = next_slot(k, m_size)) {
+      m_slots[k].~value_type();
+    }
+  }
+
+  void release() {
+    if (m_owned) {
+      destroy_values(m_size);
+      free_slots(m_slots);
+    }
+
+    m_slots = nullptr;
+    m_size = 0;
+    m_owned = false;
+  }
+
+public:
+  class const_iterator {
+  public:
+    using value_type = frozen_map::value_type;
+    using reference = const value_type &;
+    using pointer = const value_type *;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+
+  private:
+    const frozen_map *m_map;
+    size_type m_slot;
+
+    friend class frozen_map;
+
+    inline const_iterator(const frozen_map *map, size_type slot)
+        : m_map(map), m_slot(slot) {}
+
+  public:
+    inline const_iterator() : const_iterator(nullptr, 0) {}
+
+    inline reference operator*() const { return m_map->m_slots[m_slot]; }
+
+    inline pointer operator->() const { return &m_map->m_slots[m_slot]; }
+
+    inline const key_type &key() const { return (**this).first; }
+
+    inline const mapped_type &data() const { return (**this).second; }
+
+    inline const_iterator &operator++() {
+      m_slot = next_slot(m_slot, m_map->m_size);
+
+      return *this;
+    }
+
+    inline const_iterator operator++(int) {
+      auto copy = *this;
+
+      ++*this;
+      return copy;
+    }
+
+    inline const_iterator &operator--() {
+      m_slot = prev_slot(m_slot, m_map->m_size);
+
+      return *this;
+    }
+
+    inline const_iterator operator--(int) {
+      auto copy = *this;
+
+      --*this;
+      return copy;
+    }
+
+    inline bool operator==(const const_iterator &other) const {
+      assert(m_map == other.m_map);
+
+      return m_slot == other.m_slot;
+    }
+
+    inline bool operator!=(const const_iterator &other) const {
+      return !(*this == other);
+    }
+  };
+
+  using iterator = const_iterator;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using reverse_iterator = const_reverse_iterator;
+
+  frozen_map() = default;
+
+  // Builds from [first, last), which must be sorted and have unique keys.
+  template <typename ForwardIt>
+  frozen_map(ForwardIt first, ForwardIt last)
+      : m_slots(allocate_slots(std::distance(first, last))),
+        m_size(std::distance(first, last)), m_owned(true) {
+    size_type num_values = 0;
+
+    try {
+      for (size_type k = leftmost(1, m_size); first != last;
+           ++first, k = next_slot(k, m_size), num_values++) {
+        new (&m_slots[k]) value_type(*first);
+      }
+    } catch (...) {
+      destroy_values(num_values);
+      free_slots(m_slots);
+      throw;
+    }
+  }
+
+  template <typename Traits, typename Compare, typename Stats>
+  explicit frozen_map(const map<Key, Value, Traits, Compare, Stats> &other)
+      : frozen_map(other.begin(), other.end()) {}
+
+  frozen_map(const frozen_map &) = delete;
+  frozen_map &operator=(const frozen_map &) = delete;
+
+  frozen_map(frozen_map &&other) noexcept
+      : m_slots(std::exchange(other.m_slots, nullptr)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_owned(std::exchange(other.m_owned, false)) {}
+
+  frozen_map &operator=(frozen_map &&other) noexcept {
+    if (this != &other) {
+      release();
+      m_slots = std::exchange(other.m_slots, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_owned = std::exchange(other.m_owned, false);
+    }
+
+    return *this;
+  }
+
+  ~frozen_map() { release(); }
+
+  // Map over the `size` bytes image of a frozen_map, at `image` (see `data`
+  // and `byte_size`), which must be aligned to a cacheline and outlive the
+  // returned map. Nothing is copied.
+  static frozen_map view(const void *image, std::size_t size) {
+    static_assert(std::is_trivially_copyable_v<Key> &&
+                      std::is_trivially_copyable_v<Value>,
+                  "Only images of trivially copyable keys and values could "
+                  "be used in place");
+
+    if (size == 0 || size % sizeof(value_type) != 0 ||
+        reinterpret_cast<std::uintptr_t>(image) % utils::CACHELINE_SIZE != 0)
+      throw std::invalid_argument{"frozen_map: invalid image"};
+
+    frozen_map frozen;
+
+    frozen.m_slots = static_cast<value_type *>(const_cast<void *>(image));
+    frozen.m_size = size / sizeof(value_type) - 1;
+
+    return frozen;
+  }
+
+  // Image of the map, of `byte_size()` bytes.
+  inline const void *data() const { return m_slots; }
+
+  inline std::size_t byte_size() const {
+    return m_slots ? (m_size + 1) * sizeof(value_type) : 0;
+  }
+
+  inline const_iterator find(const Key &key) const {
+    auto it = lower_bound(key);
+
+    return it != end() && !key_less(key, it->first) ? it : end();
+  }
+
+  template <typename KeyType>
+  inline const_iterator lower_bound(const KeyType &key) const {
+    return {this, lower_bound_slot(key)};
+  }
+
+  template <typename KeyType>
+  inline const_iterator upper_bound(const KeyType &key) const {
+    return {this, upper_bound_slot(key)};
+  }
+
+  inline const_iterator begin() const {
+    return {this, m_size ? leftmost(1, m_size) : 0};
+  }
+
+  inline const_iterator end() const { return {this, 0}; }
+
+  inline const_iterator cbegin() const { return begin(); }
+
+  inline const_iterator cend() const { return end(); }
+
+  inline const_reverse_iterator rbegin() const {
+    return const_reverse_iterator{end()};
+  }
+
+  inline const_reverse_iterator rend() const {
+    return const_reverse_iterator{begin()};
+  }
+
+  inline std::size_t size() const { return m_size; }
+
+  inline bool empty() const { return m_size == 0; }
+};
+} // namespace indexes::btree
@@ -1,7 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
 
 namespace indexes::btree {
 namespace detail {
@@ -28,10 +35,10 @@ bool less(const compound_key<Order, Types1...> &k1,
       return false;
   } else {
     if (std::get<Index>(k1) < std::get<Index>(k2))
-      return true;
+      return Order == LESS;
 
     if (std::get<Index>(k2) < std::get<Index>(k1))
-      return false;
+      return Order == GREATER;
 
     return less<Index + 1>(k1, k2);
   }
@@ -76,6 +83,259 @@ inline bool operator>=(const compound_key<Order, Types1...> &x,
 template <typename... Types>
 using compound_key = detail::compound_key<detail::LESS, Types...>;
 
+// Members are compared in descending order. Partial keys (prefix of members)
+// are still lesser than the keys they are a prefix of.
 template <typename... Types>
 using compound_key_greater = detail::compound_key<detail::GREATER, Types...>;
+
+// Order preserving prefixes of keys, concurrent_map stores them along with the
+// slots so that node searches compare full keys only on a prefix tie.
+// `encode(key)` must return a code such that `a < b` implies
+// `encode(a) <= encode(b)` (for any number of the code's high order bits).
+// Keys of the same `family` are encoded alike and hence can be compared with
+// each other's prefixes. `family` is void for keys without a prefix.
+template <typename Key, typename = void> struct key_prefix {
+  using family = void;
+};
+
+// Integers are left aligned, so that the significant bits come first.
+template <typename Int>
+struct key_prefix<Int, std::enable_if_t<std::is_integral_v<Int> &&
+                                        !std::is_same_v<Int, bool>>> {
+  using family = Int;
+
+  static constexpr std::uint64_t encode(Int key) noexcept {
+    using UInt = std::make_unsigned_t<Int>;
+    constexpr int shift = 64 - std::numeric_limits<UInt>::digits;
+    auto code = static_cast<std::uint64_t>(static_cast<UInt>(key)) << shift;
+
+    if constexpr (std::is_signed_v<Int>)
+      code ^= std::uint64_t{1} << 63;
+
+    return code;
+  }
+};
+
+template <> struct key_prefix<std::string_view> {
+  using family = std::string_view;
+
+  // First 8 bytes in big endian order, zero padded.
+  static std::uint64_t encode(std::string_view key) noexcept {
+    std::uint64_t code = 0;
+    std::size_t len = std::min<std::size_t>(key.size(), sizeof(code));
+
+    for (std::size_t i = 0; i < len; i++)
+      code |= std::uint64_t{static_cast<unsigned char>(key[i])}
+              << (8 * (sizeof(code) - 1 - i));
+
+    return code;
+  }
+};
+
+template <> struct key_prefix<std::string> : key_prefix<std::string_view> {};
+template <> struct key_prefix<const char *> : key_prefix<std::string_view> {};
+template <> struct key_prefix<char *> : key_prefix<std::string_view> {};
+
+// String of upto `Capacity` bytes, stored inline instead of on the heap. As a
+// concurrent_map key, the key bytes are on the node's page itself, so key
+// comparisons touch no other cache lines (unlike std::string keys longer than
+// it's small string buffer). Compares with, and could be searched by,
+// std::string_view (and std::string).
+template <std::size_t Capacity> class inline_string {
+  static_assert(Capacity > 0 &&
+                    Capacity <= std::numeric_limits<std::uint8_t>::max(),
+                "Length of inline_string must fit in a byte");
+
+public:
+  inline_string() = default;
+
+  explicit inline_string(std::string_view str) {
+    if (str.size() > Capacity)
+      throw std::length_error{"inline_string: string longer than capacity"};
+
+    std::copy(str.begin(), str.end(), m_data.begin());
+    m_size = static_cast<std::uint8_t>(str.size());
+  }
+  explicit inline_string(const char *str)
+      : inline_string(std::string_view{str}) {}
+  explicit inline_string(const std::string &str)
+      : inline_string(std::string_view{str}) {}
+
+  static constexpr std::size_t capacity() noexcept { return Capacity; }
+
+  inline std::size_t size() const noexcept { return m_size; }
+  inline const char *data() const noexcept { return m_data.data(); }
+  inline std::string_view view() const noexcept { return {data(), size()}; }
+  inline operator std::string_view() const noexcept { return view(); }
+
+  friend inline bool operator==(const inline_string &x,
+                                const inline_string &y) noexcept {
+    return x.view() == y.view();
+  }
+  friend inline bool operator==(const inline_string &x,
+                                std::string_view y) noexcept {
+    return x.view() == y;
+  }
+  friend inline bool operator==(std::string_view x,
+                                const inline_string &y) noexcept {
+    return x == y.view();
+  }
+  friend inline bool operator!=(const inline_string &x,
+                                const inline_string &y) noexcept {
+    return !(x == y);
+  }
+  friend inline bool operator<(const inline_string &x,
+                               const inline_string &y) noexcept {
+    return x.view() < y.view();
+  }
+  friend inline bool operator<(const inline_string &x,
+                               std::string_view y) noexcept {
+    return x.view() < y;
+  }
+  friend inline bool operator<(std::string_view x,
+                               const inline_string &y) noexcept {
+    return x < y.view();
+  }
+
+private:
+  std::array<char, Capacity> m_data{};
+  std::uint8_t m_size = 0;
+};
+
+template <std::size_t Capacity>
+struct key_prefix<inline_string<Capacity>> : key_prefix<std::string_view> {};
+
+// Prefix of a compound key is the prefix of it's first member (inverted, if
+// members are in descending order).
+template <int Order, typename Type, typename... Types>
+struct key_prefix<detail::compound_key<Order, Type, Types...>> {
+  using member_family = typename key_prefix<Type>::family;
+  using family = std::conditional_t<
+      Order == detail::LESS || std::is_void_v<member_family>, member_family,
+      detail::compound_key<Order, member_family>>;
+
+  static std::uint64_t
+  encode(const detail::compound_key<Order, Type, Types...> &key) noexcept {
+    auto code = key_prefix<Type>::encode(std::get<0>(key));
+
+    return Order == detail::LESS ? code : ~code;
+  }
+};
+
+namespace detail {
+// Appends order preserving (as per memcmp) encoding of a key member to `out`.
+template <typename Type, typename = void> struct key_encoder;
+
+template <> struct key_encoder<bool> {
+  static void encode(std::string &out, bool member) {
+    out.push_back(member ? 1 : 0);
+  }
+};
+
+// Big endian, with the sign bit flipped for signed integers.
+template <typename Int>
+struct key_encoder<Int, std::enable_if_t<std::is_integral_v<Int> &&
+                                         !std::is_same_v<Int, bool>>> {
+  static void encode(std::string &out, Int member) {
+    using UInt = std::make_unsigned_t<Int>;
+    constexpr int bits = std::numeric_limits<UInt>::digits;
+    auto code = static_cast<UInt>(member);
+
+    if constexpr (std::is_signed_v<Int>)
+      code ^= static_cast<UInt>(UInt{1} << (bits - 1));
+
+    for (int shift = bits - 8; shift >= 0; shift -= 8)
+      out.push_back(static_cast<char>(code >> shift));
+  }
+};
+
+// Zero bytes are escaped as 0x00 0xFF and the string is terminated by
+// 0x00 0x00, so that a string sorts before the strings it is a prefix of.
+template <> struct key_encoder<std::string_view> {
+  static void encode(std::string &out, std::string_view member) {
+    for (char c : member) {
+      out.push_back(c);
+
+      if (c == '\0')
+        out.push_back('\xFF');
+    }
+
+    out.append(2, '\0');
+  }
+};
+
+template <> struct key_encoder<std::string> : key_encoder<std::string_view> {};
+template <> struct key_encoder<const char *> : key_encoder<std::string_view> {};
+template <> struct key_encoder<char *> : key_encoder<std::string_view> {};
+} // namespace detail
+
+// Order preserving binary encoding of a compound key, whose bytes compare
+// (with memcmp) in the same order as the compound keys. So a map keyed by
+// normalized keys compares keys without visiting their members and it's key
+// prefixes (see `key_prefix`) span across members.
+// Encoding of a partial key is a prefix of the encodings of keys it is a
+// partial key of, hence partial keys could still be used as scan bounds.
+class normalized_key {
+public:
+  normalized_key() = default;
+
+  template <int Order, typename... Types>
+  explicit normalized_key(const detail::compound_key<Order, Types...> &key) {
+    std::apply(
+        [&](const auto &... members) {
+          (detail::key_encoder<std::decay_t<decltype(members)>>::encode(
+               m_bytes, members),
+           ...);
+        },
+        static_cast<const std::tuple<Types...> &>(key));
+
+    // Descending order
+    if constexpr (Order == detail::GREATER) {
+      for (auto &byte : m_bytes)
+        byte = static_cast<char>(~byte);
+    }
+  }
+
+  inline std::string_view bytes() const noexcept { return m_bytes; }
+
+  inline int compare(const normalized_key &o) const noexcept {
+    return m_bytes.compare(o.m_bytes);
+  }
+
+  friend inline bool operator==(const normalized_key &x,
+                                const normalized_key &y) noexcept {
+    return x.m_bytes == y.m_bytes;
+  }
+  friend inline bool operator!=(const normalized_key &x,
+                                const normalized_key &y) noexcept {
+    return !(x == y);
+  }
+  friend inline bool operator<(const normalized_key &x,
+                               const normalized_key &y) noexcept {
+    return x.compare(y) < 0;
+  }
+  friend inline bool operator>(const normalized_key &x,
+                               const normalized_key &y) noexcept {
+    return y < x;
+  }
+  friend inline bool operator<=(const normalized_key &x,
+                                const normalized_key &y) noexcept {
+    return !(y < x);
+  }
+  friend inline bool operator>=(const normalized_key &x,
+                                const normalized_key &y) noexcept {
+    return !(x < y);
+  }
+
+private:
+  std::string m_bytes;
+};
+
+template <> struct key_prefix<normalized_key> {
+  using family = normalized_key;
+
+  static std::uint64_t encode(const normalized_key &key) noexcept {
+    return key_prefix<std::string_view>::encode(key.bytes());
+  }
+};
 } // namespace indexes::btree
\ No newline at end of file
@@ -26,6 +26,11 @@ private:
 
   enum class NodeType : bool { LEAF, INNER };
 
+  static constexpr int node_size(NodeType node_type) {
+    return node_type == NodeType::INNER ? btree_node_sizes<Traits>::INNER
+                                        : btree_node_sizes<Traits>::LEAF;
+  }
+
   template <typename KeyT1, typename KeyT2>
   static inline bool key_less(const KeyT1 &k1, const KeyT2 &k2) {
     return k1 < k2;
@@ -43,7 +48,7 @@ private:
     int logical_pagesize = 0;
     int num_values = 0;
     int next_slot_offset = 0;
-    int last_value_offset = Traits::NODE_SIZE;
+    int last_value_offset;
 
     const NodeType node_type;
     const int height;
@@ -55,11 +60,15 @@ private:
     inline node_t(NodeType ntype, int initialsize, int a_height,
                   const std::optional<Key> &a_lowkey,
                   const std::optional<Key> &a_highkey)
-        : next_slot_offset(initialsize), node_type(ntype), height(a_height),
-          lowkey(a_lowkey), highkey(a_highkey) {}
+        : next_slot_offset(initialsize), last_value_offset(node_size(ntype)),
+          node_type(ntype), height(a_height), lowkey(a_lowkey),
+          highkey(a_highkey) {}
 
     inline bool isLeaf() const { return node_type == NodeType::LEAF; }
 
+    // Size of the node's page
+    inline int pageSize() const { return node_size(node_type); }
+
     inline bool isInner() const { return node_type == NodeType::INNER; }
 
     inline bool haveEnoughSpace(int size) const {
@@ -68,9 +77,9 @@ private:
     }
 
     inline bool isUnderfull() const {
-      BTREE_DEBUG_ASSERT(this->logical_pagesize <= Traits::NODE_SIZE);
+      BTREE_DEBUG_ASSERT(this->logical_pagesize <= pageSize());
 
-      return (this->logical_pagesize * 100) / Traits::NODE_SIZE <
+      return (this->logical_pagesize * 100) / pageSize() <
              Traits::NODE_MERGE_THRESHOLD;
     }
 
@@ -109,6 +118,7 @@ private:
     using key_value_t = std::pair<Key, value_t>;
 
     static constexpr enum NodeType NODETYPE = NType;
+    static constexpr int NODE_SIZE = node_size(NType);
 
     static constexpr bool IsLeaf() { return NType == NodeType::LEAF; }
 
@@ -127,7 +137,7 @@ private:
     static inherited_node_t *alloc(const std::optional<Key> &lowkey,
                                    const std::optional<Key> &highkey,
                                    int height) {
-      return new (new char[Traits::NODE_SIZE])
+      return new (new char[NODE_SIZE])
           inherited_node_t(lowkey, highkey, height);
     }
 
@@ -135,7 +145,7 @@ private:
       return (this->logical_pagesize + other->logical_pagesize +
               (IsInner() ? sizeof(key_value_t) : 0)) +
                  sizeof(inherited_node_t) <=
-             Traits::NODE_SIZE;
+             NODE_SIZE;
     }
 
     inline char *opaque() const {
@@ -425,21 +435,21 @@ private:
   using leaf_node_t = inherited_node_t<Value, NodeType::LEAF>;
   using inner_node_t = inherited_node_t<node_t *, NodeType::INNER>;
 
-  static_assert((Traits::NODE_SIZE - sizeof(leaf_node_t)) /
+  static_assert((leaf_node_t::NODE_SIZE - sizeof(leaf_node_t)) /
                         (sizeof(typename leaf_node_t::key_value_t) +
                          sizeof(int)) >=
                     4,
                 "Btree leaf node must have atleast 4 slots");
-  static_assert((Traits::NODE_SIZE - sizeof(inner_node_t)) /
+  static_assert((inner_node_t::NODE_SIZE - sizeof(inner_node_t)) /
                         (sizeof(typename inner_node_t::key_value_t) +
                          sizeof(int)) >=
                     4,
                 "Btree inner node must have atleast 4 slots");
-  static_assert(Traits::NODE_SIZE %
+  static_assert(leaf_node_t::NODE_SIZE %
                         alignof(typename leaf_node_t::key_value_t) ==
                     0,
                 "Alignment mismatch b/w pagesize and Key, Value");
-  static_assert(Traits::NODE_SIZE %
+  static_assert(inner_node_t::NODE_SIZE %
                         alignof(typename inner_node_t::key_value_t) ==
                     0,
                 "Alignment mismatch b/w pagesize and Key, Value");
@@ -894,7 +904,7 @@ public:
 
   inline const_iterator cbegin() const { return {this, get_first_leaf(), 0}; }
 
-  inline const_iterator cend() const { return end(); }
+  inline const_iterator cend() const { return {this, nullptr, 0}; }
 
   inline const_iterator begin() const { return cbegin(); }
 
@@ -4,13 +4,18 @@
 #pragma once
 
 #include "indexes/utils/EpochManager.h"
+#include "indexes/utils/Numa.h"
+#include "indexes/utils/Utils.h"
 #include "sync_prim/Mutex.h"
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <cassert>
 #include <cinttypes>
 #include <cstddef>
+#include <cstring>
 #include <iterator>
 #include <limits>
 #include <memory>
@@ -20,6 +25,12 @@
 #include <type_traits>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #define HT_DEBUG(expr)                                                         \
   do {                                                                         \
     if (Traits::DEBUG) {                                                       \
@@ -38,12 +49,77 @@ struct hashtable_traits_default {
 
   static constexpr LinkType LINEAR_SEARCH_LIMIT =
       std::numeric_limits<LinkType>::max();
+
+  // Use the control byte layout (see `SwissHashTable`), instead of linked
+  // buckets with inline hashes.
+  static constexpr bool CONTROL_BYTES = false;
+
+  // Insert, update and delete claim buckets with CAS on their hash, instead
+  // of taking the chain's lock (see `LinkedHashTable`). Only applies to the
+  // linked layout and to values, which can be swapped atomically, others
+  // still take the chain's lock.
+  static constexpr bool LOCK_FREE = false;
+
+  // Table is rehashed, once tomb stones take TOMB_STONE_PERCENT of it's
+  // buckets, and shrunk, once values take less than MIN_LOAD_PERCENT of them.
+  static constexpr size_t TOMB_STONE_PERCENT = 25;
+  static constexpr size_t MIN_LOAD_PERCENT = 10;
 };
 
 struct hashtable_traits_debug : hashtable_traits_default {
   static constexpr bool DEBUG = true;
 };
 
+// Memory of a concurrent_map (see `concurrent_map::memory_usage`), summed
+// over it's tables (more than one, while a migration is in progress).
+struct hashtable_memory_usage_t {
+  std::size_t num_tables = 0;
+  std::size_t num_buckets = 0;
+  std::size_t num_values = 0;
+  std::size_t num_tomb_stones = 0;
+
+  // Buckets hold keys and values. Links are chain links or control bytes,
+  // and chain locks.
+  std::size_t bucket_bytes = 0;
+  std::size_t link_bytes = 0;
+  // Tables themselves and their per thread stats
+  std::size_t table_bytes = 0;
+  // Of the retired table, kept for reuse by the next migration
+  std::size_t spare_bytes = 0;
+  // Of tables pending reclamation
+  std::size_t retired_bytes = 0;
+
+  std::size_t total_bytes() const {
+    return bucket_bytes + link_bytes + table_bytes + spare_bytes +
+           retired_bytes;
+  }
+
+  hashtable_memory_usage_t &operator+=(const hashtable_memory_usage_t &other) {
+    num_tables += other.num_tables;
+    num_buckets += other.num_buckets;
+    num_values += other.num_values;
+    num_tomb_stones += other.num_tomb_stones;
+    bucket_bytes += other.bucket_bytes;
+    link_bytes += other.link_bytes;
+    table_bytes += other.table_bytes;
+    spare_bytes += other.spare_bytes;
+    retired_bytes += other.retired_bytes;
+    return *this;
+  }
+
+  void dump(std::ostream &ostr) const {
+    ostr << "Num Tables = " << num_tables << "\n";
+    ostr << "Num Buckets = " << num_buckets << "\n";
+    ostr << "Num Values = " << num_values << "\n";
+    ostr << "Num Tomb Stones = " << num_tomb_stones << "\n";
+    ostr << "Bucket Bytes = " << bucket_bytes << "\n";
+    ostr << "Link Bytes = " << link_bytes << "\n";
+    ostr << "Table Bytes = " << table_bytes << "\n";
+    ostr << "Spare Bytes = " << spare_bytes << "\n";
+    ostr << "Retired Bytes = " << retired_bytes << "\n";
+  }
+};
+
 template <typename Key, typename Value, typename Hash = std::hash<Key>,
           typename Traits = hashtable_traits_default>
 class concurrent_map {
@@ -78,20 +154,185 @@ private:
     return static_cast<size_t>(1) << count;
   }
 
-  class HashTable {
+  using KeyValuePair = std::pair<key_type, mapped_type>;
+  using MutexLock = std::unique_lock<sync_prim::mutex::Mutex>;
+
+  static constexpr bool LOCK_FREE =
+      Traits::LOCK_FREE && !Traits::CONTROL_BYTES &&
+      std::is_trivially_copyable_v<mapped_type> &&
+      std::is_default_constructible_v<mapped_type> &&
+      (sizeof(mapped_type) == 1 || sizeof(mapped_type) == 2 ||
+       sizeof(mapped_type) == 4 || sizeof(mapped_type) == 8) &&
+      alignof(mapped_type) == sizeof(mapped_type);
+
+  enum class InsertResult {
+    InsertResult_New,
+    InsertResult_Overflow,
+    // A free bucket is locked by another thread.
+    InsertResult_Busy,
+    // Key was inserted by another thread (lock free mode).
+    InsertResult_Exists,
+    // Chain is being moved to the next table (lock free mode).
+    InsertResult_Migrating,
+  };
+
+  enum class ClaimResult {
+    ClaimResult_Claimed,
+    ClaimResult_Deleted,
+    // Bucket is being moved to the next table.
+    ClaimResult_Moved,
+  };
+
+  // Values of lock free tables are read, while they're written.
+  static mapped_type load_value(const mapped_type &val) {
+    if constexpr (LOCK_FREE) {
+      mapped_type res;
+
+      __atomic_load(&val, &res, __ATOMIC_ACQUIRE);
+      return res;
+    } else {
+      return val;
+    }
+  }
+
+  static void store_value(mapped_type &dst, const mapped_type &val) {
+    if constexpr (LOCK_FREE) {
+      __atomic_store(&dst, &val, __ATOMIC_RELEASE);
+    } else {
+      dst.~mapped_type();
+      new (&dst) mapped_type{val};
+    }
+  }
+
+  // Head of a chain of keys, which are moved together to the next table.
+  // Lock of the chain protects it's keys and the free buckets, it owns.
+  struct ChainHead {
+    // Set, once the chain is moved to the next table.
+    std::atomic<bool> migrated;
+    sync_prim::mutex::Mutex m;
+  };
+
+  // State shared by both bucket layouts (`Table` is the layout).
+  template <typename Table> struct HashTableBase {
+    struct alignas(128) HashTablePerThreadStats {
+      std::atomic<size_t> num_values;
+      std::atomic<size_t> num_tomb_stones;
+    };
+
+    size_t num_buckets;
+    std::unique_ptr<HashTablePerThreadStats[]> stats;
+
+    // Table, this table is being migrated to. Chains are moved in chunks of
+    // MIGRATION_CHUNK_SIZE chains, claimed with `next_chunk`.
+    std::atomic<Table *> next_ht{nullptr};
+    std::atomic<size_t> next_chunk{0};
+    std::atomic<size_t> num_migrated_chunks{0};
+
+    // Map, which recycles the table, once it's retired (see `recycle_table`).
+    concurrent_map *map = nullptr;
+
+    HashTableBase(size_t a_num_buckets)
+        : num_buckets(a_num_buckets),
+          stats(std::make_unique<HashTablePerThreadStats[]>(
+              utils::ThreadRegistry::MAX_THREADS)) {}
+
+    void reset_base() {
+      for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++) {
+        stats[i].num_values.store(0, std::memory_order_relaxed);
+        stats[i].num_tomb_stones.store(0, std::memory_order_relaxed);
+      }
+
+      next_ht.store(nullptr, std::memory_order_relaxed);
+      next_chunk.store(0, std::memory_order_relaxed);
+      num_migrated_chunks.store(0, std::memory_order_relaxed);
+    }
+
+    void increment_num_values() {
+      std::atomic<size_t> &num_values =
+          stats[utils::ThreadRegistry::ThreadID()].num_values;
+
+      num_values.store(num_values.load() + 1, std::memory_order_relaxed);
+    }
+
+    // Returns the number of tomb stones, created by the thread.
+    size_t increment_num_tomb_stones() {
+      std::atomic<size_t> &num_tomb_stones =
+          stats[utils::ThreadRegistry::ThreadID()].num_tomb_stones;
+      size_t num = num_tomb_stones.load() + 1;
+
+      num_tomb_stones.store(num, std::memory_order_relaxed);
+      return num;
+    }
+
+    // Of the table object and it's per thread stats
+    size_t table_bytes() const {
+      return sizeof(Table) + utils::ThreadRegistry::MAX_THREADS *
+                                 sizeof(HashTablePerThreadStats);
+    }
+
+    size_t memory_size() const {
+      const Table &table = static_cast<const Table &>(*this);
+
+      return table_bytes() + table.bucket_bytes() + table.link_bytes();
+    }
+
+    std::pair<size_t, size_t> get_stats() const {
+      size_t num_values = 0;
+      size_t num_tomb_stones = 0;
+
+      for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++) {
+        num_values += stats[i].num_values.load(std::memory_order_relaxed);
+        num_tomb_stones +=
+            stats[i].num_tomb_stones.load(std::memory_order_relaxed);
+      }
+
+      return {num_values, num_tomb_stones};
+    }
+
+    MutexLock lock_chain(size_t hash) {
+      Table &table = static_cast<Table &>(*this);
+
+      return MutexLock{table.chain_head(table.get_chain(hash)).m};
+    }
+
+    bool is_chain_migrated(size_t hash) const {
+      const Table &table = static_cast<const Table &>(*this);
+
+      return table.chain_head(table.get_chain(hash))
+          .migrated.load(std::memory_order_acquire);
+    }
+  };
+
+  // Buckets with inline hashes, where keys of a chain are linked by offsets
+  // from their ideal bucket.
+  //
+  // In lock free mode, a bucket is claimed by CAS of it's hash from
+  // EMPTY_HASH to RESERVED_HASH and published by storing the hash, before
+  // it's appended to the chain by CAS of the chain's tail link from 0. Ideal
+  // bucket is never free, once it's chain is not empty, so that a key is
+  // either in it's ideal bucket or in the chain. Values are written (or
+  // deleted) under WRITING_FLAG of the hash, which is set by CAS, and chains
+  // are frozen (see `freeze_chain`), before they're moved to the next table.
+  class LinkedHashTable : public HashTableBase<LinkedHashTable> {
   public:
     struct HashBucket {
-      using KeyValuePair = std::pair<key_type, mapped_type>;
-
       std::atomic<size_t> hash;
       KeyValuePair key_value;
 
       static constexpr size_t EMPTY_HASH = std::numeric_limits<size_t>::max();
       static constexpr size_t TOMB_STONE_HASH = EMPTY_HASH - 1;
+      // Claimed by an insert, which is yet to publish the hash.
+      static constexpr size_t RESERVED_HASH = EMPTY_HASH - 2;
+
+      // Flags of a published hash, in lock free mode.
+      static constexpr size_t WRITING_FLAG = static_cast<size_t>(1) << 62;
+      static constexpr size_t MOVED_FLAG = static_cast<size_t>(1) << 61;
+      static constexpr size_t HASH_MASK =
+          LOCK_FREE ? MOVED_FLAG - 1 : EMPTY_HASH;
 
       bool is_free() const { return hash == EMPTY_HASH; }
 
-      bool has_value() const { return hash < TOMB_STONE_HASH; }
+      bool has_value() const { return hash < RESERVED_HASH; }
 
       HashBucket(size_t a_hash, const key_type &a_key, const mapped_type &a_val)
           : hash(a_hash), key_value{a_key, a_val} {}
@@ -101,21 +342,15 @@ private:
         this->hash.store(hash, std::memory_order_release);
       }
 
-      mapped_type exchange(const mapped_type &val) {
-        mapped_type oldval = key_value.second;
-
-        this->key_value.second.~mapped_type();
-        new (&key_value.second) mapped_type{val};
-
-        return oldval;
-      }
-
       void mark_as_empty() {
         hash.store(TOMB_STONE_HASH, std::memory_order_release);
       }
 
-      bool equals(size_t hash, const key_type &key) const {
-        return this->hash == hash && key_value.first == key;
+      template <typename K> bool equals(size_t hash, const K &key) const {
+        size_t bucket_hash = this->hash;
+
+        return bucket_hash < RESERVED_HASH &&
+               (bucket_hash & HASH_MASK) == hash && key_value.first == key;
       }
 
       void destroy() {
@@ -126,144 +361,152 @@ private:
       ~HashBucket() { destroy(); }
     };
 
-    struct alignas(128) HashTablePerThreadStats {
-      std::atomic<size_t> num_values;
-      std::atomic<size_t> num_tomb_stones;
-    };
-
-    struct Link {
+    // Keys, whose ideal bucket is this bucket, form a chain starting at the
+    // bucket, followed by buckets linked from `first`.
+    struct Link : ChainHead {
       std::atomic<typename Traits::LinkType> first;
       std::atomic<typename Traits::LinkType> next;
-      sync_prim::mutex::Mutex m;
     };
 
-    size_t num_buckets;
-    std::unique_ptr<HashTablePerThreadStats[]> stats;
+    using LinkType = typename Traits::LinkType;
 
-    std::unique_ptr<uint8_t[]> mem;
-    std::unique_ptr<Link[]> link;
-    HashBucket *buckets;
+    // Tail link of a frozen chain, in lock free mode.
+    static constexpr LinkType FROZEN_LINK = std::numeric_limits<LinkType>::max();
+    static constexpr size_t MAX_LINK =
+        LOCK_FREE ? std::min<size_t>(Traits::LINEAR_SEARCH_LIMIT,
+                                     FROZEN_LINK - 1)
+                  : Traits::LINEAR_SEARCH_LIMIT;
 
-    HashTable(size_t inital_num_buckets)
-        : num_buckets(next_pow_2(inital_num_buckets)),
-          stats(std::make_unique<HashTablePerThreadStats[]>(
-              utils::ThreadRegistry::MAX_THREADS)),
-          mem(std::make_unique<uint8_t[]>(num_buckets * sizeof(HashBucket))),
-          link(std::make_unique<Link[]>(num_buckets)),
-          buckets(reinterpret_cast<HashBucket *>(mem.get())) {
-      init_buckets();
+    static bool is_link(LinkType link) {
+      return link != 0 && !(LOCK_FREE && link == FROZEN_LINK);
     }
 
-    HashTable(HashTable &&ht)
-        : num_buckets(std::move(ht.num_buckets)), stats(std::move(ht.stats)),
-          mem(std::move(ht.mem)), link(std::move(ht.link)),
-          buckets(std::move(ht.buckets)) {}
-
-    HashTable &operator=(HashTable &&ht) {
-      num_buckets = std::move(ht.num_buckets);
-      stats = std::move(ht.stats);
-      mem = std::move(ht.mem);
-      link = std::move(ht.link);
-      buckets = ht.buckets;
-
-      ht.buckets = nullptr;
-      ht.num_buckets = 0;
+    utils::numa::unique_array<uint8_t> mem;
+    utils::numa::unique_array<Link> link;
+    HashBucket *buckets;
 
-      return *this;
+    static size_t round_num_buckets(size_t num_buckets) {
+      return next_pow_2(num_buckets);
     }
 
-    ~HashTable() { destroy_buckets(); }
-
-    void increment_num_values() {
-      std::atomic<size_t> &num_values =
-          stats[utils::ThreadRegistry::ThreadID()].num_values;
-
-      num_values.store(num_values.load() + 1, std::memory_order_relaxed);
+    LinkedHashTable(size_t inital_num_buckets, int numa_node)
+        : HashTableBase<LinkedHashTable>(round_num_buckets(inital_num_buckets)),
+          mem(utils::numa::make_unique_array<uint8_t>(
+              this->num_buckets * sizeof(HashBucket), numa_node)),
+          link(utils::numa::make_unique_array<Link>(this->num_buckets,
+                                                    numa_node)),
+          buckets(reinterpret_cast<HashBucket *>(mem.get())) {
+      init_buckets();
     }
 
-    void increment_num_tomb_stones() {
-      std::atomic<size_t> &num_tomb_stones =
-          stats[utils::ThreadRegistry::ThreadID()].num_tomb_stones;
+    ~LinkedHashTable() { destroy_buckets(); }
 
-      num_tomb_stones.store(num_tomb_stones.load() + 1,
-                            std::memory_order_relaxed);
+    size_t bucket_bytes() const {
+      return this->num_buckets * sizeof(HashBucket);
     }
 
-    std::pair<size_t, size_t> get_stats() const {
-      size_t num_values = 0;
-      size_t num_tomb_stones = 0;
-
-      for (int i = 0; i < utils::ThreadRegistry::MAX_THREADS; i++) {
-        num_values += stats[i].num_values.load(std::memory_order_relaxed);
-        num_tomb_stones +=
-            stats[i].num_tomb_stones.load(std::memory_order_relaxed);
-      }
-
-      return {num_values, num_tomb_stones};
-    }
+    size_t link_bytes() const { return this->num_buckets * sizeof(Link); }
 
     void init_buckets() {
-      std::for_each(buckets, buckets + num_buckets, [](auto &bucket) {
+      std::for_each(buckets, buckets + this->num_buckets, [](auto &bucket) {
         bucket.hash.store(HashBucket::EMPTY_HASH, std::memory_order_relaxed);
       });
     }
 
     void destroy_buckets() {
-      std::for_each(buckets, buckets + num_buckets,
+      std::for_each(buckets, buckets + this->num_buckets,
                     [](auto &bucket) { bucket.destroy(); });
     }
 
-    static size_t get_hash(const key_type &key) {
-      size_t hash = raw_hash(key);
+    // Empties the table, as if it was just constructed.
+    void reset() {
+      destroy_buckets();
+      init_buckets();
+
+      for (size_t chain = 0; chain < num_chains(); chain++) {
+        link[chain].migrated.store(false, std::memory_order_relaxed);
+        link[chain].first.store(0, std::memory_order_relaxed);
+        link[chain].next.store(0, std::memory_order_relaxed);
+      }
+
+      this->reset_base();
+    }
+
+    // Hash of a key, whose raw hash (from `hasher`) is `hash`.
+    static size_t get_hash(size_t hash) {
+      hash &= HashBucket::HASH_MASK;
 
-      return hash < HashBucket::TOMB_STONE_HASH ? hash : 0;
+      return hash < HashBucket::RESERVED_HASH ? hash : 0;
     }
 
     size_t get_ideal_bucket(size_t hash) const {
-      return hash & (num_buckets - 1);
+      return hash & (this->num_buckets - 1);
     }
 
     size_t add_bucket_circular(size_t bucket, size_t link) const {
-      return (bucket + link) & (num_buckets - 1);
+      return (bucket + link) & (this->num_buckets - 1);
     }
 
+    size_t num_chains() const { return this->num_buckets; }
+
+    size_t get_chain(size_t hash) const { return get_ideal_bucket(hash); }
+
+    ChainHead &chain_head(size_t chain) { return link[chain]; }
+
+    const ChainHead &chain_head(size_t chain) const { return link[chain]; }
+
     struct SearchResult {
       size_t hash;
       size_t bucket;
       std::atomic<typename Traits::LinkType> *link;
     };
 
-    std::pair<bool, SearchResult> search(const key_type &key) const {
+    void prefetch_bucket(size_t hash) const {
+      size_t bucket = get_ideal_bucket(hash);
+
+      utils::prefetch(std::addressof(buckets[bucket]));
+      utils::prefetch(std::addressof(link[bucket]));
+    }
+
+    template <typename K>
+    std::pair<bool, SearchResult> search(const K &key, size_t hash) const {
       SearchResult sres;
 
-      sres.hash = get_hash(key);
+      sres.hash = hash;
       sres.bucket = get_ideal_bucket(sres.hash);
       sres.link = std::addressof(link[sres.bucket].first);
 
       if (buckets[sres.bucket].equals(sres.hash, key))
         return {true, sres};
 
-      if (*sres.link) {
-        do {
-          sres.bucket = add_bucket_circular(sres.bucket, *sres.link);
-          sres.link = std::addressof(link[sres.bucket].next);
-
-          if (buckets[sres.bucket].equals(sres.hash, key))
-            return {true, sres};
-        } while (*sres.link);
+      for (LinkType l = *sres.link; is_link(l); l = *sres.link) {
+        sres.bucket = add_bucket_circular(sres.bucket, l);
+        sres.link = std::addressof(link[sres.bucket].next);
 
-        return {false, sres};
+        if (buckets[sres.bucket].equals(sres.hash, key))
+          return {true, sres};
       }
 
       return {false, sres};
     }
 
+    KeyValuePair &key_value(SearchResult sres) {
+      return buckets[sres.bucket].key_value;
+    }
+
+    const KeyValuePair &key_value(SearchResult sres) const {
+      return buckets[sres.bucket].key_value;
+    }
+
+    // Chain's lock must be held.
+    void erase(SearchResult sres) { buckets[sres.bucket].mark_as_empty(); }
+
     std::optional<typename Traits::LinkType>
     get_bucket_to_insert(SearchResult sres) const {
       size_t bucket = sres.bucket;
 
       for (size_t link = 0;
-           link <= Traits::LINEAR_SEARCH_LIMIT && link < num_buckets;
+           link <= MAX_LINK && link < this->num_buckets;
            link++, bucket = add_bucket_circular(sres.bucket, link)) {
         if (buckets[bucket].is_free())
           return {link};
@@ -272,309 +515,1266 @@ private:
       return std::nullopt;
     }
 
-    enum class InsertResult {
-      InsertResult_New,
-      InsertResult_AlreadyPresent,
-      InsertResult_Overflow,
-    };
-
-    using MutexLock = std::unique_lock<sync_prim::mutex::Mutex>;
+    // Inserts a missing key at the end of it's chain, `sres` (from `search`).
+    // Chain's lock must be held.
+    InsertResult insert(SearchResult sres, const key_type &key,
+                        const mapped_type &val) {
+      size_t ideal_bucket = get_ideal_bucket(sres.hash);
 
-    struct InsertSearchResult {
-      InsertResult res;
-      MutexLock lock;
-      typename Traits::LinkType bucket_link;
-      SearchResult sres;
-    };
+      while (auto bucket_link = get_bucket_to_insert(sres)) {
+        size_t bucket = add_bucket_circular(sres.bucket, *bucket_link);
+        MutexLock lock;
 
-    InsertSearchResult insert(const key_type &key) {
-      bool found;
-      SearchResult sres;
+        // Free buckets could be claimed by other chains as well.
+        if (bucket != ideal_bucket) {
+          lock = MutexLock{link[bucket].m, std::try_to_lock};
 
-      while (true) {
-        std::tie(found, sres) = search(key);
+          if (!lock)
+            return InsertResult::InsertResult_Busy;
+        }
 
-        if (found) {
-          MutexLock lock{link[sres.bucket].m};
+        if (buckets[bucket].is_free()) {
+          buckets[bucket].emplace(sres.hash, key, val);
+          sres.link->store(*bucket_link, std::memory_order_release);
+          this->increment_num_values();
 
-          if (buckets[sres.bucket].has_value()) {
-            return {InsertResult::InsertResult_AlreadyPresent, std::move(lock),
-                    0, sres};
-          } else {
-            continue;
-          }
+          return InsertResult::InsertResult_New;
         }
+      }
+
+      return InsertResult::InsertResult_Overflow;
+    }
 
-        if (auto bucket_link = get_bucket_to_insert(sres)) {
-          sres.bucket = add_bucket_circular(sres.bucket, *bucket_link);
+    // Calls `fn(hash, key_value)` for every value of `chain`.
+    // Chain's lock must be held.
+    template <typename Fn> void for_each_in_chain(size_t chain, Fn &&fn) {
+      // Ideal bucket could have a key of another chain.
+      if (buckets[chain].has_value() &&
+          get_ideal_bucket(buckets[chain].hash) == chain)
+        fn(buckets[chain].hash & HashBucket::HASH_MASK,
+           buckets[chain].key_value);
+
+      for (size_t b = chain, l = link[chain].first; is_link(l);
+           l = link[b].next) {
+        b = add_bucket_circular(b, l);
+
+        if (buckets[b].has_value())
+          fn(buckets[b].hash & HashBucket::HASH_MASK, buckets[b].key_value);
+      }
+    }
 
-          MutexLock lock{link[sres.bucket].m};
+    // Lock free mode.
 
-          if (buckets[sres.bucket].is_free()) {
-            increment_num_values();
+    // Sets WRITING_FLAG of the published `bucket`, once it's not being
+    // written, and returns it's hash. Writer must publish the new hash.
+    std::pair<ClaimResult, size_t> claim_bucket(size_t bucket) {
+      std::atomic<size_t> &bucket_hash = buckets[bucket].hash;
 
-            return {InsertResult::InsertResult_New, std::move(lock),
-                    *bucket_link, sres};
-          } else {
-            continue;
-          }
-        } else {
-          return {InsertResult::InsertResult_Overflow, {}, 0, sres};
+      while (true) {
+        size_t hash = bucket_hash.load(std::memory_order_acquire);
+
+        if (hash >= HashBucket::RESERVED_HASH)
+          return {ClaimResult::ClaimResult_Deleted, hash};
+
+        if (hash & HashBucket::MOVED_FLAG)
+          return {ClaimResult::ClaimResult_Moved, hash};
+
+        if (hash & HashBucket::WRITING_FLAG) {
+          utils::cpu_relax();
+        } else if (bucket_hash.compare_exchange_weak(
+                       hash, hash | HashBucket::WRITING_FLAG,
+                       std::memory_order_acquire)) {
+          return {ClaimResult::ClaimResult_Claimed, hash};
         }
-      };
+      }
     }
-  };
 
-  std::atomic<HashTable *> ht;
-  std::atomic<bool> is_migration_in_progress;
-  sync_prim::mutex::Mutex migration_mutex;
-  std::atomic<int> num_migrations;
+    void publish_bucket(size_t bucket, size_t hash) {
+      buckets[bucket].hash.store(hash, std::memory_order_release);
+    }
 
-  indexes::utils::EpochManager<uint64_t, void> m_gc;
+    // Frees a bucket, which was published, but not appended to the chain.
+    void abandon_bucket(size_t bucket) {
+      publish_bucket(bucket, HashBucket::TOMB_STONE_HASH);
+      buckets[bucket].key_value.~KeyValuePair();
+    }
 
-  struct EpochGuard {
-    concurrent_map *map;
+    // Inserts a missing key at the end of it's chain, `sres` (from `search`).
+    InsertResult insert_lock_free(SearchResult sres, const key_type &key,
+                                  const mapped_type &val) {
+      size_t ideal_bucket = get_ideal_bucket(sres.hash);
 
-    EpochGuard(concurrent_map *a_map) : map(a_map) { map->m_gc.enter_epoch(); }
+      // Key could be being inserted into it's ideal bucket.
+      auto is_ideal_busy = [&] {
+        return sres.bucket == ideal_bucket &&
+               buckets[ideal_bucket].hash == HashBucket::RESERVED_HASH;
+      };
 
-    ~EpochGuard() { map->m_gc.exit_epoch(); }
-  };
+      if (is_ideal_busy())
+        return InsertResult::InsertResult_Busy;
 
-  static void insert_key_val_into_ht(HashTable &ht,
-                                     typename HashTable::SearchResult &sres,
-                                     typename Traits::LinkType bucket_link,
-                                     const key_type &key,
-                                     const mapped_type &val) {
-    ht.buckets[sres.bucket].emplace(sres.hash, key, val);
-    sres.link->store(bucket_link, std::memory_order_release);
-  }
+      while (auto bucket_link = get_bucket_to_insert(sres)) {
+        size_t bucket = add_bucket_circular(sres.bucket, *bucket_link);
+        size_t free_hash = HashBucket::EMPTY_HASH;
 
-  bool try_migrate_table(size_t new_num_buckets) {
-    auto *new_ht = new HashTable{new_num_buckets};
-    auto *old_ht = ht.load();
-    size_t old_num_buckets = old_ht->num_buckets;
+        // Only the (free) ideal bucket is at link 0.
+        if (!buckets[bucket].hash.compare_exchange_strong(
+                free_hash, HashBucket::RESERVED_HASH)) {
+          if (*bucket_link == 0)
+            return InsertResult::InsertResult_Busy;
 
-    for (size_t bucket = 0; bucket < old_num_buckets; bucket++) {
-      auto &old_bucket = old_ht->buckets[bucket];
-      auto &link = old_ht->link[bucket];
-      auto bucket_lock = std::lock_guard<sync_prim::mutex::Mutex>{link.m};
+          continue;
+        }
 
-      if (old_bucket.has_value()) {
-        auto ires = new_ht->insert(old_bucket.key_value.first);
+        new (&buckets[bucket].key_value) KeyValuePair{key, val};
+        publish_bucket(bucket, sres.hash);
 
-        HT_DEBUG_ASSERT(ires.res !=
-                        HashTable::InsertResult::InsertResult_AlreadyPresent);
+        if (*bucket_link == 0) {
+          this->increment_num_values();
+          return InsertResult::InsertResult_New;
+        }
 
-        if (ires.res == HashTable::InsertResult::InsertResult_Overflow)
-          return false;
+        // Ideal bucket, seen taken, could have been claimed by an insert of
+        // the key, since it was searched.
+        if (is_ideal_busy() || (sres.bucket == ideal_bucket &&
+                                buckets[ideal_bucket].equals(sres.hash, key))) {
+          abandon_bucket(bucket);
+          return InsertResult::InsertResult_Busy;
+        }
 
-        insert_key_val_into_ht(*new_ht, ires.sres, ires.bucket_link,
-                               old_bucket.key_value.first,
-                               old_bucket.key_value.second);
+        return append_bucket(sres, bucket, key);
       }
+
+      return InsertResult::InsertResult_Overflow;
     }
 
-    ht.store(new_ht);
-    m_gc.retire_in_new_epoch(
-        [&](void *ptr) { delete reinterpret_cast<HashTable *>(ptr); },
-        reinterpret_cast<void *>(old_ht));
+    // Appends the published `bucket` to the chain, whose tail was `sres`,
+    // after the keys appended since.
+    InsertResult append_bucket(SearchResult sres, size_t bucket,
+                               const key_type &key) {
+      while (true) {
+        size_t offset = (bucket - sres.bucket) & (this->num_buckets - 1);
+        LinkType l = 0;
+
+        if (offset <= MAX_LINK) {
+          if (sres.link->compare_exchange_strong(
+                  l, static_cast<LinkType>(offset),
+                  std::memory_order_release)) {
+            this->increment_num_values();
+            return InsertResult::InsertResult_New;
+          }
+        } else {
+          l = sres.link->load();
+        }
+
+        if (!is_link(l)) {
+          abandon_bucket(bucket);
 
-    return true;
-  }
+          // Tail is too far from the bucket, when `l` is 0.
+          return l ? InsertResult::InsertResult_Migrating
+                   : InsertResult::InsertResult_Busy;
+        }
 
-  void wait_for_migration_to_end() {
-    std::lock_guard<sync_prim::mutex::Mutex> migration_lock{migration_mutex};
-  }
+        sres.bucket = add_bucket_circular(sres.bucket, l);
+        sres.link = std::addressof(link[sres.bucket].next);
 
-  void migrate_table(size_t new_num_buckets = 0) {
-    typename HashTable::MutexLock migration_lock{migration_mutex,
-                                                 std::try_to_lock};
+        if (buckets[sres.bucket].equals(sres.hash, key)) {
+          abandon_bucket(bucket);
+          return InsertResult::InsertResult_Exists;
+        }
+      }
+    }
 
-    if (migration_lock) {
-      is_migration_in_progress = true;
+    // Stops inserts into `chain` and writes to it's values, so that it can be
+    // moved. Chain's lock must be held.
+    void freeze_chain(size_t chain) {
+      std::atomic<LinkType> *tail = std::addressof(link[chain].first);
 
-      if (new_num_buckets == 0)
-        new_num_buckets = size() * 2;
+      for (size_t bucket = chain;;) {
+        LinkType l = 0;
 
-      new_num_buckets = next_pow_2(new_num_buckets);
+        if (tail->compare_exchange_strong(l, FROZEN_LINK))
+          break;
 
-      while (!try_migrate_table(new_num_buckets)) {
-        new_num_buckets *= 2;
+        bucket = add_bucket_circular(bucket, l);
+        tail = std::addressof(link[bucket].next);
       }
 
-      is_migration_in_progress = false;
-
-      num_migrations++;
-    } else {
-      wait_for_migration_to_end();
-    }
-  }
+      // Keys are inserted into a free ideal bucket, even if the chain is
+      // frozen.
+      std::atomic<size_t> &ideal_hash = buckets[chain].hash;
 
-public:
-  static constexpr size_t MINIMUM_CAPACITY = 4;
+      while (true) {
+        size_t hash = ideal_hash.load(std::memory_order_acquire);
+
+        if (hash == HashBucket::RESERVED_HASH) {
+          utils::cpu_relax();
+        } else if (hash == HashBucket::EMPTY_HASH) {
+          if (ideal_hash.compare_exchange_weak(hash,
+                                               HashBucket::TOMB_STONE_HASH))
+            break;
+        } else {
+          if (hash != HashBucket::TOMB_STONE_HASH &&
+              get_ideal_bucket(hash) == chain)
+            freeze_bucket(chain);
 
-  concurrent_map(size_t initial_capacity = MINIMUM_CAPACITY)
-      : ht(new HashTable(std::max(initial_capacity, MINIMUM_CAPACITY))),
-        is_migration_in_progress(false), migration_mutex(), num_migrations(0) {}
+          break;
+        }
+      }
 
-  concurrent_map(concurrent_map &&o_map)
-      : ht(o_map.ht.load()), is_migration_in_progress(false), migration_mutex(),
-        num_migrations(0) {
-    o_map.ht.store(nullptr);
-  }
+      for (size_t b = chain, l = link[chain].first; is_link(l);
+           l = link[b].next) {
+        b = add_bucket_circular(b, l);
+        freeze_bucket(b);
+      }
+    }
 
-  void reserve(size_t num_values) { migrate_table(num_values * 2); }
+    void freeze_bucket(size_t bucket) {
+      auto [res, hash] = claim_bucket(bucket);
 
-  std::optional<mapped_type> Search(const key_type &key) {
-    EpochGuard eg{this};
-    HashTable &ht = *this->ht.load();
-    auto [found, sres] = ht.search(key);
-    std::optional<mapped_type> val{std::nullopt};
+      if (res == ClaimResult::ClaimResult_Claimed)
+        publish_bucket(bucket, hash | HashBucket::MOVED_FLAG);
+    }
+  };
 
-    if (found)
-      val = ht.buckets[sres.bucket].key_value.second;
+  // SwissTable like layout. A dense array of control bytes, one per slot,
+  // holds 7 bits of the slot's hash (or EMPTY_CTRL / DELETED_CTRL), so that a
+  // group of GROUP_SIZE slots is probed with a single SIMD compare, and
+  // slots (hash and key value) are only read for matching tags. Keys of a
+  // chain (same ideal group) are in the first group, having a free slot
+  // when they were inserted. As control bytes are never reset to
+  // EMPTY_CTRL, probing stops at the first group having a free slot.
+  class SwissHashTable : public HashTableBase<SwissHashTable> {
+  public:
+    static constexpr size_t GROUP_SIZE = 16;
+    static constexpr uint8_t EMPTY_CTRL = 0x80;
+    static constexpr uint8_t DELETED_CTRL = 0xFE;
+    static constexpr size_t MAX_PROBE_GROUPS =
+        (static_cast<size_t>(Traits::LINEAR_SEARCH_LIMIT) + 1) / GROUP_SIZE;
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "Control bytes are packed into atomic words");
+    static_assert(MAX_PROBE_GROUPS > 0, "LINEAR_SEARCH_LIMIT is too small");
+
+    // Control bytes of a group, packed into words. Readers load whole words
+    // (a group in one or two loads), so that every access to control bytes
+    // is atomic and of the same width. A byte is changed with a CAS of it's
+    // word, as bytes of a group could be changed concurrently by different
+    // chains (under their own locks), although a slot's byte is only ever
+    // changed by the chain owning the slot.
+    struct alignas(GROUP_SIZE) CtrlGroup {
+      static constexpr size_t WORD_SIZE = sizeof(uint64_t);
+      static constexpr size_t NUM_WORDS = GROUP_SIZE / WORD_SIZE;
+
+      std::atomic<uint64_t> words[NUM_WORDS];
+
+      // Bytes in their order in memory (slot 0 in the lowest byte), whatever
+      // the byte order.
+      uint64_t load_word(size_t i) const {
+        uint64_t word = words[i].load(std::memory_order_acquire);
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+
+        return word;
+      }
 
-    return val;
-  }
+      uint8_t get(size_t slot) const {
+        uint64_t word = words[slot / WORD_SIZE].load(std::memory_order_acquire);
+        uint8_t bytes[WORD_SIZE];
 
-  bool Insert(const key_type &key, const mapped_type &val) {
-    while (true) {
-      EpochGuard eg{this};
-      HashTable &ht = *this->ht.load();
-      auto ires = ht.insert(key);
+        std::memcpy(bytes, &word, sizeof(word));
+        return bytes[slot % WORD_SIZE];
+      }
 
-      if (is_migration_in_progress) {
-        if (ires.lock)
-          ires.lock.unlock();
+      // Publishes (release) the byte of `slot`.
+      void set(size_t slot, uint8_t c) {
+        std::atomic<uint64_t> &word = words[slot / WORD_SIZE];
+        uint64_t old = word.load(std::memory_order_relaxed);
+        uint64_t val;
 
-        wait_for_migration_to_end();
-        continue;
+        do {
+          uint8_t bytes[WORD_SIZE];
+
+          std::memcpy(bytes, &old, sizeof(old));
+          bytes[slot % WORD_SIZE] = c;
+          std::memcpy(&val, bytes, sizeof(val));
+        } while (!word.compare_exchange_weak(old, val,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
       }
 
-      if (ires.res == HashTable::InsertResult::InsertResult_New) {
-        insert_key_val_into_ht(ht, ires.sres, ires.bucket_link, key, val);
-        return true;
+      // Before the table is published.
+      void fill(uint8_t c) {
+        for (auto &word : words)
+          word.store(uint64_t{c} * 0x0101010101010101ULL,
+                     std::memory_order_relaxed);
       }
+    };
+
+    struct Slot {
+      size_t hash;
+      KeyValuePair key_value;
+    };
 
-      if (ires.res == HashTable::InsertResult::InsertResult_AlreadyPresent)
-        return false;
+    utils::numa::unique_array<CtrlGroup> ctrl;
+    utils::numa::unique_array<ChainHead> groups;
+    utils::numa::unique_array<uint8_t> mem;
+    Slot *slots;
 
-      break;
+    static size_t round_num_buckets(size_t num_buckets) {
+      return std::max(next_pow_2(num_buckets), GROUP_SIZE);
     }
 
-    migrate_table();
+    SwissHashTable(size_t inital_num_buckets, int numa_node)
+        : HashTableBase<SwissHashTable>(round_num_buckets(inital_num_buckets)),
+          ctrl(utils::numa::make_unique_array<CtrlGroup>(num_chains(),
+                                                         numa_node)),
+          groups(utils::numa::make_unique_array<ChainHead>(num_chains(),
+                                                           numa_node)),
+          mem(utils::numa::make_unique_array<uint8_t>(
+              this->num_buckets * sizeof(Slot), numa_node)),
+          slots(reinterpret_cast<Slot *>(mem.get())) {
+      init_slots();
+    }
 
-    return Insert(key, val);
-  }
+    ~SwissHashTable() { destroy_slots(); }
 
-  std::optional<mapped_type> Upsert(const key_type &key,
-                                    const mapped_type &val) {
-    while (true) {
-      std::optional<mapped_type> oldval{std::nullopt};
-      EpochGuard eg{this};
-      HashTable &ht = *this->ht.load();
-      auto ires = ht.insert(key);
+    // Empties the table, as if it was just constructed.
+    void reset() {
+      destroy_slots();
+      init_slots();
 
-      if (is_migration_in_progress) {
-        if (ires.lock)
-          ires.lock.unlock();
+      for (size_t group = 0; group < num_chains(); group++)
+        groups[group].migrated.store(false, std::memory_order_relaxed);
 
-        wait_for_migration_to_end();
-        continue;
-      }
+      this->reset_base();
+    }
 
-      if (ires.res == HashTable::InsertResult::InsertResult_New) {
-        insert_key_val_into_ht(ht, ires.sres, ires.bucket_link, key, val);
-        return oldval;
-      }
+    void init_slots() {
+      for (size_t group = 0; group < num_chains(); group++)
+        ctrl[group].fill(EMPTY_CTRL);
+    }
 
-      if (ires.res == HashTable::InsertResult::InsertResult_AlreadyPresent) {
-        oldval = ht.buckets[ires.sres.bucket].exchange(val);
-        return oldval;
+    // Deleted slots keep their key value, as lookups could still read them.
+    void destroy_slots() {
+      for (size_t slot = 0; slot < this->num_buckets; slot++) {
+        if (get_ctrl(slot) != EMPTY_CTRL)
+          slots[slot].key_value.~KeyValuePair();
       }
+    }
 
-      break;
+    // Hash of a key, whose raw hash (from `hasher`) is `hash`. Hash is mixed
+    // (multiply-xorshift), as hashers like std::hash of integers are the
+    // identity, which would put runs of 128 keys into the same group and tag
+    // bits, overflowing their probe sequence however large the table is.
+    static size_t get_hash(size_t hash) {
+      uint64_t mixed = uint64_t{hash} * 0x9E3779B97F4A7C15ULL;
+
+      return mixed ^ (mixed >> 32);
     }
 
-    migrate_table();
+    static uint8_t get_tag(size_t hash) { return hash & 0x7F; }
 
-    return Upsert(key, val);
-  }
+    static bool is_full(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
 
-  std::optional<mapped_type> Update(const key_type &key,
-                                    const mapped_type &val) {
-    std::optional<mapped_type> oldval{std::nullopt};
+    uint8_t get_ctrl(size_t slot) const {
+      return ctrl[slot / GROUP_SIZE].get(slot % GROUP_SIZE);
+    }
 
-    while (true) {
-      EpochGuard eg{this};
-      HashTable &ht = *this->ht.load();
-      auto [found, sres] = ht.search(key);
+    void set_ctrl(size_t slot, uint8_t c) {
+      ctrl[slot / GROUP_SIZE].set(slot % GROUP_SIZE, c);
+    }
 
-      if (found) {
-        typename HashTable::MutexLock lock{ht.link[sres.bucket].m};
+    size_t num_chains() const { return this->num_buckets / GROUP_SIZE; }
 
-        if (is_migration_in_progress) {
-          lock.unlock();
-          wait_for_migration_to_end();
-          continue;
-        }
+    size_t bucket_bytes() const { return this->num_buckets * sizeof(Slot); }
 
-        if (ht.buckets[sres.bucket].has_value())
-          oldval = ht.buckets[sres.bucket].exchange(val);
-        else
-          continue;
-      }
+    size_t link_bytes() const {
+      return num_chains() * (sizeof(CtrlGroup) + sizeof(ChainHead));
+    }
 
-      return oldval;
+    size_t get_chain(size_t hash) const {
+      return (hash >> 7) & (num_chains() - 1);
     }
-  }
 
-  std::optional<mapped_type> Delete(const key_type &key) {
-    std::optional<mapped_type> val{std::nullopt};
+    size_t next_group(size_t group) const {
+      return (group + 1) & (num_chains() - 1);
+    }
 
-    while (true) {
-      EpochGuard eg{this};
-      HashTable &ht = *this->ht.load();
-      auto [found, sres] = ht.search(key);
+    size_t max_probe_groups() const {
+      return std::min(MAX_PROBE_GROUPS, num_chains());
+    }
 
-      if (found) {
-        auto &bucket = ht.buckets[sres.bucket];
+    ChainHead &chain_head(size_t chain) { return groups[chain]; }
 
-        typename HashTable::MutexLock lock{ht.link[sres.bucket].m};
+    const ChainHead &chain_head(size_t chain) const { return groups[chain]; }
 
-        if (is_migration_in_progress) {
-          lock.unlock();
-          wait_for_migration_to_end();
-          continue;
+    // Mask of slots of `group`, whose control byte is `c` and the number of
+    // mask bits per slot. Words of the group are acquired, synchronizing
+    // with the publishing stores of their bytes.
+#if defined(__SSE2__)
+    std::pair<uint64_t, int> match_ctrl(size_t group, uint8_t c) const {
+      __m128i ctrlvec = _mm_set_epi64x(ctrl[group].load_word(1),
+                                       ctrl[group].load_word(0));
+      __m128i cmp = _mm_cmpeq_epi8(ctrlvec, _mm_set1_epi8(c));
+
+      return {static_cast<uint64_t>(_mm_movemask_epi8(cmp)), 1};
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // No movemask in NEON, narrowing the 16 bit lanes of the comparison by 4
+    // bits, leaves a 64 bit mask with 4 bits per slot.
+    std::pair<uint64_t, int> match_ctrl(size_t group, uint8_t c) const {
+      uint8x16_t ctrlvec = vreinterpretq_u8_u64(
+          vcombine_u64(vcreate_u64(ctrl[group].load_word(0)),
+                       vcreate_u64(ctrl[group].load_word(1))));
+      uint8x16_t cmp = vceqq_u8(ctrlvec, vdupq_n_u8(c));
+      uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+      uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+
+      return {mask & 0x1111111111111111, 4};
+    }
+#else
+    std::pair<uint64_t, int> match_ctrl(size_t group, uint8_t c) const {
+      uint64_t mask = 0;
+
+      for (size_t i = 0; i < GROUP_SIZE; i++) {
+        if (ctrl[group].get(i) == c)
+          mask |= uint64_t{1} << i;
+      }
+
+      return {mask, 1};
+    }
+#endif
+
+    struct SearchResult {
+      size_t hash;
+      size_t slot;
+    };
+
+    void prefetch_bucket(size_t hash) const {
+      utils::prefetch(std::addressof(ctrl[get_chain(hash)]));
+    }
+
+    template <typename K>
+    std::pair<bool, SearchResult> search(const K &key, size_t hash) const {
+      uint8_t tag = get_tag(hash);
+      size_t group = get_chain(hash);
+
+      for (size_t probe = 0; probe < max_probe_groups();
+           probe++, group = next_group(group)) {
+        for (auto [mask, stride] = match_ctrl(group, tag); mask;
+             mask &= mask - 1) {
+          size_t slot =
+              group * GROUP_SIZE + utils::trailing_zeroes(mask) / stride;
+
+          if (slots[slot].hash == hash && slots[slot].key_value.first == key)
+            return {true, {hash, slot}};
         }
 
-        if (bucket.has_value()) {
-          val = bucket.key_value.second;
+        if (match_ctrl(group, EMPTY_CTRL).first)
+          break;
+      }
+
+      return {false, {hash, 0}};
+    }
 
-          bucket.mark_as_empty();
-          ht.increment_num_tomb_stones();
+    KeyValuePair &key_value(SearchResult sres) {
+      return slots[sres.slot].key_value;
+    }
 
-          m_gc.retire_in_new_epoch(
-              [&](void *ptr) {
-                reinterpret_cast<typename HashTable::HashBucket *>(ptr)
-                    ->destroy();
-              },
-              reinterpret_cast<void *>(&bucket));
-        } else {
+    const KeyValuePair &key_value(SearchResult sres) const {
+      return slots[sres.slot].key_value;
+    }
+
+    // Chain's lock must be held.
+    void erase(SearchResult sres) {
+      set_ctrl(sres.slot, DELETED_CTRL);
+    }
+
+    // Inserts a missing key into the first group, having a free slot.
+    // Chain's lock must be held.
+    InsertResult insert(SearchResult sres, const key_type &key,
+                        const mapped_type &val) {
+      size_t ideal_group = get_chain(sres.hash);
+      size_t group = ideal_group;
+
+      for (size_t probe = 0; probe < max_probe_groups();
+           probe++, group = next_group(group)) {
+        if (!match_ctrl(group, EMPTY_CTRL).first)
           continue;
+
+        MutexLock lock;
+
+        // Free slots of a group are owned by the group's chain.
+        if (group != ideal_group) {
+          lock = MutexLock{groups[group].m, std::try_to_lock};
+
+          if (!lock)
+            return InsertResult::InsertResult_Busy;
+        }
+
+        // Group could be filled, before it was locked.
+        if (auto [mask, stride] = match_ctrl(group, EMPTY_CTRL); mask) {
+          size_t slot =
+              group * GROUP_SIZE + utils::trailing_zeroes(mask) / stride;
+
+          slots[slot].hash = sres.hash;
+          new (&slots[slot].key_value) KeyValuePair{key, val};
+          set_ctrl(slot, get_tag(sres.hash));
+          this->increment_num_values();
+
+          return InsertResult::InsertResult_New;
         }
       }
 
+      return InsertResult::InsertResult_Overflow;
+    }
+
+    // Calls `fn(hash, key_value)` for every value of `chain`.
+    // Chain's lock must be held.
+    template <typename Fn> void for_each_in_chain(size_t chain, Fn &&fn) {
+      size_t group = chain;
+
+      for (size_t probe = 0; probe < max_probe_groups();
+           probe++, group = next_group(group)) {
+        for (size_t slot = group * GROUP_SIZE;
+             slot < (group + 1) * GROUP_SIZE; slot++) {
+          if (is_full(get_ctrl(slot)) &&
+              get_chain(slots[slot].hash) == chain)
+            fn(slots[slot].hash, slots[slot].key_value);
+        }
+
+        if (match_ctrl(group, EMPTY_CTRL).first)
+          break;
+      }
+    }
+  };
+
+  using HashTable = std::conditional_t<Traits::CONTROL_BYTES, SwissHashTable,
+                                       LinkedHashTable>;
+
+  // Oldest table, which could be migrating (see `next_ht`) to newer tables.
+  std::atomic<HashTable *> ht;
+  sync_prim::mutex::Mutex migration_mutex;
+  std::atomic<int> num_migrations;
+  // Node, bucket memory of tables is placed on (or -1, see `utils::numa`).
+  const int numa_node;
+  // Emptied table retired by the last rehash or shrink, reused by the next
+  // migration to a table of the same size (Ex: rehashing tomb stones, growing
+  // back after a shrink), instead of allocating (and placing) it's buckets
+  // again.
+  std::atomic<HashTable *> spare_table{nullptr};
+
+  // Only tables are retired.
+  indexes::utils::EpochManager<uint64_t, void> m_gc{[](void *table) {
+    return reinterpret_cast<HashTable *>(table)->memory_size();
+  }};
+
+  struct EpochGuard {
+    concurrent_map *map;
+
+    EpochGuard(concurrent_map *a_map) : map(a_map) { map->m_gc.enter_epoch(); }
+
+    ~EpochGuard() { map->m_gc.exit_epoch(); }
+  };
+
+  // Updates a value in place with `fn(mapped_type &)`, under bucket's lock.
+  // A missing value is default constructed, before `fn` is applied to it.
+  template <typename Fn> struct value_updater_t { Fn &fn; };
+
+  template <typename Fn>
+  static constexpr bool is_updater_v = std::is_invocable_v<Fn &, mapped_type &>;
+
+  static const mapped_type &new_value(const mapped_type &val) { return val; }
+
+  template <typename Fn>
+  static mapped_type new_value(const value_updater_t<Fn> &updater) {
+    mapped_type val{};
+
+    updater.fn(val);
+    return val;
+  }
+
+  // Bucket's lock must be held (or the bucket claimed, in lock free mode).
+  static mapped_type exchange_value(KeyValuePair &key_value,
+                                    const mapped_type &val) {
+    mapped_type oldval = key_value.second;
+
+    store_value(key_value.second, val);
+    return oldval;
+  }
+
+  // Bucket's lock must be held (or the bucket claimed, in lock free mode).
+  template <typename Fn>
+  static mapped_type exchange_value(KeyValuePair &key_value,
+                                    const value_updater_t<Fn> &updater) {
+    mapped_type oldval = key_value.second;
+
+    if constexpr (LOCK_FREE) {
+      mapped_type val = oldval;
+
+      updater.fn(val);
+      store_value(key_value.second, val);
+    } else {
+      updater.fn(key_value.second);
+    }
+
+    return oldval;
+  }
+
+  // Tables are resized incrementally. New table is published as `next_ht`
+  // of the table being migrated, and chains of keys are moved, one at a
+  // time under their lock, in chunks claimed by writers (`help_migration`)
+  // or by a writer of the chain itself (`lock_chain`). Lookups consult tables
+  // in order, until the one having the key's chain. Once all chunks are
+  // moved, the new table replaces the old one.
+  static constexpr size_t MIGRATION_CHUNK_SIZE = 1024;
+
+  // Starts migrating `table`, which must be the newest table.
+  void start_migration(HashTable *table, size_t new_num_buckets = 0) {
+    std::lock_guard<sync_prim::mutex::Mutex> migration_lock{migration_mutex};
+
+    if (table->next_ht.load(std::memory_order_acquire))
+      return;
+
+    if (new_num_buckets == 0) {
+      auto [num_values, num_tomb_stones] = table->get_stats();
+
+      HT_DEBUG_ONLY(num_tomb_stones);
+
+      new_num_buckets = next_pow_2(std::max(size() * 2, MINIMUM_CAPACITY));
+
+      // Table overflowed because of clustering instead of tomb stones.
+      if (new_num_buckets <= table->num_buckets &&
+          num_values * 2 < table->num_buckets)
+        new_num_buckets = table->num_buckets * 2;
+    }
+
+    table->next_ht.store(new_table(new_num_buckets),
+                         std::memory_order_release);
+  }
+
+  // Migration mutex must be held.
+  HashTable *new_table(size_t num_buckets) {
+    HashTable *table = spare_table.exchange(nullptr);
+
+    if (table &&
+        table->num_buckets == HashTable::round_num_buckets(num_buckets))
+      return table;
+
+    delete table;
+    table = new HashTable{num_buckets, numa_node};
+    table->map = this;
+
+    return table;
+  }
+
+  // Reclaimer of tables retired by a rehash or shrink, which are emptied and
+  // kept as the spare table of their map.
+  static void recycle_table(void *ptr) {
+    HashTable *table = reinterpret_cast<HashTable *>(ptr);
+
+    table->reset();
+    delete table->map->spare_table.exchange(table);
+  }
+
+  // Reclaimer of tables retired by a grow, which no later migration of the
+  // (growing) map is likely to reuse.
+  static void free_table(void *ptr) {
+    delete reinterpret_cast<HashTable *>(ptr);
+  }
+
+  // Rehashes `table`, once deletes left too many tomb stones in it, or
+  // shrinks it, once it's mostly free, by migrating it to a table sized for
+  // it's values. Checked every COMPACTION_CHECK_INTERVAL deletes of a thread
+  // (`num_thread_tomb_stones`), when no table is being migrated, as stats of
+  // a table, values are moved to, do not count values of older tables.
+  void maybe_compact(HashTable *table, size_t num_thread_tomb_stones) {
+    if (num_thread_tomb_stones % COMPACTION_CHECK_INTERVAL != 0 ||
+        table != ht.load(std::memory_order_acquire) ||
+        table->next_ht.load(std::memory_order_acquire))
+      return;
+
+    auto [num_values, num_tomb_stones] = table->get_stats();
+
+    // Insert of a deleted value could be yet to be counted.
+    if (num_values < num_tomb_stones)
+      return;
+
+    size_t num_live_values = num_values - num_tomb_stones;
+    size_t num_buckets = table->num_buckets;
+    size_t new_num_buckets = std::min(
+        next_pow_2(std::max(num_live_values * 2, MINIMUM_CAPACITY)),
+        num_buckets);
+    bool rehash =
+        num_tomb_stones * 100 >= num_buckets * Traits::TOMB_STONE_PERCENT;
+    // Small tables are not worth shrinking.
+    bool shrink =
+        num_live_values * 100 < num_buckets * Traits::MIN_LOAD_PERCENT &&
+        new_num_buckets < num_buckets &&
+        num_buckets > COMPACTION_CHECK_INTERVAL;
+
+    if (rehash || shrink)
+      start_migration(table, new_num_buckets);
+  }
+
+  // Moves `chain` of `table` to the next table.
+  // Chain's lock must be held.
+  void migrate_chain(HashTable &table, size_t chain) {
+    HashTable *next = table.next_ht.load(std::memory_order_acquire);
+
+    if constexpr (LOCK_FREE)
+      table.freeze_chain(chain);
+
+    table.for_each_in_chain(chain, [&](size_t hash, const KeyValuePair &kv) {
+      insert_moved(next, hash, kv.first, kv.second);
+      table.increment_num_tomb_stones();
+    });
+
+    table.chain_head(chain).migrated.store(true, std::memory_order_release);
+  }
+
+  // Locks chain of `hash` in the newest table having it, starting from
+  // `table`. Chains of tables being migrated are moved first.
+  std::pair<HashTable *, MutexLock> lock_chain(HashTable *table,
+                                               size_t hash) {
+    while (true) {
+      MutexLock lock = table->lock_chain(hash);
+      HashTable *next = table->next_ht.load(std::memory_order_acquire);
+
+      if (next == nullptr)
+        return {table, std::move(lock)};
+
+      if (!table->is_chain_migrated(hash))
+        migrate_chain(*table, table->get_chain(hash));
+
+      lock.unlock();
+      table = next;
+    }
+  }
+
+  // Newest table, starting from `table`, which has the chain of `hash`.
+  static HashTable *chain_table(HashTable *table, size_t hash) {
+    while (table->is_chain_migrated(hash))
+      table = table->next_ht.load(std::memory_order_acquire);
+
+    return table;
+  }
+
+  // Moves chain of `hash` of `table`, which is being migrated, unless it's
+  // moved already, and returns the next table.
+  HashTable *move_chain(HashTable *table, size_t hash) {
+    MutexLock lock = table->lock_chain(hash);
+
+    if (!table->is_chain_migrated(hash))
+      migrate_chain(*table, table->get_chain(hash));
+
+    return table->next_ht.load(std::memory_order_acquire);
+  }
+
+  // Returns the table to retry a failed lock free insert into `table` in.
+  HashTable *retry_insert(HashTable *table, size_t hash, InsertResult res) {
+    switch (res) {
+    case InsertResult::InsertResult_Overflow:
+      start_migration(table);
+      return move_chain(table, hash);
+
+    case InsertResult::InsertResult_Migrating:
+      return move_chain(table, hash);
+
+    case InsertResult::InsertResult_Busy:
+      utils::cpu_relax();
+      return table;
+
+    default:
+      return table;
+    }
+  }
+
+  // Inserts a key, moved from an older table, into `table` (or newer).
+  void insert_moved(HashTable *table, size_t hash, const key_type &key,
+                    const mapped_type &val) {
+    if constexpr (LOCK_FREE) {
+      while (true) {
+        table = chain_table(table, hash);
+
+        auto [found, sres] = table->search(key, hash);
+
+        HT_DEBUG_ASSERT(!found);
+        HT_DEBUG_ONLY(found);
+
+        auto res = table->insert_lock_free(sres, key, val);
+
+        if (res == InsertResult::InsertResult_New)
+          return;
+
+        table = retry_insert(table, hash, res);
+      }
+    }
+
+    while (true) {
+      auto [newest, lock] = lock_chain(table, hash);
+      auto [found, sres] = newest->search(key, hash);
+
+      HT_DEBUG_ASSERT(!found);
+      HT_DEBUG_ONLY(found);
+
+      auto res = newest->insert(sres, key, val);
+
+      if (res == InsertResult::InsertResult_New)
+        return;
+
+      lock.unlock();
+
+      if (res == InsertResult::InsertResult_Overflow)
+        start_migration(newest);
+
+      table = newest;
+    }
+  }
+
+  // Moves a chunk of chains of the oldest table, if it's being migrated.
+  void help_migration() {
+    HashTable *table = ht.load(std::memory_order_acquire);
+
+    if (table->next_ht.load(std::memory_order_acquire) == nullptr)
+      return;
+
+    size_t num_chains = table->num_chains();
+    size_t num_chunks =
+        (num_chains + MIGRATION_CHUNK_SIZE - 1) / MIGRATION_CHUNK_SIZE;
+    size_t chunk = table->next_chunk.fetch_add(1);
+
+    if (chunk >= num_chunks)
+      return;
+
+    size_t end = std::min((chunk + 1) * MIGRATION_CHUNK_SIZE, num_chains);
+
+    for (size_t chain = chunk * MIGRATION_CHUNK_SIZE; chain < end; chain++) {
+      ChainHead &head = table->chain_head(chain);
+      MutexLock lock{head.m};
+
+      if (!head.migrated.load(std::memory_order_relaxed))
+        migrate_chain(*table, chain);
+    }
+
+    if (table->num_migrated_chunks.fetch_add(1) + 1 == num_chunks) {
+      HashTable *next = table->next_ht.load();
+
+      ht.store(next, std::memory_order_release);
+      m_gc.retire_in_new_epoch(table->num_buckets < next->num_buckets
+                                   ? free_table
+                                   : recycle_table,
+                               reinterpret_cast<void *>(table));
+
+      num_migrations++;
+    }
+  }
+
+  // Finishes all migrations in progress.
+  void finish_migrations() {
+    while (ht.load()->next_ht.load())
+      help_migration();
+  }
+
+  template <typename K>
+  static std::optional<mapped_type> search(const HashTable *table, const K &key,
+                                           size_t hash) {
+    // Chains are only migrated, after the next table is published, and are
+    // left as is in the old table, so a chain, found not migrated, holds
+    // the values as of some point during the search.
+    while (true) {
+      HashTable *next = table->next_ht.load(std::memory_order_acquire);
+
+      if (next == nullptr || !table->is_chain_migrated(hash)) {
+        auto [found, sres] = table->search(key, hash);
+
+        if (found)
+          return load_value(table->key_value(sres).second);
+
+        return std::nullopt;
+      }
+
+      table = next;
+    }
+  }
+
+  // Writes the value of `key` with `fn(table, sres)`, with it's bucket
+  // claimed, in lock free mode. Returns std::nullopt, if `key` is missing,
+  // after trying to insert it with `insert(table, sres)`, if given.
+  template <typename K, typename WriteFn, typename InsertFn>
+  std::optional<mapped_type> write_lock_free(const K &key, size_t hash,
+                                             WriteFn &&fn, InsertFn &&insert) {
+    EpochGuard eg{this};
+
+    help_migration();
+
+    for (HashTable *table = ht.load();;) {
+      table = chain_table(table, hash);
+
+      auto [found, sres] = table->search(key, hash);
+
+      if (found) {
+        auto [res, bucket_hash] = table->claim_bucket(sres.bucket);
+
+        if (res == ClaimResult::ClaimResult_Claimed)
+          return fn(table, sres, bucket_hash);
+
+        if (res == ClaimResult::ClaimResult_Moved)
+          table = move_chain(table, hash);
+
+        continue;
+      }
+
+      if constexpr (std::is_same_v<std::decay_t<InsertFn>, std::nullptr_t>) {
+        return std::nullopt;
+      } else {
+        auto res = insert(table, sres);
+
+        if (res == InsertResult::InsertResult_New)
+          return std::nullopt;
+
+        table = retry_insert(table, hash, res);
+      }
+    }
+  }
+
+  // `val` is either the value or a value_updater_t.
+  template <typename ValueType>
+  std::optional<mapped_type> upsert(const key_type &key, size_t hash,
+                                    const ValueType &val,
+                                    bool overwrite = true) {
+    if constexpr (LOCK_FREE) {
+      return write_lock_free(
+          key, hash,
+          [&](HashTable *table, auto sres, size_t bucket_hash) {
+            auto &key_value = table->key_value(sres);
+            mapped_type oldval = overwrite ? exchange_value(key_value, val)
+                                           : key_value.second;
+
+            table->publish_bucket(sres.bucket, bucket_hash);
+            return std::optional<mapped_type>{oldval};
+          },
+          [&](HashTable *table, auto sres) {
+            return table->insert_lock_free(sres, key, new_value(val));
+          });
+    }
+
+    EpochGuard eg{this};
+
+    help_migration();
+
+    for (HashTable *table = ht.load();;) {
+      auto [newest, lock] = lock_chain(table, hash);
+      auto [found, sres] = newest->search(key, hash);
+
+      if (found) {
+        auto &key_value = newest->key_value(sres);
+
+        if (overwrite)
+          return exchange_value(key_value, val);
+
+        return key_value.second;
+      }
+
+      auto res = newest->insert(sres, key, new_value(val));
+
+      if (res == InsertResult::InsertResult_New)
+        return std::nullopt;
+
+      lock.unlock();
+
+      if (res == InsertResult::InsertResult_Overflow)
+        start_migration(newest);
+
+      table = newest;
+    }
+  }
+
+  // `val` is either the value or a value_updater_t.
+  template <typename ValueType>
+  std::optional<mapped_type> update(const key_type &key, size_t hash,
+                                    const ValueType &val) {
+    if constexpr (LOCK_FREE) {
+      return write_lock_free(
+          key, hash,
+          [&](HashTable *table, auto sres, size_t bucket_hash) {
+            mapped_type oldval = exchange_value(table->key_value(sres), val);
+
+            table->publish_bucket(sres.bucket, bucket_hash);
+            return std::optional<mapped_type>{oldval};
+          },
+          nullptr);
+    }
+
+    EpochGuard eg{this};
+
+    help_migration();
+
+    auto [table, lock] = lock_chain(ht.load(), hash);
+    auto [found, sres] = table->search(key, hash);
+
+    if (found)
+      return exchange_value(table->key_value(sres), val);
+
+    return std::nullopt;
+  }
+
+  template <typename K>
+  std::optional<mapped_type> remove(const K &key, size_t hash) {
+    if constexpr (LOCK_FREE) {
+      return write_lock_free(
+          key, hash,
+          [&](HashTable *table, auto sres, size_t) {
+            std::optional<mapped_type> val = table->key_value(sres).second;
+
+            table->publish_bucket(sres.bucket,
+                                  HashTable::HashBucket::TOMB_STONE_HASH);
+            maybe_compact(table, table->increment_num_tomb_stones());
+
+            return val;
+          },
+          nullptr);
+    }
+
+    EpochGuard eg{this};
+
+    help_migration();
+
+    auto [table, lock] = lock_chain(ht.load(), hash);
+    auto [found, sres] = table->search(key, hash);
+
+    if (found) {
+      std::optional<mapped_type> val = table->key_value(sres).second;
+
+      table->erase(sres);
+
+      size_t num_thread_tomb_stones = table->increment_num_tomb_stones();
+
+      lock.unlock();
+      maybe_compact(table, num_thread_tomb_stones);
+
       return val;
     }
+
+    return std::nullopt;
+  }
+
+  template <typename K>
+  std::optional<mapped_type> lookup(const K &key, size_t hash) {
+    EpochGuard eg{this};
+
+    return search(ht.load(), key, hash);
+  }
+
+  template <typename H, typename = void>
+  struct is_transparent : std::false_type {};
+
+  template <typename H>
+  struct is_transparent<H, std::void_t<typename H::is_transparent>>
+      : std::true_type {};
+
+  // Keys of other types than `key_type` are looked up, when the hasher is
+  // transparent, and compared with keys by `==`.
+  template <typename K>
+  using enable_if_transparent_t =
+      std::enable_if_t<is_transparent<Hash>::value &&
+                       !std::is_same_v<std::decay_t<K>, key_type>>;
+
+public:
+  static constexpr size_t MINIMUM_CAPACITY = 4;
+  static constexpr size_t COMPACTION_CHECK_INTERVAL = 256;
+  static constexpr size_t MULTI_SEARCH_GROUP_SIZE = 16;
+
+  // Bucket memory of tables is placed on NUMA node `a_numa_node`, unless it's
+  // negative.
+  concurrent_map(size_t initial_capacity = MINIMUM_CAPACITY,
+                 int a_numa_node = -1)
+      : ht(new HashTable(std::max(initial_capacity, MINIMUM_CAPACITY),
+                         a_numa_node)),
+        migration_mutex(), num_migrations(0), numa_node(a_numa_node) {
+    ht.load()->map = this;
+  }
+
+  concurrent_map(concurrent_map &&o_map)
+      : ht(o_map.ht.load()), migration_mutex(), num_migrations(0),
+        numa_node(o_map.numa_node) {
+    o_map.ht.store(nullptr);
+
+    for (HashTable *table = ht.load(); table; table = table->next_ht.load())
+      table->map = this;
+  }
+
+  ~concurrent_map() {
+    // Retired tables must be freed first.
+    m_gc.stop_background_reclamation();
+    m_gc.reclaim_all();
+    delete spare_table.load();
+
+    for (HashTable *table = ht.load(); table;) {
+      HashTable *next = table->next_ht.load();
+
+      delete table;
+      table = next;
+    }
+  }
+
+  void reserve(size_t num_values) {
+    EpochGuard eg{this};
+    HashTable *table = ht.load();
+
+    while (HashTable *next = table->next_ht.load())
+      table = next;
+
+    start_migration(table, num_values * 2);
+    finish_migrations();
+  }
+
+  // Overloads taking a `hash` of the key, expect `hash_function()(key)`, so
+  // that callers, which have it already, need not rehash the key.
+  hasher hash_function() const { return raw_hash; }
+
+  // Prefetches the buckets of `hash`, ahead of an operation on it's key.
+  void prefetch(size_t hash) {
+    EpochGuard eg{this};
+
+    ht.load()->prefetch_bucket(HashTable::get_hash(hash));
+  }
+
+  std::optional<mapped_type> Search(const key_type &key) {
+    return lookup(key, HashTable::get_hash(raw_hash(key)));
+  }
+
+  std::optional<mapped_type> Search(const key_type &key, size_t hash) {
+    return lookup(key, HashTable::get_hash(hash));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Search(const K &key) {
+    return lookup(key, HashTable::get_hash(raw_hash(key)));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Search(const K &key, size_t hash) {
+    return lookup(key, HashTable::get_hash(hash));
+  }
+
+  // Searches all `keys`, storing the result of keys[i] into values[i].
+  // Buckets of a group of keys are prefetched before any of them is probed.
+  void MultiSearch(gsl::span<const key_type> keys,
+                   gsl::span<std::optional<mapped_type>> values) {
+    std::array<size_t, MULTI_SEARCH_GROUP_SIZE> hashes;
+    std::size_t num_keys = keys.size();
+
+    HT_DEBUG_ASSERT(values.size() >= keys.size());
+
+    EpochGuard eg{this};
+    const HashTable *table = ht.load();
+
+    for (std::size_t start = 0; start < num_keys;
+         start += MULTI_SEARCH_GROUP_SIZE) {
+      std::size_t end = std::min(start + MULTI_SEARCH_GROUP_SIZE, num_keys);
+
+      for (std::size_t idx = start; idx < end; idx++) {
+        hashes[idx - start] = HashTable::get_hash(raw_hash(keys[idx]));
+        table->prefetch_bucket(hashes[idx - start]);
+      }
+
+      for (std::size_t idx = start; idx < end; idx++)
+        values[idx] = search(table, keys[idx], hashes[idx - start]);
+    }
+  }
+
+  bool Insert(const key_type &key, const mapped_type &val) {
+    return Insert(key, val, raw_hash(key));
+  }
+
+  bool Insert(const key_type &key, const mapped_type &val, size_t hash) {
+    return !upsert(key, HashTable::get_hash(hash), val, false);
+  }
+
+  std::optional<mapped_type> Upsert(const key_type &key,
+                                    const mapped_type &val) {
+    return Upsert(key, val, raw_hash(key));
+  }
+
+  std::optional<mapped_type> Upsert(const key_type &key, const mapped_type &val,
+                                    size_t hash) {
+    return upsert(key, HashTable::get_hash(hash), val);
+  }
+
+  // Functional upsert, applies `fn(mapped_type &)` in place to the value of
+  // `key`, or to a default constructed value, which is inserted, if `key` is
+  // missing. `fn` is called under the bucket's lock. Returns the old value, if
+  // any.
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn) {
+    return Upsert(key, std::forward<Fn>(fn), raw_hash(key));
+  }
+
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn,
+                                    size_t hash) {
+    return upsert(key, HashTable::get_hash(hash), value_updater_t<Fn>{fn});
+  }
+
+  std::optional<mapped_type> Update(const key_type &key,
+                                    const mapped_type &val) {
+    return Update(key, val, raw_hash(key));
+  }
+
+  std::optional<mapped_type> Update(const key_type &key, const mapped_type &val,
+                                    size_t hash) {
+    return update(key, HashTable::get_hash(hash), val);
+  }
+
+  // Functional update, same as functional `Upsert`, but does nothing if `key`
+  // is missing.
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn) {
+    return Update(key, std::forward<Fn>(fn), raw_hash(key));
+  }
+
+  template <typename Fn, typename = std::enable_if_t<is_updater_v<Fn>>>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn,
+                                    size_t hash) {
+    return update(key, HashTable::get_hash(hash), value_updater_t<Fn>{fn});
+  }
+
+  std::optional<mapped_type> Delete(const key_type &key) {
+    return remove(key, HashTable::get_hash(raw_hash(key)));
+  }
+
+  std::optional<mapped_type> Delete(const key_type &key, size_t hash) {
+    return remove(key, HashTable::get_hash(hash));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Delete(const K &key) {
+    return remove(key, HashTable::get_hash(raw_hash(key)));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Delete(const K &key, size_t hash) {
+    return remove(key, HashTable::get_hash(hash));
   }
 
   size_t size() const {
     std::atomic_thread_fence(std::memory_order_seq_cst);
 
-    auto [num_values, num_tomb_stones] = ht.load()->get_stats();
+    size_t size = 0;
+
+    // Moved values are counted as tomb stones in older tables.
+    for (const HashTable *table = ht.load(); table;
+         table = table->next_ht.load()) {
+      auto [num_values, num_tomb_stones] = table->get_stats();
 
-    return num_values - num_tomb_stones;
+      size += num_values - num_tomb_stones;
+    }
+
+    return size;
   }
 
   int load_factor() const {
@@ -587,6 +1787,58 @@ public:
 
   bool empty() const { return size() == 0; }
 
+  // Sums stats, which tables maintain, and does not scan buckets. Memory of
+  // keys and values outside the buckets is not included.
+  hashtable_memory_usage_t memory_usage() const {
+    hashtable_memory_usage_t usage;
+
+    for (const HashTable *table = ht.load(); table;
+         table = table->next_ht.load()) {
+      auto [num_values, num_tomb_stones] = table->get_stats();
+
+      usage.num_tables++;
+      usage.num_buckets += table->num_buckets;
+      usage.num_values += num_values - std::min(num_values, num_tomb_stones);
+      usage.num_tomb_stones += num_tomb_stones;
+      usage.bucket_bytes += table->bucket_bytes();
+      usage.link_bytes += table->link_bytes();
+      usage.table_bytes += table->table_bytes();
+    }
+
+    if (const HashTable *spare = spare_table.load())
+      usage.spare_bytes = spare->memory_size();
+
+    usage.retired_bytes = m_gc.stats().retired_bytes;
+
+    return usage;
+  }
+
+  // Number of buckets of the newest table.
+  size_t bucket_count() const {
+    const HashTable *table = ht.load();
+
+    while (const HashTable *next = table->next_ht.load())
+      table = next;
+
+    return table->num_buckets;
+  }
+
   inline void reclaim_all() { m_gc.reclaim_all(); }
+
+  // Objects retired and pending reclamation (see `utils::epoch_stats_t`).
+  utils::epoch_stats_t<uint64_t> reclamation_stats() const {
+    return m_gc.stats();
+  }
+
+  // Objects retired by writers are reclaimed by a thread every `interval` (see
+  // `utils::EpochManager::start_background_reclamation`).
+  void start_background_reclamation(std::chrono::microseconds interval,
+                                    bool recycle = false) {
+    m_gc.start_background_reclamation(interval, recycle);
+  }
+
+  void stop_background_reclamation() {
+    m_gc.stop_background_reclamation();
+  }
 }; // namespace indexes::hashtable
 } // namespace indexes::hashtable
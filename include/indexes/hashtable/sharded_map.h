@@ -0,0 +1,280 @@
+// include/hashtable/sharded_map.h
+// Hashtable split into independently resized shards, placed on NUMA nodes
+
+#pragma once
+
+#include "indexes/hashtable/concurrent_map.h"
+#include "indexes/utils/Numa.h"
+#include "indexes/utils/Utils.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace indexes::hashtable {
+// Keys are split by high bits of their hash into `Shards` concurrent_maps,
+// which share no state (tables, migration and epochs), so that shards are
+// resized independently, stalling writers of only one shard at a time.
+//
+// When NUMA aware, bucket memory of shard `i` is placed on node
+// `i % numa::num_nodes()`, instead of the node of the thread, which happens
+// to allocate it. Workers, which are partitioned by shard, can run on their
+// shard's node with `run_on_shard_node`.
+template <typename Key, typename Value, size_t Shards = 16,
+          typename Hash = std::hash<Key>,
+          typename Traits = hashtable_traits_default>
+class sharded_map {
+  static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0,
+                "Shards must be a power of 2");
+
+public:
+  using shard_type = concurrent_map<Key, Value, Hash, Traits>;
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<const Key, Value>;
+  using size_type = std::size_t;
+  using hasher = Hash;
+
+  static constexpr size_t NUM_SHARDS = Shards;
+  static constexpr size_t MULTI_SEARCH_GROUP_SIZE =
+      shard_type::MULTI_SEARCH_GROUP_SIZE;
+
+private:
+  static constexpr Hash raw_hash = hasher{};
+
+  static constexpr int shard_bits() {
+    int bits = 0;
+
+    while ((size_t{1} << bits) < Shards)
+      bits++;
+
+    return bits;
+  }
+
+  // Shards are kept apart, as their maps are written by all threads.
+  struct alignas(2 * utils::CACHELINE_SIZE) shard_t {
+    int numa_node;
+    shard_type map;
+
+    shard_t(size_t initial_capacity, int a_numa_node)
+        : numa_node(a_numa_node), map(initial_capacity, a_numa_node) {}
+  };
+
+  std::array<std::unique_ptr<shard_t>, Shards> shards;
+
+  template <typename H, typename = void>
+  struct is_transparent : std::false_type {};
+
+  template <typename H>
+  struct is_transparent<H, std::void_t<typename H::is_transparent>>
+      : std::true_type {};
+
+  // Same as concurrent_map, keys of other types are looked up, when the
+  // hasher is transparent.
+  template <typename K>
+  using enable_if_transparent_t =
+      std::enable_if_t<is_transparent<Hash>::value &&
+                       !std::is_same_v<std::decay_t<K>, key_type>>;
+
+  template <typename Fn>
+  using enable_if_updater_t =
+      std::enable_if_t<std::is_invocable_v<Fn &, mapped_type &>>;
+
+public:
+  sharded_map(size_t initial_capacity = shard_type::MINIMUM_CAPACITY * Shards,
+              bool numa_aware = true) {
+    int num_nodes = utils::numa::num_nodes();
+
+    for (size_t shard = 0; shard < Shards; shard++) {
+      // Placement is pointless on single node machines.
+      int numa_node = numa_aware && num_nodes > 1
+                          ? static_cast<int>(shard % num_nodes)
+                          : -1;
+
+      shards[shard] = std::make_unique<shard_t>(initial_capacity / Shards,
+                                                numa_node);
+    }
+  }
+
+  hasher hash_function() const { return raw_hash; }
+
+  // Shard of a key, whose `hash_function()(key)` is `hash`. Hash is mixed
+  // first, as hashers like std::hash of integers leave the high bits unset,
+  // while shards use low bits of it.
+  static size_t shard_of(size_t hash) {
+    if constexpr (Shards == 1)
+      return 0;
+    else
+      return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - shard_bits());
+  }
+
+  shard_type &shard(size_t shard) { return shards[shard]->map; }
+
+  const shard_type &shard(size_t shard) const { return shards[shard]->map; }
+
+  // Node, the shard's buckets are placed on, or -1, if they're not placed.
+  int shard_node(size_t shard) const { return shards[shard]->numa_node; }
+
+  // Binds the calling thread to cpus of the shard's node. Returns false, if
+  // the shard is not placed or the thread could not be bound.
+  bool run_on_shard_node(size_t shard) const {
+    int numa_node = shard_node(shard);
+
+    return numa_node >= 0 && utils::numa::run_on_node(numa_node);
+  }
+
+  void reserve(size_t num_values) {
+    for (auto &shard : shards)
+      shard->map.reserve((num_values + Shards - 1) / Shards);
+  }
+
+  void prefetch(size_t hash) { shard(shard_of(hash)).prefetch(hash); }
+
+  std::optional<mapped_type> Search(const key_type &key) {
+    return Search(key, raw_hash(key));
+  }
+
+  std::optional<mapped_type> Search(const key_type &key, size_t hash) {
+    return shard(shard_of(hash)).Search(key, hash);
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Search(const K &key) {
+    return Search(key, raw_hash(key));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Search(const K &key, size_t hash) {
+    return shard(shard_of(hash)).Search(key, hash);
+  }
+
+  // Same as concurrent_map::MultiSearch, keys of a group are prefetched in
+  // their shards, before any of them is searched.
+  void MultiSearch(gsl::span<const key_type> keys,
+                   gsl::span<std::optional<mapped_type>> values) {
+    std::array<size_t, MULTI_SEARCH_GROUP_SIZE> hashes;
+    std::size_t num_keys = keys.size();
+
+    for (std::size_t start = 0; start < num_keys;
+         start += MULTI_SEARCH_GROUP_SIZE) {
+      std::size_t end = std::min(start + MULTI_SEARCH_GROUP_SIZE, num_keys);
+
+      for (std::size_t idx = start; idx < end; idx++) {
+        hashes[idx - start] = raw_hash(keys[idx]);
+        prefetch(hashes[idx - start]);
+      }
+
+      for (std::size_t idx = start; idx < end; idx++)
+        values[idx] = Search(keys[idx], hashes[idx - start]);
+    }
+  }
+
+  bool Insert(const key_type &key, const mapped_type &val) {
+    return Insert(key, val, raw_hash(key));
+  }
+
+  bool Insert(const key_type &key, const mapped_type &val, size_t hash) {
+    return shard(shard_of(hash)).Insert(key, val, hash);
+  }
+
+  std::optional<mapped_type> Upsert(const key_type &key,
+                                    const mapped_type &val) {
+    return Upsert(key, val, raw_hash(key));
+  }
+
+  std::optional<mapped_type> Upsert(const key_type &key, const mapped_type &val,
+                                    size_t hash) {
+    return shard(shard_of(hash)).Upsert(key, val, hash);
+  }
+
+  template <typename Fn, typename = enable_if_updater_t<Fn>>
+  std::optional<mapped_type> Upsert(const key_type &key, Fn &&fn) {
+    size_t hash = raw_hash(key);
+
+    return shard(shard_of(hash)).Upsert(key, std::forward<Fn>(fn), hash);
+  }
+
+  std::optional<mapped_type> Update(const key_type &key,
+                                    const mapped_type &val) {
+    size_t hash = raw_hash(key);
+
+    return shard(shard_of(hash)).Update(key, val, hash);
+  }
+
+  template <typename Fn, typename = enable_if_updater_t<Fn>>
+  std::optional<mapped_type> Update(const key_type &key, Fn &&fn) {
+    size_t hash = raw_hash(key);
+
+    return shard(shard_of(hash)).Update(key, std::forward<Fn>(fn), hash);
+  }
+
+  std::optional<mapped_type> Delete(const key_type &key) {
+    return Delete(key, raw_hash(key));
+  }
+
+  std::optional<mapped_type> Delete(const key_type &key, size_t hash) {
+    return shard(shard_of(hash)).Delete(key, hash);
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Delete(const K &key) {
+    return Delete(key, raw_hash(key));
+  }
+
+  template <typename K, typename = enable_if_transparent_t<K>>
+  std::optional<mapped_type> Delete(const K &key, size_t hash) {
+    return shard(shard_of(hash)).Delete(key, hash);
+  }
+
+  size_t size() const {
+    size_t size = 0;
+
+    for (auto &shard : shards)
+      size += shard->map.size();
+
+    return size;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t bucket_count() const {
+    size_t num_buckets = 0;
+
+    for (auto &shard : shards)
+      num_buckets += shard->map.bucket_count();
+
+    return num_buckets;
+  }
+
+  hashtable_memory_usage_t memory_usage() const {
+    hashtable_memory_usage_t usage;
+
+    for (auto &shard : shards)
+      usage += shard->map.memory_usage();
+
+    return usage;
+  }
+
+  void reclaim_all() {
+    for (auto &shard : shards)
+      shard->map.reclaim_all();
+  }
+
+  // Every shard has it's own reclaimer thread.
+  void start_background_reclamation(std::chrono::microseconds interval,
+                                    bool recycle = false) {
+    for (auto &shard : shards)
+      shard->map.start_background_reclamation(interval, recycle);
+  }
+
+  void stop_background_reclamation() {
+    for (auto &shard : shards)
+      shard->map.stop_background_reclamation();
+  }
+};
+} // namespace indexes::hashtable
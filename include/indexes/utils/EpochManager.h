@@ -1,22 +1,63 @@
 #pragma once
 
 #include "Utils.h"
+#include "sync_prim/Mutex.h"
 
 #include <algorithm>
 #include <array>
 #include <atomic>
-#include <deque>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <initializer_list>
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <ostream>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <gsl/gsl>
 
 namespace indexes::utils {
+// Snapshot of an EpochManager (see `EpochManager::stats`).
+template <typename epoch_t> struct epoch_stats_t {
+  epoch_t global_epoch = 0;
+
+  // Oldest epoch, a thread is in, and the thread, or -1, if none is.
+  epoch_t oldest_pinned_epoch = 0;
+  int oldest_pinned_thread = -1;
+
+  // Objects retired, but not reclaimed yet, by all threads (and their size,
+  // see `SizeHookType`) and by each thread.
+  std::size_t num_retired = 0;
+  std::size_t retired_bytes = 0;
+  std::vector<std::size_t> thread_num_retired;
+
+  // Retire batches allocated by all threads, which are reused, once their
+  // objects are reclaimed.
+  std::size_t num_batches = 0;
+
+  // Reclaim passes, inline or in background, and time spent in them.
+  std::size_t num_reclaims = 0;
+  std::chrono::nanoseconds total_reclaim_time{0};
+  std::chrono::nanoseconds max_reclaim_time{0};
+
+  void dump(std::ostream &ostr) const {
+    ostr << "Global Epoch = " << global_epoch << "\n";
+    ostr << "Oldest Pinned Epoch = " << oldest_pinned_epoch << " (Thread "
+         << oldest_pinned_thread << ")\n";
+    ostr << "Num Retired = " << num_retired << "\n";
+    ostr << "Retired Bytes = " << retired_bytes << "\n";
+    ostr << "Num Batches = " << num_batches << "\n";
+    ostr << "Num Reclaims = " << num_reclaims << "\n";
+    ostr << "Total Reclaim Time (ns) = " << total_reclaim_time.count() << "\n";
+    ostr << "Max Reclaim Time (ns) = " << max_reclaim_time.count() << "\n";
+  }
+};
+
 template <typename epoch_t, typename ReclaimedType,
           int ReclamationThreshold = 1000, typename Enable = void>
 class EpochManager;
@@ -34,6 +75,17 @@ class EpochManager<
   using ReclaimedPtrType = ReclaimedType *;
 
 public:
+  // Captureless lambdas convert to it.
+  using ReclaimerType = void (*)(ReclaimedPtrType object);
+  // Size of an object in bytes, for stats.
+  using SizeHookType = std::size_t (*)(ReclaimedPtrType object);
+  using StallCallbackType =
+      std::function<void(int thread_id, epoch_t epoch,
+                         std::chrono::nanoseconds pinned_for)>;
+
+  // # objects of a retire batch (see `RetireBatch`).
+  static constexpr std::size_t RETIRE_BATCH_SIZE = 64;
+
   // It is undefined behaviour to use epoch manager, without registering the
   // thread. Returns false, if active registered thread count is more than
   // `MAX_THREADS`. If returned false, thread is not registered.
@@ -77,30 +129,26 @@ public:
   // retire objects and start a new epoch.
   // Objects will be reclaimed at a suitable and safe epoch.
   // When reclaimed `reclaimer` will be called for each reclaimed object.
-  void
-  retire_in_new_epoch(std::function<void(ReclaimedPtrType object)> reclaimer,
-                      gsl::span<ReclaimedPtrType> objects) {
+  void retire_in_new_epoch(ReclaimerType reclaimer,
+                           gsl::span<ReclaimedPtrType> objects) {
     retire(reclaimer, objects, switch_epoch());
   }
 
-  inline void
-  retire_in_new_epoch(std::function<void(ReclaimedPtrType object)> reclaimer,
-                      ReclaimedPtrType object) {
+  inline void retire_in_new_epoch(ReclaimerType reclaimer,
+                                  ReclaimedPtrType object) {
     retire_in_new_epoch(reclaimer, {&object, 1});
   }
 
   // retire objects in current (without starting new epoch) epoch.
   // Objects will be reclaimed at a suitable and safe epoch.
   // When reclaimed `reclaimer` will be called for each reclaimed object.
-  void retire_in_current_epoch(
-      std::function<void(ReclaimedPtrType object)> reclaimer,
-      gsl::span<ReclaimedPtrType> objects) {
+  void retire_in_current_epoch(ReclaimerType reclaimer,
+                               gsl::span<ReclaimedPtrType> objects) {
     retire(reclaimer, objects, now());
   }
 
-  inline void retire_in_current_epoch(
-      std::function<void(ReclaimedPtrType object)> reclaimer,
-      ReclaimedPtrType object) {
+  inline void retire_in_current_epoch(ReclaimerType reclaimer,
+                                      ReclaimedPtrType object) {
     retire_in_current_epoch(reclaimer, {&object, 1});
   }
 
@@ -109,8 +157,18 @@ public:
   // A long running thread using an epoch could prevent
   // reclaimation of objects visible to that thread.
   size_t do_reclaim() {
-    return reclaim_in_retire_list(m_retire_list[ThreadRegistry::ThreadID()],
-                                  get_min_used_epoch());
+    auto start = std::chrono::steady_clock::now();
+    auto &retire_list = m_retire_list[ThreadRegistry::ThreadID()];
+
+    push_recycled_batches(retire_list, take_recycled_batches(retire_list));
+
+    size_t num_retired =
+        reclaim_in_retire_list(retire_list, get_min_used_epoch());
+
+    record_reclaim(start);
+    check_pinned_threads();
+
+    return num_retired;
   }
 
   void reclaim_all() {
@@ -118,7 +176,61 @@ public:
 
     for (auto &retire_list : m_retire_list) {
       reclaim_in_retire_list(retire_list, min_used_epoch);
+      push_recycled_batches(retire_list, take_recycled_batches(retire_list));
     }
+
+    std::lock_guard lock{m_sealed_mutex};
+    reclaim_sealed_batches(min_used_epoch, false);
+  }
+
+  // Starts a thread, which advances the epoch and reclaims objects retired by
+  // all threads every `interval`, instead of writers reclaiming them, once
+  // they cross the threshold. Writers hand their batches over, once they're
+  // full, so that upto RETIRE_BATCH_SIZE - 1 objects of a thread wait for
+  // it's next retire. Must not be called concurrently with
+  // `stop_background_reclamation`.
+  //
+  // With `recycle`, batches, which are safe to reclaim, are returned to the
+  // threads, which retired them, to be reclaimed by their next retire (or
+  // `do_reclaim`), instead of by the reclaimer thread. Pooled allocators with
+  // per thread free lists (Ex: utils::PagePool) then get memory back on the
+  // thread, whose allocations reuse it, so that steady churn does not go
+  // through shared free lists. Objects of idle threads are not freed though.
+  void start_background_reclamation(std::chrono::microseconds interval,
+                                    bool recycle = false) {
+    if (m_reclaimer.joinable())
+      return;
+
+    m_recycle = recycle;
+    m_stop_reclaimer = false;
+    m_background_reclamation.store(true, std::memory_order_relaxed);
+    m_reclaimer = std::thread([this, interval] {
+      std::unique_lock lock{m_reclaimer_mutex};
+
+      while (!m_reclaimer_cv.wait_for(lock, interval,
+                                      [this] { return m_stop_reclaimer; })) {
+        lock.unlock();
+        reclaim_in_background();
+        lock.lock();
+      }
+    });
+  }
+
+  // Objects handed over, but not reclaimed yet, are reclaimed by
+  // `reclaim_all`.
+  void stop_background_reclamation() {
+    if (!m_reclaimer.joinable())
+      return;
+
+    m_background_reclamation.store(false, std::memory_order_relaxed);
+
+    {
+      std::lock_guard lock{m_reclaimer_mutex};
+      m_stop_reclaimer = true;
+    }
+
+    m_reclaimer_cv.notify_one();
+    m_reclaimer.join();
   }
 
   // Getter/Setter for reclaimation threshold.
@@ -134,78 +246,437 @@ public:
     return m_reclaimation_threshold;
   }
 
-  EpochManager()
+  // Calls `callback`, once a thread is seen in the same epoch for `threshold`
+  // or longer. Threads are checked by reclaim passes, instead of timing every
+  // `enter_epoch`, so a stall is reported by the first pass after it crosses
+  // the threshold and a thread repeatedly entering the same epoch, as it's not
+  // advanced, looks pinned as well (background reclamation advances it).
+  // A stall is reported once.
+  void set_stall_callback(std::chrono::nanoseconds threshold,
+                          StallCallbackType callback) {
+    std::lock_guard lock{m_stall_mutex};
+
+    m_stall_threshold = threshold;
+    m_stall_callback = std::move(callback);
+    m_pin_state.assign(ThreadRegistry::MAX_THREADS, PinState{});
+    m_check_stalls.store(static_cast<bool>(m_stall_callback),
+                         std::memory_order_relaxed);
+  }
+
+  epoch_stats_t<epoch_t> stats() const {
+    epoch_stats_t<epoch_t> stats;
+    int num_threads = ThreadRegistry::MaxThreadID() + 1;
+
+    stats.global_epoch = now();
+    stats.oldest_pinned_epoch = stats.global_epoch;
+
+    for (int i = 0; i < num_threads; i++) {
+      epoch_t epoch = m_local_epoch[i].epoch.load(std::memory_order_relaxed);
+
+      if (epoch != QUIESCENT_STATE &&
+          (stats.oldest_pinned_thread == -1 ||
+           epoch < stats.oldest_pinned_epoch)) {
+        stats.oldest_pinned_epoch = epoch;
+        stats.oldest_pinned_thread = i;
+      }
+    }
+
+    stats.thread_num_retired.resize(num_threads);
+
+    for (std::size_t i = 0; i < m_retire_list.size(); i++) {
+      auto [num_retired, retired_bytes] = m_retire_list[i].backlog();
+
+      stats.num_retired += num_retired;
+      stats.retired_bytes += retired_bytes;
+
+      if (i < stats.thread_num_retired.size())
+        stats.thread_num_retired[i] = num_retired;
+
+      stats.num_batches +=
+          m_retire_list[i].num_batches.load(std::memory_order_relaxed);
+    }
+
+    stats.num_reclaims = m_num_reclaims.load(std::memory_order_relaxed);
+    stats.total_reclaim_time = std::chrono::nanoseconds{
+        m_total_reclaim_time.load(std::memory_order_relaxed)};
+    stats.max_reclaim_time = std::chrono::nanoseconds{
+        m_max_reclaim_time.load(std::memory_order_relaxed)};
+
+    return stats;
+  }
+
+  // Sizes of retired objects are accounted in `stats` with `size_hook`, if
+  // it's given.
+  explicit EpochManager(SizeHookType size_hook = nullptr)
       : m_reclaimation_threshold{ReclamationThreshold}, m_global_epoch{0},
         m_local_epoch(ThreadRegistry::MAX_THREADS),
-        m_retire_list(ThreadRegistry::MAX_THREADS) {}
+        m_retire_list(ThreadRegistry::MAX_THREADS), m_size_hook(size_hook) {}
 
   EpochManager(const EpochManager &) = delete;
   EpochManager(EpochManager &&) = delete;
 
+  // Objects not reclaimed yet are leaked, only batches are freed.
+  ~EpochManager() {
+    stop_background_reclamation();
+
+    for (auto &retire_list : m_retire_list) {
+      free_batches(retire_list.head);
+      free_batches(retire_list.free_batches);
+      free_batches(retire_list.sealed.load());
+      free_batches(retire_list.recycled.load());
+    }
+
+    free_batches(m_sealed_batches);
+  }
+
 private:
-  class Retiree {
-  public:
-    Retiree(ReclaimedPtrType object,
-            std::function<void(ReclaimedPtrType object)> reclaimer,
-            epoch_t retired_epoch)
-        : m_object(object), m_retired_epoch(retired_epoch),
-          m_reclaimer(reclaimer) {}
-
-    // Can reclaim this object after the given `epoch`
-    bool can_reclaim(epoch_t epoch) const { return epoch > m_retired_epoch; }
-
-    void reclaim() { return m_reclaimer(m_object); }
-
-  private:
-    // Object to reclaim safely.
-    ReclaimedPtrType m_object;
-    // Epoch on which the object was retired.
-    epoch_t m_retired_epoch;
-    // Callback to call during reclaimation.
-    std::function<void(ReclaimedPtrType object)> m_reclaimer;
+  // Objects retired by a thread with the same `reclaimer`, which can be
+  // reclaimed after `retired_epoch` (epoch of the latest of them).
+  struct RetireList;
+
+  struct RetireBatch {
+    RetireBatch *next;
+    RetireList *owner;
+    ReclaimerType reclaimer;
+    epoch_t retired_epoch;
+    std::size_t num_objects;
+    std::size_t num_bytes;
+    std::array<ReclaimedPtrType, RETIRE_BATCH_SIZE> objects;
   };
 
-  static size_t reclaim_in_retire_list(std::deque<Retiree> &retire_list,
-                                       epoch_t min_used_epoch) {
-    auto begin = std::begin(retire_list);
-    auto reclaim_upto = begin;
+  // # objects and bytes, for stats. Counters have a single writer each, which
+  // need not atomically increment them.
+  struct RetireCounter {
+    std::atomic<std::size_t> num_objects{0};
+    std::atomic<std::size_t> num_bytes{0};
+
+    void add(std::size_t objects, std::size_t bytes) {
+      num_objects.store(num_objects.load(std::memory_order_relaxed) + objects,
+                        std::memory_order_relaxed);
+      num_bytes.store(num_bytes.load(std::memory_order_relaxed) + bytes,
+                      std::memory_order_relaxed);
+    }
+  };
+
+  // Batches of a thread in retired order, from `head` to `tail` (being
+  // filled). Reclaimed batches are recycled through `free_batches`, so that
+  // retire does not allocate, once a thread has enough of them.
+  //
+  // With background reclamation, full batches are handed over to the
+  // reclaimer thread through `sealed` and come back through `recycled`. Both
+  // are stacks, whose consumer takes all of it at once, so pushes need not
+  // worry about ABA.
+  struct alignas(128) RetireList {
+    RetireBatch *head = nullptr;
+    RetireBatch *tail = nullptr;
+    RetireBatch *free_batches = nullptr;
+    std::size_t num_objects = 0;
+
+    // # batches allocated by the thread (it's only writer), for stats.
+    std::atomic<std::size_t> num_batches{0};
+
+    std::atomic<RetireBatch *> sealed{nullptr};
+    std::atomic<RetireBatch *> recycled{nullptr};
+
+    // Objects retired by the thread and reclaimed by it (or `reclaim_all`)
+    // and by the reclaimer thread (`sealed_reclaimed`).
+    RetireCounter retired;
+    RetireCounter reclaimed;
+    RetireCounter sealed_reclaimed;
+
+    // # objects and bytes, which are not reclaimed yet.
+    std::pair<std::size_t, std::size_t> backlog() const {
+      std::size_t num_objects =
+          reclaimed.num_objects.load(std::memory_order_relaxed) +
+          sealed_reclaimed.num_objects.load(std::memory_order_relaxed);
+      std::size_t num_bytes =
+          reclaimed.num_bytes.load(std::memory_order_relaxed) +
+          sealed_reclaimed.num_bytes.load(std::memory_order_relaxed);
+      std::size_t num_retired =
+          retired.num_objects.load(std::memory_order_relaxed);
+      std::size_t retired_bytes =
+          retired.num_bytes.load(std::memory_order_relaxed);
+
+      return {num_retired > num_objects ? num_retired - num_objects : 0,
+              retired_bytes > num_bytes ? retired_bytes - num_bytes : 0};
+    }
+  };
+
+  // Pin state of a thread, observed by `check_pinned_threads`.
+  struct PinState {
+    epoch_t epoch = QUIESCENT_STATE;
+    std::chrono::steady_clock::time_point since;
+    bool reported = false;
+  };
+
+  // Pushes batches from `first` to `last` (linked by `next`) to `stack`.
+  static void push_batches(std::atomic<RetireBatch *> &stack,
+                           RetireBatch *first, RetireBatch *last) {
+    RetireBatch *top = stack.load(std::memory_order_relaxed);
+
+    do {
+      last->next = top;
+    } while (!stack.compare_exchange_weak(
+        top, first, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  static void reclaim_batch(RetireBatch *batch) {
+    for (std::size_t i = 0; i < batch->num_objects; i++)
+      batch->reclaimer(batch->objects[i]);
+  }
 
-    for (auto &retiree : retire_list) {
-      if (!retiree.can_reclaim(min_used_epoch))
+  static void free_batches(RetireBatch *batch) {
+    while (batch) {
+      RetireBatch *next = batch->next;
+
+      delete batch;
+      batch = next;
+    }
+  }
+
+  // Takes batches returned by the reclaimer thread, reclaiming those, which
+  // were recycled unreclaimed (see `start_background_reclamation`).
+  static RetireBatch *take_recycled_batches(RetireList &retire_list) {
+    RetireBatch *batches =
+        retire_list.recycled.exchange(nullptr, std::memory_order_acquire);
+
+    for (RetireBatch *batch = batches; batch; batch = batch->next) {
+      if (batch->num_objects) {
+        reclaim_batch(batch);
+        retire_list.reclaimed.add(batch->num_objects, batch->num_bytes);
+        batch->num_objects = 0;
+      }
+    }
+
+    return batches;
+  }
+
+  static void push_recycled_batches(RetireList &retire_list,
+                                    RetireBatch *batches) {
+    if (batches == nullptr)
+      return;
+
+    RetireBatch *last = batches;
+
+    while (last->next)
+      last = last->next;
+
+    push_batches(retire_list.recycled, batches, last);
+  }
+
+  static RetireBatch *append_batch(RetireList &retire_list,
+                                   ReclaimerType reclaimer) {
+    if (retire_list.free_batches == nullptr)
+      retire_list.free_batches = take_recycled_batches(retire_list);
+
+    RetireBatch *batch = retire_list.free_batches;
+
+    if (batch) {
+      retire_list.free_batches = batch->next;
+    } else {
+      batch = new RetireBatch;
+      retire_list.num_batches.store(
+          retire_list.num_batches.load(std::memory_order_relaxed) + 1,
+          std::memory_order_relaxed);
+    }
+
+    batch->next = nullptr;
+    batch->owner = &retire_list;
+    batch->reclaimer = reclaimer;
+    batch->retired_epoch = 0;
+    batch->num_objects = 0;
+    batch->num_bytes = 0;
+
+    if (retire_list.tail)
+      retire_list.tail->next = batch;
+    else
+      retire_list.head = batch;
+
+    retire_list.tail = batch;
+    return batch;
+  }
+
+  static size_t reclaim_in_retire_list(RetireList &retire_list,
+                                       epoch_t min_used_epoch) {
+    while (RetireBatch *batch = retire_list.head) {
+      if (min_used_epoch <= batch->retired_epoch)
         break;
 
-      retiree.reclaim();
-      reclaim_upto++;
+      reclaim_batch(batch);
+
+      retire_list.num_objects -= batch->num_objects;
+      retire_list.reclaimed.add(batch->num_objects, batch->num_bytes);
+      retire_list.head = batch->next;
+
+      if (retire_list.head == nullptr)
+        retire_list.tail = nullptr;
+
+      batch->next = retire_list.free_batches;
+      retire_list.free_batches = batch;
+    }
+
+    return retire_list.num_objects;
+  }
+
+  // Hands all batches of the calling thread's `retire_list` over to the
+  // reclaimer thread.
+  static void seal_batches(RetireList &retire_list) {
+    push_batches(retire_list.sealed, retire_list.head, retire_list.tail);
+
+    retire_list.head = retire_list.tail = nullptr;
+    retire_list.num_objects = 0;
+  }
+
+  // Reclaims sealed batches, which are safe to reclaim and returns them to
+  // their owners, unreclaimed if `recycle`. Others are kept for later.
+  // `m_sealed_mutex` must be held.
+  void reclaim_sealed_batches(epoch_t min_used_epoch, bool recycle) {
+    for (auto &retire_list : m_retire_list) {
+      RetireBatch *batch =
+          retire_list.sealed.exchange(nullptr, std::memory_order_acquire);
+
+      while (batch) {
+        RetireBatch *next = batch->next;
+
+        batch->next = m_sealed_batches;
+        m_sealed_batches = batch;
+        batch = next;
+      }
+    }
+
+    for (RetireBatch **link = &m_sealed_batches; *link;) {
+      RetireBatch *batch = *link;
+
+      if (min_used_epoch <= batch->retired_epoch) {
+        link = &batch->next;
+        continue;
+      }
+
+      *link = batch->next;
+
+      if (!recycle) {
+        reclaim_batch(batch);
+        batch->owner->sealed_reclaimed.add(batch->num_objects,
+                                           batch->num_bytes);
+        batch->num_objects = 0;
+      }
+
+      push_batches(batch->owner->recycled, batch, batch);
     }
+  }
+
+  // A tick of the reclaimer thread. Epoch is advanced, so that objects
+  // retired in the current epoch become reclaimable, even if no thread starts
+  // a new epoch.
+  void reclaim_in_background() {
+    auto start = std::chrono::steady_clock::now();
 
-    size_t num_reclaimed = reclaim_upto - begin;
+    switch_epoch();
 
-    if (num_reclaimed) {
-      retire_list.erase(begin, reclaim_upto);
-      retire_list.shrink_to_fit();
+    {
+      epoch_t min_used_epoch = get_min_used_epoch();
+      std::lock_guard lock{m_sealed_mutex};
+
+      reclaim_sealed_batches(min_used_epoch, m_recycle);
     }
 
-    return retire_list.size();
+    record_reclaim(start);
+    check_pinned_threads();
+  }
+
+  void record_reclaim(std::chrono::steady_clock::time_point start) {
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    auto max_time = m_max_reclaim_time.load(std::memory_order_relaxed);
+
+    m_num_reclaims.fetch_add(1, std::memory_order_relaxed);
+    m_total_reclaim_time.fetch_add(time, std::memory_order_relaxed);
+
+    while (time > max_time && !m_max_reclaim_time.compare_exchange_weak(
+                                  max_time, time, std::memory_order_relaxed))
+      ;
+  }
+
+  // Reports threads, which are pinned for longer than the stall threshold
+  // (see `set_stall_callback`). Skipped, if another thread is checking.
+  void check_pinned_threads() {
+    if (!m_check_stalls.load(std::memory_order_relaxed))
+      return;
+
+    std::unique_lock lock{m_stall_mutex, std::try_to_lock};
+
+    if (!lock.owns_lock() || !m_stall_callback)
+      return;
+
+    auto now_time = std::chrono::steady_clock::now();
+    int num_threads = ThreadRegistry::MaxThreadID() + 1;
+
+    for (int i = 0; i < num_threads; i++) {
+      epoch_t epoch = m_local_epoch[i].epoch.load(std::memory_order_relaxed);
+      auto &pin = m_pin_state[i];
+
+      if (epoch != pin.epoch) {
+        pin = PinState{epoch, now_time, false};
+        continue;
+      }
+
+      auto pinned_for = now_time - pin.since;
+
+      if (epoch != QUIESCENT_STATE && !pin.reported &&
+          pinned_for >= m_stall_threshold) {
+        pin.reported = true;
+        m_stall_callback(
+            i, epoch,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(pinned_for));
+      }
+    }
   }
 
   epoch_t get_min_used_epoch() {
-    return std::min_element(std::begin(m_local_epoch),
-                            std::begin(m_local_epoch) +
-                                ThreadRegistry::MaxThreadID() + 1,
-                            [](const auto &a, const auto &b) {
-                              return a.epoch.load() < b.epoch.load();
-                            })
-        ->epoch;
+    epoch_t min_used_epoch = QUIESCENT_STATE;
+    int num_threads = ThreadRegistry::MaxThreadID() + 1;
+
+    for (int i = 0; i < num_threads; i++)
+      min_used_epoch = std::min(min_used_epoch, m_local_epoch[i].epoch.load());
+
+    return min_used_epoch;
   }
 
-  void retire(std::function<void(ReclaimedPtrType object)> reclaimer,
-              gsl::span<ReclaimedPtrType> objects, epoch_t retired_epoch) {
+  void retire(ReclaimerType reclaimer, gsl::span<ReclaimedPtrType> objects,
+              epoch_t retired_epoch) {
     auto &retire_list = m_retire_list[ThreadRegistry::ThreadID()];
+    bool background =
+        m_background_reclamation.load(std::memory_order_relaxed);
+    std::size_t num_bytes = 0;
+
+    for (auto object : objects) {
+      RetireBatch *batch = retire_list.tail;
+
+      if (batch == nullptr || batch->num_objects == RETIRE_BATCH_SIZE ||
+          batch->reclaimer != reclaimer) {
+        if (background && batch)
+          seal_batches(retire_list);
+
+        batch = append_batch(retire_list, reclaimer);
+      }
+
+      batch->objects[batch->num_objects++] = object;
+      batch->retired_epoch = std::max(batch->retired_epoch, retired_epoch);
+
+      if (m_size_hook) {
+        std::size_t object_bytes = m_size_hook(object);
+
+        batch->num_bytes += object_bytes;
+        num_bytes += object_bytes;
+      }
+    }
 
-    for (auto object : objects)
-      retire_list.emplace_back(object, reclaimer, retired_epoch);
+    retire_list.num_objects += objects.size();
+    retire_list.retired.add(objects.size(), num_bytes);
 
-    if (static_cast<int>(retire_list.size()) >= m_reclaimation_threshold)
+    if (!background && retire_list.num_objects >=
+                           static_cast<std::size_t>(m_reclaimation_threshold))
       do_reclaim();
   }
 
@@ -229,6 +700,32 @@ private:
   std::vector<PrivateData> m_local_epoch;
 
   // Thread local retire list. Accessed using `slot` by each thread.
-  std::vector<std::deque<Retiree>> m_retire_list;
+  std::vector<RetireList> m_retire_list;
+
+  // Batches sealed by threads, which are not safe to reclaim yet.
+  sync_prim::mutex::Mutex m_sealed_mutex;
+  RetireBatch *m_sealed_batches = nullptr;
+
+  // Background reclamation (see `start_background_reclamation`).
+  std::atomic<bool> m_background_reclamation{false};
+  std::thread m_reclaimer;
+  std::mutex m_reclaimer_mutex;
+  std::condition_variable m_reclaimer_cv;
+  bool m_stop_reclaimer = false;
+  bool m_recycle = false;
+
+  SizeHookType m_size_hook = nullptr;
+
+  // Reclaim passes (see `record_reclaim`).
+  std::atomic<std::size_t> m_num_reclaims{0};
+  std::atomic<std::int64_t> m_total_reclaim_time{0};
+  std::atomic<std::int64_t> m_max_reclaim_time{0};
+
+  // Stall detection (see `set_stall_callback`).
+  std::atomic<bool> m_check_stalls{false};
+  std::mutex m_stall_mutex;
+  std::chrono::nanoseconds m_stall_threshold{0};
+  StallCallbackType m_stall_callback;
+  std::vector<PinState> m_pin_state;
 };
 } // namespace indexes::utils
@@ -0,0 +1,115 @@
+// include/indexes/utils/MappedFile.h
+// Read only view of a whole file
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#include <vector>
+#endif
+
+namespace indexes::utils {
+// File is mmap'd where available (and read into memory elsewhere), so it's
+// contents are paged in on demand. Throws std::system_error, if the file
+// could not be read.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) { map(path); }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {
+#if !(defined(__unix__) || defined(__APPLE__))
+    m_buffer = std::move(other.m_buffer);
+#endif
+  }
+
+  ~MappedFile() { unmap(); }
+
+  inline const void *data() const { return m_data; }
+
+  inline std::size_t size() const { return m_size; }
+
+private:
+  const void *m_data = nullptr;
+  std::size_t m_size = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+  static void throw_error(const std::string &path) {
+    throw std::system_error{errno, std::generic_category(), path};
+  }
+
+  void map(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+
+    if (fd < 0)
+      throw_error(path);
+
+    if (::fstat(fd, &st) != 0) {
+      int err = errno;
+
+      ::close(fd);
+      errno = err;
+      throw_error(path);
+    }
+
+    m_size = st.st_size;
+
+    if (m_size) {
+      void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      int err = errno;
+
+      ::close(fd);
+
+      if (data == MAP_FAILED) {
+        errno = err;
+        throw_error(path);
+      }
+
+      // Files are usually read front to back (Ex: to restore a map).
+      ::madvise(data, m_size, MADV_SEQUENTIAL);
+      m_data = data;
+    } else {
+      ::close(fd);
+    }
+  }
+
+  void unmap() {
+    if (m_data)
+      ::munmap(const_cast<void *>(m_data), m_size);
+  }
+#else
+  std::vector<char> m_buffer;
+
+  void map(const std::string &path) {
+    std::ifstream file{path, std::ios::binary};
+
+    if (!file)
+      throw std::system_error{ENOENT, std::generic_category(), path};
+
+    m_buffer.assign(std::istreambuf_iterator<char>{file},
+                    std::istreambuf_iterator<char>{});
+    m_data = m_buffer.empty() ? nullptr : m_buffer.data();
+    m_size = m_buffer.size();
+  }
+
+  void unmap() {}
+#endif
+};
+} // namespace indexes::utils
@@ -0,0 +1,248 @@
+// include/indexes/utils/Numa.h
+// NUMA node discovery, memory placement and thread affinity
+
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Only linux is supported, elsewhere the machine is a single node, memory is
+// not placed and threads are not bound.
+namespace indexes::utils::numa {
+namespace detail {
+// Parses a sysfs list (Ex: "0-3,8-11\n") into it's members.
+inline std::vector<int> read_list(const char *path) {
+  std::vector<int> members;
+  FILE *file = std::fopen(path, "r");
+
+  if (file == nullptr)
+    return members;
+
+  int first, last;
+
+  while (std::fscanf(file, "%d", &first) == 1) {
+    last = first;
+
+    if (std::fscanf(file, "-%d", &last) != 1)
+      last = first;
+
+    for (int member = first; member <= last; member++)
+      members.push_back(member);
+
+    if (std::fgetc(file) != ',')
+      break;
+  }
+
+  std::fclose(file);
+  return members;
+}
+
+constexpr std::size_t PAGE_SIZE = 4096;
+
+// Mode of `mbind`, pages are allocated from the node, until it runs out of
+// memory.
+constexpr int MPOL_PREFERRED = 1;
+// Modes of `set_mempolicy`, pages are allocated round robin across nodes, or
+// from the node of the allocating thread.
+constexpr int MPOL_INTERLEAVE = 3;
+constexpr int MPOL_LOCAL = 4;
+
+#if defined(__linux__)
+inline bool run_on(const std::vector<int> &cpus) {
+  cpu_set_t cpu_set;
+
+  CPU_ZERO(&cpu_set);
+
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &cpu_set);
+  }
+
+  return CPU_COUNT(&cpu_set) != 0 &&
+         sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+}
+#endif
+} // namespace detail
+
+// # NUMA nodes of the machine.
+inline int num_nodes() {
+#if defined(__linux__)
+  static const int num =
+      [] {
+        auto nodes = detail::read_list("/sys/devices/system/node/online");
+
+        return nodes.empty() ? 0 : nodes.back();
+      }() +
+      1;
+
+  return num;
+#else
+  return 1;
+#endif
+}
+
+// Node, the calling thread is running on.
+inline int current_node() {
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    return static_cast<int>(node);
+#endif
+
+  return 0;
+}
+
+// Cpus of `node`, in ascending order. Empty, if the node is unknown.
+inline std::vector<int> node_cpus(int node) {
+#if defined(__linux__)
+  char path[64];
+
+  std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                node);
+
+  return detail::read_list(path);
+#else
+  (void)node;
+  return {};
+#endif
+}
+
+// Restricts the calling thread to cpus of `node`. Returns false, if the
+// thread could not be bound.
+inline bool run_on_node(int node) {
+#if defined(__linux__)
+  return detail::run_on(node_cpus(node));
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+// Binds the calling thread to `cpu`. Returns false, if it could not be bound.
+inline bool run_on_cpu(int cpu) {
+#if defined(__linux__)
+  return detail::run_on({cpu});
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+enum class memory_policy {
+  // Pages are placed on the node of the thread, which first touches them.
+  local,
+  // Pages are spread round robin across all nodes.
+  interleave
+};
+
+// Sets placement of pages, allocated later by the calling thread and threads
+// it creates afterwards (except those of `allocate` on a node). Returns false,
+// if the policy could not be set.
+inline bool set_memory_policy(memory_policy policy) {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+  if (policy == memory_policy::local)
+    return syscall(SYS_set_mempolicy, detail::MPOL_LOCAL, nullptr, 0) == 0;
+
+  constexpr std::size_t BITS_PER_WORD = sizeof(unsigned long) * 8;
+  int nodes = num_nodes();
+  std::vector<unsigned long> mask(nodes / BITS_PER_WORD + 1);
+
+  for (int node = 0; node < nodes; node++)
+    mask[node / BITS_PER_WORD] |= 1UL << (node % BITS_PER_WORD);
+
+  return syscall(SYS_set_mempolicy, detail::MPOL_INTERLEAVE, mask.data(),
+                 mask.size() * BITS_PER_WORD + 1) == 0;
+#else
+  (void)policy;
+  return false;
+#endif
+}
+
+// Allocations of a page or more on a `node` (non negative) are mapped
+// separately and their pages placed on it, before they're touched. Others
+// come from the global heap.
+inline bool is_placed(std::size_t size, int node) {
+#if defined(__linux__) && defined(SYS_mbind)
+  return node >= 0 && size >= detail::PAGE_SIZE;
+#else
+  (void)size;
+  (void)node;
+  return false;
+#endif
+}
+
+inline void *allocate(std::size_t size, int node) {
+  if (!is_placed(size, node))
+    return ::operator new(size);
+
+#if defined(__linux__) && defined(SYS_mbind)
+  void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (mem == MAP_FAILED)
+    throw std::bad_alloc{};
+
+  constexpr std::size_t BITS_PER_WORD = sizeof(unsigned long) * 8;
+  std::vector<unsigned long> mask(node / BITS_PER_WORD + 1);
+
+  mask[node / BITS_PER_WORD] |= 1UL << (node % BITS_PER_WORD);
+
+  // Best effort, pages are placed on first touch, if the node is unknown.
+  syscall(SYS_mbind, mem, size, detail::MPOL_PREFERRED, mask.data(),
+          mask.size() * BITS_PER_WORD + 1, 0);
+
+  return mem;
+#endif
+}
+
+inline void deallocate(void *mem, std::size_t size, int node) {
+  if (!is_placed(size, node)) {
+    ::operator delete(mem);
+    return;
+  }
+
+#if defined(__linux__)
+  munmap(mem, size);
+#endif
+}
+
+template <typename T> struct array_deleter {
+  std::size_t size;
+  int node;
+
+  void operator()(T *arr) const {
+    for (std::size_t i = 0; i < size; i++)
+      arr[i].~T();
+
+    deallocate(arr, size * sizeof(T), node);
+  }
+};
+
+template <typename T>
+using unique_array = std::unique_ptr<T[], array_deleter<T>>;
+
+// Same as std::make_unique<T[]>(size), but placed on `node` (see `allocate`).
+template <typename T>
+unique_array<T> make_unique_array(std::size_t size, int node) {
+  static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                "Over aligned types are not supported");
+
+  T *arr = static_cast<T *>(allocate(size * sizeof(T), node));
+
+  for (std::size_t i = 0; i < size; i++)
+    new (arr + i) T();
+
+  return unique_array<T>{arr, array_deleter<T>{size, node}};
+}
+} // namespace indexes::utils::numa
@@ -0,0 +1,191 @@
+// include/indexes/utils/PageAllocator.h
+// Fixed size page allocators for index nodes
+
+#pragma once
+
+#include "Utils.h"
+#include "sync_prim/Mutex.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace indexes::utils {
+// Every page is a separate allocation from the global heap.
+template <std::size_t PageSize> struct HeapPageAllocator {
+  static void *allocate() { return new char[PageSize]; }
+
+  static void deallocate(void *page) { delete[] static_cast<char *>(page); }
+};
+
+// Pages are carved out of huge page sized (and aligned) chunks and recycled
+// through per thread free lists. Pages of a power of two size are aligned to
+// it, others to a cache line. Threads exchange free pages in batches with a
+// shared free list, so a page freed by a thread can be reused by others.
+// Chunks are never returned to the OS.
+template <std::size_t PageSize> class PagePool {
+public:
+  static constexpr std::size_t CHUNK_SIZE = 2 * 1024 * 1024;
+  static constexpr std::size_t PAGE_ALIGNMENT =
+      (PageSize & (PageSize - 1)) == 0 ? PageSize : CACHELINE_SIZE;
+  // Distance b/w pages carved out of a chunk, PageSize rounded up to
+  // PAGE_ALIGNMENT.
+  static constexpr std::size_t PAGE_STRIDE =
+      (PageSize + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT * PAGE_ALIGNMENT;
+  static constexpr std::size_t PAGES_PER_CHUNK = CHUNK_SIZE / PAGE_STRIDE;
+
+  // Free pages cached by a thread before it returns a batch to the pool.
+  static constexpr std::size_t MAX_CACHED_PAGES = 2 * PAGES_PER_CHUNK;
+  static constexpr std::size_t TRANSFER_BATCH_SIZE =
+      PAGES_PER_CHUNK > 1 ? PAGES_PER_CHUNK / 2 : 1;
+
+  static_assert(PageSize >= sizeof(void *) && PAGE_STRIDE <= CHUNK_SIZE,
+                "Page must fit in a chunk and hold a free list link");
+
+  static void *allocate() { return instance().allocate_page(); }
+
+  static void deallocate(void *page) { instance().free_page(page); }
+
+  // # chunks (of CHUNK_SIZE bytes) allocated so far.
+  static std::size_t num_chunks() {
+    auto &pool = instance();
+    std::lock_guard lock{pool.m_mutex};
+
+    return pool.m_num_chunks;
+  }
+
+private:
+  struct free_page_t {
+    free_page_t *next;
+  };
+
+  struct thread_cache_t {
+    free_page_t *free_pages = nullptr;
+    std::size_t num_free_pages = 0;
+
+    char *next_page = nullptr;
+    char *chunk_end = nullptr;
+
+    // Hand over all cached and uncarved pages to the pool on thread exit.
+    ~thread_cache_t() {
+      auto &pool = instance();
+
+      for (; next_page != chunk_end; next_page += PAGE_STRIDE)
+        push(free_pages, num_free_pages, next_page);
+
+      std::lock_guard lock{pool.m_mutex};
+      transfer(free_pages, num_free_pages, pool.m_free_pages,
+               pool.m_num_free_pages, num_free_pages);
+    }
+  };
+
+  sync_prim::mutex::Mutex m_mutex;
+  free_page_t *m_free_pages = nullptr;
+  std::size_t m_num_free_pages = 0;
+  std::size_t m_num_chunks = 0;
+
+  // Caches are thread local instead of indexed by ThreadRegistry::ThreadID(),
+  // as nodes are also freed by unregistered threads (Ex: map destructors).
+  static thread_cache_t &local_cache() {
+    static thread_local thread_cache_t cache;
+
+    return cache;
+  }
+
+  static PagePool &instance() {
+    // Intentionally leaked, nodes of static maps could be freed after the
+    // pool would have been destroyed.
+    static PagePool *pool = new PagePool();
+
+    return *pool;
+  }
+
+  static void push(free_page_t *&head, std::size_t &count, void *page) {
+    auto free_page = static_cast<free_page_t *>(page);
+
+    free_page->next = head;
+    head = free_page;
+    count++;
+  }
+
+  static void *pop(free_page_t *&head, std::size_t &count) {
+    auto free_page = head;
+
+    head = free_page->next;
+    count--;
+
+    return free_page;
+  }
+
+  // Moves upto `num_pages` pages from `src` to `dst`.
+  static void transfer(free_page_t *&src, std::size_t &src_count,
+                       free_page_t *&dst, std::size_t &dst_count,
+                       std::size_t num_pages) {
+    while (num_pages-- && src)
+      push(dst, dst_count, pop(src, src_count));
+  }
+
+  void *allocate_page() {
+    auto &cache = local_cache();
+
+    if (cache.free_pages == nullptr) {
+      std::lock_guard lock{m_mutex};
+
+      transfer(m_free_pages, m_num_free_pages, cache.free_pages,
+               cache.num_free_pages, TRANSFER_BATCH_SIZE);
+    }
+
+    if (cache.free_pages)
+      return pop(cache.free_pages, cache.num_free_pages);
+
+    if (cache.next_page == cache.chunk_end) {
+      cache.next_page = static_cast<char *>(allocate_chunk());
+      cache.chunk_end = cache.next_page + PAGES_PER_CHUNK * PAGE_STRIDE;
+    }
+
+    void *page = cache.next_page;
+
+    cache.next_page += PAGE_STRIDE;
+    return page;
+  }
+
+  void free_page(void *page) {
+    auto &cache = local_cache();
+
+    push(cache.free_pages, cache.num_free_pages, page);
+
+    if (cache.num_free_pages > MAX_CACHED_PAGES) {
+      std::lock_guard lock{m_mutex};
+
+      transfer(cache.free_pages, cache.num_free_pages, m_free_pages,
+               m_num_free_pages, TRANSFER_BATCH_SIZE);
+    }
+  }
+
+  void *allocate_chunk() {
+#if defined(_WIN32)
+    void *chunk = _aligned_malloc(CHUNK_SIZE, CHUNK_SIZE);
+#else
+    void *chunk = std::aligned_alloc(CHUNK_SIZE, CHUNK_SIZE);
+#endif
+
+    if (chunk == nullptr)
+      throw std::bad_alloc{};
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // Best effort, falls back to regular pages if THP is disabled.
+    madvise(chunk, CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+
+    std::lock_guard lock{m_mutex};
+    m_num_chunks++;
+
+    return chunk;
+  }
+};
+} // namespace indexes::utils
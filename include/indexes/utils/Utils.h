@@ -5,6 +5,15 @@
 
 #include "sync_prim/ThreadRegistry.h"
 
+// Hardware transactional memory (Intel RTM or Arm TME), if the build targets
+// it (e.g. -mrtm). See `htm_begin`.
+#if defined(__RTM__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__ARM_FEATURE_TME)
+#include <arm_acle.h>
+#endif
+
 #if defined(__APPLE__) || defined(__linux__)
 #define _RESTRICT __restrict__
 #endif
@@ -18,7 +27,92 @@
 #endif
 
 namespace indexes::utils {
+static constexpr int CACHELINE_SIZE = 64;
+
 static inline int leading_zeroes(uint64_t val) { return __builtin_clzl(val); }
 static inline int leading_zeroes(uint32_t val) { return __builtin_clz(val); }
+static inline int trailing_zeroes(uint64_t val) { return __builtin_ctzl(val); }
+
+// Prefetch `NumLines` cachelines starting at `addr` for reading.
+template <int NumLines = 1> static inline void prefetch(const void *addr) {
+  for (int line = 0; line < NumLines; line++) {
+    __builtin_prefetch(static_cast<const char *>(addr) + line * CACHELINE_SIZE);
+  }
+}
+
+// Hints the CPU, that the thread is spinning on a memory location.
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Tells if hardware transactions can be started (the build targets HTM, and
+// the CPU supports it).
+static inline bool htm_supported() {
+#if defined(__RTM__)
+  static const bool supported = [] {
+    unsigned eax, ebx, ecx, edx;
+
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) &&
+           (ebx & bit_RTM) != 0;
+  }();
+
+  return supported;
+#elif defined(__ARM_FEATURE_TME)
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Starts a hardware transaction, and returns true in it. When the transaction
+// aborts, execution returns here with false, and `may_retry` tells if a retry
+// could commit (the abort was not due to the transaction's size or an
+// unsupported instruction). Must only be called if `htm_supported`.
+__attribute__((always_inline)) static inline bool htm_begin(bool &may_retry) {
+#if defined(__RTM__)
+  unsigned status = _xbegin();
+
+  if (status == _XBEGIN_STARTED)
+    return true;
+
+  may_retry =
+      (status & (_XABORT_RETRY | _XABORT_CONFLICT | _XABORT_EXPLICIT)) != 0;
+  return false;
+#elif defined(__ARM_FEATURE_TME)
+  uint64_t status = __tstart();
+
+  if (status == 0)
+    return true;
+
+  may_retry = (status & _TMFAILURE_RTRY) != 0;
+  return false;
+#else
+  may_retry = false;
+  return false;
+#endif
+}
+
+// Commits the calling thread's transaction.
+__attribute__((always_inline)) static inline void htm_commit() {
+#if defined(__RTM__)
+  _xend();
+#elif defined(__ARM_FEATURE_TME)
+  __tcommit();
+#endif
+}
+
+// Aborts the calling thread's transaction, as retryable.
+__attribute__((always_inline)) static inline void htm_abort() {
+#if defined(__RTM__)
+  _xabort(0xff);
+#elif defined(__ARM_FEATURE_TME)
+  __tcancel(0x8000);
+#endif
+}
+
 using ThreadRegistry = sync_prim::ThreadRegistry;
 } // namespace indexes::utils
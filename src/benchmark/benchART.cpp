@@ -1,3 +1,4 @@
+#include "benchPerfCounters.h"
 #include "indexes/art/map.h"
 #include "utils/utils.h"
 
@@ -22,6 +23,8 @@ static void BM_ARTInsert(benchmark::State &state) {
   uint64_t *keys = get_rand_values();
   uint64_t num_unique_keys = static_cast<uint64_t>(state.range(0));
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind];
 
@@ -50,6 +53,8 @@ static void BM_ARTSearch(benchmark::State &state) {
     return map;
   }();
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind++];
 
@@ -1,3 +1,4 @@
+#include "benchPerfCounters.h"
 #include "indexes/btree/concurrent_map.h"
 #include "utils/utils.h"
 
@@ -22,6 +23,8 @@ static void BM_BtreeInsert(benchmark::State &state) {
   int64_t ind = 0;
   int64_t *keys = get_rand_values();
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind];
 
@@ -53,6 +56,8 @@ static void BM_BtreeSearch(benchmark::State &state) {
     return map;
   }();
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind++];
 
@@ -0,0 +1,266 @@
+#include "benchPerfCounters.h"
+#include "indexes/art/concurrent_map.h"
+#include "indexes/btree/concurrent_map.h"
+#include "indexes/hashtable/concurrent_map.h"
+#include "utils/utils.h"
+#include "utils/zipfian_generator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <absl/hash/hash.h>
+#include <benchmark/benchmark.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Workloads shared by all concurrent maps, run by 1 to #cpus threads on a
+// map of `state.range(0)` keys. The map is populated once per map type and
+// key count, and shared by all its benchmarks, which restore its keys, if
+// they insert or delete.
+//
+// Keys are scattered (hashes of key indexes), so that hot indexes of a
+// skewed distribution are not neighbours.
+
+using BtreeMap = indexes::btree::concurrent_map<uint64_t, uint64_t>;
+using HashMap =
+    indexes::hashtable::concurrent_map<uint64_t, uint64_t,
+                                       absl::Hash<uint64_t>>;
+using ArtMap = indexes::art::concurrent_map<uint64_t>;
+
+// Btrees of the node size sweep, which trades the cache footprint of inner
+// nodes against the scan length of leaves.
+template <int InnerNodeSize, int LeafNodeSize>
+struct btree_node_size_traits : indexes::btree::btree_traits_default {
+  static constexpr int INNER_NODE_SIZE = InnerNodeSize;
+  static constexpr int LEAF_NODE_SIZE = LeafNodeSize;
+};
+
+template <int InnerNodeSize, int LeafNodeSize>
+using SizedBtreeMap = indexes::btree::concurrent_map<
+    uint64_t, uint64_t, btree_node_size_traits<InnerNodeSize, LeafNodeSize>>;
+
+template <typename Map> struct MapInfo;
+
+template <> struct MapInfo<BtreeMap> {
+  static constexpr const char *NAME = "Btree";
+  static constexpr bool ORDERED = true;
+};
+
+template <> struct MapInfo<HashMap> {
+  static constexpr const char *NAME = "HashTable";
+  static constexpr bool ORDERED = false;
+};
+
+template <> struct MapInfo<ArtMap> {
+  static constexpr const char *NAME = "ART";
+  static constexpr bool ORDERED = true;
+};
+
+template <> struct MapInfo<SizedBtreeMap<256, 8192>> {
+  static constexpr const char *NAME = "Btree_inner256_leaf8192";
+  static constexpr bool ORDERED = true;
+};
+
+template <> struct MapInfo<SizedBtreeMap<1024, 8192>> {
+  static constexpr const char *NAME = "Btree_inner1024_leaf8192";
+  static constexpr bool ORDERED = true;
+};
+
+template <> struct MapInfo<SizedBtreeMap<1024, 16384>> {
+  static constexpr const char *NAME = "Btree_inner1024_leaf16384";
+  static constexpr bool ORDERED = true;
+};
+
+// Proportions of operations (in percent).
+struct Workload {
+  const char *name;
+  int read_p;
+  int update_p;
+  int insert_p;
+  int delete_p;
+  int scan_p;
+};
+
+static constexpr Workload WORKLOADS[] = {
+    {"read", 100, 0, 0, 0, 0},
+    {"read90_update10", 90, 10, 0, 0, 0},
+    {"read50_update50", 50, 50, 0, 0, 0},
+    {"read50_insert25_delete25", 50, 0, 25, 25, 0},
+    {"scan95_insert5", 0, 0, 5, 0, 95},
+};
+
+enum class Dist { UNIFORM, ZIPF };
+
+static constexpr int SCAN_LENGTH = 100;
+
+static uint64_t key_of(uint64_t index) { return utils::Hash(index); }
+
+static size_t resident_bytes() {
+#if defined(__linux__)
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0, resident = 0;
+
+  statm >> size >> resident;
+
+  return resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+template <typename Map> struct SharedMap {
+  Map map;
+  // Growth of the resident set, when the map was populated.
+  double bytes_per_key;
+  // Memory of the map itself (see memory_usage()), once populated.
+  double index_bytes_per_key;
+};
+
+// Must be called by a single thread (registered with the ThreadRegistry).
+template <typename Map> static SharedMap<Map> &shared_map(int64_t num_keys) {
+  static std::map<int64_t, std::unique_ptr<SharedMap<Map>>> maps;
+  auto &shared = maps[num_keys];
+
+  if (!shared) {
+    size_t resident = resident_bytes();
+
+    shared.reset(new SharedMap<Map>);
+
+    for (int64_t index = 0; index < num_keys; index++)
+      shared->map.Insert(key_of(index), index);
+
+    shared->bytes_per_key =
+        static_cast<double>(resident_bytes() - resident) / num_keys;
+    shared->index_bytes_per_key =
+        static_cast<double>(shared->map.memory_usage().total_bytes()) /
+        num_keys;
+  }
+
+  return *shared;
+}
+
+// Key indexes of a thread, seeded by the thread's index.
+class KeyPicker {
+public:
+  KeyPicker(Dist dist, uint64_t num_keys, int thread)
+      : dist(dist), rng(thread + 1), uniform(0, num_keys - 1) {
+    // Zipfian draws from utils::RandomDouble.
+    utils::RandomEngine().seed(thread + 1);
+
+    if (dist == Dist::ZIPF)
+      zipf.reset(new ycsbc::ZipfianGenerator(0, num_keys - 1));
+  }
+
+  uint64_t next() {
+    return dist == Dist::ZIPF ? zipf->NextUnlocked() : uniform(rng);
+  }
+
+private:
+  Dist dist;
+  std::mt19937_64 rng;
+  std::uniform_int_distribution<uint64_t> uniform;
+  std::unique_ptr<ycsbc::ZipfianGenerator> zipf;
+};
+
+template <typename Map>
+static void BM_Workload(benchmark::State &state, Workload workload,
+                        Dist dist) {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  const int64_t num_keys = state.range(0);
+  static SharedMap<Map> *shared;
+
+  // Other threads wait for the setup at the start of the loop.
+  if (state.thread_index() == 0)
+    shared = &shared_map<Map>(num_keys);
+
+  KeyPicker keys(dist, num_keys, state.thread_index());
+  std::mt19937_64 rng(state.thread_index() + 1);
+  std::uniform_int_distribution<int> percent(0, 99);
+  ScopedPerfCounters perf_counters(state);
+
+  for (auto _ : state) {
+    Map &map = shared->map;
+    uint64_t index = keys.next();
+    uint64_t key = key_of(index);
+    int op = percent(rng);
+
+    if ((op -= workload.read_p) < 0) {
+      benchmark::DoNotOptimize(map.Search(key));
+    } else if ((op -= workload.update_p) < 0) {
+      benchmark::DoNotOptimize(map.Update(key, index + 1));
+    } else if ((op -= workload.insert_p) < 0) {
+      benchmark::DoNotOptimize(map.Insert(key, index));
+    } else if ((op -= workload.delete_p) < 0) {
+      benchmark::DoNotOptimize(map.Delete(key));
+    } else {
+      if constexpr (MapInfo<Map>::ORDERED) {
+        int length = 0;
+
+        for (auto it = map.lower_bound(key);
+             it != map.end() && length < SCAN_LENGTH; ++it, ++length) {
+          benchmark::DoNotOptimize(it->second);
+        }
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+
+  // Other threads have finished their loop.
+  if (state.thread_index() == 0) {
+    state.counters["bytes_per_key"] = shared->bytes_per_key;
+    state.counters["index_bytes_per_key"] = shared->index_bytes_per_key;
+
+    if (workload.insert_p || workload.delete_p) {
+      for (int64_t index = 0; index < num_keys; index++)
+        shared->map.Insert(key_of(index), index);
+    }
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+// With `reads_and_scans`, only the read only and scan workloads are run.
+template <typename Map>
+static bool register_suite(bool reads_and_scans = false) {
+  int max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for (const auto &workload : WORKLOADS) {
+    if (workload.scan_p && !MapInfo<Map>::ORDERED)
+      continue;
+
+    if (reads_and_scans && workload.read_p != 100 && !workload.scan_p)
+      continue;
+
+    for (auto dist : {Dist::UNIFORM, Dist::ZIPF}) {
+      std::string name = std::string("BM_") + MapInfo<Map>::NAME + "/" +
+                         workload.name + "/" +
+                         (dist == Dist::ZIPF ? "zipf" : "uniform");
+
+      benchmark::RegisterBenchmark(name.c_str(), BM_Workload<Map>, workload,
+                                   dist)
+          ->ArgName("keys")
+          ->Arg(1 << 20)
+          ->ThreadRange(1, max_threads)
+          ->UseRealTime();
+    }
+  }
+
+  return true;
+}
+
+static const bool registered =
+    register_suite<BtreeMap>() && register_suite<HashMap>() &&
+    register_suite<ArtMap>() &&
+    register_suite<SizedBtreeMap<256, 8192>>(true) &&
+    register_suite<SizedBtreeMap<1024, 8192>>(true) &&
+    register_suite<SizedBtreeMap<1024, 16384>>(true);
@@ -1,3 +1,4 @@
+#include "benchPerfCounters.h"
 #include "indexes/hashtable/concurrent_map.h"
 #include "utils/utils.h"
 
@@ -26,6 +27,8 @@ static void BM_HashTableInsert(benchmark::State &state) {
   uint64_t *keys = get_rand_values();
   uint64_t num_unique_keys = static_cast<uint64_t>(state.range(0));
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind];
 
@@ -58,6 +61,8 @@ static void BM_HashTableSearch(benchmark::State &state) {
     return map;
   }();
 
+  ScopedPerfCounters perf_counters(state);
+
   for (auto _ : state) {
     auto key = keys[ind++];
 
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "utils/perf_counters.h"
+
+#include <benchmark/benchmark.h>
+
+// Counts hardware events of the calling benchmark thread, from construction
+// until destruction, into the benchmark's counters as values per iteration
+// (of all threads). Construct it right before the benchmark loop, so that
+// setup is not counted.
+class ScopedPerfCounters {
+public:
+  explicit ScopedPerfCounters(benchmark::State &state) : state(state) {
+    counters.Start();
+  }
+
+  ~ScopedPerfCounters() {
+    counters.Stop();
+
+    auto counts = counters.Read();
+
+    for (int event = 0; event < utils::PerfCounters::NUM_EVENTS; event++) {
+      if (counts.counted[event]) {
+        state.counters[utils::PerfCounters::EventName(event)] =
+            benchmark::Counter(counts.values[event],
+                               benchmark::Counter::kAvgIterations);
+      }
+    }
+  }
+
+private:
+  benchmark::State &state;
+  utils::PerfCounters counters;
+};
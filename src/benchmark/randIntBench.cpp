@@ -1,6 +1,12 @@
 #include "indexes/art/concurrent_map.h"
+#include "indexes/btree/cached_map.h"
 #include "indexes/btree/concurrent_map.h"
 #include "indexes/hashtable/concurrent_map.h"
+#include "utils/affinity.h"
+#include "utils/hotspot_generator.h"
+#include "utils/moving_hotspot_generator.h"
+#include "utils/perf_counters.h"
+#include "utils/trace_replay.h"
 #include "utils/uniform_generator.h"
 #include "utils/zipfian_generator.h"
 
@@ -10,9 +16,13 @@
 #include <cinttypes>
 #include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <vector>
 
 #include <absl/hash/hash.h>
 #include <boost/program_options.hpp>
@@ -21,18 +31,42 @@ struct btree_big_page_traits : indexes::btree::btree_traits_default {
   static constexpr int NODE_SIZE = 4 * 1024;
 };
 
+// Elides leaf locks in hardware transactions, if built with HTM (-mrtm).
+struct btree_lock_elision_traits : btree_big_page_traits {
+  static constexpr bool LOCK_ELISION = true;
+};
+
 using u64 = uint64_t;
 
 using BtreeMap =
     indexes::btree::concurrent_map<u64, u64, btree_big_page_traits>;
+using ElidedBtreeMap =
+    indexes::btree::concurrent_map<u64, u64, btree_lock_elision_traits>;
+using CachedBtreeMap =
+    indexes::btree::cached_map<u64, u64, btree_big_page_traits>;
 using HashMap = indexes::hashtable::concurrent_map<u64, u64, absl::Hash<u64>>;
 using ArtMap = indexes::art::concurrent_map<u64>;
+using PerfCounts = utils::PerfCounters::Counts;
 
 struct BMArgs {
-  enum class MapType { BtreeMap, HashMap, ArtMap };
+  enum class MapType {
+    BtreeMap,
+    ElidedBtreeMap,
+    CachedBtreeMap,
+    HashMap,
+    ArtMap
+  };
 
   MapType map;
+  // Of the hot key cache of CachedBtreeMap.
+  size_t cache_size;
   std::string dist;
+  // Of the hotspot distributions.
+  double hot_data;
+  double hot_ops;
+  uint64_t hot_move;
+  // Operations and keys of the `trace` distribution, shared by all threads.
+  std::shared_ptr<ycsbc::TraceReplay> trace;
   int64_t rowcount;
   int64_t opercount;
   int num_threads;
@@ -40,13 +74,19 @@ struct BMArgs {
   int insert_p;
   int delete_p;
   int update_p;
+  // Threads of both the populate and the transaction phase are pinned.
+  utils::CpuPinning pinning;
+  std::string numa_policy;
+  // Hardware events of each thread are counted, in both phases.
+  bool perf;
 
   bool check_operations_proportions() const {
     return read_p + insert_p + delete_p + update_p == 100;
   }
 
   bool check_distribution() const {
-    return dist == "zipf" || dist == "uniform";
+    return dist == "zipf" || dist == "uniform" || dist == "hotspot" ||
+           dist == "moving_hotspot" || dist == "trace";
   }
 };
 
@@ -116,8 +156,11 @@ public:
   inline const IntType &operator[](size_t index) const { return data[index]; }
 };
 
+// Counts of thread `i` are written to `perf[i]`, if `perf` is given.
 template <typename MapType>
-static auto insert_values(MapType &map, int64_t rowcount, int num_threads) {
+static auto insert_values(MapType &map, int64_t rowcount, int num_threads,
+                          const utils::CpuPinning &pinning,
+                          std::vector<PerfCounts> *perf) {
   std::vector<std::thread> workers;
   Permutation<int64_t> generator(rowcount);
 
@@ -127,9 +170,14 @@ static auto insert_values(MapType &map, int64_t rowcount, int num_threads) {
   auto start = std::chrono::steady_clock::now();
 
   for (int i = 0; i < num_threads; i++) {
-    workers.emplace_back([&]() {
+    workers.emplace_back([&, i]() {
+      pinning.Pin(i);
       indexes::utils::ThreadRegistry::RegisterThread();
 
+      utils::PerfCounters counters(perf != nullptr);
+
+      counters.Start();
+
       do {
         auto start = next_batch.fetch_add(BATCH);
         auto end = std::min(start + BATCH, rowcount);
@@ -142,6 +190,11 @@ static auto insert_values(MapType &map, int64_t rowcount, int num_threads) {
         }
       } while (next_batch < rowcount);
 
+      counters.Stop();
+
+      if (perf)
+        (*perf)[i] = counters.Read();
+
       indexes::utils::ThreadRegistry::UnregisterThread();
     });
   }
@@ -158,14 +211,35 @@ static auto insert_values(MapType &map, int64_t rowcount, int num_threads) {
                   static_cast<std::chrono::milliseconds::rep>(1));
 }
 
+enum Oper { READ, INSERT, DELETE, UPDATE };
+
+// Scans are replayed as reads, and read-modify-writes as updates.
+static Oper trace_op(uint8_t op) {
+  switch (op) {
+  case ycsbc::TraceReplay::INSERT:
+    return INSERT;
+  case ycsbc::TraceReplay::DELETE:
+    return DELETE;
+  case ycsbc::TraceReplay::UPDATE:
+  case ycsbc::TraceReplay::READMODIFYWRITE:
+    return UPDATE;
+  default:
+    return READ;
+  }
+}
+
 template <typename MapType>
-static void worker(std::promise<uint64_t> result, std::string dist,
-                   MapType &map, int64_t rowcount,
-                   std::atomic<int64_t> &opercount, int read_p, int insert_p,
-                   int delete_p, int update_p) {
+static void worker(std::promise<uint64_t> result, const BMArgs &args,
+                   int thread, PerfCounts *perf, MapType &map,
+                   std::atomic<int64_t> &opercount) {
+  args.pinning.Pin(thread);
   indexes::utils::ThreadRegistry::RegisterThread();
 
-  enum Oper { READ, INSERT, DELETE, UPDATE };
+  const std::string &dist = args.dist;
+  const int64_t rowcount = args.rowcount;
+  const int read_p = args.read_p;
+  const int insert_p = args.insert_p;
+  const int delete_p = args.delete_p;
 
   auto get_key = [&]() {
     if (dist == "zipf") {
@@ -180,6 +254,20 @@ static void worker(std::promise<uint64_t> result, std::string dist,
             0, static_cast<uint64_t>(rowcount)};
         return ugenerator.NextUnlocked();
       });
+    } else if (dist == "hotspot") {
+      return static_cast<std::function<uint64_t()>>([&]() {
+        static thread_local ycsbc::HotspotGenerator hgenerator{
+            0, static_cast<uint64_t>(rowcount), args.hot_data, args.hot_ops};
+        return hgenerator.Next();
+      });
+    } else if (dist == "moving_hotspot") {
+      // The hot set of each thread moves every `hot_move` of its operations.
+      return static_cast<std::function<uint64_t()>>([&]() {
+        static thread_local ycsbc::MovingHotspotGenerator mgenerator{
+            0, static_cast<uint64_t>(rowcount), args.hot_data, args.hot_ops,
+            args.hot_move};
+        return mgenerator.Next();
+      });
     } else {
       return static_cast<std::function<uint64_t()>>([]() {
         std::terminate();
@@ -207,31 +295,54 @@ static void worker(std::promise<uint64_t> result, std::string dist,
                                                               : UPDATE));
   };
 
+  std::optional<ycsbc::TraceReplay::Cursor> trace;
+
+  if (args.trace)
+    trace.emplace(*args.trace);
+
+  auto next = [&]() -> std::pair<Oper, uint64_t> {
+    if (trace) {
+      const auto &entry = trace->Next();
+
+      return {trace_op(entry.op), entry.key};
+    }
+
+    auto op = get_op();
+
+    return {op, get_key()};
+  };
+
+  utils::PerfCounters counters(perf != nullptr);
+
+  counters.Start();
+
   while (opercount-- > 0) {
     auto local_opercount = BATCH;
 
     while (local_opercount--) {
-      switch (get_op()) {
+      auto [op, key] = next();
+
+      switch (op) {
       case READ:
-        if (map.Search(get_key()))
+        if (map.Search(key))
           num_successful_ops++;
 
         break;
 
       case DELETE:
-        if (map.Delete(get_key()))
+        if (map.Delete(key))
           num_successful_ops++;
 
         break;
 
       case INSERT:
-        if (map.Insert(get_key(), hasher(local_opercount)))
+        if (map.Insert(key, hasher(local_opercount)))
           num_successful_ops++;
 
         break;
 
       case UPDATE:
-        if (map.Update(get_key(), hasher(local_opercount)))
+        if (map.Update(key, hasher(local_opercount)))
           num_successful_ops++;
 
         break;
@@ -241,6 +352,11 @@ static void worker(std::promise<uint64_t> result, std::string dist,
     opercount -= BATCH;
   }
 
+  counters.Stop();
+
+  if (perf)
+    *perf = counters.Read();
+
   result.set_value(num_successful_ops);
 
   indexes::utils::ThreadRegistry::UnregisterThread();
@@ -255,18 +371,67 @@ static void map_reserve(MapType &map, const BMArgs &args) {
   indexes::utils::ThreadRegistry::UnregisterThread();
 }
 
+// Prints counts of all threads per operation, on a single line.
+static void report_perf(const std::vector<PerfCounts> &perf, int64_t num_ops) {
+  PerfCounts total;
+
+  for (const auto &counts : perf)
+    total += counts;
+
+  std::cout << "Perf counters per operation :";
+
+  if (!total.Any()) {
+    std::cout << " unavailable\n";
+    return;
+  }
+
+  for (int event = 0; event < utils::PerfCounters::NUM_EVENTS; event++) {
+    if (total.counted[event]) {
+      std::cout << ' ' << utils::PerfCounters::EventName(event) << ' '
+                << total.values[event] / num_ops;
+    }
+  }
+
+  std::cout << std::endl;
+}
+
+template <typename MapType>
+static std::unique_ptr<MapType> make_map(const BMArgs &args) {
+  if constexpr (std::is_same_v<MapType, CachedBtreeMap>)
+    return std::make_unique<MapType>(args.cache_size);
+  else
+    return std::make_unique<MapType>();
+}
+
 template <typename MapType> static void do_benchmark(const BMArgs &args) {
-  MapType map;
+  std::cout << "Thread to cpu mapping : "
+            << args.pinning.Mapping(args.num_threads) << "\n";
+  std::cout << "NUMA memory policy : "
+            << (args.numa_policy.empty() ? "default" : args.numa_policy)
+            << "\n";
+
+  auto map_ptr = make_map<MapType>(args);
+  MapType &map = *map_ptr;
 
   map_reserve(map, args);
 
   {
-    auto millis_elapsed = insert_values(map, args.rowcount, args.num_threads);
+    std::vector<PerfCounts> perf(args.num_threads);
+    auto millis_elapsed =
+        insert_values(map, args.rowcount, args.num_threads, args.pinning,
+                      args.perf ? &perf : nullptr);
 
     std::cout << "Populated " << args.rowcount << " values in "
               << millis_elapsed << " ms\n";
     std::cout << "Insert Transaction throughput (KTPS) : "
               << args.rowcount / millis_elapsed << std::endl;
+    std::cout << "Memory usage (bytes per key) : "
+              << static_cast<double>(map.memory_usage().total_bytes()) /
+                     args.rowcount
+              << std::endl;
+
+    if (args.perf)
+      report_perf(perf, args.rowcount);
   }
 
   {
@@ -274,6 +439,7 @@ template <typename MapType> static void do_benchmark(const BMArgs &args) {
     std::vector<std::future<uint64_t>> results;
     std::atomic<int64_t> shared_opercount{args.opercount};
     uint64_t num_successful_ops = 0;
+    std::vector<PerfCounts> perf(args.num_threads);
 
     auto start = std::chrono::steady_clock::now();
 
@@ -281,10 +447,9 @@ template <typename MapType> static void do_benchmark(const BMArgs &args) {
       std::promise<uint64_t> result;
 
       results.emplace_back(result.get_future());
-      workers.emplace_back(worker<MapType>, std::move(result), args.dist,
-                           std::ref(map), args.rowcount,
-                           std::ref(shared_opercount), args.read_p,
-                           args.insert_p, args.delete_p, args.update_p);
+      workers.emplace_back(worker<MapType>, std::move(result), std::cref(args),
+                           i, args.perf ? &perf[i] : nullptr, std::ref(map),
+                           std::ref(shared_opercount));
     }
 
     for (auto &result : results) {
@@ -303,6 +468,14 @@ template <typename MapType> static void do_benchmark(const BMArgs &args) {
     std::cout << "Transaction throughput (KTPS) : "
               << args.opercount / millis_elapsed << std::endl;
 
+    if (args.perf)
+      report_perf(perf, args.opercount);
+
+    if constexpr (std::is_same_v<MapType, CachedBtreeMap>) {
+      std::cout << "Cache hit ratio : " << map.cache_stats().hit_ratio()
+                << std::endl;
+    }
+
     for (auto &worker : workers) {
       worker.join();
     }
@@ -321,6 +494,14 @@ static void do_benchmark(const BMArgs &args) {
     do_benchmark<BtreeMap>(args);
     break;
 
+  case BMArgs::MapType::ElidedBtreeMap:
+    do_benchmark<ElidedBtreeMap>(args);
+    break;
+
+  case BMArgs::MapType::CachedBtreeMap:
+    do_benchmark<CachedBtreeMap>(args);
+    break;
+
   case BMArgs::MapType::ArtMap:
     do_benchmark<ArtMap>(args);
     break;
@@ -335,7 +516,11 @@ int main(int argc, char *argv[]) {
   options.add_options()("help,h", "Display this help message");
 
   options.add_options()("map,m", po::value<std::string>()->required(),
-                        "Maptype Hash/Btree");
+                        "Maptype Hash/Btree/ElidedBtree/CachedBtree/ART")(
+      "cache-size",
+      po::value<size_t>()->default_value(
+          CachedBtreeMap::DEFAULT_CACHE_CAPACITY),
+      "# key/values in the hot key cache of CachedBtree");
 
   options.add_options()("rowcount,R", po::value<int64_t>()->required(),
                         "Record count")(
@@ -346,7 +531,19 @@ int main(int argc, char *argv[]) {
 
   options.add_options()(
       "dist,D", po::value<std::string>()->required(),
-      "Distribution of data. One of `uniform` or `zipf` distribution");
+      "Distribution of data. One of `uniform`, `zipf`, `hotspot`, "
+      "`moving_hotspot` or `trace` (operations and keys replayed from "
+      "--trace, instead of the proportions)");
+
+  options.add_options()("hot-data", po::value<double>()->default_value(0.2),
+                        "Fraction of keys in the hot set of hotspots")(
+      "hot-ops", po::value<double>()->default_value(0.8),
+      "Fraction of operations on the hot set of hotspots")(
+      "hot-move", po::value<uint64_t>()->default_value(100000),
+      "# operations of a thread, after which a moving hotspot moves")(
+      "trace", po::value<std::string>(),
+      "Trace of (key, operation) entries, as read by ycsbc::TraceReplay. "
+      "Keys of the map are 0 to rowcount - 1");
 
   options.add_options()("read,r", po::value<int>()->required(),
                         "Read proportion")(
@@ -354,6 +551,16 @@ int main(int argc, char *argv[]) {
       "delete,d", po::value<int>()->required(), "Delete proportion")(
       "update,u", po::value<int>()->required(), "Update proportion");
 
+  options.add_options()("pin", po::value<std::string>()->default_value("none"),
+                        "Pin threads to cpus. One of `compact`, `scatter`, "
+                        "a cpu list (Ex: 0,2,4-7) or `none`")(
+      "numa-interleave", "Interleave memory across NUMA nodes")(
+      "numa-local", "Place memory on the NUMA node of the allocating thread");
+
+  options.add_options()("perf",
+                        "Count cycles, instructions, cache, TLB and branch "
+                        "misses per operation");
+
   try {
     po::variables_map vm;
 
@@ -364,14 +571,29 @@ int main(int argc, char *argv[]) {
     std::string maptype;
 
     maptype = vm["map"].as<std::string>();
+    args.cache_size = vm["cache-size"].as<size_t>();
     args.rowcount = vm["rowcount"].as<int64_t>();
     args.opercount = vm["opercount"].as<int64_t>();
     args.num_threads = vm["threads"].as<int>();
     args.dist = vm["dist"].as<std::string>();
+    args.hot_data = vm["hot-data"].as<double>();
+    args.hot_ops = vm["hot-ops"].as<double>();
+    args.hot_move = vm["hot-move"].as<uint64_t>();
     args.read_p = vm["read"].as<int>();
     args.insert_p = vm["insert"].as<int>();
     args.delete_p = vm["delete"].as<int>();
     args.update_p = vm["update"].as<int>();
+    args.pinning = utils::CpuPinning{vm["pin"].as<std::string>()};
+    args.perf = vm.count("perf");
+
+    if (vm.count("numa-interleave") && vm.count("numa-local"))
+      throw std::string{
+          "Only one of numa-interleave and numa-local is allowed"};
+
+    if (vm.count("numa-interleave"))
+      args.numa_policy = "interleave";
+    else if (vm.count("numa-local"))
+      args.numa_policy = "local";
 
     if (args.rowcount % args.num_threads != 0)
       args.rowcount =
@@ -384,21 +606,41 @@ int main(int argc, char *argv[]) {
     if (!args.check_distribution())
       throw std::string{"Unsupported data distribution requested"};
 
+    if (args.hot_data < 0 || args.hot_data > 1 || args.hot_ops < 0 ||
+        args.hot_ops > 1)
+      throw std::string{"Hotspot fractions should be in [0, 1]"};
+
+    if ((args.dist == "trace") != (vm.count("trace") > 0))
+      throw std::string{"The trace distribution requires a trace, and only it"};
+
+    if (vm.count("trace"))
+      args.trace = std::make_shared<ycsbc::TraceReplay>(
+          vm["trace"].as<std::string>());
+
     std::transform(maptype.begin(), maptype.end(), maptype.begin(), ::tolower);
 
     if (maptype == "hash")
       args.map = BMArgs::MapType::HashMap;
     else if (maptype == "btree")
       args.map = BMArgs::MapType::BtreeMap;
+    else if (maptype == "elidedbtree")
+      args.map = BMArgs::MapType::ElidedBtreeMap;
+    else if (maptype == "cachedbtree")
+      args.map = BMArgs::MapType::CachedBtreeMap;
     else if (maptype == "art")
       args.map = BMArgs::MapType::ArtMap;
     else
       throw std::string{"Unsupported MapType requested"};
 
+    // Before the map and threads are created, so that they inherit it.
+    utils::SetNumaPolicy(args.numa_policy);
+
     do_benchmark(args);
   } catch (const po::error &ex) {
     std::cerr << "ERROR: " << ex.what() << std::endl;
     std::cerr << options << std::endl;
+  } catch (const utils::Exception &ex) {
+    std::cerr << "ERROR: " << ex.what() << std::endl;
   } catch (...) {
     std::cerr << options << std::endl;
   }
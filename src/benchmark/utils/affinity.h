@@ -0,0 +1,168 @@
+//
+//  affinity.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_AFFINITY_H_
+#define YCSB_C_AFFINITY_H_
+
+#include "indexes/utils/Numa.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace utils {
+///
+/// Thread to cpu mapping of benchmark threads, given as
+///   compact: threads fill cpus of a NUMA node, before the next node
+///   scatter: threads are spread round robin across NUMA nodes
+///   a cpu list (Ex: "0,2,4-7"): the i'th thread runs on the i'th cpu
+///   none: threads are not pinned
+/// Threads wrap around to the first cpu, if there are more threads than cpus.
+///
+class CpuPinning {
+public:
+  explicit CpuPinning(const std::string &spec = "none") {
+    if (spec == "compact" || spec == "scatter") {
+      std::vector<std::vector<int>> nodes;
+
+      for (int node = 0; node < indexes::utils::numa::num_nodes(); node++)
+        nodes.push_back(indexes::utils::numa::node_cpus(node));
+
+      if (std::all_of(nodes.begin(), nodes.end(),
+                      [](const auto &cpus) { return cpus.empty(); })) {
+        // Unknown topology, a single node.
+        nodes.assign(1, {});
+        for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency();
+             cpu++) {
+          nodes[0].push_back(cpu);
+        }
+      }
+
+      if (spec == "compact") {
+        for (const auto &cpus : nodes)
+          cpus_.insert(cpus_.end(), cpus.begin(), cpus.end());
+      } else {
+        for (size_t i = 0; cpus_.size() < NumCpus(nodes); i++) {
+          for (const auto &cpus : nodes) {
+            if (i < cpus.size())
+              cpus_.push_back(cpus[i]);
+          }
+        }
+      }
+    } else if (spec != "none" && !spec.empty()) {
+      cpus_ = ParseList(spec);
+
+      for (int cpu : cpus_) {
+        if (cpu >= static_cast<int>(std::thread::hardware_concurrency()))
+          throw Exception("Unknown cpu " + std::to_string(cpu));
+      }
+    }
+  }
+
+  bool Enabled() const { return !cpus_.empty(); }
+
+  /// Cpu of the `thread`th thread, or -1 if threads are not pinned.
+  int CpuOf(int thread) const {
+    return Enabled() ? cpus_[thread % cpus_.size()] : -1;
+  }
+
+  /// Pins the calling thread, the `thread`th one, to its cpu.
+  void Pin(int thread) const {
+    if (Enabled() && !indexes::utils::numa::run_on_cpu(CpuOf(thread))) {
+      throw Exception("Could not pin thread " + std::to_string(thread) +
+                      " to cpu " + std::to_string(CpuOf(thread)));
+    }
+  }
+
+  /// Mapping of `num_threads` threads (Ex: "0->0 1->2"), or "none".
+  std::string Mapping(int num_threads) const {
+    if (!Enabled())
+      return "none";
+
+    std::string mapping;
+
+    for (int thread = 0; thread < num_threads; thread++) {
+      mapping.append(thread ? " " : "")
+          .append(std::to_string(thread))
+          .append("->")
+          .append(std::to_string(CpuOf(thread)));
+    }
+
+    return mapping;
+  }
+
+private:
+  std::vector<int> cpus_;
+
+  static size_t NumCpus(const std::vector<std::vector<int>> &nodes) {
+    size_t num = 0;
+
+    for (const auto &cpus : nodes)
+      num += cpus.size();
+
+    return num;
+  }
+
+  static std::vector<int> ParseList(const std::string &list) {
+    std::vector<int> cpus;
+    const char *str = list.c_str();
+
+    while (true) {
+      char *end;
+      long first = std::strtol(str, &end, 10);
+      long last = first;
+
+      if (end == str || first < 0)
+        throw Exception("Invalid cpu list: " + list);
+
+      if (*end == '-') {
+        str = end + 1;
+        last = std::strtol(str, &end, 10);
+
+        if (end == str || last < first)
+          throw Exception("Invalid cpu list: " + list);
+      }
+
+      for (long cpu = first; cpu <= last; cpu++)
+        cpus.push_back(static_cast<int>(cpu));
+
+      if (*end == '\0')
+        return cpus;
+
+      if (*end != ',')
+        throw Exception("Invalid cpu list: " + list);
+
+      str = end + 1;
+    }
+  }
+};
+
+///
+/// Sets NUMA placement of memory, allocated later by the calling thread and
+/// threads it creates afterwards, to "interleave" or "local" (or leaves it
+/// as is, for "default").
+///
+inline void SetNumaPolicy(const std::string &policy) {
+  using indexes::utils::numa::memory_policy;
+
+  if (policy == "default" || policy.empty())
+    return;
+
+  if (policy != "interleave" && policy != "local")
+    throw Exception("Unknown NUMA policy: " + policy);
+
+  if (!indexes::utils::numa::set_memory_policy(
+          policy == "interleave" ? memory_policy::interleave
+                                 : memory_policy::local)) {
+    throw Exception("Could not set NUMA policy " + policy);
+  }
+}
+
+} // namespace utils
+
+#endif // YCSB_C_AFFINITY_H_
@@ -0,0 +1,66 @@
+//
+//  hotspot_generator.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_HOTSPOT_GENERATOR_H_
+#define YCSB_C_HOTSPOT_GENERATOR_H_
+
+#include "generator.h"
+#include "utils.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace ycsbc {
+///
+/// Values in [min, max] (both inclusive), of which the first
+/// `hot_set_fraction` are the hot set. `hot_op_fraction` of values are drawn
+/// uniformly from the hot set, and the rest uniformly from the others (as
+/// HotspotIntegerGenerator of YCSB).
+///
+/// Draws from utils::RandomDouble, so that threads could share it without
+/// locking.
+///
+class HotspotGenerator : public Generator<uint64_t> {
+public:
+  HotspotGenerator(uint64_t min, uint64_t max, double hot_set_fraction,
+                   double hot_op_fraction)
+      : min_(min), hot_interval_((max - min + 1) * hot_set_fraction),
+        cold_interval_(max - min + 1 - hot_interval_),
+        hot_op_fraction_(hot_op_fraction) {
+    if (hot_set_fraction < 0 || hot_set_fraction > 1 || hot_op_fraction < 0 ||
+        hot_op_fraction > 1) {
+      throw utils::Exception("Hotspot fractions must be in [0, 1]");
+    }
+    Next();
+  }
+
+  uint64_t Next();
+  uint64_t Last() { return last_; }
+
+  uint64_t hot_interval() const { return hot_interval_; }
+
+private:
+  static uint64_t Uniform(uint64_t num_values) {
+    return static_cast<uint64_t>(utils::RandomDouble() * num_values);
+  }
+
+  uint64_t min_;
+  uint64_t hot_interval_;
+  uint64_t cold_interval_;
+  double hot_op_fraction_;
+  std::atomic<uint64_t> last_;
+};
+
+inline uint64_t HotspotGenerator::Next() {
+  bool hot = cold_interval_ == 0 ||
+             (hot_interval_ && utils::RandomDouble() < hot_op_fraction_);
+
+  return last_ = hot ? min_ + Uniform(hot_interval_)
+                     : min_ + hot_interval_ + Uniform(cold_interval_);
+}
+
+} // namespace ycsbc
+
+#endif // YCSB_C_HOTSPOT_GENERATOR_H_
@@ -0,0 +1,55 @@
+//
+//  moving_hotspot_generator.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_MOVING_HOTSPOT_GENERATOR_H_
+#define YCSB_C_MOVING_HOTSPOT_GENERATOR_H_
+
+#include "generator.h"
+#include "hotspot_generator.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace ycsbc {
+///
+/// Hotspot (see HotspotGenerator), whose hot set moves to the next range of
+/// values every `move_period` values drawn (by all threads), wrapping around
+/// to `min` after `max`. Models hot ranges, which shift over time (Ex: the
+/// most recent day of a time series).
+///
+class MovingHotspotGenerator : public Generator<uint64_t> {
+public:
+  MovingHotspotGenerator(uint64_t min, uint64_t max, double hot_set_fraction,
+                         double hot_op_fraction, uint64_t move_period)
+      : min_(min), num_values_(max - min + 1),
+        hotspot_(0, max - min, hot_set_fraction, hot_op_fraction),
+        move_period_(move_period ? move_period : 1), num_drawn_(0) {
+    Next();
+  }
+
+  uint64_t Next();
+  uint64_t Last() { return last_; }
+
+private:
+  uint64_t min_;
+  uint64_t num_values_;
+  HotspotGenerator hotspot_;
+  uint64_t move_period_;
+  std::atomic<uint64_t> num_drawn_;
+  std::atomic<uint64_t> last_;
+};
+
+inline uint64_t MovingHotspotGenerator::Next() {
+  uint64_t moves =
+      num_drawn_.fetch_add(1, std::memory_order_relaxed) / move_period_;
+  uint64_t offset = static_cast<unsigned __int128>(moves % num_values_) *
+                    hotspot_.hot_interval() % num_values_;
+
+  return last_ = min_ + (hotspot_.Next() + offset) % num_values_;
+}
+
+} // namespace ycsbc
+
+#endif // YCSB_C_MOVING_HOTSPOT_GENERATOR_H_
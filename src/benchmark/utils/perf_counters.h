@@ -0,0 +1,197 @@
+//
+//  perf_counters.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_PERF_COUNTERS_H_
+#define YCSB_C_PERF_COUNTERS_H_
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace utils {
+///
+/// Hardware event counters of the calling thread (user space only), opened
+/// as a single perf_event group, so that all events are counted over the same
+/// intervals. Events the machine (or perf_event_paranoid) does not allow are
+/// left out, and none are counted outside linux.
+///
+class PerfCounters {
+public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    L1D_MISSES,
+    LLC_MISSES,
+    DTLB_MISSES,
+    BRANCH_MISSES,
+    NUM_EVENTS
+  };
+
+  static const char *EventName(int event) {
+    static const char *names[NUM_EVENTS] = {
+        "cycles",     "instructions", "L1D-misses",
+        "LLC-misses", "dTLB-misses",  "branch-misses"};
+    return names[event];
+  }
+
+  ///
+  /// Counts of events, summed over threads. Counts are scaled up, if the
+  /// group was multiplexed with others.
+  ///
+  struct Counts {
+    std::array<double, NUM_EVENTS> values{};
+    std::array<bool, NUM_EVENTS> counted{};
+
+    Counts &operator+=(const Counts &other) {
+      for (int event = 0; event < NUM_EVENTS; ++event) {
+        values[event] += other.values[event];
+        counted[event] = counted[event] || other.counted[event];
+      }
+      return *this;
+    }
+
+    bool Any() const {
+      for (bool c : counted) {
+        if (c) {
+          return true;
+        }
+      }
+      return false;
+    }
+  };
+
+  /// Opens the counters (stopped), if `enable` is set.
+  explicit PerfCounters(bool enable = true) {
+    if (enable) {
+      Open();
+    }
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  ~PerfCounters() {
+#if defined(__linux__)
+    for (int fd : fds_) {
+      close(fd);
+    }
+#endif
+  }
+
+  bool Available() const { return !fds_.empty(); }
+
+  /// Starts counting, adding to counts of earlier intervals.
+  void Start() { Enable(true); }
+
+  void Stop() { Enable(false); }
+
+  Counts Read() const {
+    Counts counts;
+#if defined(__linux__)
+    if (!Available()) {
+      return counts;
+    }
+
+    // See PERF_FORMAT_GROUP in perf_event_open(2).
+    std::vector<uint64_t> data(3 + events_.size());
+    if (read(fds_[0], data.data(), data.size() * sizeof(uint64_t)) <= 0 ||
+        data[2] == 0) {
+      return counts;
+    }
+
+    double scale = static_cast<double>(data[1]) / data[2];
+    for (size_t i = 0; i < events_.size(); ++i) {
+      counts.values[events_[i]] = data[3 + i] * scale;
+      counts.counted[events_[i]] = true;
+    }
+#endif
+    return counts;
+  }
+
+private:
+  // Counter file of each opened event, the first one leads the group.
+  std::vector<int> fds_;
+  std::vector<Event> events_;
+
+#if defined(__linux__)
+  void Open() {
+    for (int event = 0; event < NUM_EVENTS; ++event) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      SetEvent(attr, static_cast<Event>(event));
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      // Members follow the leader.
+      attr.disabled = fds_.empty();
+
+      int fd = syscall(SYS_perf_event_open, &attr, 0, -1,
+                       fds_.empty() ? -1 : fds_[0], 0);
+      if (fd >= 0) {
+        fds_.push_back(fd);
+        events_.push_back(static_cast<Event>(event));
+      }
+    }
+  }
+
+  static void SetEvent(perf_event_attr &attr, Event event) {
+    auto cache_miss = [&](uint64_t cache) {
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+
+    switch (event) {
+    case CYCLES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case INSTRUCTIONS:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case L1D_MISSES:
+      cache_miss(PERF_COUNT_HW_CACHE_L1D);
+      break;
+    case LLC_MISSES:
+      cache_miss(PERF_COUNT_HW_CACHE_LL);
+      break;
+    case DTLB_MISSES:
+      cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+      break;
+    case BRANCH_MISSES:
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+      break;
+    default:
+      break;
+    }
+  }
+
+  void Enable(bool enable) {
+    if (Available()) {
+      ioctl(fds_[0], enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE,
+            PERF_IOC_FLAG_GROUP);
+    }
+  }
+#else
+  void Open() {}
+  void Enable(bool) {}
+#endif
+};
+
+} // namespace utils
+
+#endif // YCSB_C_PERF_COUNTERS_H_
@@ -0,0 +1,95 @@
+//
+//  trace_replay.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_TRACE_REPLAY_H_
+#define YCSB_C_TRACE_REPLAY_H_
+
+#include "indexes/utils/MappedFile.h"
+#include "utils.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ycsbc {
+///
+/// Replays a binary trace of operations (Ex: recorded from production),
+/// which is an array of Entry (in native byte order). Keys are key numbers,
+/// which benchmarks map to their keys, as they do with generated ones.
+///
+/// The trace is mmap'd, and entries are read in place. Threads share the
+/// trace, each replaying the entries it claims through its Cursor, so that
+/// every entry is replayed once per pass. Replay wraps around to the first
+/// entry at the end.
+///
+class TraceReplay {
+public:
+  enum Op : uint8_t { READ, UPDATE, INSERT, DELETE, SCAN, READMODIFYWRITE };
+
+  struct Entry {
+    uint64_t key;
+    uint8_t op;
+    uint8_t reserved[7];
+  };
+
+  static_assert(sizeof(Entry) == 16, "Trace entries are 16 bytes");
+
+  ///
+  /// Entries of a thread, claimed BATCH at a time, so that threads do not
+  /// contend on the trace position for every entry.
+  ///
+  class Cursor {
+  public:
+    explicit Cursor(TraceReplay &trace) : trace_(trace), next_(0), end_(0) {}
+
+    const Entry &Next() {
+      if (next_ == end_) {
+        next_ = trace_.position_.fetch_add(BATCH, std::memory_order_relaxed);
+        end_ = next_ + BATCH;
+      }
+      return trace_.entries_[next_++ % trace_.num_entries_];
+    }
+
+    const TraceReplay &trace() const { return trace_; }
+
+  private:
+    static constexpr uint64_t BATCH = 64;
+
+    TraceReplay &trace_;
+    uint64_t next_;
+    uint64_t end_;
+  };
+
+  /// Throws std::system_error, if the file could not be read, and
+  /// utils::Exception, if it is not a trace.
+  explicit TraceReplay(const std::string &path)
+      : file_(path), entries_(static_cast<const Entry *>(file_.data())),
+        num_entries_(file_.size() / sizeof(Entry)), position_(0) {
+    if (num_entries_ == 0 || file_.size() % sizeof(Entry)) {
+      throw utils::Exception("Trace " + path + " is not an array of " +
+                             std::to_string(sizeof(Entry)) + " byte entries");
+    }
+    // Also faults the trace in, before it is replayed.
+    for (uint64_t i = 0; i < num_entries_; ++i) {
+      if (entries_[i].op > READMODIFYWRITE) {
+        throw utils::Exception("Trace " + path + " has an unknown operation " +
+                               std::to_string(entries_[i].op) + " at entry " +
+                               std::to_string(i));
+      }
+    }
+  }
+
+  uint64_t num_entries() const { return num_entries_; }
+
+private:
+  indexes::utils::MappedFile file_;
+  const Entry *entries_;
+  uint64_t num_entries_;
+  std::atomic<uint64_t> position_;
+};
+
+} // namespace ycsbc
+
+#endif // YCSB_C_TRACE_REPLAY_H_
@@ -35,10 +35,18 @@ inline uint64_t FNVHash64(uint64_t val) {
 
 inline uint64_t Hash(uint64_t val) { return FNVHash64(val); }
 
-inline double RandomDouble(double min = 0.0, double max = 1.0) {
+///
+/// Per thread engine of RandomDouble (and so generators, which use it),
+/// which threads could seed differently, to draw different sequences.
+///
+inline std::default_random_engine &RandomEngine() {
   static thread_local std::default_random_engine generator;
+  return generator;
+}
+
+inline double RandomDouble(double min = 0.0, double max = 1.0) {
   static thread_local std::uniform_real_distribution<double> uniform(min, max);
-  return uniform(generator);
+  return uniform(RandomEngine());
 }
 
 ///
@@ -11,16 +11,29 @@
 
 #include "core_workload.h"
 #include "db.h"
+#include "histogram.h"
+#include "timer.h"
 #include "utils/utils.h"
+#include <array>
 #include <string>
 
 namespace ycsbc {
+///
+/// Latencies of transactions of a client, by operation, in TscClock ticks.
+///
+using OperationHistograms = std::array<Histogram, NUM_OPERATIONS>;
+
 class Client {
 public:
-  Client(DB &db, CoreWorkload &wl) : db_(db), workload_(wl) {}
+  Client(DB &db, CoreWorkload &wl, OperationHistograms *latencies = nullptr)
+      : db_(db), workload_(wl), latencies_(latencies) {}
 
   virtual bool DoInsert();
-  virtual bool DoTransaction();
+  ///
+  /// Latency is measured from `intended_start` (in TscClock ticks), if it's
+  /// given, instead of from when the transaction is issued.
+  ///
+  virtual bool DoTransaction(uint64_t intended_start = 0);
 
   virtual ~Client() {}
 
@@ -31,20 +44,45 @@ protected:
   virtual int TransactionUpdate();
   virtual int TransactionInsert();
 
+  // Calls `fn` with the next sequence (or transaction) key, which is the key
+  // number, when the workload's keys are integers.
+  template <typename Fn> int WithSequenceKey(Fn &&fn) {
+    if (workload_.integer_keys())
+      return fn(workload_.NextSequenceKeyNum());
+    return fn(workload_.NextSequenceKey());
+  }
+
+  template <typename Fn> int WithTransactionKey(Fn &&fn) {
+    if (workload_.integer_keys())
+      return fn(workload_.NextTransactionKeyNum());
+    return fn(workload_.NextTransactionKey());
+  }
+
   DB &db_;
   CoreWorkload &workload_;
+  OperationHistograms *latencies_;
+  // Reused by every operation, so that results and values, which DBs write
+  // into (or read from) in place, are not allocated again.
+  DB::FieldVec values_;
+  DB::FieldVec result_;
+  std::vector<DB::FieldVec> scan_result_;
 };
 
 inline bool Client::DoInsert() {
-  std::string key = workload_.NextSequenceKey();
-  DB::FieldVec pairs;
-  workload_.BuildValues(pairs);
-  return (db_.Insert(workload_.NextTable(), key, pairs) == DB::kOK);
+  return WithSequenceKey([&](const auto &key) {
+           workload_.BuildValues(values_);
+           return db_.Insert(workload_.NextTable(), key, values_);
+         }) == DB::kOK;
 }
 
-inline bool Client::DoTransaction() {
+inline bool Client::DoTransaction(uint64_t intended_start) {
   int status = -1;
-  switch (workload_.NextOperation()) {
+  Operation op = workload_.NextOperation();
+  uint64_t start = intended_start;
+  if (latencies_ && !start) {
+    start = utils::TscClock::Now();
+  }
+  switch (op) {
   case READ:
     status = TransactionRead();
     break;
@@ -63,78 +101,82 @@ inline bool Client::DoTransaction() {
   default:
     throw utils::Exception("Operation request is not recognized!");
   }
+  if (latencies_) {
+    (*latencies_)[op].Record(utils::TscClock::Now() - start);
+  }
   assert(status >= 0);
   return (status == DB::kOK);
 }
 
 inline int Client::TransactionRead() {
   const std::string &table = workload_.NextTable();
-  const std::string &key = workload_.NextTransactionKey();
-  DB::FieldVec result;
-
-  if (!workload_.read_all_fields()) {
-    DB::FieldSet fields;
-    fields.insert("field" + workload_.NextFieldName());
-    return db_.Read(table, key, &fields, workload_.field_count(), result);
-  } else {
-    return db_.Read(table, key, NULL, workload_.field_count(), result);
-  }
+  return WithTransactionKey([&](const auto &key) {
+    if (!workload_.read_all_fields()) {
+      DB::FieldSet fields;
+      fields.insert("field" + workload_.NextFieldName());
+      return db_.Read(table, key, &fields, workload_.field_count(), result_);
+    } else {
+      return db_.Read(table, key, NULL, workload_.field_count(), result_);
+    }
+  });
 }
 
 inline int Client::TransactionReadModifyWrite() {
   const std::string &table = workload_.NextTable();
-  const std::string &key = workload_.NextTransactionKey();
-  DB::FieldVec result;
-
-  if (!workload_.read_all_fields()) {
-    DB::FieldSet fields;
-    fields.insert("field" + workload_.NextFieldName());
-    db_.Read(table, key, &fields, workload_.field_count(), result);
-  } else {
-    db_.Read(table, key, NULL, workload_.field_count(), result);
-  }
-
-  DB::FieldMap values;
-  if (workload_.write_all_fields()) {
-    workload_.BuildValues(values);
-  } else {
-    workload_.BuildUpdate(values);
-  }
-  return db_.Update(table, key, workload_.field_count(), values);
+  return WithTransactionKey([&](const auto &key) {
+    if (!workload_.read_all_fields()) {
+      DB::FieldSet fields;
+      fields.insert("field" + workload_.NextFieldName());
+      db_.Read(table, key, &fields, workload_.field_count(), result_);
+    } else {
+      db_.Read(table, key, NULL, workload_.field_count(), result_);
+    }
+
+    DB::FieldMap values;
+    if (workload_.write_all_fields()) {
+      workload_.BuildValues(values);
+    } else {
+      workload_.BuildUpdate(values);
+    }
+    return db_.Update(table, key, workload_.field_count(), values);
+  });
 }
 
 inline int Client::TransactionScan() {
   const std::string &table = workload_.NextTable();
-  const std::string &key = workload_.NextTransactionKey();
-  int len = workload_.NextScanLength();
-  std::vector<DB::FieldVec> result;
-  if (!workload_.read_all_fields()) {
-    DB::FieldSet fields;
-    fields.insert("field" + workload_.NextFieldName());
-    return db_.Scan(table, key, len, &fields, workload_.field_count(), result);
-  } else {
-    return db_.Scan(table, key, len, NULL, workload_.field_count(), result);
-  }
+  return WithTransactionKey([&](const auto &key) {
+    int len = workload_.NextScanLength();
+    if (!workload_.read_all_fields()) {
+      DB::FieldSet fields;
+      fields.insert("field" + workload_.NextFieldName());
+      return db_.Scan(table, key, len, &fields, workload_.field_count(),
+                      scan_result_);
+    } else {
+      return db_.Scan(table, key, len, NULL, workload_.field_count(),
+                      scan_result_);
+    }
+  });
 }
 
 inline int Client::TransactionUpdate() {
   const std::string &table = workload_.NextTable();
-  const std::string &key = workload_.NextTransactionKey();
-  DB::FieldMap values;
-  if (workload_.write_all_fields()) {
-    workload_.BuildValues(values);
-  } else {
-    workload_.BuildUpdate(values);
-  }
-  return db_.Update(table, key, workload_.field_count(), values);
+  return WithTransactionKey([&](const auto &key) {
+    DB::FieldMap values;
+    if (workload_.write_all_fields()) {
+      workload_.BuildValues(values);
+    } else {
+      workload_.BuildUpdate(values);
+    }
+    return db_.Update(table, key, workload_.field_count(), values);
+  });
 }
 
 inline int Client::TransactionInsert() {
   const std::string &table = workload_.NextTable();
-  const std::string &key = workload_.NextSequenceKey();
-  DB::FieldVec values;
-  workload_.BuildValues(values);
-  return db_.Insert(table, key, values);
+  return WithSequenceKey([&](const auto &key) {
+    workload_.BuildValues(values_);
+    return db_.Insert(table, key, values_);
+  });
 }
 
 } // namespace ycsbc
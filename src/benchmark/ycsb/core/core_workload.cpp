@@ -8,11 +8,14 @@
 
 #include "core_workload.h"
 #include "utils/const_generator.h"
+#include "utils/hotspot_generator.h"
+#include "utils/moving_hotspot_generator.h"
 #include "utils/scrambled_zipfian_generator.h"
 #include "utils/skewed_latest_generator.h"
 #include "utils/uniform_generator.h"
 #include "utils/zipfian_generator.h"
 
+#include <memory>
 #include <string>
 
 using std::string;
@@ -57,6 +60,17 @@ const string CoreWorkload::REQUEST_DISTRIBUTION_PROPERTY =
     "requestdistribution";
 const string CoreWorkload::REQUEST_DISTRIBUTION_DEFAULT = "uniform";
 
+const string CoreWorkload::HOTSPOT_DATA_FRACTION_PROPERTY =
+    "hotspotdatafraction";
+const string CoreWorkload::HOTSPOT_DATA_FRACTION_DEFAULT = "0.2";
+const string CoreWorkload::HOTSPOT_OPN_FRACTION_PROPERTY = "hotspotopnfraction";
+const string CoreWorkload::HOTSPOT_OPN_FRACTION_DEFAULT = "0.8";
+const string CoreWorkload::HOTSPOT_MOVE_PERIOD_PROPERTY = "hotspotmoveperiod";
+const string CoreWorkload::HOTSPOT_MOVE_PERIOD_DEFAULT = "100000";
+
+const string CoreWorkload::TRACE_FILE_PROPERTY = "tracefile";
+const string CoreWorkload::TRACE_FILE_DEFAULT = "";
+
 const string CoreWorkload::MAX_SCAN_LENGTH_PROPERTY = "maxscanlength";
 const string CoreWorkload::MAX_SCAN_LENGTH_DEFAULT = "1000";
 
@@ -67,6 +81,9 @@ const string CoreWorkload::SCAN_LENGTH_DISTRIBUTION_DEFAULT = "uniform";
 const string CoreWorkload::INSERT_ORDER_PROPERTY = "insertorder";
 const string CoreWorkload::INSERT_ORDER_DEFAULT = "hashed";
 
+const string CoreWorkload::KEY_MODE_PROPERTY = "keymode";
+const string CoreWorkload::KEY_MODE_DEFAULT = "string";
+
 const string CoreWorkload::INSERT_START_PROPERTY = "insertstart";
 const string CoreWorkload::INSERT_START_DEFAULT = "0";
 
@@ -112,8 +129,23 @@ void CoreWorkload::Init(const utils::Properties &p) {
     ordered_inserts_ = true;
   }
 
+  std::string key_mode = p.GetProperty(KEY_MODE_PROPERTY, KEY_MODE_DEFAULT);
+  if (key_mode == "integer") {
+    integer_keys_ = true;
+  } else if (key_mode == "string") {
+    integer_keys_ = false;
+  } else {
+    throw utils::Exception("Unknown key mode: " + key_mode);
+  }
+
   key_generator_ = new CounterGenerator(insert_start);
 
+  std::string trace_file =
+      p.GetProperty(TRACE_FILE_PROPERTY, TRACE_FILE_DEFAULT);
+  if (!trace_file.empty()) {
+    trace_ = new TraceReplay(trace_file);
+  }
+
   if (read_proportion > 0) {
     op_chooser_.AddValue(READ, read_proportion);
   }
@@ -145,6 +177,21 @@ void CoreWorkload::Init(const utils::Properties &p) {
     key_chooser_ = new ScrambledZipfianGenerator(record_count_ + new_keys);
   } else if (request_dist == "latest") {
     key_chooser_ = new SkewedLatestGenerator(insert_key_sequence_);
+  } else if (request_dist == "hotspot" || request_dist == "movinghotspot") {
+    double hot_data_fraction = std::stod(p.GetProperty(
+        HOTSPOT_DATA_FRACTION_PROPERTY, HOTSPOT_DATA_FRACTION_DEFAULT));
+    double hot_opn_fraction = std::stod(p.GetProperty(
+        HOTSPOT_OPN_FRACTION_PROPERTY, HOTSPOT_OPN_FRACTION_DEFAULT));
+    if (request_dist == "hotspot") {
+      key_chooser_ = new HotspotGenerator(0, record_count_ - 1,
+                                          hot_data_fraction, hot_opn_fraction);
+    } else {
+      uint64_t move_period = std::stoull(p.GetProperty(
+          HOTSPOT_MOVE_PERIOD_PROPERTY, HOTSPOT_MOVE_PERIOD_DEFAULT));
+      key_chooser_ =
+          new MovingHotspotGenerator(0, record_count_ - 1, hot_data_fraction,
+                                     hot_opn_fraction, move_period);
+    }
   } else {
     throw utils::Exception("Unknown request distribution: " + request_dist);
   }
@@ -179,12 +226,60 @@ CoreWorkload::GetFieldLenGenerator(const utils::Properties &p) {
   }
 }
 
+namespace {
+// Trace position of a client thread, and the entry of its transaction.
+struct TraceThread {
+  explicit TraceThread(ycsbc::TraceReplay &trace) : cursor(trace) {}
+
+  ycsbc::TraceReplay::Cursor cursor;
+  const ycsbc::TraceReplay::Entry *entry = NULL;
+};
+
+thread_local std::unique_ptr<TraceThread> trace_thread;
+} // namespace
+
+ycsbc::Operation CoreWorkload::NextTraceOperation() {
+  if (!trace_thread || &trace_thread->cursor.trace() != trace_) {
+    trace_thread.reset(new TraceThread(*trace_));
+  }
+
+  // Workloads have no deletes, they are skipped.
+  for (uint64_t i = 0; i < trace_->num_entries(); ++i) {
+    const TraceReplay::Entry &entry = trace_thread->cursor.Next();
+    trace_thread->entry = &entry;
+    switch (entry.op) {
+    case TraceReplay::READ:
+      return READ;
+    case TraceReplay::UPDATE:
+      return UPDATE;
+    case TraceReplay::INSERT:
+      return INSERT;
+    case TraceReplay::SCAN:
+      return SCAN;
+    case TraceReplay::READMODIFYWRITE:
+      return READMODIFYWRITE;
+    case TraceReplay::DELETE:
+      break;
+    }
+  }
+  throw utils::Exception("Trace has only deletes");
+}
+
+const ycsbc::TraceReplay::Entry *CoreWorkload::TraceEntry() const {
+  if (!trace_thread || &trace_thread->cursor.trace() != trace_) {
+    return NULL;
+  }
+  return trace_thread->entry;
+}
+
+// Overwrites `values`, reusing its fields, so that a reused vector is not
+// allocated again.
 void CoreWorkload::BuildValues(ycsbc::DB::FieldVec &values) {
+  values.resize(field_count_);
   for (int i = 0; i < field_count_; ++i) {
-    ycsbc::DB::KVPair pair;
-    pair.first.append("field").append(std::to_string(i));
-    pair.second.append(field_len_generator_->Next(), utils::RandomPrintChar());
-    values.push_back(pair);
+    ycsbc::DB::KVPair &pair = values[i];
+    pair.first.assign("field").append(std::to_string(i));
+    pair.second.assign(field_len_generator_->Next(), utils::RandomPrintChar());
   }
 }
 
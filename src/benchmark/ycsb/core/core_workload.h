@@ -14,6 +14,7 @@
 #include "utils/discrete_generator.h"
 #include "utils/generator.h"
 #include "utils/properties.h"
+#include "utils/trace_replay.h"
 #include "utils/utils.h"
 #include <string>
 #include <vector>
@@ -21,6 +22,14 @@
 namespace ycsbc {
 enum Operation { INSERT, READ, UPDATE, SCAN, READMODIFYWRITE };
 
+constexpr int NUM_OPERATIONS = READMODIFYWRITE + 1;
+
+inline const char *OperationName(Operation op) {
+  static const char *const names[NUM_OPERATIONS] = {
+      "INSERT", "READ", "UPDATE", "SCAN", "READMODIFYWRITE"};
+  return names[op];
+}
+
 class CoreWorkload {
 public:
   ///
@@ -95,11 +104,36 @@ public:
 
   ///
   /// The name of the property for the the distribution of request keys.
-  /// Options are "uniform", "zipfian" and "latest".
+  /// Options are "uniform", "zipfian", "latest", "hotspot" and
+  /// "movinghotspot".
   ///
   static const std::string REQUEST_DISTRIBUTION_PROPERTY;
   static const std::string REQUEST_DISTRIBUTION_DEFAULT;
 
+  ///
+  /// The names of the properties for the fraction of keys in the hot set,
+  /// and the fraction of requests to it, of "hotspot" distributions.
+  ///
+  static const std::string HOTSPOT_DATA_FRACTION_PROPERTY;
+  static const std::string HOTSPOT_DATA_FRACTION_DEFAULT;
+  static const std::string HOTSPOT_OPN_FRACTION_PROPERTY;
+  static const std::string HOTSPOT_OPN_FRACTION_DEFAULT;
+
+  ///
+  /// The name of the property for the number of requests, after which the hot
+  /// set of "movinghotspot" moves to the next keys.
+  ///
+  static const std::string HOTSPOT_MOVE_PERIOD_PROPERTY;
+  static const std::string HOTSPOT_MOVE_PERIOD_DEFAULT;
+
+  ///
+  /// The name of the property for a trace (see TraceReplay), whose operations
+  /// and key numbers transactions replay, instead of generating them. Trace
+  /// deletes are skipped.
+  ///
+  static const std::string TRACE_FILE_PROPERTY;
+  static const std::string TRACE_FILE_DEFAULT;
+
   ///
   /// The name of the property for the max scan length (number of records).
   ///
@@ -120,6 +154,14 @@ public:
   static const std::string INSERT_ORDER_PROPERTY;
   static const std::string INSERT_ORDER_DEFAULT;
 
+  ///
+  /// The name of the property for the type of keys handed to the DB.
+  /// Options are "string" (key names, "user" followed by the key number) or
+  /// "integer" (key numbers, without formatting them).
+  ///
+  static const std::string KEY_MODE_PROPERTY;
+  static const std::string KEY_MODE_DEFAULT;
+
   static const std::string INSERT_START_PROPERTY;
   static const std::string INSERT_START_DEFAULT;
 
@@ -139,19 +181,25 @@ public:
   virtual std::string NextTable() { return table_name_; }
   virtual std::string NextSequenceKey();    /// Used for loading data
   virtual std::string NextTransactionKey(); /// Used for transactions
-  virtual Operation NextOperation() { return op_chooser_.Next(); }
+  virtual uint64_t NextSequenceKeyNum();    /// Integer key mode variants
+  virtual uint64_t NextTransactionKeyNum();
+  virtual Operation NextOperation() {
+    return trace_ ? NextTraceOperation() : op_chooser_.Next();
+  }
   virtual std::string NextFieldName();
   virtual size_t NextScanLength() { return scan_len_chooser_->Next(); }
 
   bool read_all_fields() const { return read_all_fields_; }
   bool write_all_fields() const { return write_all_fields_; }
   int field_count() const { return field_count_; }
+  bool integer_keys() const { return integer_keys_; }
 
   CoreWorkload()
       : field_count_(0), read_all_fields_(false), write_all_fields_(false),
         field_len_generator_(NULL), key_generator_(NULL), key_chooser_(NULL),
         field_chooser_(NULL), scan_len_chooser_(NULL), insert_key_sequence_(3),
-        ordered_inserts_(true), record_count_(0) {}
+        ordered_inserts_(true), integer_keys_(false), record_count_(0),
+        trace_(NULL) {}
 
   virtual ~CoreWorkload() {
     if (field_len_generator_)
@@ -164,11 +212,17 @@ public:
       delete field_chooser_;
     if (scan_len_chooser_)
       delete scan_len_chooser_;
+    if (trace_)
+      delete trace_;
   }
 
 protected:
   static Generator<uint64_t> *GetFieldLenGenerator(const utils::Properties &p);
   std::string BuildKeyName(uint64_t key_num);
+  uint64_t BuildKeyNum(uint64_t key_num);
+  Operation NextTraceOperation();
+  /// Trace entry of the calling thread's transaction, if any.
+  const TraceReplay::Entry *TraceEntry() const;
 
   std::string table_name_;
   int field_count_;
@@ -182,27 +236,47 @@ protected:
   Generator<uint64_t> *scan_len_chooser_;
   CounterGenerator insert_key_sequence_;
   bool ordered_inserts_;
+  bool integer_keys_;
   size_t record_count_;
+  TraceReplay *trace_;
 };
 
 inline std::string CoreWorkload::NextSequenceKey() {
-  uint64_t key_num = key_generator_->Next();
-  return BuildKeyName(key_num);
+  return DB::KeyName(NextSequenceKeyNum());
 }
 
 inline std::string CoreWorkload::NextTransactionKey() {
+  return DB::KeyName(NextTransactionKeyNum());
+}
+
+inline uint64_t CoreWorkload::NextSequenceKeyNum() {
+  // Inserts of a trace insert its keys.
+  if (const TraceReplay::Entry *entry = trace_ ? TraceEntry() : NULL) {
+    return BuildKeyNum(entry->key);
+  }
+  return BuildKeyNum(key_generator_->Next());
+}
+
+inline uint64_t CoreWorkload::NextTransactionKeyNum() {
+  if (const TraceReplay::Entry *entry = trace_ ? TraceEntry() : NULL) {
+    return BuildKeyNum(entry->key);
+  }
   uint64_t key_num;
   do {
     key_num = key_chooser_->Next();
   } while (key_num > insert_key_sequence_.Last());
-  return BuildKeyName(key_num);
+  return BuildKeyNum(key_num);
 }
 
 inline std::string CoreWorkload::BuildKeyName(uint64_t key_num) {
+  return DB::KeyName(BuildKeyNum(key_num));
+}
+
+inline uint64_t CoreWorkload::BuildKeyNum(uint64_t key_num) {
   if (!ordered_inserts_) {
     key_num = utils::Hash(key_num);
   }
-  return std::string("user").append(std::to_string(key_num));
+  return key_num;
 }
 
 inline std::string CoreWorkload::NextFieldName() {
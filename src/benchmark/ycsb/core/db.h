@@ -9,6 +9,7 @@
 #ifndef YCSB_C_DB_H_
 #define YCSB_C_DB_H_
 
+#include <cstdint>
 #include <string>
 #include <tsl/robin_map.h>
 #include <tsl/robin_set.h>
@@ -98,6 +99,43 @@ public:
   /// @return Zero on success, a non-zero error code on error.
   ///
   virtual int Delete(const std::string &table, const std::string &key) = 0;
+  ///
+  /// Integer key variants of the operations above, used when the workload's
+  /// key mode is "integer" (see CoreWorkload::KEY_MODE_PROPERTY).
+  /// By default, the key number is formatted as a key name.
+  ///
+  virtual int Read(const std::string &table, uint64_t key,
+                   const FieldSet *fields, int field_count,
+                   std::vector<KVPair> &result) {
+    return Read(table, KeyName(key), fields, field_count, result);
+  }
+
+  virtual int Scan(const std::string &table, uint64_t key, int record_count,
+                   const FieldSet *fields, int field_count,
+                   std::vector<std::vector<KVPair>> &result) {
+    return Scan(table, KeyName(key), record_count, fields, field_count,
+                result);
+  }
+
+  virtual int Update(const std::string &table, uint64_t key, int field_count,
+                     FieldMap &values) {
+    return Update(table, KeyName(key), field_count, values);
+  }
+
+  virtual int Insert(const std::string &table, uint64_t key,
+                     std::vector<KVPair> &values) {
+    return Insert(table, KeyName(key), values);
+  }
+
+  virtual int Delete(const std::string &table, uint64_t key) {
+    return Delete(table, KeyName(key));
+  }
+  ///
+  /// Name of the record with key number `key`.
+  ///
+  static std::string KeyName(uint64_t key) {
+    return std::string("user").append(std::to_string(key));
+  }
 
   virtual ~DB() {}
 };
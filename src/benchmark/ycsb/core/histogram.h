@@ -0,0 +1,166 @@
+//
+//  histogram.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_HISTOGRAM_H_
+#define YCSB_C_HISTOGRAM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace ycsbc {
+///
+/// Log bucketed histogram of latencies (HDR style). Values are bucketed by
+/// their highest set bit, and then linearly by the next SUB_BUCKET_BITS bits,
+/// so that a value is off by at most 1 / 2^SUB_BUCKET_BITS of it.
+///
+/// Recording takes no locks and does not allocate. A histogram has a single
+/// writer, but could be read (Ex: merged) concurrently.
+///
+class Histogram {
+public:
+  static constexpr int SUB_BUCKET_BITS = 5;
+  static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  Histogram() : counts_(new std::atomic<uint64_t>[NUM_BUCKETS]) { Reset(); }
+
+  Histogram(const Histogram &other) : Histogram() { Merge(other); }
+
+  Histogram &operator=(const Histogram &other) {
+    if (this != &other) {
+      Reset();
+      Merge(other);
+    }
+    return *this;
+  }
+
+  void Record(uint64_t value) {
+    Add(counts_[BucketOf(value)], 1);
+    Add(count_, 1);
+    Add(sum_, value);
+
+    if (value > max_.load(std::memory_order_relaxed))
+      max_.store(value, std::memory_order_relaxed);
+  }
+
+  void Merge(const Histogram &other) {
+    for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+      Add(counts_[bucket],
+          other.counts_[bucket].load(std::memory_order_relaxed));
+    }
+
+    Add(count_, other.Count());
+    Add(sum_, other.sum_.load(std::memory_order_relaxed));
+    max_.store(std::max(Max(), other.Max()), std::memory_order_relaxed);
+  }
+
+  ///
+  /// Removes values of `before`, an earlier copy of this histogram, leaving
+  /// values recorded since (Ex: in a reporting window). Max is then the
+  /// highest value of the highest non empty bucket.
+  ///
+  void Subtract(const Histogram &before) {
+    int highest = -1;
+
+    for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+      uint64_t count = counts_[bucket].load(std::memory_order_relaxed) -
+                       before.counts_[bucket].load(std::memory_order_relaxed);
+
+      counts_[bucket].store(count, std::memory_order_relaxed);
+
+      if (count)
+        highest = bucket;
+    }
+
+    count_.store(Count() - before.Count(), std::memory_order_relaxed);
+    sum_.store(sum_.load(std::memory_order_relaxed) -
+                   before.sum_.load(std::memory_order_relaxed),
+               std::memory_order_relaxed);
+    max_.store(highest < 0 ? 0 : std::min(BucketHighest(highest), Max()),
+               std::memory_order_relaxed);
+  }
+
+  void Reset() {
+    for (int bucket = 0; bucket < NUM_BUCKETS; bucket++)
+      counts_[bucket].store(0, std::memory_order_relaxed);
+
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+  uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+
+  double Mean() const {
+    uint64_t count = Count();
+    return count ? static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                       count
+                 : 0;
+  }
+
+  ///
+  /// Highest value of the bucket holding the `percentile`th value (upto
+  /// Max()), or 0 if the histogram is empty.
+  ///
+  uint64_t Percentile(double percentile) const {
+    uint64_t count = Count();
+
+    if (count == 0)
+      return 0;
+
+    uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(percentile / 100 * count + 0.5));
+    uint64_t seen = 0;
+
+    for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+      seen += counts_[bucket].load(std::memory_order_relaxed);
+
+      if (seen >= rank)
+        return std::min(BucketHighest(bucket), Max());
+    }
+
+    return Max();
+  }
+
+  static int BucketOf(uint64_t value) {
+    if (value < SUB_BUCKETS)
+      return static_cast<int>(value);
+
+    int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+
+    return (shift << SUB_BUCKET_BITS) + static_cast<int>(value >> shift);
+  }
+
+  static uint64_t BucketHighest(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS)
+      return bucket;
+
+    int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+    uint64_t mantissa = (bucket & (SUB_BUCKETS - 1)) + SUB_BUCKETS;
+
+    // Wraps around to the maximum value, for the last bucket.
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+private:
+  // Counters have a single writer, so a relaxed load and store suffice.
+  static void Add(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+} // namespace ycsbc
+
+#endif // YCSB_C_HISTOGRAM_H_
@@ -0,0 +1,63 @@
+//
+//  pacer.h
+//  YCSB-C
+//
+
+#ifndef YCSB_C_PACER_H_
+#define YCSB_C_PACER_H_
+
+#include "indexes/utils/Utils.h"
+#include "timer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <thread>
+
+namespace ycsbc {
+///
+/// Open loop schedule of a client's operations, `ops_per_sec` on average,
+/// either at fixed intervals or as a Poisson process. Operations are issued
+/// at their intended start, regardless of how long earlier ones took, and
+/// latency is measured from it, so that time spent queued behind a slow
+/// operation is counted (avoids coordinated omission).
+///
+class Pacer {
+public:
+  Pacer(double ops_per_sec, bool poisson, uint64_t seed)
+      : ticks_per_op_(1e9 / ops_per_sec / utils::TscClock::NanosPerTick()),
+        poisson_(poisson), rng_(seed), next_(utils::TscClock::Now()) {}
+
+  ///
+  /// Waits for the intended start of the next operation and returns it (in
+  /// TscClock ticks). Returns immediately, if the client is behind.
+  ///
+  uint64_t Wait() {
+    uint64_t start = static_cast<uint64_t>(next_);
+    next_ += poisson_ ? gap_(rng_) * ticks_per_op_ : ticks_per_op_;
+
+    for (uint64_t now = utils::TscClock::Now(); now < start;
+         now = utils::TscClock::Now()) {
+      // Sleeps are too coarse for the last stretch.
+      if (utils::TscClock::ToNanos(start - now) > kSpinNanos) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      } else {
+        indexes::utils::cpu_relax();
+      }
+    }
+    return start;
+  }
+
+private:
+  static constexpr double kSpinNanos = 100000;
+
+  double ticks_per_op_;
+  bool poisson_;
+  std::mt19937_64 rng_;
+  std::exponential_distribution<double> gap_{1.0};
+  double next_;
+};
+
+} // namespace ycsbc
+
+#endif // YCSB_C_PACER_H_
@@ -10,6 +10,12 @@
 #define YCSB_C_TIMER_H_
 
 #include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace utils {
 template <typename T> class Timer {
@@ -30,6 +36,52 @@ private:
   Clock::time_point time_;
 };
 
+///
+/// Cheap timestamps for timing single operations. Ticks of the TSC, where
+/// available (which is invariant on recent x86), nanoseconds otherwise.
+///
+class TscClock {
+public:
+  static uint64_t Now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  ///
+  /// Calibrated once, against the steady clock.
+  ///
+  static double NanosPerTick() {
+    static const double nanos_per_tick = Calibrate();
+    return nanos_per_tick;
+  }
+
+  static double ToNanos(uint64_t ticks) { return ticks * NanosPerTick(); }
+
+private:
+  static double Calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+    auto start = std::chrono::steady_clock::now();
+    uint64_t start_ticks = Now();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    uint64_t ticks = Now() - start_ticks;
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+
+    return ticks ? static_cast<double>(nanos) / ticks : 1.0;
+#else
+    return 1.0;
+#endif
+  }
+};
+
 } // namespace utils
 
 #endif // YCSB_C_TIMER_H_
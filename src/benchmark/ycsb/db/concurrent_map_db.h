@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core/db.h"
+#include "db/map_key.h"
+#include "db/records.h"
 #include "sync_prim/ThreadRegistry.h"
 #include "utils/properties.h"
 
@@ -8,146 +10,154 @@
 #include <vector>
 
 namespace ycsbc {
-template <bool ScanSupported, typename MapType>
+// Keys are strings, or key numbers of the "integer" key mode, if `Key` is an
+// integer. Maps could take them as another type (Ex: std::string_view).
+// Values of the map are records of `Records` (see records.h).
+template <bool ScanSupported, typename MapType, typename Key = std::string,
+          typename Records = HeapRecords>
 class ConcurrentMapDB : public DB {
+  using map_key = MapKey<Key>;
+  using key_type = Key;
+
 public:
+  explicit ConcurrentMapDB(const utils::Properties &props) : records(props) {}
+
   void Init() { sync_prim::ThreadRegistry::RegisterThread(); }
 
   int Read(const std::string &table, const std::string &key,
            const DB::FieldSet *fields, int field_count,
            std::vector<KVPair> &result) {
-    std::string keyind = table + key;
+    return Read(map_key::make(table, key), fields, field_count, result);
+  }
 
-    return Read(keyind, fields, field_count, result);
+  int Read(const std::string &table, uint64_t key, const DB::FieldSet *fields,
+           int field_count, std::vector<KVPair> &result) {
+    return Read(map_key::make(table, key), fields, field_count, result);
   }
 
   int Scan(const std::string &table, const std::string &key, int record_count,
            const DB::FieldSet *fields, int field_count,
            std::vector<std::vector<KVPair>> &result) {
-    if constexpr (ScanSupported) {
-      std::string keyind = table + key;
+    return Scan(map_key::make(table, key), record_count, fields, field_count,
+                result);
+  }
 
-      return Scan(keyind, record_count, fields, field_count, result);
-    } else {
-      throw "Scan: function not implemented!";
-    }
+  int Scan(const std::string &table, uint64_t key, int record_count,
+           const DB::FieldSet *fields, int field_count,
+           std::vector<std::vector<KVPair>> &result) {
+    return Scan(map_key::make(table, key), record_count, fields, field_count,
+                result);
   }
 
   int Update(const std::string &table, const std::string &key, int field_count,
              DB::FieldMap &values) {
-    std::string keyind = table + key;
+    return Update(map_key::make(table, key), field_count, values);
+  }
 
-    return Update(keyind, field_count, values);
+  int Update(const std::string &table, uint64_t key, int field_count,
+             DB::FieldMap &values) {
+    return Update(map_key::make(table, key), field_count, values);
   }
 
   int Insert(const std::string &table, const std::string &key,
              std::vector<KVPair> &values) {
-    return insert(table + key, values);
+    return insert(map_key::make(table, key), values);
   }
 
-  int Delete(const std::string &table, const std::string &key) {
-    std::string keyind = table + key;
-    KVPair *fields = nullptr;
-
-    fields = Delete(key);
+  int Insert(const std::string &table, uint64_t key,
+             std::vector<KVPair> &values) {
+    return insert(map_key::make(table, key), values);
+  }
 
-    if (fields)
-      delete[] fields;
+  int Delete(const std::string &table, const std::string &key) {
+    return Delete(map_key::make(table, key));
+  }
 
-    return fields ? DB::kOK : DB::kErrorNoData;
+  int Delete(const std::string &table, uint64_t key) {
+    return Delete(map_key::make(table, key));
   }
 
 private:
+  using record_type = typename Records::record_type;
+
   MapType db;
+  Records records;
 
-  int Read(std::string &key, const DB::FieldSet *fields, int field_count,
+  int Read(const key_type &key, const DB::FieldSet *fields, int field_count,
            std::vector<KVPair> &result) {
-    auto val = db.Search(key);
+    auto record = db.Search(key);
 
-    if (!val)
+    if (!record)
       return DB::kErrorNoData;
 
-    result.clear();
-    get_fields(result, fields, field_count, *val);
+    records.Get(result, fields, field_count, *record);
 
     return DB::kOK;
   }
 
-  int Scan(std::string &key, int record_count, const DB::FieldSet *fields,
+  int Scan(const key_type &key, int record_count, const DB::FieldSet *fields,
            int field_count, std::vector<std::vector<KVPair>> &result) {
-    result.clear();
-
-    for (auto it = db.lower_bound(key); it != db.end() && record_count;
-         ++it, --record_count) {
-      result.push_back(get_fields(fields, field_count, it->second));
-    }
-
-    return DB::kOK;
-  }
-
-  int Update(const std::string &key, int field_count, DB::FieldMap &values) {
-    auto val = db.Search(key);
-
-    if (!val)
-      return insert(key, values);
+    if constexpr (ScanSupported) {
+      size_t num_records = 0;
 
-    KVPair *fields = new KVPair[field_count];
-    int num_updates = values.size();
+      for (auto it = db.lower_bound(key); it != db.end() && record_count;
+           ++it, --record_count) {
+        if (num_records == result.size())
+          result.emplace_back();
 
-    std::copy(*val, *val + field_count, fields);
+        records.Get(result[num_records++], fields, field_count, it->second);
+      }
 
-    for (int i = 0; (i < field_count) && num_updates; i++) {
-      KVPair &field = fields[i];
-      auto it = values.find(field.first);
+      result.resize(num_records);
 
-      if (it != values.end()) {
-        field.second = it->second;
-        num_updates--;
-      }
+      return DB::kOK;
+    } else {
+      throw "Scan: function not implemented!";
     }
-
-    return DB::kOK;
   }
 
-  KVPair *Delete(const std::string &key) {
-    auto val = db.Delete(key);
+  int Update(const key_type &key, int field_count, DB::FieldMap &values) {
+    if constexpr (Records::IN_PLACE_UPDATE) {
+      auto record = db.Search(key);
 
-    return val ? *val : nullptr;
-  }
+      if (!record) {
+        if (insert(key, values) == DB::kOK)
+          return DB::kOK;
 
-  template <typename Cont> int insert(const std::string &key, Cont &values) {
-    KVPair *fields = new KVPair[values.size()];
+        // Inserted concurrently.
+        record = db.Search(key);
+      }
 
-    std::copy(std::begin(values), std::end(values), fields);
+      records.Update(*record, field_count, values);
+    } else {
+      // Read-modify-write with a single lookup. Fields are copied on write, as
+      // they could be read concurrently.
+      db.Upsert(key, [&](record_type &record) {
+        record = records.Updated(record, field_count, values);
+      });
+    }
 
-    return db.Insert(key, fields) ? DB::kOK : DB::kErrorConflict;
+    return DB::kOK;
   }
 
-  std::vector<KVPair> get_fields(const DB::FieldSet *fields, int field_count,
-                                 const KVPair *fieldvec) {
-    std::vector<KVPair> result;
+  int Delete(const key_type &key) {
+    auto record = db.Delete(key);
 
-    get_fields(result, fields, field_count, fieldvec);
+    if (!record)
+      return DB::kErrorNoData;
 
-    return result;
+    records.Free(record.value());
+    return DB::kOK;
   }
 
-  void get_fields(std::vector<KVPair> &result, const DB::FieldSet *fields,
-                  int field_count, const KVPair *fieldvec) {
-    if (!fields) {
-      result = std::vector<KVPair>{fieldvec, fieldvec + field_count};
-    } else {
-      int num_field_reads = fields->size();
+  template <typename Cont> int insert(const key_type &key, Cont &values) {
+    record_type record = records.Make(values);
 
-      for (int i = 0; (i < field_count) && num_field_reads; i++) {
-        const KVPair &field = fieldvec[i];
+    if (db.Insert(key, record))
+      return DB::kOK;
 
-        if (fields->count(field.first)) {
-          result.push_back(field);
-          num_field_reads--;
-        }
-      }
-    }
+    records.Free(record);
+    return DB::kErrorConflict;
   }
 };
 
@@ -6,13 +6,16 @@
 //  Copyright (c) 2014 Jinglei Ren <jinglei@ren.systems>.
 //
 
+#include "indexes/art/concurrent_map.h"
 #include "indexes/btree/concurrent_map.h"
 #include "indexes/btree/map.h"
+#include "indexes/hashtable/concurrent_map.h"
 
 #include "db/concurrent_map_db.h"
 #include "db/db_factory.h"
 #include "db/locked_map_db.h"
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <tsl/robin_map.h>
@@ -29,19 +32,64 @@ template <typename Key, typename T, typename Hash = std::hash<Key>,
 using robin_map =
     tsl::robin_map<Key, T, Hash, KeyEqual, Allocator, false, GrowthPolicy>;
 
-DB *DBFactory::CreateDB(utils::Properties &props) {
-  if (props["dbname"] == "stl_map") {
-    return new LockedMapDB<SCAN, std::map>;
-  } else if (props["dbname"] == "stl_umap") {
-    return new LockedMapDB<NOSCAN, std::unordered_map>;
-  } else if (props["dbname"] == "robinmap") {
-    return new LockedMapDB<NOSCAN, robin_map>;
-  } else if (props["dbname"] == "btree") {
-    return new LockedMapDB<SCAN, indexes::btree::map>;
-  } else if (props["dbname"] == "concurrent_btree") {
+namespace ycsbc {
+// ART encodes string keys as binary keys.
+template <typename Key, typename Value>
+using art_map = std::conditional_t<
+    std::is_integral_v<Key>, indexes::art::concurrent_map<Value>,
+    indexes::art::concurrent_map<Value, indexes::art::art_traits_default,
+                                 indexes::art::binary_key>>;
+
+// `Key` is either std::string or uint64_t, in the "integer" key mode.
+// `Records` is either HeapRecords or ArenaRecords (see records.h).
+template <typename Key, typename Records>
+static DB *CreateMapDB(const utils::Properties &props) {
+  using Value = typename Records::record_type;
+  const std::string &dbname = props["dbname"];
+
+  if (dbname == "stl_map") {
+    return new LockedMapDB<SCAN, std::map, Key, Records>(props);
+  } else if (dbname == "stl_umap") {
+    return new LockedMapDB<NOSCAN, std::unordered_map, Key, Records>(props);
+  } else if (dbname == "robinmap") {
+    return new LockedMapDB<NOSCAN, robin_map, Key, Records>(props);
+  } else if (dbname == "btree") {
+    return new LockedMapDB<SCAN, indexes::btree::map, Key, Records>(props);
+  } else if (dbname == "concurrent_btree") {
+    return new ConcurrentMapDB<SCAN,
+                               indexes::btree::concurrent_map<Key, Value>, Key,
+                               Records>(props);
+  } else if (dbname == "concurrent_art") {
+    return new ConcurrentMapDB<SCAN, art_map<Key, Value>, Key, Records>(props);
+  } else if (dbname == "concurrent_hash") {
     return new ConcurrentMapDB<
-        SCAN, indexes::btree::concurrent_map<std::string, DB::KVPair *>>;
+        NOSCAN, indexes::hashtable::concurrent_map<Key, Value>, Key, Records>(
+        props);
+  } else {
+    return nullptr;
+  }
+}
+
+template <typename Key> static DB *CreateMapDB(const utils::Properties &props) {
+  // Records are kept in an arena and updated in place, with "arena".
+  const std::string records = props.GetProperty("recordstore", "heap");
+
+  if (records == "arena") {
+    return CreateMapDB<Key, ArenaRecords>(props);
+  } else if (records == "heap") {
+    return CreateMapDB<Key, HeapRecords>(props);
   } else {
     return nullptr;
   }
 }
+} // namespace ycsbc
+
+DB *DBFactory::CreateDB(utils::Properties &props) {
+  // See CoreWorkload::KEY_MODE_PROPERTY (whose Operation enum clashes with
+  // SCAN/NOSCAN).
+  if (props.GetProperty("keymode", "string") == "integer") {
+    return ycsbc::CreateMapDB<uint64_t>(props);
+  } else {
+    return ycsbc::CreateMapDB<std::string>(props);
+  }
+}
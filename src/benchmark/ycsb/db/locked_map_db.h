@@ -1,6 +1,8 @@
 #pragma once
 
 #include "core/db.h"
+#include "db/map_key.h"
+#include "db/records.h"
 #include "utils/properties.h"
 
 #include <mutex>
@@ -11,163 +13,155 @@ namespace ycsbc {
 static constexpr bool SCAN = true;
 static constexpr bool NOSCAN = false;
 
-template <bool ScanSupported, template <typename...> class MapType>
+// Keys are strings, or key numbers of the "integer" key mode, if `Key` is an
+// integer. Values of the map are records of `Records` (see records.h).
+template <bool ScanSupported, template <typename...> class MapType,
+          typename Key = std::string, typename Records = HeapRecords>
 class LockedMapDB : public DB {
+  using map_key = MapKey<Key>;
+  using key_type = Key;
+
 public:
+  explicit LockedMapDB(const utils::Properties &props) : records(props) {}
+
   void Init() {}
 
   int Read(const std::string &table, const std::string &key,
            const DB::FieldSet *fields, int field_count,
            std::vector<KVPair> &result) {
-    std::string keyind = table + key;
-    std::lock_guard<std::mutex> lock(mutex);
+    return Read(map_key::make(table, key), fields, field_count, result);
+  }
 
-    return Read(keyind, fields, field_count, result);
+  int Read(const std::string &table, uint64_t key, const DB::FieldSet *fields,
+           int field_count, std::vector<KVPair> &result) {
+    return Read(map_key::make(table, key), fields, field_count, result);
   }
 
   int Scan(const std::string &table, const std::string &key, int record_count,
            const DB::FieldSet *fields, int field_count,
            std::vector<std::vector<KVPair>> &result) {
-    if constexpr (ScanSupported) {
-      std::string keyind = table + key;
-      std::lock_guard<std::mutex> lock(mutex);
+    return Scan(map_key::make(table, key), record_count, fields, field_count,
+                result);
+  }
 
-      return Scan(keyind, record_count, fields, field_count, result);
-    } else {
-      throw "Scan: function not implemented!";
-    }
+  int Scan(const std::string &table, uint64_t key, int record_count,
+           const DB::FieldSet *fields, int field_count,
+           std::vector<std::vector<KVPair>> &result) {
+    return Scan(map_key::make(table, key), record_count, fields, field_count,
+                result);
   }
 
   int Update(const std::string &table, const std::string &key, int field_count,
              DB::FieldMap &values) {
-    std::string keyind = table + key;
-    std::lock_guard<std::mutex> lock(mutex);
+    return Update(map_key::make(table, key), field_count, values);
+  }
 
-    return Update(keyind, field_count, values);
+  int Update(const std::string &table, uint64_t key, int field_count,
+             DB::FieldMap &values) {
+    return Update(map_key::make(table, key), field_count, values);
   }
 
   int Insert(const std::string &table, const std::string &key,
              std::vector<KVPair> &values) {
-    return insert(table + key, values, false);
+    return insert(map_key::make(table, key), values, false);
   }
 
-  int Delete(const std::string &table, const std::string &key) {
-    std::string keyind = table + key;
-    KVPair *fields = nullptr;
-    std::lock_guard<std::mutex> lock(mutex);
-
-    fields = Delete(key);
+  int Insert(const std::string &table, uint64_t key,
+             std::vector<KVPair> &values) {
+    return insert(map_key::make(table, key), values, false);
+  }
 
-    if (fields)
-      delete[] fields;
+  int Delete(const std::string &table, const std::string &key) {
+    return Delete(map_key::make(table, key));
+  }
 
-    return fields ? DB::kOK : DB::kErrorNoData;
+  int Delete(const std::string &table, uint64_t key) {
+    return Delete(map_key::make(table, key));
   }
 
 private:
-  MapType<std::string, KVPair *> db;
+  using record_type = typename Records::record_type;
+
+  MapType<key_type, record_type> db;
+  Records records;
   std::mutex mutex;
 
-  int Read(std::string &key, const DB::FieldSet *fields, int field_count,
+  int Read(const key_type &key, const DB::FieldSet *fields, int field_count,
            std::vector<KVPair> &result) {
+    std::lock_guard<std::mutex> lock(mutex);
     auto it = db.find(key);
 
     if (it == db.end())
       return DB::kErrorNoData;
 
-    result.clear();
-    get_fields(result, fields, field_count, it->second);
+    records.Get(result, fields, field_count, it->second);
 
     return DB::kOK;
   }
 
-  int Scan(std::string &key, int record_count, const DB::FieldSet *fields,
+  int Scan(const key_type &key, int record_count, const DB::FieldSet *fields,
            int field_count, std::vector<std::vector<KVPair>> &result) {
-    result.clear();
+    if constexpr (ScanSupported) {
+      std::lock_guard<std::mutex> lock(mutex);
+      size_t num_records = 0;
 
-    for (auto it = db.lower_bound(key); it != db.end() && record_count;
-         ++it, --record_count) {
-      result.push_back(get_fields(fields, field_count, it->second));
-    }
+      for (auto it = db.lower_bound(key); it != db.end() && record_count;
+           ++it, --record_count) {
+        if (num_records == result.size())
+          result.emplace_back();
 
-    return DB::kOK;
+        records.Get(result[num_records++], fields, field_count, it->second);
+      }
+
+      result.resize(num_records);
+
+      return DB::kOK;
+    } else {
+      throw "Scan: function not implemented!";
+    }
   }
 
-  int Update(const std::string &key, int field_count, DB::FieldMap &values) {
+  int Update(const key_type &key, int field_count, DB::FieldMap &values) {
+    std::lock_guard<std::mutex> lock(mutex);
     auto it = db.find(key);
 
     if (it == db.end())
       return insert(key, values, true);
 
-    KVPair *fields = it->second;
-    int num_updates = values.size();
-
-    for (int i = 0; (i < field_count) && num_updates; i++) {
-      KVPair &field = fields[i];
-      auto it = values.find(field.first);
-
-      if (it != values.end()) {
-        field.second = it->second;
-        num_updates--;
-      }
-    }
+    records.Update(it->second, field_count, values);
 
     return DB::kOK;
   }
 
-  KVPair *Delete(const std::string &key) {
-    KVPair *fields = nullptr;
+  int Delete(const key_type &key) {
+    std::lock_guard<std::mutex> lock(mutex);
     auto it = db.find(key);
 
-    if (it != db.end()) {
-      fields = it->second;
-      db.erase(it);
-    }
-
-    return fields;
-  }
-
-  template <typename Cont>
-  int insert(const std::string &key, Cont &values, bool locked) {
-    KVPair *fields = new KVPair[values.size()];
-
-    std::copy(std::begin(values), std::end(values), fields);
+    if (it == db.end())
+      return DB::kErrorNoData;
 
-    if (locked) {
-      db[key] = fields;
-    } else {
-      std::lock_guard<std::mutex> lock(mutex);
-      db[key] = fields;
-    }
+    records.Free(it->second);
+    db.erase(it);
 
     return DB::kOK;
   }
 
-  std::vector<KVPair> get_fields(const DB::FieldSet *fields, int field_count,
-                                 const KVPair *fieldvec) {
-    std::vector<KVPair> result;
+  template <typename Cont>
+  int insert(const key_type &key, Cont &values, bool locked) {
+    record_type record = records.Make(values);
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
 
-    get_fields(result, fields, field_count, fieldvec);
+    if (!locked)
+      lock.lock();
 
-    return result;
-  }
+    record_type &old = db[key];
 
-  void get_fields(std::vector<KVPair> &result, const DB::FieldSet *fields,
-                  int field_count, const KVPair *fieldvec) {
-    if (!fields) {
-      result = std::vector<KVPair>{fieldvec, fieldvec + field_count};
-    } else {
-      int num_field_reads = fields->size();
+    if (old)
+      records.Free(old);
 
-      for (int i = 0; (i < field_count) && num_field_reads; i++) {
-        const KVPair &field = fieldvec[i];
+    old = record;
 
-        if (fields->count(field.first)) {
-          result.push_back(field);
-          num_field_reads--;
-        }
-      }
-    }
+    return DB::kOK;
   }
 };
 
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "core/db.h"
+#include "utils/utils.h"
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace ycsbc {
+// Keys of maps, whose keys are of type `Key`. String keys are the table name
+// followed by the key name, built in a per thread buffer, instead of
+// allocating them on every operation. Integer keys are key numbers of the
+// "integer" key mode (see CoreWorkload::KEY_MODE_PROPERTY), tables are
+// ignored.
+template <typename Key> struct MapKey {
+  static constexpr bool INTEGER = std::is_integral_v<Key>;
+
+  using type = std::conditional_t<INTEGER, Key, const std::string &>;
+
+  static type make(const std::string &table, const std::string &key) {
+    if constexpr (INTEGER) {
+      throw utils::Exception("DB has integer keys, set keymode=integer");
+    } else {
+      return keybuf().assign(table).append(key);
+    }
+  }
+
+  static type make(const std::string &table, uint64_t key) {
+    if constexpr (INTEGER) {
+      return key;
+    } else {
+      char num[20];
+      char *end = std::to_chars(num, num + sizeof(num), key).ptr;
+
+      return keybuf().assign(table).append("user").append(num, end);
+    }
+  }
+
+private:
+  static std::string &keybuf() {
+    static thread_local std::string buf;
+
+    return buf;
+  }
+};
+} // namespace ycsbc
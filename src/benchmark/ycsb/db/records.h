@@ -0,0 +1,336 @@
+#pragma once
+
+#include "core/db.h"
+#include "indexes/utils/Utils.h"
+#include "utils/properties.h"
+#include "utils/utils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace ycsbc {
+// Stores of records (fields of a key), which DB adapters keep in their maps as
+// `record_type`. Results are written into the caller's vector, reusing its
+// elements, so that a caller, which reuses its results, does not allocate.
+
+// Records are heap allocated arrays of fields. Concurrent updates copy the
+// record, as it could be read concurrently, and leak the old one.
+class HeapRecords {
+public:
+  using record_type = DB::KVPair *;
+
+  static constexpr bool IN_PLACE_UPDATE = false;
+
+  explicit HeapRecords(const utils::Properties &) {}
+
+  template <typename Cont> record_type Make(const Cont &values) {
+    record_type record = new DB::KVPair[values.size()];
+
+    std::copy(std::begin(values), std::end(values), record);
+
+    return record;
+  }
+
+  // Record must not be read concurrently.
+  void Update(record_type record, int field_count,
+              const DB::FieldMap &values) {
+    int num_updates = values.size();
+
+    for (int i = 0; (i < field_count) && num_updates; i++) {
+      DB::KVPair &field = record[i];
+      auto it = values.find(field.first);
+
+      if (it != values.end()) {
+        field.second = it->second;
+        num_updates--;
+      }
+    }
+  }
+
+  // Copy of `record` (or a new one, if it's null) with `values` updated.
+  record_type Updated(record_type record, int field_count,
+                      const DB::FieldMap &values) {
+    if (record == nullptr)
+      return Make(values);
+
+    record_type copy = new DB::KVPair[field_count];
+
+    std::copy(record, record + field_count, copy);
+    Update(copy, field_count, values);
+
+    return copy;
+  }
+
+  void Get(std::vector<DB::KVPair> &result, const DB::FieldSet *fields,
+           int field_count, const DB::KVPair *record) const {
+    size_t num_results = 0;
+
+    for (int i = 0; i < field_count; i++) {
+      if (fields && !fields->count(record[i].first))
+        continue;
+
+      if (num_results == result.size())
+        result.emplace_back();
+
+      result[num_results++] = record[i];
+    }
+
+    result.resize(num_results);
+  }
+
+  void Free(record_type record) { delete[] record; }
+};
+
+// Fixed size records of "fieldcount" fields of upto "fieldlength" bytes (see
+// CoreWorkload), carved out of large chunks, which are freed only with the
+// store. Records are not allocated on update. Deleted records are pushed to
+// a free list, which inserts pop before carving out new records, so that the
+// store does not grow under insert/delete churn.
+//
+// Fields are overwritten in place under the record's sequence lock, which
+// readers validate after copying fields out, retrying on a concurrent update.
+// A reused record is written under it's lock as well (it's sequence is never
+// reset), so a reader of a record deleted concurrently retries, instead of
+// returning a mix of the old and the new record's fields.
+class ArenaRecords {
+  struct Header {
+    // Odd, while the record is being written.
+    std::atomic<uint32_t> seq;
+    // Index of the record in the store and of the next record in the free
+    // list, while it's free.
+    uint32_t index;
+    std::atomic<uint32_t> next_free;
+  };
+
+public:
+  using record_type = Header *;
+
+  static constexpr bool IN_PLACE_UPDATE = true;
+
+  explicit ArenaRecords(const utils::Properties &props)
+      : field_count_(std::stoi(props.GetProperty("fieldcount", "10"))),
+        field_length_(std::stoi(props.GetProperty("fieldlength", "100"))),
+        record_size_(RoundUp(sizeof(Header) + field_count_ * sizeof(uint32_t) +
+                                 field_count_ * field_length_,
+                             alignof(Header))),
+        chunks_(new std::atomic<char *>[MAX_CHUNKS]) {
+    for (size_t chunk = 0; chunk < MAX_CHUNKS; chunk++)
+      chunks_[chunk].store(nullptr, std::memory_order_relaxed);
+
+    for (int i = 0; i < field_count_; i++)
+      field_names_.push_back("field" + std::to_string(i));
+  }
+
+  ArenaRecords(const ArenaRecords &) = delete;
+
+  ~ArenaRecords() {
+    for (size_t chunk = 0; chunk < MAX_CHUNKS; chunk++)
+      ::operator delete(chunks_[chunk].load(std::memory_order_relaxed));
+  }
+
+  template <typename Cont> record_type Make(const Cont &values) {
+    record_type record = PopFree();
+
+    if (record == nullptr)
+      record = Allocate();
+
+    uint32_t seq = Lock(record);
+
+    std::fill_n(Lengths(record), field_count_, 0);
+
+    for (const auto &field : values)
+      Write(record, field);
+
+    Unlock(record, seq);
+
+    return record;
+  }
+
+  void Update(record_type record, int, const DB::FieldMap &values) {
+    uint32_t seq = Lock(record);
+
+    for (const auto &field : values)
+      Write(record, field);
+
+    Unlock(record, seq);
+  }
+
+  void Get(std::vector<DB::KVPair> &result, const DB::FieldSet *fields, int,
+           record_type record) const {
+    while (true) {
+      uint32_t seq = record->seq.load(std::memory_order_acquire);
+
+      if (seq & 1) {
+        indexes::utils::cpu_relax();
+        continue;
+      }
+
+      size_t num_results = 0;
+
+      for (int i = 0; i < field_count_; i++) {
+        if (fields && !fields->count(field_names_[i]))
+          continue;
+
+        if (num_results == result.size())
+          result.emplace_back();
+
+        uint32_t length =
+            std::min<uint32_t>(Lengths(record)[i], field_length_);
+
+        result[num_results].first.assign(field_names_[i]);
+        result[num_results].second.assign(Data(record, i), length);
+        num_results++;
+      }
+
+      result.resize(num_results);
+      std::atomic_thread_fence(std::memory_order_acquire);
+
+      if (record->seq.load(std::memory_order_relaxed) == seq)
+        return;
+    }
+  }
+
+  // Pushes `record` to the free list. Head of the list is tagged with a
+  // counter of pushes, so that a pop does not succeed over a record popped
+  // and pushed back meanwhile (ABA). Records are never unmapped, so the link
+  // of a popped record could be read.
+  void Free(record_type record) {
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    uint64_t new_head;
+
+    do {
+      record->next_free.store(static_cast<uint32_t>(head),
+                              std::memory_order_relaxed);
+      new_head = ((head >> 32) + 1) << 32 | record->index;
+    } while (!free_head_.compare_exchange_weak(head, new_head,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+  }
+
+private:
+  static constexpr size_t RECORDS_PER_CHUNK = 4096;
+  static constexpr size_t MAX_CHUNKS = 1 << 16;
+  // Index of no record, for the end of the free list.
+  static constexpr uint32_t NO_RECORD = UINT32_MAX;
+
+  static_assert(RECORDS_PER_CHUNK * MAX_CHUNKS < NO_RECORD,
+                "Record indexes must fit in 32 bits");
+
+  int field_count_;
+  int field_length_;
+  size_t record_size_;
+  std::vector<std::string> field_names_;
+  std::unique_ptr<std::atomic<char *>[]> chunks_;
+  std::atomic<size_t> next_record_{0};
+  // Push counter (high 32 bits) and index of the first free record.
+  std::atomic<uint64_t> free_head_{NO_RECORD};
+
+  static size_t RoundUp(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+  }
+
+  record_type Record(size_t index) const {
+    char *mem = chunks_[index / RECORDS_PER_CHUNK].load(
+        std::memory_order_acquire);
+
+    return reinterpret_cast<record_type>(
+        mem + (index % RECORDS_PER_CHUNK) * record_size_);
+  }
+
+  record_type PopFree() {
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+
+    while (static_cast<uint32_t>(head) != NO_RECORD) {
+      record_type record = Record(static_cast<uint32_t>(head));
+      uint64_t new_head = (head >> 32) << 32 |
+                          record->next_free.load(std::memory_order_relaxed);
+
+      if (free_head_.compare_exchange_weak(head, new_head,
+                                           std::memory_order_acquire))
+        return record;
+    }
+
+    return nullptr;
+  }
+
+  // Write lock of `record`, returning it's (even) sequence before.
+  uint32_t Lock(record_type record) {
+    uint32_t seq = record->seq.load(std::memory_order_relaxed);
+
+    while ((seq & 1) || !record->seq.compare_exchange_weak(
+                            seq, seq + 1, std::memory_order_acquire)) {
+      indexes::utils::cpu_relax();
+      seq = record->seq.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return seq;
+  }
+
+  void Unlock(record_type record, uint32_t seq) {
+    record->seq.store(seq + 2, std::memory_order_release);
+  }
+
+  // Lock free, only a chunk's first record allocates it (and the loser of a
+  // race to allocate it frees its copy).
+  record_type Allocate() {
+    size_t index = next_record_.fetch_add(1, std::memory_order_relaxed);
+    size_t chunk = index / RECORDS_PER_CHUNK;
+
+    if (chunk >= MAX_CHUNKS)
+      throw utils::Exception("Record store is full");
+
+    char *mem = chunks_[chunk].load(std::memory_order_acquire);
+
+    if (mem == nullptr) {
+      char *new_mem = static_cast<char *>(
+          ::operator new(RECORDS_PER_CHUNK * record_size_));
+
+      if (chunks_[chunk].compare_exchange_strong(mem, new_mem,
+                                                 std::memory_order_acq_rel)) {
+        mem = new_mem;
+      } else {
+        ::operator delete(new_mem);
+      }
+    }
+
+    record_type record =
+        new (mem + (index % RECORDS_PER_CHUNK) * record_size_) Header{};
+
+    record->index = static_cast<uint32_t>(index);
+
+    return record;
+  }
+
+  uint32_t *Lengths(record_type record) const {
+    return reinterpret_cast<uint32_t *>(record + 1);
+  }
+
+  char *Data(record_type record, int field) const {
+    return reinterpret_cast<char *>(Lengths(record) + field_count_) +
+           static_cast<size_t>(field) * field_length_;
+  }
+
+  // Fields are named "field<index>" (see CoreWorkload). Longer values are
+  // truncated to the field length.
+  template <typename Field> void Write(record_type record, const Field &field) {
+    int index = std::atoi(field.first.c_str() + 5);
+
+    if (index < 0 || index >= field_count_)
+      return;
+
+    uint32_t length = std::min<size_t>(field.second.size(), field_length_);
+
+    std::memcpy(Data(record, index), field.second.data(), length);
+    Lengths(record)[index] = length;
+  }
+};
+} // namespace ycsbc
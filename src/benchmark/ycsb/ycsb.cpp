@@ -8,13 +8,23 @@
 
 #include "core/client.h"
 #include "core/core_workload.h"
+#include "core/pacer.h"
 #include "core/timer.h"
 #include "db/db_factory.h"
+#include "utils/affinity.h"
+#include "utils/perf_counters.h"
 #include "utils/utils.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
 #include <future>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
@@ -23,23 +33,123 @@ static void UsageMessage(const char *command);
 static bool StrStartWith(const char *str, const char *pre);
 static string ParseCommandLine(int argc, const char *argv[],
                                utils::Properties &props);
+static void ReportLatencies(const ycsbc::OperationHistograms &latencies);
+static void ReportPerf(const vector<utils::PerfCounters::Counts> &perf,
+                       uint64_t ops, const char *phase);
 
+// Transactions of a client thread, sampled by the reporter thread.
+struct alignas(64) ClientProgress {
+  atomic<uint64_t> ops{0};
+  ycsbc::OperationHistograms latencies;
+};
+
+// Transactions and their latencies of all clients, at some point of the run.
+struct Snapshot {
+  uint64_t ops = 0;
+  ycsbc::OperationHistograms latencies;
+
+  void Take(const vector<unique_ptr<ClientProgress>> &clients) {
+    ops = 0;
+    for (auto &op_latencies : latencies) {
+      op_latencies.Reset();
+    }
+    for (auto &client : clients) {
+      ops += client->ops.load(memory_order_relaxed);
+      for (int op = 0; op < ycsbc::NUM_OPERATIONS; ++op) {
+        latencies[op].Merge(client->latencies[op]);
+      }
+    }
+  }
+
+  // Leaves transactions since `before`.
+  void Subtract(const Snapshot &before) {
+    ops -= before.ops;
+    for (int op = 0; op < ycsbc::NUM_OPERATIONS; ++op) {
+      latencies[op].Subtract(before.latencies[op]);
+    }
+  }
+};
+
+// Runs `num_ops` operations, or transactions until `stop` is set, if it's
+// given. Transactions are issued as scheduled by `pacer` (open loop), if it's
+// given, instead of as soon as the last one returns.
 int DelegateClient(ycsbc::DB *db, ycsbc::CoreWorkload *wl, const int num_ops,
-                   bool is_loading) {
+                   bool is_loading, ClientProgress *progress,
+                   const atomic<bool> *stop, ycsbc::Pacer *pacer) {
   db->Init();
-  ycsbc::Client client(*db, *wl);
+  ycsbc::Client client(*db, *wl, progress ? &progress->latencies : nullptr);
   int oks = 0;
-  for (int i = 0; i < num_ops; ++i) {
+  for (int i = 0; stop ? !stop->load(memory_order_relaxed) : i < num_ops;
+       ++i) {
     if (is_loading) {
       oks += client.DoInsert();
     } else {
-      oks += client.DoTransaction();
+      oks += client.DoTransaction(pacer ? pacer->Wait() : 0);
+    }
+    if (progress) {
+      progress->ops.store(progress->ops.load(memory_order_relaxed) + 1,
+                          memory_order_relaxed);
     }
   }
   db->Close();
   return oks;
 }
 
+// Runs `client` on the `thread`th client thread, pinned as per `pinning`,
+// counting its hardware events into `perf`, if it's given.
+template <typename Client>
+static int RunClient(const utils::CpuPinning &pinning, int thread,
+                     utils::PerfCounters::Counts *perf, Client client) {
+  pinning.Pin(thread);
+  utils::PerfCounters counters(perf != nullptr);
+  counters.Start();
+  int oks = client();
+  counters.Stop();
+  if (perf) {
+    *perf = counters.Read();
+  }
+  return oks;
+}
+
+// Prints throughput and latency (of all operations) of every `interval` as
+// CSV to stdout, until `done` is set.
+static void ReportProgress(const vector<unique_ptr<ClientProgress>> &clients,
+                           chrono::duration<double> interval, mutex &m,
+                           condition_variable &cv, const bool &done) {
+  auto us = [](uint64_t ticks) {
+    return utils::TscClock::ToNanos(ticks) / 1000;
+  };
+  auto start = chrono::steady_clock::now();
+  auto next = start;
+  Snapshot prev, now;
+
+  cout << "time_s,ktps,mean_us,p50_us,p99_us,p99.9_us,max_us" << endl;
+  cout << fixed << setprecision(2);
+
+  unique_lock<mutex> lock(m);
+  while (true) {
+    next += chrono::duration_cast<chrono::steady_clock::duration>(interval);
+    if (cv.wait_until(lock, next, [&] { return done; })) {
+      break;
+    }
+
+    now.Take(clients);
+    Snapshot window = now;
+    window.Subtract(prev);
+    prev = now;
+
+    ycsbc::Histogram all;
+    for (auto &op_latencies : window.latencies) {
+      all.Merge(op_latencies);
+    }
+    chrono::duration<double> time = chrono::steady_clock::now() - start;
+    cout << time.count() << ',' << window.ops / interval.count() / 1000 << ','
+         << utils::TscClock::NanosPerTick() * all.Mean() / 1000 << ','
+         << us(all.Percentile(50)) << ',' << us(all.Percentile(99)) << ','
+         << us(all.Percentile(99.9)) << ',' << us(all.Max()) << endl;
+  }
+}
+
 int main(const int argc, const char *argv[]) {
   utils::Properties props;
   string file_name = ParseCommandLine(argc, argv, props);
@@ -54,13 +164,58 @@ int main(const int argc, const char *argv[]) {
   wl.Init(props);
 
   const int num_threads = stoi(props.GetProperty("threadcount", "1"));
+  // Transactions run for `duration` seconds (after `warmup` seconds, which are
+  // not counted) instead of a fixed operation count, if it's set.
+  const chrono::duration<double> duration(
+      stod(props.GetProperty("duration", "0")));
+  const chrono::duration<double> warmup(stod(props.GetProperty("warmup", "0")));
+  const chrono::duration<double> report_interval(
+      stod(props.GetProperty("report_interval", "0")));
+
+  // Transactions are scheduled at `target_ops` per second in total (open
+  // loop), if it's set, with "fixed" or "poisson" arrivals.
+  const double target_ops = stod(props.GetProperty("target_ops", "0"));
+  const string arrival = props.GetProperty("arrival", "poisson");
+
+  if (warmup.count() > 0 && duration.count() <= 0) {
+    cout << "Warmup needs a duration" << endl;
+    exit(0);
+  }
+  if (arrival != "poisson" && arrival != "fixed") {
+    cout << "Unknown arrival " << arrival << endl;
+    exit(0);
+  }
+
+  // Threads of both the load and the transaction phase are pinned, the i'th
+  // client of a phase to the i'th cpu of the mapping.
+  utils::CpuPinning pinning;
+  const string numa_policy = props.GetProperty("numa_policy", "default");
+  try {
+    pinning = utils::CpuPinning(props.GetProperty("pin", "none"));
+    utils::SetNumaPolicy(numa_policy);
+  } catch (const utils::Exception &e) {
+    cout << e.what() << endl;
+    exit(0);
+  }
+  cerr << "# Thread to cpu mapping:\t" << pinning.Mapping(num_threads)
+       << endl;
+  cerr << "# NUMA memory policy:\t" << numa_policy << endl;
+
+  // Hardware events of client threads are counted, in both phases.
+  const bool perf = utils::StrToBool(props.GetProperty("perf", "false"));
+  vector<utils::PerfCounters::Counts> load_perf(num_threads);
+  vector<utils::PerfCounters::Counts> run_perf(num_threads);
 
   // Loads data
   vector<future<int>> actual_ops;
   int total_ops = stoi(props[ycsbc::CoreWorkload::RECORD_COUNT_PROPERTY]);
   for (int i = 0; i < num_threads; ++i) {
-    actual_ops.emplace_back(async(launch::async, DelegateClient, db, &wl,
-                                  total_ops / num_threads, true));
+    actual_ops.emplace_back(async(launch::async, [&, i] {
+      return RunClient(pinning, i, perf ? &load_perf[i] : nullptr, [&] {
+        return DelegateClient(db, &wl, total_ops / num_threads, true, nullptr,
+                              nullptr, nullptr);
+      });
+    }));
   }
   assert((int)actual_ops.size() == num_threads);
 
@@ -70,27 +225,153 @@ int main(const int argc, const char *argv[]) {
     sum += n.get();
   }
   cerr << "# Loading records:\t" << sum << endl;
+  if (perf) {
+    ReportPerf(load_perf, total_ops / num_threads * num_threads, "load");
+  }
+
+  // Peforms transactions, recording progress per thread
+  vector<unique_ptr<ClientProgress>> clients;
+  for (int i = 0; i < num_threads; ++i) {
+    clients.emplace_back(new ClientProgress);
+  }
+  utils::TscClock::NanosPerTick();
+
+  vector<unique_ptr<ycsbc::Pacer>> pacers(num_threads);
+  if (target_ops > 0) {
+    for (int i = 0; i < num_threads; ++i) {
+      pacers[i].reset(new ycsbc::Pacer(target_ops / num_threads,
+                                       arrival == "poisson", i + 1));
+    }
+  }
+
+  mutex report_mutex;
+  condition_variable report_cv;
+  bool report_done = false;
+  thread reporter;
+  if (report_interval.count() > 0) {
+    reporter = thread(ReportProgress, cref(clients), report_interval,
+                      ref(report_mutex), ref(report_cv), cref(report_done));
+  }
 
-  // Peforms transactions
   actual_ops.clear();
   total_ops = stoi(props[ycsbc::CoreWorkload::OPERATION_COUNT_PROPERTY]);
+  atomic<bool> stop{false};
   utils::Timer<double> timer;
   timer.Start();
+  auto start = chrono::steady_clock::now();
   for (int i = 0; i < num_threads; ++i) {
-    actual_ops.emplace_back(async(launch::async, DelegateClient, db, &wl,
-                                  total_ops / num_threads, false));
+    actual_ops.emplace_back(async(launch::async, [&, i] {
+      return RunClient(pinning, i, perf ? &run_perf[i] : nullptr, [&] {
+        return DelegateClient(db, &wl, total_ops / num_threads, false,
+                              clients[i].get(),
+                              duration.count() > 0 ? &stop : nullptr,
+                              pacers[i].get());
+      });
+    }));
   }
   assert((int)actual_ops.size() == num_threads);
 
+  Snapshot warm;
+  if (duration.count() > 0) {
+    if (warmup.count() > 0) {
+      this_thread::sleep_until(
+          start + chrono::duration_cast<chrono::steady_clock::duration>(warmup));
+      warm.Take(clients);
+      timer.Start();
+    }
+    this_thread::sleep_until(
+        start + chrono::duration_cast<chrono::steady_clock::duration>(
+                    warmup + duration));
+    stop = true;
+  }
+
   sum = 0;
   for (auto &n : actual_ops) {
     assert(n.valid());
     sum += n.get();
   }
-  double duration = timer.End();
+  double elapsed = timer.End();
+
+  if (reporter.joinable()) {
+    {
+      lock_guard<mutex> lock(report_mutex);
+      report_done = true;
+    }
+    report_cv.notify_one();
+    reporter.join();
+  }
+
+  Snapshot run;
+  run.Take(clients);
+  // Events are counted during warmup too.
+  const uint64_t counted_ops = run.ops;
+  run.Subtract(warm);
   cerr << "# Transaction throughput (KTPS)" << endl;
   cerr << props["dbname"] << '\t' << file_name << '\t' << num_threads << '\t';
-  cerr << total_ops / duration / 1000 << endl;
+  cerr << run.ops / elapsed / 1000 << endl;
+  if (target_ops > 0) {
+    cerr << "# Target throughput (KTPS, " << arrival << " arrivals)\t"
+         << target_ops / 1000 << endl;
+  }
+
+  if (perf) {
+    ReportPerf(run_perf, counted_ops, "transactions");
+  }
+
+  ReportLatencies(run.latencies);
+}
+
+void ReportPerf(const vector<utils::PerfCounters::Counts> &perf, uint64_t ops,
+                const char *phase) {
+  utils::PerfCounters::Counts total;
+  for (auto &counts : perf) {
+    total += counts;
+  }
+
+  if (!total.Any() || ops == 0) {
+    cerr << "# Perf counters (" << phase << "):\tunavailable" << endl;
+    return;
+  }
+
+  cerr << "# Perf counters per operation (" << phase << ")" << endl;
+  string sep;
+  for (int event = 0; event < utils::PerfCounters::NUM_EVENTS; ++event) {
+    if (total.counted[event]) {
+      cerr << sep << utils::PerfCounters::EventName(event);
+      sep = "\t";
+    }
+  }
+  cerr << endl;
+  sep.clear();
+  for (int event = 0; event < utils::PerfCounters::NUM_EVENTS; ++event) {
+    if (total.counted[event]) {
+      cerr << sep << fixed << setprecision(2) << total.values[event] / ops;
+      sep = "\t";
+    }
+  }
+  cerr << endl;
+}
+
+void ReportLatencies(const ycsbc::OperationHistograms &latencies) {
+  auto us = [](uint64_t ticks) {
+    return utils::TscClock::ToNanos(ticks) / 1000;
+  };
+
+  cerr << "# Latency (us)" << endl;
+  cerr << "op\tcount\tmean\tp50\tp90\tp99\tp99.9\tmax" << endl;
+  cerr << fixed << setprecision(2);
+  for (int op = 0; op < ycsbc::NUM_OPERATIONS; ++op) {
+    const ycsbc::Histogram &hist = latencies[op];
+    if (hist.Count() == 0) {
+      continue;
+    }
+    cerr << ycsbc::OperationName(static_cast<ycsbc::Operation>(op)) << '\t'
+         << hist.Count() << '\t'
+         << utils::TscClock::NanosPerTick() * hist.Mean() / 1000 << '\t'
+         << us(hist.Percentile(50)) << '\t' << us(hist.Percentile(90)) << '\t'
+         << us(hist.Percentile(99)) << '\t' << us(hist.Percentile(99.9))
+         << '\t' << us(hist.Max()) << endl;
+  }
 }
 
 string ParseCommandLine(int argc, const char *argv[],
@@ -138,6 +419,29 @@ string ParseCommandLine(int argc, const char *argv[],
       }
       props.SetProperty("slaves", argv[argindex]);
       argindex++;
+    } else if (strcmp(argv[argindex], "-duration") == 0 ||
+               strcmp(argv[argindex], "-warmup") == 0 ||
+               strcmp(argv[argindex], "-report_interval") == 0 ||
+               strcmp(argv[argindex], "-target_ops") == 0 ||
+               strcmp(argv[argindex], "-arrival") == 0 ||
+               strcmp(argv[argindex], "-pin") == 0) {
+      const char *name = argv[argindex] + 1;
+      argindex++;
+      if (argindex >= argc) {
+        UsageMessage(argv[0]);
+        exit(0);
+      }
+      props.SetProperty(name, argv[argindex]);
+      argindex++;
+    } else if (strcmp(argv[argindex], "-perf") == 0) {
+      props.SetProperty("perf", "true");
+      argindex++;
+    } else if (strcmp(argv[argindex], "-numa_interleave") == 0) {
+      props.SetProperty("numa_policy", "interleave");
+      argindex++;
+    } else if (strcmp(argv[argindex], "-numa_local") == 0) {
+      props.SetProperty("numa_policy", "local");
+      argindex++;
     } else if (strcmp(argv[argindex], "-P") == 0) {
       argindex++;
       if (argindex >= argc) {
@@ -174,6 +478,36 @@ void UsageMessage(const char *command) {
   cout << "  -threads n: execute using n threads (default: 1)" << endl;
   cout << "  -db dbname: specify the name of the DB to use (default: basic)"
        << endl;
+  cout << "  -duration s: run transactions for s seconds, instead of "
+          "operationcount"
+       << endl;
+  cout << "  -warmup s: run transactions for s seconds before the duration, "
+          "without"
+       << endl;
+  cout << "             counting them" << endl;
+  cout << "  -report_interval s: print throughput and latency of every s "
+          "seconds as CSV"
+       << endl;
+  cout << "  -target_ops n: issue n transactions per second in total, open "
+          "loop"
+       << endl;
+  cout << "  -arrival poisson|fixed: intervals between transactions of "
+          "-target_ops"
+       << endl;
+  cout << "  -pin compact|scatter|list: pin client threads to cpus, filling a "
+          "NUMA"
+       << endl;
+  cout << "             node first, round robin across nodes, or as listed "
+          "(Ex: 0,2-5)"
+       << endl;
+  cout << "  -numa_interleave: interleave memory across NUMA nodes" << endl;
+  cout << "  -numa_local: place memory on the NUMA node of the allocating "
+          "thread"
+       << endl;
+  cout << "  -perf: count cycles, instructions, cache, TLB and branch misses "
+          "per"
+       << endl;
+  cout << "         operation" << endl;
   cout << "  -P propertyfile: load properties from the given file. Multiple "
           "files can"
        << endl;
@@ -1,3 +1,4 @@
+#include "indexes/btree/cached_map.h"
 #include "indexes/btree/concurrent_map.h"
 #include "indexes/btree/key.h"
 #include "sha512.h"
@@ -7,9 +8,16 @@
 #include <gsl/span>
 #include <tsl/robin_set.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <limits>
 #include <map>
+#include <numeric>
 #include <random>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -24,12 +32,43 @@ struct btree_traits_string_key : indexes::btree::btree_traits_debug {
   static constexpr int NODE_MERGE_THRESHOLD = 80;
 };
 
+struct btree_heap_alloc_traits : btree_small_page_traits {
+  template <std::size_t PageSize>
+  using Allocator = indexes::utils::HeapPageAllocator<PageSize>;
+};
+
+struct btree_no_simd_traits : btree_small_page_traits {
+  static constexpr bool SIMD_SEARCH = false;
+};
+
+struct btree_even_split_traits : indexes::btree::btree_traits_debug {
+  static constexpr int APPEND_SPLIT_PERCENT = 50;
+};
+
+struct btree_deferred_traits : btree_small_page_traits {
+  static constexpr bool DEFERRED_MAINTENANCE = true;
+};
+
+struct btree_sampled_stat_traits : btree_small_page_traits {
+  static constexpr int STAT_SAMPLE_PERIOD = 1;
+};
+
 struct btree_medium_page_traits : indexes::btree::btree_traits_default {
   static constexpr int NODE_SIZE = 384;
   static constexpr int NODE_MERGE_THRESHOLD = 50;
   static constexpr bool STAT = true;
 };
 
+struct btree_mixed_page_traits : indexes::btree::btree_traits_debug {
+  static constexpr int INNER_NODE_SIZE = 256;
+  static constexpr int LEAF_NODE_SIZE = 1024;
+  static constexpr int NODE_MERGE_THRESHOLD = 40;
+};
+
+struct btree_lock_elision_traits : btree_medium_page_traits {
+  static constexpr bool LOCK_ELISION = true;
+};
+
 using Key = indexes::btree::compound_key<int, int, int>;
 using PartKey = indexes::btree::compound_key<int>;
 using range_kind = indexes::btree::range_kind;
@@ -38,6 +77,10 @@ template class indexes::btree::concurrent_map<Key, int,
                                               btree_small_page_traits>;
 template class indexes::btree::concurrent_map<std::string, int,
                                               btree_traits_string_key>;
+template class indexes::btree::concurrent_map<indexes::btree::normalized_key,
+                                              int, btree_traits_string_key>;
+template class indexes::btree::concurrent_map<
+    indexes::btree::inline_string<23>, int, btree_traits_string_key>;
 
 static Key gen_key(std::uniform_int_distribution<int> &dist,
                    std::mt19937 &rnd) {
@@ -354,6 +397,165 @@ TEST_CASE("BtreeConcurrentMapRangeIter") {
   indexes::utils::ThreadRegistry::UnregisterThread();
 }
 
+template <range_kind LRK, range_kind RRK>
+static void check_scan(
+    const indexes::btree::concurrent_map<int, int, btree_small_page_traits>
+        &map,
+    const std::map<int, int> &key_values, int min, int max, std::size_t limit) {
+  auto kv_iter = LRK == range_kind::INCLUSIVE ? key_values.lower_bound(min)
+                                              : key_values.upper_bound(min);
+  auto kv_end = RRK == range_kind::INCLUSIVE ? key_values.upper_bound(max)
+                                             : key_values.lower_bound(max);
+  std::vector<std::pair<int, int>> expected;
+
+  for (; min <= max && kv_iter != kv_end && expected.size() < limit; ++kv_iter)
+    expected.emplace_back(*kv_iter);
+
+  std::vector<std::pair<int, int>> scanned;
+  auto num_scanned = map.scan<LRK, RRK>(
+      min, max, limit,
+      [&](int key, int value) { scanned.emplace_back(key, value); });
+
+  REQUIRE(num_scanned == expected.size());
+  REQUIRE(scanned == expected);
+
+  std::vector<std::pair<int, int>> buffer(limit);
+
+  REQUIRE(map.scan_into<LRK, RRK>(min, max,
+                                 gsl::span<std::pair<int, int>>{buffer}) ==
+          expected.size());
+  buffer.resize(expected.size());
+  REQUIRE(buffer == expected);
+}
+
+TEST_CASE("BtreeConcurrentMapScan") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::btree::concurrent_map<int, int, btree_small_page_traits> map;
+    std::map<int, int> key_values;
+    constexpr auto num_keys = 50000;
+    std::mt19937 rnd{std::random_device{}()};
+    std::uniform_int_distribution<int> kdist{0, num_keys * 2};
+    std::uniform_int_distribution<int> rdist{0, 5000};
+
+    REQUIRE(map.scan<range_kind::INCLUSIVE, range_kind::INCLUSIVE>(
+                0, num_keys, num_keys, [](int, int) {}) == 0);
+
+    for (int i = 0; i < num_keys; i++) {
+      int key = kdist(rnd);
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    for (int i = 0; i < 200; i++) {
+      int min = kdist(rnd);
+      int max = min + rdist(rnd);
+      std::size_t limit = i % 4 ? rdist(rnd) : num_keys;
+
+      check_scan<range_kind::INCLUSIVE, range_kind::INCLUSIVE>(
+          map, key_values, min, max, limit);
+      check_scan<range_kind::INCLUSIVE, range_kind::EXCLUSIVE>(
+          map, key_values, min, max, limit);
+      check_scan<range_kind::EXCLUSIVE, range_kind::INCLUSIVE>(
+          map, key_values, min, max, limit);
+      check_scan<range_kind::EXCLUSIVE, range_kind::EXCLUSIVE>(
+          map, key_values, min, max, limit);
+    }
+
+    // Whole map and min > max
+    check_scan<range_kind::INCLUSIVE, range_kind::INCLUSIVE>(
+        map, key_values, std::numeric_limits<int>::min(),
+        std::numeric_limits<int>::max(), num_keys);
+    check_scan<range_kind::INCLUSIVE, range_kind::INCLUSIVE>(
+        map, key_values, num_keys, 0, num_keys);
+
+    // Callback stops the scan
+    int num_called = 0;
+    auto num_scanned = map.scan<range_kind::INCLUSIVE, range_kind::INCLUSIVE>(
+        0, num_keys * 2, num_keys, [&](int, int) { return ++num_called < 10; });
+
+    REQUIRE(num_called == 10);
+    REQUIRE(num_scanned == 10);
+  }
+  // Partial keys as bounds
+  {
+    indexes::btree::concurrent_map<Key, int, btree_small_page_traits> map;
+
+    for (int i = 0; i < 1000; i++) {
+      for (int j = 0; j < 10; j++)
+        map.Insert(Key{i, j, 0}, i);
+    }
+
+    std::vector<Key> keys;
+    auto num_scanned = map.scan<range_kind::INCLUSIVE, range_kind::EXCLUSIVE>(
+        PartKey{10}, PartKey{20}, 1000,
+        [&](const Key &key, int) { keys.push_back(key); });
+
+    REQUIRE(num_scanned == 100);
+    REQUIRE(keys.front() == Key{10, 0, 0});
+    REQUIRE(keys.back() == Key{19, 9, 0});
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapParallelScan") {
+  constexpr int num_keys = 50000;
+  constexpr int num_partitions = 8;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  indexes::btree::concurrent_map<int, int, btree_small_page_traits> map;
+
+  REQUIRE(map.partition_keys(num_partitions).empty());
+  REQUIRE(map.parallel_scan(num_partitions, [](int, int) {}) == 0);
+
+  std::vector<int> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{std::random_device{}()});
+
+  for (int key : keys)
+    REQUIRE(map.Insert(key, key));
+
+  auto partition_keys = map.partition_keys(num_partitions);
+
+  REQUIRE(partition_keys.size() == num_partitions - 1);
+  REQUIRE(std::is_sorted(partition_keys.begin(), partition_keys.end()));
+  REQUIRE(map.partition_keys(1).empty());
+
+  // Partitions are disjoint and cover the whole map, in order.
+  int next_key = 0;
+  for (std::size_t n = 0; n <= partition_keys.size(); n++) {
+    std::optional<int> lowkey;
+    std::optional<int> highkey;
+
+    if (n > 0)
+      lowkey = partition_keys[n - 1];
+    if (n < partition_keys.size())
+      highkey = partition_keys[n];
+
+    map.scan_partition(lowkey, highkey, [&](int key, int value) {
+      REQUIRE(key == next_key);
+      REQUIRE(value == key);
+      REQUIRE((!lowkey || *lowkey <= key));
+      REQUIRE((!highkey || key < *highkey));
+      next_key++;
+    });
+  }
+  REQUIRE(next_key == num_keys);
+
+  std::vector<std::atomic<int>> num_seen(num_keys);
+  auto num_scanned = map.parallel_scan(num_partitions, [&](int key, int) {
+    num_seen[key].fetch_add(1, std::memory_order_relaxed);
+  });
+
+  REQUIRE(num_scanned == num_keys);
+  for (const auto &count : num_seen)
+    REQUIRE(count == 1);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
 TEST_CASE("BtreeConcurrentMapString") {
   indexes::utils::ThreadRegistry::RegisterThread();
   indexes::btree::concurrent_map<std::string, int, btree_traits_string_key> map;
@@ -444,11 +646,993 @@ TEST_CASE("BtreeConcurrentMapString") {
   indexes::utils::ThreadRegistry::UnregisterThread();
 }
 
+TEST_CASE("BtreeConcurrentMapNormalizedKey") {
+  using StrKey = indexes::btree::compound_key<int, std::string, int64_t>;
+  using DescKey =
+      indexes::btree::compound_key_greater<int, std::string, int64_t>;
+  using indexes::btree::normalized_key;
+
+  const std::vector<std::string> strs{
+      "", std::string(1, '\0'), std::string("a\0b", 3), "a", "ab", "abc",
+      "b", "\xff"};
+  std::mt19937 rnd{std::random_device{}()};
+  std::uniform_int_distribution<int> idist{-3, 3};
+  std::uniform_int_distribution<std::size_t> sdist{0, strs.size() - 1};
+  auto gen_key = [&]() {
+    return StrKey{idist(rnd), strs[sdist(rnd)],
+                  idist(rnd) * (std::numeric_limits<int64_t>::max() / 3)};
+  };
+  auto desc_key = [](const StrKey &key) {
+    return DescKey{std::get<0>(key), std::get<1>(key), std::get<2>(key)};
+  };
+
+  // Normalized keys are ordered like the compound keys.
+  for (int i = 0; i < 10000; i++) {
+    auto k1 = gen_key();
+    auto k2 = gen_key();
+    auto d1 = desc_key(k1);
+    auto d2 = desc_key(k2);
+    PartKey p1{std::get<0>(k1)};
+
+    REQUIRE((k1 < k2) == (normalized_key{k1} < normalized_key{k2}));
+    REQUIRE((k1 == k2) == (normalized_key{k1} == normalized_key{k2}));
+    REQUIRE((d1 < d2) == (k2 < k1));
+    REQUIRE((d1 < d2) == (normalized_key{d1} < normalized_key{d2}));
+    REQUIRE((p1 < k2) == (normalized_key{p1} < normalized_key{k2}));
+    REQUIRE((k2 < p1) == (normalized_key{k2} < normalized_key{p1}));
+  }
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::btree::concurrent_map<normalized_key, int,
+                                   btree_traits_string_key>
+        map;
+    std::map<StrKey, int> key_values;
+
+    for (int i = 0; i < 20000; i++) {
+      auto key = gen_key();
+
+      std::get<2>(key) = i;
+      REQUIRE(map.Insert(normalized_key{key}, i));
+      key_values[key] = i;
+    }
+
+    auto it = key_values.begin();
+    for (const auto &kv : map) {
+      REQUIRE(it != key_values.end());
+      REQUIRE(kv.first == normalized_key{it->first});
+      REQUIRE(kv.second == it->second);
+      ++it;
+    }
+    REQUIRE(it == key_values.end());
+
+    // Partial keys as bounds
+    for (int first = -3; first <= 3; first++) {
+      auto expected = std::count_if(
+          key_values.begin(), key_values.end(),
+          [&](const auto &kv) { return std::get<0>(kv.first) == first; });
+      auto num_scanned =
+          map.scan<range_kind::INCLUSIVE, range_kind::EXCLUSIVE>(
+              normalized_key{PartKey{first}},
+              normalized_key{PartKey{first + 1}}, key_values.size(),
+              [](const normalized_key &, int) {});
+
+      REQUIRE(num_scanned == static_cast<std::size_t>(expected));
+    }
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapInlineString") {
+  using InlineKey = indexes::btree::inline_string<23>;
+
+  REQUIRE_THROWS_AS(InlineKey{std::string(24, 'a')}, std::length_error);
+  REQUIRE(InlineKey{std::string(23, 'a')}.view() == std::string(23, 'a'));
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::btree::concurrent_map<InlineKey, int, btree_traits_string_key>
+        map;
+    indexes::btree::concurrent_map<std::string, int, btree_traits_string_key>
+        str_map;
+    std::map<std::string, int> key_values;
+    constexpr auto num_keys = 20000;
+
+    for (int i = 0; i < num_keys; i++) {
+      std::string key = std::string(i % 3, '\0') + "key_" +
+                        std::to_string(i * 7 % num_keys);
+
+      REQUIRE(map.Insert(InlineKey{key}, i));
+      REQUIRE(str_map.Insert(key, i));
+      key_values[key] = i;
+    }
+
+    // Lookups by std::string_view, without materializing a key_type.
+    for (const auto &kv : key_values) {
+      std::string_view key = kv.first;
+
+      REQUIRE(*map.Search(key) == kv.second);
+      REQUIRE(*str_map.Search(key) == kv.second);
+      REQUIRE(map.lower_bound(key)->first == key);
+      REQUIRE(str_map.lower_bound(key)->first == key);
+    }
+    REQUIRE(!map.Search(std::string_view{"missing"}).has_value());
+
+    auto kv_iter = key_values.begin();
+
+    for (const auto &kv : map) {
+      REQUIRE(kv.first == std::string_view{kv_iter->first});
+      REQUIRE(kv.second == kv_iter->second);
+      ++kv_iter;
+    }
+    REQUIRE(kv_iter == key_values.end());
+
+    for (const auto &kv : key_values)
+      REQUIRE(*map.Delete(InlineKey{kv.first}) == kv.second);
+    REQUIRE(map.size() == 0);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapBulkLoad") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  indexes::btree::concurrent_map<int, int, btree_small_page_traits> map;
+
+  constexpr auto num_keys = 100000;
+  std::vector<std::pair<int, int>> key_values;
+
+  for (int i = 0; i < num_keys; i++)
+    key_values.emplace_back(i * 2, i);
+
+  auto mid = key_values.begin() + num_keys / 2;
+
+  REQUIRE(map.bulk_load(key_values.begin(), mid, 70));
+  REQUIRE(map.bulk_load(mid, key_values.end()) == false);
+  REQUIRE(map.bulk_append(key_values.begin(), mid) == false);
+  REQUIRE(map.bulk_append(mid, key_values.end()));
+  REQUIRE(map.size() == key_values.size());
+
+  auto check_iteration = [&map](auto &key_values) {
+    auto kv_iter = key_values.begin();
+
+    for (auto map_iter = map.begin(); map_iter != map.end(); ++map_iter) {
+      REQUIRE(kv_iter != key_values.end());
+      REQUIRE(map_iter->first == kv_iter->first);
+      REQUIRE(map_iter->second == kv_iter->second);
+      ++kv_iter;
+    }
+    REQUIRE(kv_iter == key_values.end());
+
+    auto kv_riter = key_values.rbegin();
+
+    for (auto map_iter = map.rbegin(); map_iter != map.rend(); ++map_iter) {
+      REQUIRE(map_iter->first == (kv_riter++)->first);
+    }
+    REQUIRE(kv_riter == key_values.rend());
+  };
+
+  check_iteration(key_values);
+
+  for (const auto &kv : key_values) {
+    REQUIRE(*map.Search(kv.first) == kv.second);
+    REQUIRE(map.Search(kv.first + 1).has_value() == false);
+  }
+
+  // New keys fall in b/w the bulk loaded ones and split the packed nodes.
+  std::map<int, int> all_key_values{key_values.begin(), key_values.end()};
+
+  for (int i = 0; i < num_keys; i++) {
+    REQUIRE(map.Insert(i * 2 + 1, i));
+    all_key_values[i * 2 + 1] = i;
+  }
+
+  REQUIRE(map.size() == all_key_values.size());
+  check_iteration(all_key_values);
+
+  for (const auto &kv : all_key_values) {
+    REQUIRE(*map.Delete(kv.first) == kv.second);
+  }
+
+  REQUIRE(map.size() == 0);
+
+  // Emptied tree still accepts appends to its rightmost end.
+  for (auto &kv : key_values)
+    kv.first += num_keys * 2;
+
+  REQUIRE(map.bulk_append(key_values.begin(), key_values.end(), 50));
+  REQUIRE(map.size() == key_values.size());
+  check_iteration(key_values);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapSnapshot") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    using map_t =
+        indexes::btree::concurrent_map<int, int, btree_small_page_traits>;
+    map_t map;
+    std::map<int, int> key_values;
+    constexpr auto num_keys = 100000;
+    std::atomic<bool> done{false};
+
+    for (int i = 0; i < num_keys; i++) {
+      map.Insert(i * 2, i);
+      key_values[i * 2] = i;
+    }
+
+    // Keys inserted concurrently may or may not be in the snapshot.
+    std::thread writer{[&]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+      for (int i = 0; !done; i++)
+        map.Insert(i % num_keys * 2 + 1, i);
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    }};
+
+    const std::string path = "btree_snapshot_test.snap";
+    std::size_t num_written;
+
+    {
+      std::ofstream out{path, std::ios::binary};
+
+      num_written = map.snapshot(out);
+      REQUIRE(out.good());
+    }
+    done = true;
+    writer.join();
+
+    map_t restored;
+
+    REQUIRE(restored.restore(path, 70));
+    REQUIRE(restored.size() == num_written);
+    REQUIRE(restored.restore(path) == false);
+    std::remove(path.c_str());
+
+    std::size_t num_restored = 0;
+    int prev_key = -1;
+
+    for (const auto &kv : restored) {
+      REQUIRE(kv.first > prev_key);
+      REQUIRE(*map.Search(kv.first) == kv.second);
+      prev_key = kv.first;
+      num_restored++;
+    }
+    REQUIRE(num_restored == num_written);
+
+    for (const auto &kv : key_values)
+      REQUIRE(*restored.Search(kv.first) == kv.second);
+
+    std::ostringstream out;
+    map_t in_memory;
+
+    map.snapshot(out);
+
+    std::string image = out.str();
+
+    REQUIRE(in_memory.restore_image(image.data(), image.size()));
+    REQUIRE(in_memory.size() == map.size());
+
+    std::string corrupt = image;
+
+    corrupt[0] = 'X';
+    REQUIRE_THROWS_AS(map_t{}.restore_image(corrupt.data(), corrupt.size()),
+                      std::invalid_argument);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapKeyPrefix") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  // Keys share prefixes longer than the ones stored in slots, so that node
+  // searches have to fall back to full key comparison on ties.
+  {
+    indexes::btree::concurrent_map<std::string, int, btree_traits_string_key>
+        map;
+    std::map<std::string, int> key_values;
+    constexpr auto num_keys = 20000;
+
+    for (int i = 0; i < num_keys; i++) {
+      std::string key = std::string(i % 3, '\0') + "common_prefix_" +
+                        std::to_string(i * 7 % num_keys);
+
+      if (i % 5 == 0)
+        key.resize(i % 9);
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    REQUIRE(map.size() == key_values.size());
+
+    for (const auto &kv : key_values) {
+      REQUIRE(*map.Search(kv.first) == kv.second);
+      REQUIRE(map.Search(kv.first + '\0').has_value() ==
+              (key_values.count(kv.first + '\0') != 0));
+
+      auto kv_upper = key_values.upper_bound(kv.first);
+      auto map_upper = map.upper_bound(kv.first);
+
+      if (kv_upper != key_values.end())
+        REQUIRE(*map_upper == *kv_upper);
+      else
+        REQUIRE(map_upper == map.end());
+    }
+
+    auto kv_iter = key_values.begin();
+
+    for (const auto &kv : map)
+      REQUIRE(kv == *kv_iter++);
+    REQUIRE(kv_iter == key_values.end());
+
+    for (const auto &kv : key_values)
+      REQUIRE(*map.Delete(kv.first) == kv.second);
+    REQUIRE(map.size() == 0);
+  }
+
+  // Prefix of negative members must order before positive ones.
+  {
+    indexes::btree::concurrent_map<Key, int, btree_small_page_traits> map;
+    constexpr auto num_keys = 1000;
+
+    for (int i = -num_keys; i < num_keys; i++) {
+      for (int j = 0; j < 3; j++)
+        REQUIRE(map.Insert(Key{i, j, -j}, i));
+    }
+
+    for (int i = -num_keys; i < num_keys; i++) {
+      auto iter = map.lower_bound(PartKey{i});
+
+      REQUIRE(iter != map.end());
+      REQUIRE(iter->first == Key{i, 0, 0});
+      REQUIRE(*map.Search(Key{i, 2, -2}) == i);
+    }
+
+    int prev = std::numeric_limits<int>::min();
+
+    for (const auto &kv : map) {
+      REQUIRE(prev <= std::get<0>(kv.first));
+      prev = std::get<0>(kv.first);
+    }
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+template <typename KeyType, typename Traits> static void IntegralKeysTest() {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::btree::concurrent_map<KeyType, int, Traits> map;
+    std::map<KeyType, int> key_values;
+    constexpr auto num_keys = 10000;
+    // Keys around the sign bit and both the ends of the key range
+    constexpr auto limits = std::numeric_limits<KeyType>{};
+    KeyType mid = KeyType(1) << (limits.digits - 1);
+    std::vector<KeyType> bases = {limits.min(), mid,
+                                  limits.max() - num_keys * 2};
+
+    for (auto base : bases) {
+      for (int i = 0; i < num_keys; i++) {
+        KeyType key = base + static_cast<KeyType>(i * 7 % num_keys) * 2;
+
+        REQUIRE(map.Insert(key, i));
+        key_values[key] = i;
+      }
+    }
+
+    REQUIRE(map.size() == key_values.size());
+
+    for (const auto &kv : key_values) {
+      REQUIRE(*map.Search(kv.first) == kv.second);
+      REQUIRE(map.Search(kv.first + 1).has_value() == false);
+      REQUIRE(map.lower_bound(kv.first + 1) == map.upper_bound(kv.first));
+
+      auto kv_upper = key_values.upper_bound(kv.first);
+      auto map_upper = map.upper_bound(kv.first);
+
+      if (kv_upper != key_values.end())
+        REQUIRE(*map_upper == *kv_upper);
+      else
+        REQUIRE(map_upper == map.end());
+    }
+
+    auto kv_iter = key_values.begin();
+
+    for (const auto &kv : map)
+      REQUIRE(kv == *kv_iter++);
+    REQUIRE(kv_iter == key_values.end());
+
+    for (const auto &kv : key_values)
+      REQUIRE(*map.Delete(kv.first) == kv.second);
+    REQUIRE(map.size() == 0);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapIntegralKeys") {
+  IntegralKeysTest<int32_t, btree_small_page_traits>();
+  IntegralKeysTest<uint32_t, btree_small_page_traits>();
+  IntegralKeysTest<int64_t, btree_small_page_traits>();
+  IntegralKeysTest<uint64_t, btree_small_page_traits>();
+  IntegralKeysTest<uint64_t, btree_no_simd_traits>();
+  IntegralKeysTest<int32_t, btree_no_simd_traits>();
+}
+
+template <typename Traits> static std::size_t AppendTest(int num_keys) {
+  indexes::btree::concurrent_map<int, int, Traits> map;
+
+  for (int i = 0; i < num_keys; i++) {
+    REQUIRE(map.Insert(i, i));
+    REQUIRE(map.Upsert(i, i + 1) == i);
+    REQUIRE(map.Insert(i, i) == false);
+  }
+
+  REQUIRE(map.size() == static_cast<std::size_t>(num_keys));
+
+  int key = 0;
+  for (const auto &kv : map) {
+    REQUIRE(kv.first == key);
+    REQUIRE(kv.second == key + 1);
+    key++;
+  }
+  REQUIRE(key == num_keys);
+
+  std::size_t num_splits = map.stats().num_leaf_splits;
+
+  // Inserts to the left of rightmost leaf must not use it.
+  for (int i = 0; i < num_keys; i++)
+    REQUIRE(map.Insert(-i - 1, i));
+
+  for (int i = -num_keys; i < num_keys; i++)
+    REQUIRE(map.Search(i).has_value());
+
+  for (int i = -num_keys; i < num_keys; i++)
+    REQUIRE(map.Delete(i).has_value());
+
+  REQUIRE(map.size() == 0);
+  REQUIRE(map.Insert(num_keys, 0));
+
+  return num_splits;
+}
+
+TEST_CASE("BtreeConcurrentMapAppend") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr auto num_keys = 200000;
+  auto append_splits = AppendTest<indexes::btree::btree_traits_debug>(num_keys);
+  auto even_splits = AppendTest<btree_even_split_traits>(num_keys);
+
+  // Appends leave leaves 90% full instead of half full.
+  REQUIRE(append_splits * 10 < even_splits * 7);
+
+  AppendTest<btree_small_page_traits>(num_keys / 10);
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapDeferredMaintenance") {
+  using Btree = indexes::btree::concurrent_map<int, int, btree_deferred_traits>;
+  constexpr int num_keys = 20000;
+  constexpr int KEEP_EVERY = 16;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  Btree map;
+
+  for (int i = 0; i < num_keys; i++)
+    REQUIRE(map.Insert(i, i));
+
+  for (int i = 0; i < num_keys; i++) {
+    if (i % KEEP_EVERY)
+      REQUIRE(map.Delete(i) == i);
+  }
+
+  // Deletes only queue the leaves.
+  REQUIRE(map.stats().num_leaf_merges == 0);
+  REQUIRE(map.maintain(1) == 1);
+
+  auto num_maintained = map.maintain();
+
+  REQUIRE(num_maintained > 0);
+  REQUIRE(map.stats().num_leaf_merges > 0);
+  REQUIRE(map.maintain() == 0);
+
+  REQUIRE(map.size() == num_keys / KEEP_EVERY);
+  int key = 0;
+  for (const auto &kv : map) {
+    REQUIRE(kv.first == key);
+    REQUIRE(kv.second == key);
+    key += KEEP_EVERY;
+  }
+  REQUIRE(key == num_keys);
+
+  // Concurrent deletes and maintenance.
+  for (int i = 0; i < num_keys; i++) {
+    if (i % KEEP_EVERY)
+      REQUIRE(map.Insert(i, i));
+  }
+
+  std::atomic<bool> done = false;
+  std::thread maintainer{[&]() {
+    indexes::utils::ThreadRegistry::RegisterThread();
+
+    while (!done)
+      map.maintain(8);
+
+    indexes::utils::ThreadRegistry::UnregisterThread();
+  }};
+
+  for (int i = 0; i < num_keys; i++)
+    REQUIRE(map.Delete(i) == i);
+
+  done = true;
+  maintainer.join();
+  map.maintain();
+
+  REQUIRE(map.size() == 0);
+
+  for (int i = 0; i < num_keys; i++)
+    REQUIRE(!map.Search(i).has_value());
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapShardedStats") {
+  using Btree =
+      indexes::btree::concurrent_map<int, int, btree_sampled_stat_traits>;
+  constexpr int num_threads = 4;
+  constexpr int keys_per_thread = 10000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  Btree map;
+  std::vector<std::thread> threads;
+
+  // Threads insert interleaved keys, so that they contend on leaves, and
+  // delete some of each other's.
+  for (int thread = 0; thread < num_threads; thread++) {
+    threads.emplace_back([&map, thread]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+
+      for (int i = 0; i < keys_per_thread; i++)
+        REQUIRE(map.Insert(i * num_threads + thread, i));
+
+      for (int i = 0; i < keys_per_thread; i += 4) {
+        int key = i * num_threads + (thread + 1) % num_threads;
+
+        while (!map.Delete(key).has_value())
+          std::this_thread::yield();
+      }
+
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  auto stats = map.stats();
+  std::size_t num_traversals = 0;
+
+  for (auto n : stats.num_traversals)
+    num_traversals += n;
+
+  REQUIRE(map.size() == num_threads * keys_per_thread * 3 / 4);
+  REQUIRE(stats.num_elements == map.size());
+  REQUIRE(stats.num_leaf_splits > 0);
+  REQUIRE(num_traversals >= num_threads * keys_per_thread);
+  // Every pessimistic read is timed.
+  REQUIRE(stats.num_lock_wait_samples == stats.num_pessimistic_reads);
+  REQUIRE(stats.max_lock_wait_nanos * stats.num_lock_wait_samples >=
+          stats.lock_wait_nanos);
+
+  std::ostringstream ostr;
+
+  stats.dump(ostr);
+  REQUIRE(ostr.str().find("Num Traversals With 0 Restarts = ") !=
+          std::string::npos);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapMemoryUsage") {
+  using Btree =
+      indexes::btree::concurrent_map<int, int, btree_small_page_traits>;
+  constexpr int num_keys = 20000;
+  constexpr std::size_t kv_bytes = sizeof(std::pair<int, int>);
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  auto require_consistent = [](const indexes::btree::btree_memory_usage_t &u) {
+    REQUIRE(u.inner_bytes ==
+            u.num_inner_nodes * btree_small_page_traits::NODE_SIZE);
+    REQUIRE(u.leaf_bytes ==
+            u.num_leaf_nodes * btree_small_page_traits::NODE_SIZE);
+    REQUIRE(u.header_bytes + u.live_bytes + u.dead_bytes + u.free_bytes ==
+            u.total_bytes());
+  };
+
+  {
+    Btree map;
+
+    REQUIRE(map.memory_usage().total_bytes() == 0);
+
+    for (int i = 0; i < num_keys; i++)
+      REQUIRE(map.Insert(i, i));
+
+    auto usage = map.memory_usage();
+
+    require_consistent(usage);
+    REQUIRE(usage.num_leaf_nodes > num_keys * kv_bytes /
+                                       btree_small_page_traits::NODE_SIZE);
+    REQUIRE(usage.num_inner_nodes > 0);
+    REQUIRE(usage.live_bytes > num_keys * kv_bytes);
+
+    // Deleted values leave dead space in their leaves.
+    for (int i = 0; i < num_keys; i += 2)
+      REQUIRE(map.Delete(i) == i);
+
+    auto deleted_usage = map.memory_usage();
+
+    require_consistent(deleted_usage);
+    REQUIRE(deleted_usage.live_bytes <=
+            usage.live_bytes - num_keys / 2 * kv_bytes);
+    REQUIRE(deleted_usage.dead_bytes > usage.dead_bytes);
+    REQUIRE(deleted_usage.fragmentation() > usage.fragmentation());
+
+    for (int i = 1; i < num_keys; i += 2)
+      REQUIRE(map.Delete(i) == i);
+
+    map.reclaim_all();
+
+    auto empty_usage = map.memory_usage();
+
+    require_consistent(empty_usage);
+    REQUIRE(empty_usage.retired_bytes == 0);
+    REQUIRE(empty_usage.num_leaf_nodes < usage.num_leaf_nodes / 4);
+
+    std::ostringstream ostr;
+
+    empty_usage.dump(ostr);
+    REQUIRE(ostr.str().find("Num Leaf Nodes = ") != std::string::npos);
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapNodeSizes") {
+  using Btree =
+      indexes::btree::concurrent_map<int, int, btree_mixed_page_traits>;
+  constexpr int num_keys = 20000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  {
+    Btree map;
+    indexes::btree::concurrent_map<int, int, btree_small_page_traits>
+        small_map;
+
+    for (int i = 0; i < num_keys; i++) {
+      REQUIRE(map.Insert(i, i));
+      REQUIRE(small_map.Insert(i, i));
+    }
+
+    auto usage = map.memory_usage();
+    auto small_usage = small_map.memory_usage();
+
+    REQUIRE(usage.inner_bytes ==
+            usage.num_inner_nodes * btree_mixed_page_traits::INNER_NODE_SIZE);
+    REQUIRE(usage.leaf_bytes ==
+            usage.num_leaf_nodes * btree_mixed_page_traits::LEAF_NODE_SIZE);
+    // Leaves are 4x the (small) inner nodes.
+    REQUIRE(usage.num_leaf_nodes * 3 < small_usage.num_leaf_nodes);
+    REQUIRE(usage.num_inner_nodes > 1);
+
+    for (int i = 0; i < num_keys; i++)
+      REQUIRE(map.Search(i) == i);
+
+    for (int i = 0; i < num_keys; i++)
+      REQUIRE(map.Delete(i) == i);
+
+    map.reclaim_all();
+
+    auto empty_usage = map.memory_usage();
+
+    REQUIRE(empty_usage.retired_bytes == 0);
+    REQUIRE(empty_usage.num_leaf_nodes < usage.num_leaf_nodes / 4);
+  }
+
+  MixedMapTest<Btree>();
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeConcurrentMapBatchWrites") {
+  using Btree =
+      indexes::btree::concurrent_map<int, int, btree_small_page_traits>;
+  constexpr int num_keys = 20000;
+  constexpr int num_threads = 4;
+  constexpr int batch_size = 1000;
+
+  auto num_traversals = [](const Btree &map) {
+    std::size_t n = 0;
+
+    for (auto traversals : map.stats().num_traversals)
+      n += traversals;
+    return n;
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  {
+    Btree map;
+    std::vector<std::pair<int, int>> key_values;
+
+    for (int i = 0; i < num_keys; i += 2)
+      key_values.emplace_back(i, i);
+
+    // A sorted batch takes (about) a traversal per leaf.
+    REQUIRE(map.InsertBatch(key_values) == num_keys / 2);
+    REQUIRE(map.size() == num_keys / 2);
+    REQUIRE(map.stats().num_leaf_splits > 0);
+    REQUIRE(num_traversals(map) < num_keys / 8);
+    REQUIRE(map.InsertBatch(key_values) == 0);
+
+    // Shuffled batch with duplicates, the last one of which wins.
+    key_values.clear();
+    for (int i = 0; i < num_keys; i++)
+      key_values.emplace_back(i, -i);
+    for (int i = 1; i < num_keys; i += 2)
+      key_values.emplace_back(i, i);
+    std::shuffle(key_values.begin(), key_values.begin() + num_keys,
+                 std::mt19937{42});
+
+    REQUIRE(map.UpsertBatch(key_values) == num_keys / 2);
+    REQUIRE(map.size() == num_keys);
+    for (int i = 0; i < num_keys; i++)
+      REQUIRE(map.Search(i) == (i % 2 ? i : -i));
+
+    std::vector<int> keys;
+
+    for (int i = -3 * num_keys; i < num_keys; i += 3)
+      keys.push_back(i);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937{42});
+
+    REQUIRE(map.DeleteBatch(keys) == (num_keys + 2) / 3);
+    REQUIRE(map.DeleteBatch(keys) == 0);
+    REQUIRE(map.size() == num_keys - (num_keys + 2) / 3);
+    REQUIRE(map.stats().num_elements == map.size());
+
+    int key = 0;
+    for (const auto &kv : map) {
+      if (key % 3 == 0)
+        key++;
+      REQUIRE(kv.first == key);
+      key++;
+    }
+    REQUIRE(key >= num_keys);
+  }
+
+  {
+    // Batch deletes only queue the leaves.
+    indexes::btree::concurrent_map<int, int, btree_deferred_traits> map;
+    std::vector<std::pair<int, int>> key_values;
+    std::vector<int> keys;
+
+    for (int i = 0; i < num_keys; i++) {
+      key_values.emplace_back(i, i);
+      keys.push_back(i);
+    }
+
+    REQUIRE(map.InsertBatch(key_values) == num_keys);
+    REQUIRE(map.DeleteBatch(keys) == num_keys);
+    REQUIRE(map.stats().num_leaf_merges == 0);
+    REQUIRE(map.maintain() > 0);
+    REQUIRE(map.stats().num_leaf_merges > 0);
+    REQUIRE(map.size() == 0);
+  }
+
+  {
+    Btree map;
+    std::vector<std::thread> threads;
+
+    // Threads write interleaved keys, so that their batches contend on (and
+    // split) the same leaves, then delete some of each other's.
+    for (int thread = 0; thread < num_threads; thread++) {
+      threads.emplace_back([&map, thread]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+
+        std::vector<std::pair<int, int>> key_values;
+        std::vector<int> keys;
+
+        for (int i = 0; i < num_keys; i++)
+          key_values.emplace_back(i * num_threads + thread, i);
+
+        gsl::span<const std::pair<int, int>> batches{key_values};
+
+        for (int i = 0; i < num_keys; i += batch_size)
+          REQUIRE(map.InsertBatch(batches.subspan(i, batch_size)) ==
+                  batch_size);
+
+        for (int i = 0; i < num_keys; i += 2)
+          keys.push_back(i * num_threads + (thread + 1) % num_threads);
+
+        std::size_t num_deleted = 0;
+        while (num_deleted < keys.size()) {
+          num_deleted += map.DeleteBatch(keys);
+          std::this_thread::yield();
+        }
+        REQUIRE(num_deleted == keys.size());
+
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (auto &thread : threads)
+      thread.join();
+
+    REQUIRE(map.size() == num_threads * num_keys / 2);
+    REQUIRE(map.stats().num_elements == map.size());
+
+    for (int key = 0; key < num_threads * num_keys; key++)
+      REQUIRE(map.Search(key).has_value() == ((key / num_threads) % 2 == 1));
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
 TEST_CASE("BtreeConcurrentMapMixed") {
   MixedMapTest<
       indexes::btree::concurrent_map<int, int, btree_small_page_traits>>();
 }
 
+TEST_CASE("BtreeConcurrentMapHeapAllocator") {
+  MixedMapTest<
+      indexes::btree::concurrent_map<int, int, btree_heap_alloc_traits>>();
+}
+
+template <std::size_t PageSize> static void PagePoolAlignmentTest() {
+  using pool_t = indexes::utils::PagePool<PageSize>;
+  std::vector<char *> pages;
+
+  REQUIRE(pool_t::PAGE_STRIDE >= PageSize);
+
+  // Pages of more than a chunk.
+  for (std::size_t i = 0; i < pool_t::PAGES_PER_CHUNK * 2; i++) {
+    auto page = static_cast<char *>(pool_t::allocate());
+
+    REQUIRE(reinterpret_cast<std::uintptr_t>(page) % pool_t::PAGE_ALIGNMENT ==
+            0);
+    std::fill(page, page + PageSize, 0);
+    pages.push_back(page);
+  }
+
+  std::sort(pages.begin(), pages.end());
+
+  for (std::size_t i = 1; i < pages.size(); i++)
+    REQUIRE(pages[i] - pages[i - 1] >= static_cast<std::ptrdiff_t>(PageSize));
+
+  for (char *page : pages)
+    pool_t::deallocate(page);
+}
+
+TEST_CASE("BtreeConcurrentMapPageAlignment") {
+  PagePoolAlignmentTest<btree_small_page_traits::NODE_SIZE>();
+  PagePoolAlignmentTest<btree_medium_page_traits::NODE_SIZE>();
+  PagePoolAlignmentTest<btree_traits_string_key::NODE_SIZE>();
+  // Sizes, that are not a multiple of a cache line (Ex: ART nodes).
+  PagePoolAlignmentTest<200>();
+}
+
+TEST_CASE("BtreeConcurrentMapMultiSearch") {
+  MultiSearchTest<
+      indexes::btree::concurrent_map<int, int, btree_small_page_traits>>();
+}
+
+TEST_CASE("BtreeConcurrentMapFunctionalUpdate") {
+  FunctionalUpdateTest<
+      indexes::btree::concurrent_map<int, int, btree_small_page_traits>>();
+}
+
+TEST_CASE("BtreeCachedMapMixed") {
+  MixedMapTest<indexes::btree::cached_map<int, int, btree_small_page_traits>>();
+}
+
+TEST_CASE("BtreeCachedMapFunctionalUpdate") {
+  FunctionalUpdateTest<
+      indexes::btree::cached_map<int, int, btree_small_page_traits>>();
+}
+
+TEST_CASE("BtreeCachedMapHotKeys") {
+  using CachedMap =
+      indexes::btree::cached_map<int, int, btree_small_page_traits>;
+  constexpr int num_keys = 10000;
+  constexpr int num_hot_keys = 16;
+  constexpr int num_updates = 20000;
+  constexpr int num_readers = 3;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  // Smaller than the keys, so that entries are evicted.
+  CachedMap map(num_keys / 8);
+
+  REQUIRE(map.cache_capacity() >= num_keys / 8);
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Insert(key, 0));
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Search(key) == 0);
+
+  // Values of hot keys only grow, so that readers would see a stale cached
+  // value as a decrease.
+  std::atomic<bool> done = false;
+  std::vector<std::thread> readers;
+
+  for (int reader = 0; reader < num_readers; reader++) {
+    readers.emplace_back([&map, &done, reader]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+
+      std::vector<int> last(num_hot_keys, 0);
+      std::mt19937 rnd(reader);
+
+      while (!done) {
+        int key = rnd() % num_hot_keys;
+        auto value = map.Search(key);
+
+        REQUIRE(value.has_value());
+        REQUIRE(*value >= last[key]);
+        last[key] = *value;
+      }
+
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    });
+  }
+
+  for (int i = 1; i <= num_updates; i++) {
+    int key = i % num_hot_keys;
+
+    if (i % 3 == 0) {
+      REQUIRE(map.Update(key, [](int &value) { value++; }).has_value());
+    } else {
+      auto value = map.Search(key);
+
+      REQUIRE(map.Update(key, *value + 1) == *value);
+    }
+  }
+
+  done = true;
+
+  for (auto &reader : readers)
+    reader.join();
+
+  for (int key = 0; key < num_hot_keys; key++) {
+    REQUIRE(map.Search(key) == num_updates / num_hot_keys);
+    REQUIRE(map.Search(key) == map.map().lower_bound(key)->second);
+  }
+
+  // Deletes are not served from the cache.
+  for (int key = 0; key < num_keys; key += 2)
+    REQUIRE(map.Delete(key).has_value());
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Search(key).has_value() == (key % 2 == 1));
+
+  REQUIRE(map.size() == num_keys / 2);
+  REQUIRE(map.cache_stats().num_hits > 0);
+  REQUIRE(map.cache_stats().num_misses >= num_keys);
+  REQUIRE(map.memory_usage().cache_bytes >=
+          map.cache_capacity() * 2 * sizeof(int));
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("BtreeCachedMapConcurrency") {
+  using CachedMap = indexes::btree::cached_map<int64_t, int64_t,
+                                               btree_medium_page_traits>;
+  ConcurrentMapTest<CachedMap, LookupType::LT_DEFAULT>(
+      ConcurrentMapTestWorkload::WL_CONTENTED, [] {});
+}
+
 using Btree =
     indexes::btree::concurrent_map<int64_t, int64_t, btree_medium_page_traits>;
 static void range_scan(Btree &map, int64_t min, int64_t max, size_t count) {
@@ -488,4 +1672,11 @@ TEST_CASE("BtreeConcurrentMapConcurrencyContented") {
       ConcurrentMapTestWorkload::WL_CONTENTED, range_scan);
 }
 
+TEST_CASE("BtreeConcurrentMapLockElision") {
+  using Btree = indexes::btree::concurrent_map<int64_t, int64_t,
+                                               btree_lock_elision_traits>;
+  ConcurrentMapTest<Btree, LookupType::LT_DEFAULT>(
+      ConcurrentMapTestWorkload::WL_CONTENTED, [] {});
+}
+
 TEST_SUITE_END();
\ No newline at end of file
@@ -1,13 +1,16 @@
+#include "indexes/btree/frozen_map.h"
 #include "indexes/btree/key.h"
 #include "indexes/btree/map.h"
 #include "sha512.h"
 
 #include <doctest/doctest.h>
 
+#include <algorithm>
 #include <limits>
 #include <map>
 #include <random>
 #include <string>
+#include <vector>
 
 struct btree_small_page_traits : indexes::btree::btree_traits_debug {
   static constexpr int NODE_SIZE = 192;
@@ -18,8 +21,16 @@ struct btree_traits_string_key : indexes::btree::btree_traits_debug {
   static constexpr int NODE_SIZE = 448;
 };
 
+struct btree_mixed_page_traits : indexes::btree::btree_traits_debug {
+  static constexpr int INNER_NODE_SIZE = 192;
+  static constexpr int LEAF_NODE_SIZE = 512;
+  static constexpr int NODE_MERGE_THRESHOLD = 40;
+};
+
 template class indexes::btree::map<int, int, btree_small_page_traits>;
+template class indexes::btree::map<int, int, btree_mixed_page_traits>;
 template class indexes::btree::map<std::string, int, btree_traits_string_key>;
+template class indexes::btree::frozen_map<int, int>;
 
 TEST_SUITE_BEGIN("btree");
 
@@ -341,4 +352,122 @@ TEST_CASE("BtreeMapMixed") {
   REQUIRE(map.size() == 0);
 }
 
+TEST_CASE("BtreeMapNodeSizes") {
+  indexes::btree::map<int, int, btree_mixed_page_traits> map;
+
+  constexpr auto num_keys = 100000;
+
+  for (int i = 0; i < num_keys; i++)
+    map[i] = i;
+
+  REQUIRE(map.size() == num_keys);
+
+  for (int i = 0; i < num_keys; i += 2) {
+    auto it = map.find(i);
+
+    REQUIRE(it != map.end());
+    REQUIRE(it.data() == i);
+    map.erase(it);
+  }
+
+  REQUIRE(map.size() == num_keys / 2);
+
+  for (int i = 0; i < num_keys; i++) {
+    auto it = map.find(i);
+
+    if (i % 2) {
+      REQUIRE(it != map.end());
+      REQUIRE(it.data() == i);
+    } else {
+      REQUIRE(it == map.end());
+    }
+  }
+}
+
+TEST_CASE("BtreeFrozenMap") {
+  indexes::btree::map<int, int, btree_small_page_traits> map;
+  std::map<int, int> key_values;
+
+  std::random_device r;
+  std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+  std::mt19937 rnd(seed);
+  std::uniform_int_distribution<int> key_dist{-100000, 100000};
+
+  REQUIRE(indexes::btree::frozen_map<int, int>{map}.empty());
+
+  for (int i = 0; i < 50000; i++) {
+    auto key = key_dist(rnd);
+
+    map[key] = i;
+    key_values[key] = i;
+  }
+
+  const indexes::btree::frozen_map<int, int> frozen{map};
+
+  REQUIRE(frozen.size() == key_values.size());
+  REQUIRE(std::equal(frozen.begin(), frozen.end(), key_values.begin(),
+                     key_values.end()));
+  REQUIRE(std::equal(frozen.rbegin(), frozen.rend(), key_values.rbegin(),
+                     key_values.rend()));
+
+  auto check_bounds = [&](const auto &frozen) {
+    for (int key = -100002; key <= 100002; key += 3) {
+      auto lower = key_values.lower_bound(key);
+      auto upper = key_values.upper_bound(key);
+      auto it = frozen.find(key);
+
+      if (key_values.count(key))
+        REQUIRE(it.data() == key_values[key]);
+      else
+        REQUIRE(it == frozen.end());
+
+      if (lower != key_values.end())
+        REQUIRE(*frozen.lower_bound(key) == *lower);
+      else
+        REQUIRE(frozen.lower_bound(key) == frozen.end());
+
+      if (upper != key_values.end())
+        REQUIRE(*frozen.upper_bound(key) == *upper);
+      else
+        REQUIRE(frozen.upper_bound(key) == frozen.end());
+    }
+  };
+
+  check_bounds(frozen);
+
+  // Serve lookups from a copy of the image, as if read from a file.
+  auto image = static_cast<char *>(
+      ::operator new(frozen.byte_size(), std::align_val_t{64}));
+
+  std::copy_n(static_cast<const char *>(frozen.data()), frozen.byte_size(),
+              image);
+  {
+    auto view =
+        indexes::btree::frozen_map<int, int>::view(image, frozen.byte_size());
+
+    REQUIRE(view.size() == frozen.size());
+    check_bounds(view);
+  }
+  ::operator delete(image, std::align_val_t{64});
+
+  // Non trivial keys
+  std::vector<std::pair<std::string, int>> str_values;
+
+  for (const auto &kv : key_values)
+    str_values.emplace_back(std::to_string(kv.first), kv.second);
+  std::sort(str_values.begin(), str_values.end());
+
+  indexes::btree::frozen_map<std::string, int> str_frozen{str_values.begin(),
+                                                          str_values.end()};
+
+  REQUIRE(std::equal(
+      str_frozen.begin(), str_frozen.end(), str_values.begin(),
+      str_values.end(), [](const auto &kv1, const auto &kv2) {
+        return kv1.first == kv2.first && kv1.second == kv2.second;
+      }));
+  for (const auto &kv : str_values)
+    REQUIRE(str_frozen.find(kv.first).data() == kv.second);
+  REQUIRE(str_frozen.find("x") == str_frozen.end());
+}
+
 TEST_SUITE_END();
\ No newline at end of file
@@ -5,13 +5,45 @@
 #include <absl/hash/hash.h>
 #include <doctest/doctest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <limits>
+#include <map>
+#include <optional>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 TEST_SUITE_BEGIN("concurrent_art");
 
+namespace {
+std::atomic<std::int64_t> num_live_nodes{0};
+
+// Counts nodes allocated (and not yet freed) from the default pools.
+struct art_counting_alloc_traits : indexes::art::art_traits_default {
+  template <std::size_t NodeSize> struct Allocator {
+    using pool_t = indexes::art::art_traits_default::Allocator<NodeSize>;
+
+    static void *allocate() {
+      num_live_nodes++;
+      return pool_t::allocate();
+    }
+
+    static void deallocate(void *node) {
+      num_live_nodes--;
+      pool_t::deallocate(node);
+    }
+  };
+};
+} // namespace
+
 TEST_CASE("ConcurrentARTBasic") {
   indexes::utils::ThreadRegistry::RegisterThread();
   indexes::art::concurrent_map<uint64_t, indexes::art::art_traits_debug> map;
@@ -57,6 +89,18 @@ TEST_CASE("ConcurrentARTMixed") {
       indexes::art::concurrent_map<int, indexes::art::art_traits_debug>>();
 }
 
+TEST_CASE("ConcurrentARTMultiSearch") {
+  MultiSearchTest<
+      indexes::art::concurrent_map<int, indexes::art::art_traits_debug>,
+      uint64_t>();
+}
+
+TEST_CASE("ConcurrentARTFunctionalUpdate") {
+  FunctionalUpdateTest<
+      indexes::art::concurrent_map<int, indexes::art::art_traits_debug>,
+      uint64_t>();
+}
+
 TEST_CASE("ConcurrentARTConcurrencyRandom") {
   ConcurrentMapTest<indexes::art::concurrent_map<int64_t>,
                     LookupType::LT_DEFAULT>(
@@ -69,4 +113,968 @@ TEST_CASE("ConcurrentARTConcurrencyContented") {
       ConcurrentMapTestWorkload::WL_CONTENTED_SWAP, [] {});
 }
 
+TEST_CASE("ConcurrentARTBinaryKey") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<int, indexes::art::art_traits_default,
+                                 indexes::art::binary_key>
+        map;
+    std::unordered_map<std::string, int> key_values;
+
+    std::random_device r;
+    std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+    std::mt19937 rnd(seed);
+    std::uniform_int_distribution<int> len_dist{0, 12};
+    std::uniform_int_distribution<int> char_dist{0, 3};
+
+    // Small alphabet (with '\0') and short keys, so that many keys are
+    // prefixes of others and share long prefixes.
+    auto gen_key = [&]() {
+      std::string key(len_dist(rnd), '\0');
+
+      for (auto &c : key)
+        c = "\0ab\xFF"[char_dist(rnd)];
+
+      return key;
+    };
+
+    for (int i = 0; i < 100000; i++) {
+      auto key = gen_key();
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    std::string long_key(1000, 'x');
+
+    REQUIRE(map.Insert(long_key, -1));
+    REQUIRE(map.Insert(long_key + 'x', -2));
+    key_values[long_key] = -1;
+    key_values[long_key + 'x'] = -2;
+
+    REQUIRE(map.size() == key_values.size());
+
+    for (const auto &kv : key_values) {
+      REQUIRE(*map.Search(kv.first) == kv.second);
+      REQUIRE(map.Search(kv.first + "c").has_value() == false);
+    }
+
+    std::vector<std::string_view> keys;
+    std::vector<std::optional<int>> values(key_values.size());
+
+    for (const auto &kv : key_values)
+      keys.push_back(kv.first);
+
+    map.MultiSearch(keys, values);
+
+    for (std::size_t i = 0; i < keys.size(); i++)
+      REQUIRE(*values[i] == key_values[std::string{keys[i]}]);
+
+    int num_deleted = 0;
+
+    for (const auto &kv : key_values) {
+      if (num_deleted++ % 2)
+        REQUIRE(*map.Delete(kv.first) == kv.second);
+    }
+
+    num_deleted = 0;
+    for (const auto &kv : key_values) {
+      REQUIRE(map.Search(kv.first).has_value() == (num_deleted++ % 2 == 0));
+    }
+
+    for (const auto &kv : key_values)
+      map.Delete(kv.first);
+    REQUIRE(map.size() == 0);
+
+    REQUIRE_THROWS_AS(map.Insert(std::string(40000, 'x'), 0),
+                      std::length_error);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTLongPrefix") {
+  auto same = [](const auto &kv1, const auto &kv2) {
+    return kv1.first == kv2.first && kv1.second == kv2.second;
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    using map_t =
+        indexes::art::concurrent_map<int, indexes::art::art_traits_default,
+                                     indexes::art::binary_key>;
+    map_t map;
+    std::map<std::string, int> key_values;
+
+    std::mt19937 rnd(42);
+
+    // Keys differ at a few positions of a long common prefix, before and
+    // after the bytes of it inner nodes store, and are cut at lengths within
+    // it, so that inner nodes are split at any byte of their prefix.
+    auto gen_key = [&]() {
+      std::string key(64, 'a');
+
+      for (int pos : {3, 17, 33, 50})
+        if (rnd() % 2)
+          key[pos] = 'b';
+
+      key.resize(std::array{20, 40, 64}[rnd() % 3]);
+
+      for (int i = rnd() % 3; i > 0; i--)
+        key.push_back("ab"[rnd() % 2]);
+
+      return key;
+    };
+
+    auto check = [&]() {
+      REQUIRE(map.size() == key_values.size());
+      REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                         key_values.end(), same));
+
+      for (int i = 0; i < 2000; i++) {
+        auto key = gen_key();
+        auto it = key_values.find(key);
+        auto lb = map.lower_bound(key);
+        auto ub = map.upper_bound(key);
+        auto expected_lb = key_values.lower_bound(key);
+        auto expected_ub = key_values.upper_bound(key);
+
+        REQUIRE(map.Search(key) ==
+                (it != key_values.end() ? std::optional{it->second}
+                                        : std::nullopt));
+
+        REQUIRE((lb == map.end()) == (expected_lb == key_values.end()));
+        if (lb != map.end())
+          REQUIRE(same(*lb, *expected_lb));
+
+        REQUIRE((ub == map.end()) == (expected_ub == key_values.end()));
+        if (ub != map.end())
+          REQUIRE(same(*ub, *expected_ub));
+      }
+    };
+
+    for (int i = 0; i < 2000; i++) {
+      auto key = gen_key();
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    check();
+
+    // Inner nodes left without leaves, have no leaf to read their prefix
+    // from, when keys are inserted again.
+    for (const auto &kv : key_values)
+      REQUIRE(*map.Delete(kv.first) == kv.second);
+    key_values.clear();
+
+    for (int i = 0; i < 2000; i++) {
+      auto key = gen_key();
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    check();
+  }
+  {
+    indexes::art::concurrent_map<int, indexes::art::art_traits_default,
+                                 indexes::art::binary_key>
+        map;
+    constexpr int NUM_THREADS = 4;
+    constexpr int NUM_KEYS = 1000;
+    std::vector<std::thread> threads;
+
+    // Threads insert and delete keys of their own, under a common prefix,
+    // so that nodes are split and emptied concurrently.
+    auto thread_key = [](int thread, int i) {
+      return std::string(40, 'p') + std::to_string(i % 10) +
+             std::string(30, 'q') + std::to_string(thread) +
+             std::to_string(i);
+    };
+
+    for (int thread = 0; thread < NUM_THREADS; thread++) {
+      threads.emplace_back([&, thread]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+
+        for (int round = 0; round < 3; round++) {
+          for (int i = 0; i < NUM_KEYS; i++)
+            map.Insert(thread_key(thread, i), i);
+          for (int i = 0; i < NUM_KEYS; i++)
+            map.Delete(thread_key(thread, i));
+        }
+
+        for (int i = 0; i < NUM_KEYS; i++)
+          map.Insert(thread_key(thread, i), i);
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (auto &thread : threads)
+      thread.join();
+
+    REQUIRE(map.size() == NUM_THREADS * NUM_KEYS);
+
+    for (int thread = 0; thread < NUM_THREADS; thread++)
+      for (int i = 0; i < NUM_KEYS; i++)
+        REQUIRE(*map.Search(thread_key(thread, i)) == i);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTOrderedScan") {
+  // Key types of the pairs differ in constness.
+  auto same = [](const auto &kv1, const auto &kv2) {
+    return kv1.first == kv2.first && kv1.second == kv2.second;
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<int> map;
+    std::map<std::uint64_t, int> key_values;
+
+    std::random_device r;
+    std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+    std::mt19937_64 rnd(seed);
+    // Narrow and full ranges, so that keys share long prefixes and differ in
+    // their most significant bytes.
+    auto gen_key = [&]() {
+      return rnd() % 2 ? rnd() % 100000 : rnd();
+    };
+
+    REQUIRE(map.begin() == map.end());
+    REQUIRE(map.rbegin() == map.rend());
+
+    for (int i = 0; i < 100000; i++) {
+      auto key = gen_key();
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    int num_deleted = 0;
+
+    for (auto it = key_values.begin(); it != key_values.end();) {
+      if (num_deleted++ % 3 == 0) {
+        REQUIRE(*map.Delete(it->first) == it->second);
+        it = key_values.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                       key_values.end(), same));
+    REQUIRE(std::equal(map.rbegin(), map.rend(), key_values.rbegin(),
+                       key_values.rend(), same));
+
+    for (int i = 0; i < 10000; i++) {
+      auto key = gen_key();
+      auto lb = map.lower_bound(key);
+      auto ub = map.upper_bound(key);
+      auto expected_lb = key_values.lower_bound(key);
+      auto expected_ub = key_values.upper_bound(key);
+
+      REQUIRE((lb == map.end()) == (expected_lb == key_values.end()));
+      if (lb != map.end())
+        REQUIRE(same(*lb, *expected_lb));
+
+      REQUIRE((ub == map.end()) == (expected_ub == key_values.end()));
+      if (ub != map.end())
+        REQUIRE(same(*ub, *expected_ub));
+    }
+
+    for (int i = 0; i < 1000; i++) {
+      auto min = gen_key();
+      auto max = min + rnd() % 1000;
+      std::vector<std::pair<std::uint64_t, int>> scanned;
+
+      auto num_scanned = map.scan(min, max, [&](auto key, int value) {
+        scanned.emplace_back(key, value);
+      });
+
+      REQUIRE(num_scanned == scanned.size());
+      REQUIRE(std::equal(scanned.begin(), scanned.end(),
+                         key_values.lower_bound(min),
+                         key_values.upper_bound(max), same));
+    }
+
+    std::size_t num_scanned = 0;
+
+    REQUIRE(map.scan(0, std::numeric_limits<std::uint64_t>::max(),
+                     [&](auto, int) { return ++num_scanned < 10; }) == 10);
+  }
+  {
+    indexes::art::concurrent_map<int, indexes::art::art_traits_default,
+                                 indexes::art::binary_key>
+        map;
+    std::map<std::string, int> key_values;
+
+    std::random_device r;
+    std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+    std::mt19937 rnd(seed);
+    std::uniform_int_distribution<int> len_dist{0, 8};
+    std::uniform_int_distribution<int> char_dist{0, 3};
+
+    // '\0' is escaped in stored keys, which must still sort before others.
+    auto gen_key = [&]() {
+      std::string key(len_dist(rnd), '\0');
+
+      for (auto &c : key)
+        c = "\0ab\xFF"[char_dist(rnd)];
+
+      return key;
+    };
+
+    for (int i = 0; i < 20000; i++) {
+      auto key = gen_key();
+
+      map.Upsert(key, i);
+      key_values[key] = i;
+    }
+
+    REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                       key_values.end(), same));
+    REQUIRE(std::equal(map.rbegin(), map.rend(), key_values.rbegin(),
+                       key_values.rend(), same));
+
+    // std::string compares chars as unsigned, like stored keys.
+    for (int i = 0; i < 10000; i++) {
+      auto key = gen_key();
+      auto lb = map.lower_bound(key);
+      auto expected_lb = key_values.lower_bound(key);
+
+      REQUIRE((lb == map.end()) == (expected_lb == key_values.end()));
+      if (lb != map.end())
+        REQUIRE(same(*lb, *expected_lb));
+    }
+
+    auto min = std::string{"a"}, max = std::string{"b"};
+    std::vector<std::pair<std::string, int>> scanned;
+
+    map.scan(min, max, [&](const std::string &key, int value) {
+      scanned.emplace_back(key, value);
+    });
+    REQUIRE(std::equal(scanned.begin(), scanned.end(),
+                       key_values.lower_bound(min),
+                       key_values.upper_bound(max), same));
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTConcurrentOrderedScan") {
+  // Values are too large to be embedded, and updated in place, so that a
+  // value copied while it is written would be torn.
+  using value_t = std::array<std::uint64_t, 64>;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<value_t> map;
+    // Words of a value are all `key << 20 | counter`.
+    constexpr std::uint64_t NUM_KEYS = 4096;
+    constexpr int NUM_WRITERS = 2;
+    constexpr int NUM_SCANS = 500;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+
+    auto make_value = [](std::uint64_t key, std::uint64_t counter) {
+      value_t value;
+
+      value.fill(key << 20 | counter);
+      return value;
+    };
+
+    auto is_torn = [](std::uint64_t key, const value_t &value) {
+      return value[0] >> 20 != key ||
+             std::any_of(value.begin(), value.end(),
+                         [&](auto word) { return word != value[0]; });
+    };
+
+    // Every other key is never deleted, so that scans always find them.
+    for (std::uint64_t key = 0; key < NUM_KEYS; key += 2)
+      REQUIRE(map.Insert(key, make_value(key, 0)));
+
+    for (int writer = 0; writer < NUM_WRITERS; writer++) {
+      writers.emplace_back([&, writer]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+        std::mt19937_64 rnd(writer);
+
+        for (std::uint64_t counter = 1; !done; counter++) {
+          auto key = rnd() % NUM_KEYS;
+
+          if (key % 2 && rnd() % 2) {
+            map.Delete(key);
+          } else {
+            map.Upsert(key, make_value(key, counter % (1 << 20)));
+          }
+        }
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    std::size_t num_torn = 0;
+    std::size_t num_unordered = 0;
+    std::size_t num_missing = 0;
+
+    // Checks that keys are strictly ordered, that values are not torn and
+    // that no key which is never deleted is skipped.
+    auto check = [&](auto first, auto last, bool reverse) {
+      // Next key, which is never deleted.
+      std::int64_t expected = reverse ? NUM_KEYS - 2 : 0;
+      std::optional<std::int64_t> prev;
+
+      for (auto it = first; it != last; ++it) {
+        std::int64_t key = it->first;
+
+        if (prev && (reverse ? key >= *prev : key <= *prev))
+          num_unordered++;
+        if (is_torn(key, it->second))
+          num_torn++;
+        if (reverse ? key < expected : key > expected)
+          num_missing++;
+
+        expected = reverse ? (key - 1) & ~1ll : (key + 2) & ~1ll;
+        prev = key;
+      }
+
+      if (reverse ? expected >= 0 : expected < std::int64_t{NUM_KEYS})
+        num_missing++;
+    };
+
+    for (int i = 0; i < NUM_SCANS; i++) {
+      check(map.begin(), map.end(), false);
+      check(map.rbegin(), map.rend(), true);
+
+      std::optional<std::uint64_t> prev;
+
+      map.scan(NUM_KEYS / 4, NUM_KEYS / 2, [&](auto key, const value_t &value) {
+        if (prev && key <= *prev)
+          num_unordered++;
+        if (is_torn(key, value))
+          num_torn++;
+        prev = key;
+      });
+    }
+
+    done = true;
+    for (auto &writer : writers)
+      writer.join();
+
+    REQUIRE(num_unordered == 0);
+    REQUIRE(num_torn == 0);
+    REQUIRE(num_missing == 0);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTNodeAllocator") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<int, art_counting_alloc_traits> map;
+    std::mt19937_64 rnd(0);
+    std::vector<std::uint64_t> keys(10000);
+
+    for (auto &key : keys)
+      key = rnd();
+
+    // Churn grows and shrinks nodes of every type.
+    for (int round = 0; round < 10; round++) {
+      for (std::size_t i = 0; i < keys.size(); i++)
+        REQUIRE(map.Insert(keys[i], static_cast<int>(i)));
+
+      REQUIRE(num_live_nodes > static_cast<std::int64_t>(keys.size()));
+
+      for (std::size_t i = 0; i < keys.size(); i++)
+        REQUIRE(*map.Delete(keys[i]) == static_cast<int>(i));
+
+      map.reclaim_all();
+    }
+
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+      REQUIRE(map.Insert(keys[i], static_cast<int>(i)));
+  }
+  REQUIRE(num_live_nodes == 0);
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTMemoryUsage") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<std::uint64_t, art_counting_alloc_traits>
+        map;
+    std::mt19937_64 rnd(0);
+    std::vector<std::uint64_t> keys(10000);
+    auto num_nodes = num_live_nodes.load();
+
+    for (auto &key : keys)
+      key = rnd() | std::uint64_t{1} << 63;
+
+    auto count_nodes = [](const indexes::art::art_memory_usage_t &usage) {
+      return static_cast<std::int64_t>(usage.num_node4 + usage.num_node16 +
+                                       usage.num_node48 + usage.num_node256 +
+                                       usage.num_leaves);
+    };
+
+    for (std::size_t i = 0; i < keys.size(); i++)
+      REQUIRE(map.Insert(keys[i], keys[i]));
+
+    map.reclaim_all();
+
+    auto usage = map.memory_usage();
+
+    // Values with the top bit set are not embedded.
+    REQUIRE(usage.num_leaves == keys.size());
+    REQUIRE(count_nodes(usage) == num_live_nodes - num_nodes);
+    REQUIRE(usage.retired_bytes == 0);
+    REQUIRE(usage.total_bytes() == usage.inner_bytes + usage.leaf_bytes);
+
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+      REQUIRE(*map.Delete(keys[i]) == keys[i]);
+
+    REQUIRE(map.memory_usage().retired_bytes > 0);
+
+    map.reclaim_all();
+    usage = map.memory_usage();
+
+    REQUIRE(usage.num_leaves == keys.size() / 2);
+    REQUIRE(count_nodes(usage) == num_live_nodes - num_nodes);
+
+    for (std::size_t i = 1; i < keys.size(); i += 2)
+      REQUIRE(*map.Delete(keys[i]) == keys[i]);
+
+    map.reclaim_all();
+
+    usage = map.memory_usage();
+
+    REQUIRE(usage.num_leaves == 0);
+    REQUIRE(usage.leaf_bytes == 0);
+    REQUIRE(count_nodes(usage) == num_live_nodes - num_nodes);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTEmbeddedLeaves") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<std::uint64_t, art_counting_alloc_traits>
+        map;
+    std::map<std::uint64_t, std::uint64_t> key_values;
+    // Values with the top bit set could not be embedded.
+    constexpr std::uint64_t BIG_VALUE = std::uint64_t{1} << 63;
+    constexpr std::uint64_t NUM_KEYS = 100000;
+    auto num_nodes = num_live_nodes.load();
+
+    // Dense keys, so that leaves are at the last level.
+    for (std::uint64_t key = 0; key < NUM_KEYS; key++) {
+      auto value = key % 10 ? key : key | BIG_VALUE;
+
+      REQUIRE(map.Insert(key, value));
+      key_values[key] = value;
+    }
+
+    // Only inner nodes and leaves of big values are allocated.
+    REQUIRE(num_live_nodes <
+            num_nodes + static_cast<std::int64_t>(NUM_KEYS / 5));
+
+    for (const auto &kv : key_values) {
+      REQUIRE(*map.Search(kv.first) == kv.second);
+      REQUIRE(map.Insert(kv.first, 0) == false);
+    }
+
+    REQUIRE(map.Search(NUM_KEYS).has_value() == false);
+
+    // Move values between embedded and allocated leaves.
+    for (auto &kv : key_values) {
+      if (kv.first % 3 == 0) {
+        REQUIRE(*map.Update(kv.first, kv.second ^ BIG_VALUE) == kv.second);
+        kv.second ^= BIG_VALUE;
+      } else if (kv.first % 3 == 1) {
+        REQUIRE(*map.Upsert(kv.first, [](std::uint64_t &v) { v += 2; }) ==
+                kv.second);
+        kv.second += 2;
+      }
+    }
+
+    std::vector<std::uint64_t> keys;
+    std::vector<std::optional<std::uint64_t>> values(key_values.size());
+
+    for (const auto &kv : key_values)
+      keys.push_back(kv.first);
+
+    map.MultiSearch(keys, values);
+
+    for (std::size_t i = 0; i < keys.size(); i++)
+      REQUIRE(*values[i] == key_values[keys[i]]);
+
+    auto same = [](const auto &kv1, const auto &kv2) {
+      return kv1.first == kv2.first && kv1.second == kv2.second;
+    };
+
+    REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                       key_values.end(), same));
+    REQUIRE(std::equal(map.rbegin(), map.rend(), key_values.rbegin(),
+                       key_values.rend(), same));
+    REQUIRE(map.lower_bound(NUM_KEYS / 2)->first == NUM_KEYS / 2);
+    REQUIRE(map.upper_bound(NUM_KEYS / 2)->first == NUM_KEYS / 2 + 1);
+
+    for (auto it = key_values.begin(); it != key_values.end();) {
+      if (it->first % 2) {
+        REQUIRE(*map.Delete(it->first) == it->second);
+        REQUIRE(map.Search(it->first).has_value() == false);
+        it = key_values.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    REQUIRE(map.size() == key_values.size());
+    REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                       key_values.end(), same));
+  }
+  REQUIRE(num_live_nodes == 0);
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTNodeKeyMatch") {
+  using map_t = indexes::art::concurrent_map<std::uint64_t>;
+  // Keys of a single node (at the last level), which differ in their last
+  // byte. Bytes with their high bit set (or clear) and 0x00 and 0xFF, catch
+  // carries and borrows of word (SWAR) matching.
+  constexpr std::uint64_t PREFIX = 0x0102030405060700;
+
+  auto test_node = [](const std::vector<std::uint8_t> &bytes,
+                      std::size_t min_size, auto num_nodes_of) {
+    const std::size_t num_bytes = bytes.size();
+    map_t map;
+    std::map<std::uint64_t, std::uint64_t> key_values;
+    std::mt19937 rnd{42};
+
+    auto check = [&] {
+      for (int byte = 0; byte < 256; byte++) {
+        auto it = key_values.find(PREFIX | byte);
+        auto value = map.Search(PREFIX | byte);
+
+        REQUIRE(value.has_value() == (it != key_values.end()));
+        if (value)
+          REQUIRE(*value == it->second);
+      }
+
+      REQUIRE(num_nodes_of(map.memory_usage()) == 1);
+    };
+    auto insert = [&](std::uint8_t byte, std::uint64_t value) {
+      REQUIRE(map.Insert(PREFIX | byte, value));
+      key_values[PREFIX | byte] = value;
+    };
+    auto remove = [&](std::uint8_t byte) {
+      REQUIRE(map.Delete(PREFIX | byte) == key_values[PREFIX | byte]);
+      key_values.erase(PREFIX | byte);
+    };
+
+    for (std::size_t i = 0; i + 1 < num_bytes; i++)
+      insert(bytes[i], i);
+    check();
+
+    // Deleted slot keeps it's byte, which is then added again to another
+    // slot.
+    remove(bytes[0]);
+    check();
+    insert(bytes[0], num_bytes);
+    check();
+
+    // Full node is compacted, and the byte added to a freed slot.
+    insert(bytes[num_bytes - 1], num_bytes + 1);
+    check();
+
+    for (std::uint64_t i = 0; i < 2000; i++) {
+      std::uint8_t byte = bytes[rnd() % num_bytes];
+
+      if (key_values.count(PREFIX | byte) == 0)
+        insert(byte, i);
+      else if (key_values.size() > min_size)
+        remove(byte);
+
+      check();
+    }
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  test_node({0x80, 0x00, 0x7F, 0xFF}, 2,
+            [](const auto &usage) { return usage.num_node4; });
+  test_node({0x80, 0x00, 0x7F, 0xFF, 0x01, 0xFE, 0x81, 0x40, 0x10, 0x11,
+             0xC0, 0x08, 0x20, 0x90, 0x02, 0xF0},
+            5, [](const auto &usage) {
+              return usage.num_node48 ? 0 : usage.num_node16;
+            });
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTInPlaceCompaction") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    indexes::art::concurrent_map<std::uint64_t, art_counting_alloc_traits>
+        map;
+    // Keys of a single node16 (with leaves embedded), of which the first
+    // half are searched, while the rest are deleted and inserted again by
+    // writers, each of it's own keys. Node is never full without deleted
+    // slots, so it is compacted in place, while it is read and written by
+    // the other threads.
+    constexpr std::uint64_t NUM_KEYS = 16;
+    constexpr int NUM_WRITERS = 4;
+    constexpr int NUM_READERS = 2;
+    constexpr int NUM_ROUNDS = 10000;
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> num_mismatches{0};
+    std::atomic<bool> all_applied{true};
+    std::vector<std::thread> readers, writers;
+
+    for (std::uint64_t key = 0; key < NUM_KEYS; key++)
+      REQUIRE(map.Insert(key, key + 1));
+
+    map.reclaim_all();
+
+    auto num_nodes = num_live_nodes.load();
+
+    for (int reader = 0; reader < NUM_READERS; reader++) {
+      readers.emplace_back([&]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+        while (!done) {
+          for (std::uint64_t key = 0; key < NUM_KEYS / 2; key++) {
+            auto value = map.Search(key);
+
+            if (!value || *value != key + 1)
+              num_mismatches++;
+          }
+        }
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (int writer = 0; writer < NUM_WRITERS; writer++) {
+      writers.emplace_back([&, writer]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+        bool applied = true;
+
+        for (int round = 0; round < NUM_ROUNDS; round++) {
+          for (std::uint64_t key = NUM_KEYS / 2 + writer; key < NUM_KEYS;
+               key += NUM_WRITERS) {
+            applied &= map.Delete(key) == key + 1;
+            applied &= map.Insert(key, key + 1);
+          }
+        }
+
+        if (!applied)
+          all_applied = false;
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (auto &writer : writers)
+      writer.join();
+    done = true;
+    for (auto &reader : readers)
+      reader.join();
+
+    REQUIRE(all_applied);
+    REQUIRE(num_mismatches == 0);
+
+    for (std::uint64_t key = 0; key < NUM_KEYS; key++)
+      REQUIRE(map.Search(key) == key + 1);
+
+    // Node was never replaced.
+    REQUIRE(map.memory_usage().retired_bytes == 0);
+    REQUIRE(num_live_nodes == num_nodes);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTBulkLoad") {
+  using map_t =
+      indexes::art::concurrent_map<std::uint64_t, art_counting_alloc_traits>;
+
+  auto count_nodes = [](const indexes::art::art_memory_usage_t &usage) {
+    return static_cast<std::int64_t>(usage.num_node4 + usage.num_node16 +
+                                     usage.num_node48 + usage.num_node256 +
+                                     usage.num_leaves);
+  };
+  auto same = [](const auto &kv1, const auto &kv2) {
+    return kv1.first == kv2.first && kv1.second == kv2.second;
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    std::mt19937_64 rnd(0);
+    std::map<std::uint64_t, std::uint64_t> key_values;
+
+    // Dense keys (with embedded leaves) and sparse ones.
+    for (std::uint64_t key = 0; key < 65536; key++)
+      key_values[key] = key;
+
+    for (int i = 0; i < 100000; i++) {
+      auto key = rnd() | std::uint64_t{1} << 63;
+      key_values[key] = key;
+    }
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> sorted(
+        key_values.begin(), key_values.end());
+
+    for (int num_threads : {1, 4}) {
+      auto num_nodes = num_live_nodes.load();
+      map_t map;
+
+      REQUIRE(map.bulk_load(sorted.begin(), sorted.begin()));
+      REQUIRE(map.bulk_load(sorted.begin(), sorted.end(), num_threads));
+      REQUIRE(map.bulk_load(sorted.begin(), sorted.end()) == false);
+      REQUIRE(map.size() == key_values.size());
+
+      auto usage = map.memory_usage();
+
+      // Nodes are not expanded (or retired) while loaded.
+      REQUIRE(usage.retired_bytes == 0);
+      REQUIRE(count_nodes(usage) == num_live_nodes - num_nodes);
+      // Inner nodes of the dense keys are node256.
+      REQUIRE(usage.num_node256 >= 256);
+      REQUIRE(usage.num_leaves == key_values.size() - 65536);
+
+      for (const auto &kv : key_values)
+        REQUIRE(*map.Search(kv.first) == kv.second);
+
+      REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                         key_values.end(), same));
+
+      for (std::uint64_t key = 0; key < 65536; key += 2)
+        REQUIRE(*map.Delete(key) == key);
+
+      REQUIRE(map.Insert(65536, 0));
+      REQUIRE(map.size() == key_values.size() - 32768 + 1);
+    }
+
+    map_t map;
+
+    REQUIRE(map.bulk_load(sorted.begin(), sorted.begin() + 1));
+    REQUIRE(*map.Search(0) == 0);
+    REQUIRE(map.size() == 1);
+
+    // Once every slot of the registry is taken, loader threads could not be
+    // registered, and leave their children to the calling thread.
+    std::atomic<bool> release{false};
+    std::vector<std::thread> holders;
+
+    for (bool full = false; !full;) {
+      std::atomic<int> registered{-1};
+
+      holders.emplace_back([&]() {
+        if (!indexes::utils::ThreadRegistry::RegisterThread()) {
+          registered = 0;
+          return;
+        }
+
+        registered = 1;
+        while (!release)
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+
+      while (registered == -1)
+        std::this_thread::yield();
+      full = registered == 0;
+    }
+
+    map_t full_map;
+
+    REQUIRE(full_map.bulk_load(sorted.begin(), sorted.end(), 4));
+
+    release = true;
+    for (auto &holder : holders)
+      holder.join();
+
+    REQUIRE(full_map.size() == key_values.size());
+    REQUIRE(std::equal(full_map.begin(), full_map.end(), key_values.begin(),
+                       key_values.end(), same));
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ConcurrentARTInsertBatch") {
+  using map_t = indexes::art::concurrent_map<std::uint64_t>;
+
+  auto same = [](const auto &kv1, const auto &kv2) {
+    return kv1.first == kv2.first && kv1.second == kv2.second;
+  };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    map_t map;
+    std::mt19937_64 rnd(0);
+    std::map<std::uint64_t, std::uint64_t> key_values;
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> batch;
+
+    // Some keys of the batch are inserted before.
+    for (int i = 0; i < 100000; i++) {
+      std::uint64_t key = i % 2 ? rnd() : rnd() % 100000;
+
+      batch.emplace_back(key, i);
+
+      if (i % 5 == 0 && key_values.emplace(key, i).second)
+        REQUIRE(map.Insert(key, i));
+    }
+
+    std::size_t num_before = key_values.size();
+
+    for (const auto &kv : batch)
+      key_values.emplace(kv.first, kv.second);
+
+    std::sort(batch.begin(), batch.end());
+
+    REQUIRE(map.InsertBatch(batch) == key_values.size() - num_before);
+    REQUIRE(map.size() == key_values.size());
+    REQUIRE(std::equal(map.begin(), map.end(), key_values.begin(),
+                       key_values.end(), same));
+
+    // Unsorted, and all present.
+    std::shuffle(batch.begin(), batch.end(), rnd);
+
+    REQUIRE(map.InsertBatch(batch) == 0);
+    REQUIRE(map.size() == key_values.size());
+  }
+
+  {
+    map_t map;
+    constexpr int NUM_THREADS = 4;
+    constexpr std::uint64_t NUM_KEYS = 100000;
+    std::atomic<std::size_t> num_inserted{0};
+    std::vector<std::thread> threads;
+
+    // Every key is in the batches of 2 threads.
+    for (int t = 0; t < NUM_THREADS; t++) {
+      threads.emplace_back([&, t]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> batch;
+
+        for (std::uint64_t key = t; key < NUM_KEYS; key += 2) {
+          batch.emplace_back(key * 1000, key);
+
+          if (key % 64 == 0) {
+            num_inserted += map.InsertBatch(batch);
+            batch.clear();
+          }
+        }
+
+        num_inserted += map.InsertBatch(batch);
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (auto &thread : threads)
+      thread.join();
+
+    REQUIRE(num_inserted == NUM_KEYS);
+    REQUIRE(map.size() == NUM_KEYS);
+
+    for (std::uint64_t key = 0; key < NUM_KEYS; key++)
+      REQUIRE(*map.Search(key * 1000) == key);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
 TEST_SUITE_END();
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <inttypes.h>
 #include <limits>
 #include <map>
+#include <optional>
 #include <random>
 #include <string>
 #include <thread>
@@ -104,6 +105,112 @@ template <typename MapType> void MixedMapTest() {
   indexes::utils::ThreadRegistry::UnregisterThread();
 }
 
+template <typename MapType, typename KeyType = int> void MultiSearchTest() {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  MapType map;
+
+  constexpr int num_keys = 100000;
+  constexpr int num_batches = 1000;
+  constexpr int max_batch_size = 300;
+
+  std::random_device r;
+  std::seed_seq seed{r(), r(), r(), r(), r(), r(), r(), r()};
+  std::mt19937 rnd(seed);
+
+  std::uniform_int_distribution<int> key_dist{1, num_keys * 2};
+  std::uniform_int_distribution<int> batch_size_dist{1, max_batch_size};
+
+  std::map<KeyType, int> key_values;
+
+  for (int i = 0; i < num_keys; i++) {
+    auto key = static_cast<KeyType>(key_dist(rnd));
+
+    map.Upsert(key, i);
+    key_values[key] = i;
+  }
+
+  std::vector<KeyType> keys;
+  std::vector<std::optional<int>> values;
+
+  for (int i = 0; i < num_batches; i++) {
+    keys.resize(batch_size_dist(rnd));
+    values.assign(keys.size(), std::nullopt);
+
+    for (auto &key : keys)
+      key = static_cast<KeyType>(key_dist(rnd));
+
+    map.MultiSearch(keys, values);
+
+    for (size_t j = 0; j < keys.size(); j++) {
+      auto it = key_values.find(keys[j]);
+
+      if (it != key_values.end())
+        REQUIRE(*values[j] == it->second);
+      else
+        REQUIRE(values[j].has_value() == false);
+    }
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+template <typename MapType, typename KeyType = int>
+void FunctionalUpdateTest() {
+  constexpr int num_keys = 10000;
+  constexpr int num_threads = 4;
+  constexpr int num_increments = 5;
+  constexpr int expected = num_threads * num_increments;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  MapType map;
+  auto increment = [](int &value) { value++; };
+
+  REQUIRE(!map.Update(0, increment).has_value());
+  REQUIRE(!map.Search(0).has_value());
+
+  // Missing values are default constructed.
+  REQUIRE(!map.Upsert(0, increment).has_value());
+  REQUIRE(map.Search(0) == 1);
+  REQUIRE(map.Update(0, increment) == 1);
+  REQUIRE(map.Search(0) == 2);
+  REQUIRE(map.Delete(0) == 2);
+
+  // Concurrent increments are not lost.
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < num_threads; t++) {
+    workers.emplace_back([&]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+
+      for (int i = 0; i < num_increments; i++) {
+        for (int key = 0; key < num_keys; key++)
+          map.Upsert(static_cast<KeyType>(key), increment);
+      }
+
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    });
+  }
+
+  for (auto &worker : workers)
+    worker.join();
+
+  for (int key = 0; key < num_keys; key++) {
+    auto k = static_cast<KeyType>(key);
+
+    REQUIRE(map.Search(k) == expected);
+    REQUIRE(map.Update(k, [](int &value) { value = -value; }) == expected);
+    REQUIRE(map.Search(k) == -expected);
+  }
+
+  // Plain values still pick the non functional overloads.
+  REQUIRE(map.Upsert(0, 7) == -expected);
+  REQUIRE(map.Update(0, 8) == 7);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
 template <typename MapType, LookupType LkType, typename LookupOp>
 static void lookup_worker(MapType &map, gsl::span<const int64_t> vals,
                           int64_t min_val, int64_t max_val,
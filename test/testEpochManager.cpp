@@ -0,0 +1,315 @@
+#include "indexes/utils/EpochManager.h"
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST_SUITE_BEGIN("epoch_manager");
+
+namespace {
+using epoch_manager = indexes::utils::EpochManager<uint64_t, int>;
+
+std::atomic<int> num_reclaimed{0};
+
+void count_reclaimed(int *) { num_reclaimed++; }
+
+// Waits upto a second for `num` objects to be reclaimed.
+bool wait_for_reclaimed(int num) {
+  for (int i = 0; i < 1000 && num_reclaimed < num; i++)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  return num_reclaimed >= num;
+}
+} // namespace
+
+TEST_CASE("EpochManagerRetire") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr int num_objects = epoch_manager::RETIRE_BATCH_SIZE * 10 + 1;
+  epoch_manager gc;
+  std::vector<int> values(num_objects);
+  std::vector<int *> objects;
+
+  for (auto &value : values)
+    objects.push_back(&value);
+
+  num_reclaimed = 0;
+
+  // Objects are not reclaimed, while a thread is in their epoch.
+  gc.enter_epoch();
+
+  for (auto object : objects)
+    gc.retire_in_new_epoch(count_reclaimed, object);
+
+  REQUIRE(gc.do_reclaim() == num_objects);
+  REQUIRE(num_reclaimed == 0);
+
+  gc.exit_epoch();
+
+  REQUIRE(gc.do_reclaim() == 0);
+  REQUIRE(num_reclaimed == num_objects);
+
+  // Batches of reclaimed objects are reused.
+  for (int round = 0; round < 100; round++) {
+    gc.retire_in_new_epoch(count_reclaimed, objects);
+    REQUIRE(gc.do_reclaim() == 0);
+  }
+
+  REQUIRE(num_reclaimed == num_objects * 101);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("EpochManagerBackgroundReclamation") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr int num_batches = 10;
+  constexpr int num_objects = epoch_manager::RETIRE_BATCH_SIZE * num_batches;
+  epoch_manager gc;
+  std::vector<int> values(num_objects);
+  std::vector<int *> objects;
+
+  for (auto &value : values)
+    objects.push_back(&value);
+
+  num_reclaimed = 0;
+  gc.start_background_reclamation(std::chrono::microseconds(100));
+
+  // Epoch is never advanced by the writer, which then goes idle. All, but
+  // the batch being filled, are reclaimed by the reclaimer thread.
+  std::thread writer{[&] {
+    indexes::utils::ThreadRegistry::RegisterThread();
+
+    for (auto object : objects)
+      gc.retire_in_current_epoch(count_reclaimed, object);
+
+    indexes::utils::ThreadRegistry::UnregisterThread();
+  }};
+
+  writer.join();
+
+  REQUIRE(wait_for_reclaimed(num_objects - epoch_manager::RETIRE_BATCH_SIZE));
+
+  // Objects are not reclaimed, while a thread is in their epoch.
+  gc.enter_epoch();
+
+  int num_reclaimed_before = num_reclaimed;
+
+  gc.retire_in_current_epoch(count_reclaimed, objects);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  REQUIRE(num_reclaimed == num_reclaimed_before);
+
+  gc.exit_epoch();
+
+  // Batches being filled by both threads are left.
+  REQUIRE(wait_for_reclaimed(num_objects * 2 -
+                             epoch_manager::RETIRE_BATCH_SIZE * 2));
+
+  gc.stop_background_reclamation();
+  gc.reclaim_all();
+
+  REQUIRE(num_reclaimed == num_objects * 2);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("EpochManagerRecycle") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr int num_batches = 10;
+  constexpr int num_objects = epoch_manager::RETIRE_BATCH_SIZE * num_batches;
+  epoch_manager gc;
+  std::vector<int> values(num_objects);
+  std::vector<int *> objects;
+
+  for (auto &value : values)
+    objects.push_back(&value);
+
+  static std::atomic<int> num_foreign_reclaims;
+  static std::thread::id writer_id;
+
+  num_reclaimed = 0;
+  num_foreign_reclaims = 0;
+  writer_id = std::this_thread::get_id();
+
+  gc.start_background_reclamation(std::chrono::microseconds(100), true);
+  gc.retire_in_current_epoch(
+      [](int *) {
+        if (std::this_thread::get_id() != writer_id)
+          num_foreign_reclaims++;
+
+        num_reclaimed++;
+      },
+      objects);
+
+  // Reclaimer thread hands safe batches back, without reclaiming them.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+  REQUIRE(num_reclaimed == 0);
+
+  // Which are reclaimed by the writer, along with the batch being filled.
+  for (int i = 0; i < 1000 && num_reclaimed < num_objects; i++) {
+    gc.do_reclaim();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  REQUIRE(num_reclaimed == num_objects);
+  REQUIRE(num_foreign_reclaims == 0);
+
+  gc.stop_background_reclamation();
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("EpochManagerConcurrentBatches") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr int num_threads = 4;
+  constexpr int num_batches = 200;
+  constexpr int num_objects_per_thread =
+      epoch_manager::RETIRE_BATCH_SIZE * num_batches;
+  constexpr int num_objects = num_objects_per_thread * num_threads;
+
+  // Objects are indexes of their reclaim counts.
+  static std::unique_ptr<std::atomic<int>[]> reclaim_counts;
+  std::vector<int> values(num_objects);
+  auto count_once = [](int *value) { reclaim_counts[*value]++; };
+
+  for (int i = 0; i < num_objects; i++)
+    values[i] = i;
+
+  for (bool recycle : {false, true}) {
+    epoch_manager gc;
+    std::vector<std::thread> writers;
+
+    reclaim_counts = std::make_unique<std::atomic<int>[]>(num_objects);
+    gc.start_background_reclamation(std::chrono::microseconds(100), recycle);
+
+    // Writers retire many batches each, pausing every few of them, so that
+    // the reclaimer thread gets to hand batches back to be reused.
+    for (int t = 0; t < num_threads; t++) {
+      writers.emplace_back([&, t] {
+        indexes::utils::ThreadRegistry::RegisterThread();
+
+        for (int i = 0; i < num_objects_per_thread; i++) {
+          gc.retire_in_current_epoch(count_once,
+                                     &values[t * num_objects_per_thread + i]);
+
+          if ((i + 1) % (epoch_manager::RETIRE_BATCH_SIZE * 10) == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (auto &writer : writers)
+      writer.join();
+
+    gc.stop_background_reclamation();
+    gc.reclaim_all();
+
+    int num_mismatches = 0;
+
+    for (int i = 0; i < num_objects; i++) {
+      if (reclaim_counts[i] != 1)
+        num_mismatches++;
+    }
+
+    auto stats = gc.stats();
+
+    REQUIRE(num_mismatches == 0);
+    REQUIRE(stats.num_retired == 0);
+    REQUIRE(stats.num_batches < num_threads * num_batches / 4);
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("EpochManagerStats") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  constexpr int num_objects = 100;
+  epoch_manager gc{[](int *) { return sizeof(int); }};
+  std::vector<int> values(num_objects);
+  std::vector<int *> objects;
+  std::atomic<bool> stalled{false};
+  std::atomic<int> stalled_thread{-1};
+
+  for (auto &value : values)
+    objects.push_back(&value);
+
+  num_reclaimed = 0;
+  gc.set_stall_callback(std::chrono::milliseconds(1),
+                        [&](int thread_id, uint64_t, auto) {
+                          stalled_thread = thread_id;
+                          stalled = true;
+                        });
+
+  // A reader pins it's epoch, until it's told to exit.
+  std::atomic<bool> entered{false};
+  std::atomic<bool> exit{false};
+  std::atomic<int> reader_id{-1};
+  std::thread reader{[&] {
+    indexes::utils::ThreadRegistry::RegisterThread();
+
+    reader_id = indexes::utils::ThreadRegistry::ThreadID();
+    gc.enter_epoch();
+    entered = true;
+
+    while (!exit)
+      std::this_thread::yield();
+
+    gc.exit_epoch();
+    indexes::utils::ThreadRegistry::UnregisterThread();
+  }};
+
+  while (!entered)
+    std::this_thread::yield();
+
+  uint64_t pinned_epoch = gc.now();
+
+  gc.retire_in_new_epoch(count_reclaimed, objects);
+
+  // Reclaim passes observe the reader, until it's pinned long enough.
+  for (int i = 0; i < 1000 && !stalled; i++) {
+    gc.do_reclaim();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  auto stats = gc.stats();
+
+  REQUIRE(stalled);
+  REQUIRE(stalled_thread == reader_id);
+  REQUIRE(stats.oldest_pinned_thread == reader_id);
+  REQUIRE(stats.oldest_pinned_epoch == pinned_epoch);
+  REQUIRE(stats.global_epoch > pinned_epoch);
+  REQUIRE(stats.num_retired == num_objects);
+  REQUIRE(stats.retired_bytes == num_objects * sizeof(int));
+  REQUIRE(
+      stats.thread_num_retired[indexes::utils::ThreadRegistry::ThreadID()] ==
+      num_objects);
+  REQUIRE(stats.num_reclaims > 0);
+  REQUIRE(stats.max_reclaim_time.count() > 0);
+  REQUIRE(num_reclaimed == 0);
+
+  exit = true;
+  reader.join();
+
+  REQUIRE(gc.do_reclaim() == 0);
+
+  stats = gc.stats();
+
+  REQUIRE(stats.oldest_pinned_thread == -1);
+  REQUIRE(stats.num_retired == 0);
+  REQUIRE(stats.retired_bytes == 0);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_SUITE_END();
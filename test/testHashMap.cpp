@@ -1,17 +1,109 @@
 #include "indexes/hashtable/concurrent_map.h"
+#include "indexes/hashtable/sharded_map.h"
 #include "sha512.h"
 #include "testConcurrentMapUtils.h"
 
 #include <absl/hash/hash.h>
 #include <doctest/doctest.h>
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
 #include <random>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 TEST_SUITE_BEGIN("hashtable");
 
+namespace {
+struct hashtable_control_bytes_traits
+    : indexes::hashtable::hashtable_traits_debug {
+  static constexpr bool CONTROL_BYTES = true;
+};
+
+struct hashtable_lock_free_traits : indexes::hashtable::hashtable_traits_debug {
+  static constexpr bool LOCK_FREE = true;
+};
+
+// Hashes std::string and std::string_view keys alike.
+struct transparent_string_hash {
+  using is_transparent = void;
+
+  size_t operator()(std::string_view key) const {
+    return absl::Hash<std::string_view>{}(key);
+  }
+};
+
+template <typename Traits>
+using int_map =
+    indexes::hashtable::concurrent_map<int, int, absl::Hash<int>, Traits>;
+
+template <typename Traits>
+using sharded_int_map =
+    indexes::hashtable::sharded_map<int, int, 8, absl::Hash<int>, Traits>;
+
+template <typename Map> void ConcurrentResizeTest() {
+  constexpr int num_threads = 4;
+  constexpr int num_keys_per_thread = 200000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  // Tables are migrated many times, while keys are inserted, updated and
+  // searched concurrently.
+  Map map;
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < num_threads; t++) {
+    workers.emplace_back([&, t]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+
+      int first_key = t * num_keys_per_thread;
+
+      for (int i = 0; i < num_keys_per_thread; i++) {
+        int key = first_key + i;
+
+        REQUIRE(map.Insert(key, key));
+
+        // Keys are never missed, while their chains are moved.
+        int old_key = first_key + i / 2;
+
+        REQUIRE(map.Search(old_key) == old_key);
+
+        if (i % 2)
+          REQUIRE(map.Upsert(old_key, [](int &value) { value++; }));
+      }
+
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    });
+  }
+
+  for (auto &worker : workers)
+    worker.join();
+
+  map.reserve(num_threads * num_keys_per_thread * 2);
+
+  REQUIRE(map.size() == num_threads * num_keys_per_thread);
+
+  for (int t = 0; t < num_threads; t++) {
+    int first_key = t * num_keys_per_thread;
+
+    for (int i = 0; i < num_keys_per_thread; i++) {
+      int key = first_key + i;
+      // Keys in the first half were incremented once per odd `i`, that
+      // visited them.
+      int num_increments = i < num_keys_per_thread / 2 ? 1 : 0;
+
+      REQUIRE(map.Search(key) == key + num_increments);
+    }
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+} // namespace
+
 TEST_CASE("HashMapBasic") {
   indexes::utils::ThreadRegistry::RegisterThread();
   indexes::hashtable::concurrent_map<int, int, absl::Hash<int>,
@@ -93,6 +185,16 @@ TEST_CASE("HashMapMixed") {
       int, int, absl::Hash<int>, indexes::hashtable::hashtable_traits_debug>>();
 }
 
+TEST_CASE("HashMapMultiSearch") {
+  MultiSearchTest<indexes::hashtable::concurrent_map<
+      int, int, absl::Hash<int>, indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("HashMapFunctionalUpdate") {
+  FunctionalUpdateTest<indexes::hashtable::concurrent_map<
+      int, int, absl::Hash<int>, indexes::hashtable::hashtable_traits_debug>>();
+}
+
 TEST_CASE("HashMapConcurrencyRandom") {
   ConcurrentMapTest<indexes::hashtable::concurrent_map<
                         int64_t, int64_t, absl::Hash<int64_t>,
@@ -101,4 +203,546 @@ TEST_CASE("HashMapConcurrencyRandom") {
       ConcurrentMapTestWorkload::WL_RANDOM, [] {});
 }
 
-TEST_SUITE_END();
\ No newline at end of file
+TEST_CASE("HashMapConcurrentResize") {
+  ConcurrentResizeTest<int_map<indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("HashMapCompaction") {
+  constexpr int num_keys = 100000;
+  constexpr int num_live_keys = 1000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  int_map<indexes::hashtable::hashtable_traits_debug> map;
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Insert(key, key));
+
+  size_t peak_bucket_count = map.bucket_count();
+
+  // Table shrinks, once most of it's keys are deleted.
+  for (int key = num_live_keys; key < num_keys; key++)
+    REQUIRE(map.Delete(key) == key);
+
+  REQUIRE(map.bucket_count() < peak_bucket_count / 16);
+  REQUIRE(map.size() == num_live_keys);
+
+  for (int key = 0; key < num_live_keys; key++)
+    REQUIRE(map.Search(key) == key);
+
+  // Tomb stones of churn do not grow the table.
+  for (int key = num_keys; key < num_keys * 10; key++) {
+    REQUIRE(map.Insert(key, key));
+    REQUIRE(map.Delete(key) == key);
+  }
+
+  REQUIRE(map.bucket_count() < peak_bucket_count / 16);
+  REQUIRE(map.size() == num_live_keys);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapMemoryUsage") {
+  constexpr int num_keys = 100000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  auto require_usage = [](const auto &map, size_t num_values) {
+    auto usage = map.memory_usage();
+
+    REQUIRE(usage.num_values == num_values);
+    REQUIRE(usage.num_buckets >= map.bucket_count());
+    REQUIRE(usage.bucket_bytes >= usage.num_buckets * sizeof(int) * 2);
+    REQUIRE(usage.total_bytes() > usage.bucket_bytes + usage.link_bytes);
+
+    return usage;
+  };
+
+  {
+    int_map<indexes::hashtable::hashtable_traits_debug> map;
+
+    for (int key = 0; key < num_keys; key++)
+      REQUIRE(map.Insert(key, key));
+
+    REQUIRE(require_usage(map, num_keys).num_tables >= 1);
+
+    for (int key = 0; key < num_keys; key += 2)
+      REQUIRE(map.Delete(key) == key);
+
+    REQUIRE(require_usage(map, num_keys / 2).num_tomb_stones <= num_keys / 2);
+  }
+
+  {
+    int_map<hashtable_control_bytes_traits> map;
+
+    for (int key = 0; key < num_keys; key++)
+      REQUIRE(map.Insert(key, key));
+
+    require_usage(map, num_keys);
+  }
+
+  {
+    sharded_int_map<indexes::hashtable::hashtable_traits_debug> map;
+
+    for (int key = 0; key < num_keys; key++)
+      REQUIRE(map.Insert(key, key));
+
+    auto usage = map.memory_usage();
+
+    REQUIRE(usage.num_values == num_keys);
+    REQUIRE(usage.num_tables >= map.NUM_SHARDS);
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapSpareTable") {
+  constexpr int num_keys = 100000;
+  constexpr int num_live_keys = 1000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  {
+    int_map<indexes::hashtable::hashtable_traits_debug> map;
+
+    for (int key = 0; key < num_keys; key++)
+      REQUIRE(map.Insert(key, key));
+
+    map.reclaim_all();
+
+    // Tables grown from are freed, instead of being kept with their values.
+    REQUIRE(map.memory_usage().spare_bytes == 0);
+
+    for (int key = num_live_keys; key < num_keys; key++)
+      REQUIRE(map.Delete(key) == key);
+
+    map.reclaim_all();
+
+    // Tables shrunk from are kept, to grow back to.
+    REQUIRE(map.memory_usage().spare_bytes > 0);
+  }
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapPrecomputedHash") {
+  constexpr int num_keys = 100000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  indexes::hashtable::concurrent_map<std::string, int, transparent_string_hash,
+                                     indexes::hashtable::hashtable_traits_debug>
+      map;
+  auto hasher = map.hash_function();
+  std::vector<std::string> keys;
+
+  for (int i = 0; i < num_keys; i++)
+    keys.push_back(sha512(std::to_string(i)));
+
+  for (int i = 0; i < num_keys; i++) {
+    size_t hash = hasher(keys[i]);
+
+    map.prefetch(hash);
+    REQUIRE(map.Insert(keys[i], i, hash));
+    REQUIRE(!map.Insert(keys[i], i, hash));
+    REQUIRE(map.Upsert(keys[i], i + 1, hash) == i);
+  }
+
+  REQUIRE(map.size() == num_keys);
+
+  for (int i = 0; i < num_keys; i++) {
+    std::string_view key = keys[i];
+
+    REQUIRE(map.Search(keys[i], hasher(keys[i])) == i + 1);
+    REQUIRE(map.Search(key) == i + 1);
+    REQUIRE(map.Search(key, hasher(key)) == i + 1);
+  }
+
+  REQUIRE(map.Search(std::string_view{"missing"}) == std::nullopt);
+
+  for (int i = 0; i < num_keys; i++) {
+    std::string_view key = keys[i];
+
+    if (i % 2)
+      REQUIRE(map.Delete(key) == i + 1);
+    else
+      REQUIRE(map.Delete(keys[i], hasher(key)) == i + 1);
+
+    REQUIRE(map.Search(key) == std::nullopt);
+  }
+
+  REQUIRE(map.empty());
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapControlBytesString") {
+  indexes::utils::ThreadRegistry::RegisterThread();
+  indexes::hashtable::concurrent_map<std::string, int, absl::Hash<std::string>,
+                                     hashtable_control_bytes_traits>
+      map;
+
+  int num_keys = 100000;
+
+  std::map<std::string, int> key_values;
+
+  for (int i = 0; i < num_keys; i++) {
+    std::string key = sha512(std::to_string(i));
+
+    REQUIRE(map.Insert(key, i));
+    key_values[key] = i;
+  }
+
+  REQUIRE(map.size() == key_values.size());
+
+  for (const auto &kv : key_values) {
+    REQUIRE(map.Search(kv.first) == kv.second);
+    REQUIRE(*map.Delete(kv.first) == kv.second);
+    REQUIRE(map.Search(kv.first) == std::nullopt);
+    REQUIRE(map.Insert(kv.first, kv.second));
+  }
+
+  REQUIRE(map.size() == key_values.size());
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapControlBytesGroupProbing") {
+  // Keys are their hashes, as mixed by the table (the inverse of it's
+  // multiply-xorshift), so that a key's group (bits 7 and up of it's hash)
+  // and tag (low 7 bits) are chosen by the test.
+  struct unmixed_hash {
+    size_t operator()(uint64_t key) const {
+      // Inverse of the multiplier (mod 2^64), by Newton's iteration.
+      constexpr uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+      uint64_t inverse = MULTIPLIER;
+
+      for (int i = 0; i < 5; i++)
+        inverse *= 2 - MULTIPLIER * inverse;
+
+      return (key ^ (key >> 32)) * inverse;
+    }
+  };
+
+  using map_t = indexes::hashtable::concurrent_map<
+      uint64_t, uint64_t, unmixed_hash, hashtable_control_bytes_traits>;
+
+  constexpr uint64_t TAG = 0x2A;
+  // Keys of the last group (whatever the # groups) and of the first one,
+  // all with the same tag, which matches every slot they are in.
+  auto last_group_key = [](uint64_t i) {
+    return i << 40 | uint64_t{0x1FFFFFFFF} << 7 | TAG;
+  };
+  auto first_group_key = [](uint64_t i) { return i << 40 | TAG; };
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    map_t map;
+
+    map.reserve(1000);
+
+    size_t num_buckets = map.bucket_count();
+
+    // A group holds 16 slots, so the last group fills up and keys of it's
+    // chain continue into the first group (wrapping around), and the next.
+    for (uint64_t i = 0; i < 40; i++)
+      REQUIRE(map.Insert(last_group_key(i), i));
+
+    // Keys of the first group probe past slots taken by the last group.
+    for (uint64_t i = 0; i < 16; i++)
+      REQUIRE(map.Insert(first_group_key(i), i));
+
+    // Tomb stones within the last and the first group.
+    for (uint64_t i : {3, 5, 15, 16, 20, 31})
+      REQUIRE(map.Delete(last_group_key(i)) == i);
+    for (uint64_t i : {0, 7})
+      REQUIRE(map.Delete(first_group_key(i)) == i);
+
+    auto require_keys = [&](std::vector<uint64_t> deleted_last,
+                            std::vector<uint64_t> deleted_first) {
+      auto is_deleted = [](const auto &deleted, uint64_t i) {
+        return std::find(deleted.begin(), deleted.end(), i) != deleted.end();
+      };
+
+      for (uint64_t i = 0; i < 40; i++) {
+        if (is_deleted(deleted_last, i))
+          REQUIRE(map.Search(last_group_key(i)) == std::nullopt);
+        else
+          REQUIRE(map.Search(last_group_key(i)) == i);
+      }
+
+      for (uint64_t i = 0; i < 16; i++) {
+        if (is_deleted(deleted_first, i))
+          REQUIRE(map.Search(first_group_key(i)) == std::nullopt);
+        else
+          REQUIRE(map.Search(first_group_key(i)) == i);
+      }
+
+      // Missing keys, whose tag matches slots of the probed groups.
+      REQUIRE(map.Search(last_group_key(1000)) == std::nullopt);
+      REQUIRE(map.Search(first_group_key(1000)) == std::nullopt);
+    };
+
+    require_keys({3, 5, 15, 16, 20, 31}, {0, 7});
+
+    // Deleted slots are not reused, keys are inserted again after them.
+    REQUIRE(map.Insert(last_group_key(5), 5));
+    REQUIRE(map.Insert(first_group_key(7), 7));
+    REQUIRE(!map.Insert(last_group_key(6), 6));
+
+    require_keys({3, 15, 16, 20, 31}, {0});
+
+    REQUIRE(map.bucket_count() == num_buckets);
+    REQUIRE(map.size() == 40 - 5 + 16 - 1);
+  }
+  {
+    // Readers probe the groups, while a writer deletes and inserts keys of
+    // them again, changing control bytes of the groups they read.
+    map_t map;
+    constexpr uint64_t NUM_STABLE_KEYS = 24;
+    constexpr uint64_t NUM_CHURN_KEYS = 8;
+    constexpr int NUM_READERS = 2;
+    constexpr int NUM_ROUNDS = 20000;
+    std::atomic<bool> done{false};
+    std::atomic<size_t> num_mismatches{0};
+    std::vector<std::thread> readers;
+
+    for (uint64_t i = 0; i < NUM_STABLE_KEYS + NUM_CHURN_KEYS; i++)
+      REQUIRE(map.Insert(last_group_key(i), i));
+
+    for (int reader = 0; reader < NUM_READERS; reader++) {
+      readers.emplace_back([&]() {
+        indexes::utils::ThreadRegistry::RegisterThread();
+        while (!done) {
+          for (uint64_t i = 0; i < NUM_STABLE_KEYS; i++) {
+            if (map.Search(last_group_key(i)) != i)
+              num_mismatches++;
+          }
+        }
+        indexes::utils::ThreadRegistry::UnregisterThread();
+      });
+    }
+
+    for (int round = 0; round < NUM_ROUNDS; round++) {
+      uint64_t i = NUM_STABLE_KEYS + round % NUM_CHURN_KEYS;
+
+      REQUIRE(map.Delete(last_group_key(i)) == i);
+      REQUIRE(map.Insert(last_group_key(i), i));
+    }
+
+    done = true;
+    for (auto &reader : readers)
+      reader.join();
+
+    REQUIRE(num_mismatches == 0);
+
+    for (uint64_t i = 0; i < NUM_STABLE_KEYS + NUM_CHURN_KEYS; i++)
+      REQUIRE(map.Search(last_group_key(i)) == i);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapControlBytesDefaultHash") {
+  constexpr uint64_t num_keys = 100000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+  {
+    // std::hash of integers is the identity (in libstdc++), so sequential
+    // keys only spread over groups and tags, once the table mixes them.
+    indexes::hashtable::concurrent_map<uint64_t, uint64_t,
+                                       std::hash<uint64_t>,
+                                       hashtable_control_bytes_traits>
+        map;
+
+    for (uint64_t key = 0; key < num_keys; key++)
+      REQUIRE(!map.Upsert(key, key));
+
+    REQUIRE(map.size() == num_keys);
+    REQUIRE(map.bucket_count() <= num_keys * 4);
+
+    for (uint64_t key = 0; key < num_keys; key++)
+      REQUIRE(map.Search(key) == key);
+  }
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("HashMapControlBytesMixed") {
+  MixedMapTest<int_map<hashtable_control_bytes_traits>>();
+}
+
+TEST_CASE("HashMapControlBytesMultiSearch") {
+  MultiSearchTest<int_map<hashtable_control_bytes_traits>>();
+}
+
+TEST_CASE("HashMapControlBytesFunctionalUpdate") {
+  FunctionalUpdateTest<int_map<hashtable_control_bytes_traits>>();
+}
+
+TEST_CASE("HashMapControlBytesConcurrencyRandom") {
+  ConcurrentMapTest<
+      indexes::hashtable::concurrent_map<int64_t, int64_t,
+                                         absl::Hash<int64_t>,
+                                         hashtable_control_bytes_traits>,
+      LookupType::LT_DEFAULT>(ConcurrentMapTestWorkload::WL_RANDOM, [] {});
+}
+
+TEST_CASE("HashMapControlBytesConcurrentResize") {
+  ConcurrentResizeTest<int_map<hashtable_control_bytes_traits>>();
+}
+
+TEST_CASE("HashMapLockFreeMixed") {
+  MixedMapTest<int_map<hashtable_lock_free_traits>>();
+}
+
+TEST_CASE("HashMapLockFreeMultiSearch") {
+  MultiSearchTest<int_map<hashtable_lock_free_traits>>();
+}
+
+TEST_CASE("HashMapLockFreeFunctionalUpdate") {
+  FunctionalUpdateTest<int_map<hashtable_lock_free_traits>>();
+}
+
+TEST_CASE("HashMapLockFreeConcurrencyRandom") {
+  ConcurrentMapTest<
+      indexes::hashtable::concurrent_map<int64_t, int64_t,
+                                         absl::Hash<int64_t>,
+                                         hashtable_lock_free_traits>,
+      LookupType::LT_DEFAULT>(ConcurrentMapTestWorkload::WL_RANDOM, [] {});
+}
+
+TEST_CASE("HashMapLockFreeConcurrentResize") {
+  ConcurrentResizeTest<int_map<hashtable_lock_free_traits>>();
+}
+
+TEST_CASE("HashMapLockFreeHotKeys") {
+  constexpr int num_threads = 4;
+  constexpr int num_keys = 8;
+  constexpr int num_ops_per_thread = 100000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  // Threads race to insert, increment and delete the same few keys.
+  indexes::hashtable::concurrent_map<std::string, int64_t,
+                                     absl::Hash<std::string>,
+                                     hashtable_lock_free_traits>
+      map;
+  std::atomic<int64_t> num_deleted{0};
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < num_threads; t++) {
+    workers.emplace_back([&, t]() {
+      indexes::utils::ThreadRegistry::RegisterThread();
+
+      for (int i = 0; i < num_ops_per_thread; i++) {
+        std::string key = std::to_string((i + t) % num_keys);
+
+        if (i % 64 == 63) {
+          if (auto val = map.Delete(key))
+            num_deleted += *val;
+        } else {
+          map.Upsert(key, [](int64_t &value) { value++; });
+        }
+      }
+
+      indexes::utils::ThreadRegistry::UnregisterThread();
+    });
+  }
+
+  for (auto &worker : workers)
+    worker.join();
+
+  int64_t num_increments = num_deleted;
+
+  for (int k = 0; k < num_keys; k++)
+    num_increments += map.Search(std::to_string(k)).value_or(0);
+
+  REQUIRE(map.size() <= num_keys);
+  REQUIRE(num_increments ==
+          num_threads * (num_ops_per_thread - num_ops_per_thread / 64));
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("ShardedHashMapMixed") {
+  MixedMapTest<sharded_int_map<indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("ShardedHashMapMultiSearch") {
+  MultiSearchTest<
+      sharded_int_map<indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("ShardedHashMapFunctionalUpdate") {
+  FunctionalUpdateTest<
+      sharded_int_map<indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("ShardedHashMapConcurrentResize") {
+  ConcurrentResizeTest<
+      sharded_int_map<indexes::hashtable::hashtable_traits_debug>>();
+}
+
+TEST_CASE("ShardedHashMapPlacement") {
+  constexpr int num_keys = 100000;
+
+  indexes::utils::ThreadRegistry::RegisterThread();
+
+  // Identity hash of std::hash<int> must still spread keys over all shards.
+  indexes::hashtable::sharded_map<int, int, 16, std::hash<int>,
+                                  indexes::hashtable::hashtable_traits_debug>
+      map;
+  int num_nodes = indexes::utils::numa::num_nodes();
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Insert(key, key));
+
+  REQUIRE(map.size() == num_keys);
+
+  for (size_t shard = 0; shard < map.NUM_SHARDS; shard++) {
+    REQUIRE(map.shard(shard).size() > num_keys / map.NUM_SHARDS / 2);
+    REQUIRE(map.shard_node(shard) ==
+            (num_nodes > 1 ? static_cast<int>(shard % num_nodes) : -1));
+  }
+
+  for (int key = 0; key < num_keys; key++)
+    REQUIRE(map.Delete(key) == key);
+
+  REQUIRE(map.empty());
+
+  // Arrays of a page or more are mapped separately, when placed on a node.
+  auto arr = indexes::utils::numa::make_unique_array<int64_t>(1 << 20, 0);
+
+  for (int i = 0; i < (1 << 20); i++)
+    REQUIRE(arr[i] == 0);
+
+  indexes::utils::ThreadRegistry::UnregisterThread();
+}
+
+TEST_CASE("NumaAffinity") {
+  namespace numa = indexes::utils::numa;
+
+  // Affinity and memory policy are per thread, keep them off the test thread.
+  std::thread([] {
+    auto cpus = numa::node_cpus(0);
+
+    if (!cpus.empty()) {
+      REQUIRE(numa::run_on_cpu(cpus.back()));
+      REQUIRE(numa::current_node() == 0);
+      REQUIRE(numa::run_on_node(0));
+    }
+
+    REQUIRE(!numa::run_on_cpu(-1));
+
+#if defined(__linux__)
+    REQUIRE(numa::set_memory_policy(numa::memory_policy::interleave));
+
+    std::vector<int64_t> interleaved(1 << 20, 1);
+
+    REQUIRE(interleaved.back() == 1);
+
+    REQUIRE(numa::set_memory_policy(numa::memory_policy::local));
+#endif
+  }).join();
+}
+
+TEST_SUITE_END();